@@ -0,0 +1,75 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdint.h>
+
+#define ARENA_ALIGNMENT alignof(max_align_t)
+
+static ArenaBlock* addBlock(Arena *arena, size_t size) {
+    ArenaBlock *block = (ArenaBlock *)malloc(sizeof(ArenaBlock) + size);
+    if (!block) return NULL;
+    block->data = (char *)(block + 1);
+    block->size = size;
+    block->used = 0;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    return block;
+}
+
+Arena* arena_create(size_t blockSize) {
+    Arena *arena = (Arena *)malloc(sizeof(Arena));
+    arena->blocks = NULL;
+    arena->blockSize = blockSize > 0 ? blockSize : 4096;
+    return arena;
+}
+
+void* arena_alloc(Arena *arena, size_t size) {
+    ArenaBlock *block = arena->blocks;
+    if (block) {
+        uintptr_t at = ((uintptr_t)(block->data + block->used) + ARENA_ALIGNMENT - 1) &
+                       ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+        size_t offset = (size_t)(at - (uintptr_t)block->data);
+        if (offset + size <= block->size) {
+            block->used = offset + size;
+            return block->data + offset;
+        }
+    }
+
+    // Room for the request plus the worst-case alignment shift
+    size_t needed = size + ARENA_ALIGNMENT;
+    ArenaBlock *current = arena->blocks;
+    block = addBlock(arena, needed > arena->blockSize ? needed : arena->blockSize);
+    if (!block) return NULL;
+    if (needed > arena->blockSize && current) {
+        // An oversized block is used up at once; keep filling the current one
+        arena->blocks = current;
+        block->next = current->next;
+        current->next = block;
+    }
+    uintptr_t at = ((uintptr_t)block->data + ARENA_ALIGNMENT - 1) & ~(uintptr_t)(ARENA_ALIGNMENT - 1);
+    size_t offset = (size_t)(at - (uintptr_t)block->data);
+    block->used = offset + size;
+    return block->data + offset;
+}
+
+void* arena_copy(Arena *arena, const void *data, size_t size) {
+    void *copy = arena_alloc(arena, size);
+    if (copy && size > 0) memcpy(copy, data, size);
+    return copy;
+}
+
+char* arena_strdup(Arena *arena, const char *text) {
+    return (char *)arena_copy(arena, text, strlen(text) + 1);
+}
+
+void arena_free(Arena *arena) {
+    if (!arena) return;
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
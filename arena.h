@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    size_t size;
+    size_t used;
+    char *data;
+} ArenaBlock;
+
+// Bump allocator for memory that dies together. Allocations are carved from
+// large blocks and never freed one by one; arena_free releases every block.
+typedef struct {
+    ArenaBlock *blocks;   // newest first
+    size_t blockSize;
+} Arena;
+
+Arena* arena_create(size_t blockSize);
+// Aligned for any type; larger requests than blockSize get a block of their own
+void* arena_alloc(Arena *arena, size_t size);
+void* arena_copy(Arena *arena, const void *data, size_t size);
+char* arena_strdup(Arena *arena, const char *text);
+void arena_free(Arena *arena);
+
+#endif
@@ -10,23 +10,146 @@
  */
 
 #include "autocomplete.h"
+#include "arena.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /* Global autocomplete context */
 static autocomplete_context_t g_autocomplete_ctx = {0};
 
 /* Internal helper functions */
-static trie_node_t* create_trie_node(void);
-static void destroy_trie(trie_node_t *node);
+static trie_node_t* trie_root(void);
+static trie_node_t* find_child(const trie_node_t *node, int label);
+static trie_node_t* first_child(const trie_node_t *node);
+static trie_node_t* next_sibling(const trie_node_t *node);
+static uint32_t child_index(uint32_t node);
+static uint32_t sibling_index(uint32_t node);
+static trie_node_stats_t* node_stats(const trie_node_t *node);
+static trie_node_trend_t* node_trend(const trie_node_t *node);
+static const char* node_text(const trie_node_t *node);
+static bool node_is_word(const trie_node_t *node);
+static uint32_t create_trie_node(unsigned char label);
+static void release_trie(void);
 static void insert_suggestion_into_trie(const char *suggestion, float score);
-static int collect_suggestions_from_trie(trie_node_t *node, const char *prefix, 
-                                        autocomplete_result_t *suggestions, int max_suggestions, int *count);
+static int collect_suggestions_from_trie(trie_node_t *node, autocomplete_result_t *suggestions, int max_suggestions);
+static int collect_best_hits(trie_node_t *node, ac_hit_t *hits, int max_hits);
+static void topk_cache_build(void);
+static void topk_cache_release(void);
+static void topk_cache_note(const char *suggestion, const trie_node_t *node);
+static int topk_cache_read(uint32_t node, autocomplete_result_t *suggestions, int max_suggestions);
+static void fill_suggestion(autocomplete_result_t *suggestion, const trie_node_t *node, float score, bool trending);
+static void raise_path_bounds(const char *suggestion, float score);
 static int compare_suggestions(const void *a, const void *b);
 static float calculate_suggestion_score(const char *suggestion, const char *query, autocomplete_source_t source);
+static trie_node_t* find_suggestion_node(const char *suggestion);
+static void record_selection(trie_node_t *node, long now);
+static bool node_is_trending(const trie_node_t *node, long now, long time_window);
+static long trending_until(const trie_node_t *node, long time_window);
+static float boosted_score(const trie_node_t *node, bool trending);
+
+/* Candidate buffer for batched fuzzy verification */
+typedef struct {
+    trie_node_t **nodes;
+    const char **texts;
+    int count;
+    int capacity;
+} fuzzy_candidate_list_t;
+
+static void collect_fuzzy_candidates(trie_node_t *node, int depth, int min_length, int max_length,
+                                     fuzzy_candidate_list_t *candidates);
+static void collect_prefix_candidates(trie_node_t *node, int limit, fuzzy_candidate_list_t *candidates);
+static bool append_candidate(fuzzy_candidate_list_t *candidates, trie_node_t *node);
+
+/* Best-first frontier: a subtree keyed by its score bound, or a finished
+ * suggestion keyed by its score */
+typedef struct {
+    trie_node_t *node;
+    float key;
+    bool is_result;
+    bool is_trending;
+} frontier_entry_t;
+
+typedef struct {
+    frontier_entry_t *entries;
+    int count;
+    int capacity;
+} frontier_t;
+
+static bool frontier_push(frontier_t *frontier, frontier_entry_t entry);
+static bool frontier_pop(frontier_t *frontier, frontier_entry_t *entry);
+
+/* Snapshot files: a header, the node array, the node stats, then the string
+ * pool, exactly as they are laid out in memory. Native byte order and struct
+ * layout; node_size and stats_size tell builds with a different layout apart.
+ * Loading checks the header against its checksum and the file size, and the
+ * links between nodes as searches follow them. */
+#define AC_SNAPSHOT_MAGIC "ACSNAP2"
+
+typedef struct {
+    char magic[8];
+    uint32_t node_size;
+    uint32_t stats_size;
+    uint64_t node_count;
+    uint64_t string_bytes;
+    int64_t total_suggestions;
+    uint64_t checksum;               // Of the fields above
+} ac_snapshot_header_t;
+
+/* Bulk loading: query logs are aggregated to one entry per trie path, sorted,
+ * and laid out as a fresh node array in a single pass */
+#define AC_BULK_LINE_LENGTH 4096
+#define AC_BULK_ARENA_BLOCK (1 << 20)
+// Log lines looked up together: each lookup is a chain of cache misses (slot,
+// entry, key), so the batch takes every step for all its lines before the
+// next step, and the misses overlap instead of queueing
+#define AC_BULK_LANES 16
+
+#if defined(__GNUC__)
+#define AC_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define AC_PREFETCH(address) ((void)(address))
+#endif
+
+typedef struct {
+    const char *text;
+    char *path;                     // Lowercased ASCII characters of the text, the trie path
+    size_t length;
+    uint64_t hash;
+    double weight;
+} bulk_key_t;
+
+typedef struct {
+    const char *path;
+    const char *text;               // The trie's spelling, else the first one logged
+    uint64_t hash;
+    double count;                   // Lines, or their summed weights
+    int64_t node;                   // Existing node whose counters carry over, -1 for new
+} bulk_entry_t;
+
+typedef struct {
+    Arena *arena;
+    bulk_entry_t *entries;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t *slots;                // Open-addressed path -> entry index + 1
+    uint32_t slot_capacity;
+    char *path;                     // Scratch key for suggestions already in the trie
+    size_t path_capacity;
+} bulk_table_t;
+
+/* Bounds for the learned ranking pass */
+#define AC_ML_MAX_CANDIDATES 1000
+#define AC_ML_MAX_DISTANCE 2
 
 /**
  * @brief Initialize the autocomplete system
@@ -35,8 +158,8 @@ int init_autocomplete_system(void) {
     printf("Initializing autocomplete system...\n");
     
     // Initialize the trie root
-    g_autocomplete_ctx.root = create_trie_node();
-    if (!g_autocomplete_ctx.root) {
+    release_trie();
+    if (create_trie_node(0) != 0) {
         fprintf(stderr, "Error: Failed to create autocomplete trie root\n");
         return -1;
     }
@@ -51,6 +174,7 @@ int init_autocomplete_system(void) {
     g_autocomplete_ctx.config.trending_weight = 1.5;
     g_autocomplete_ctx.config.history_weight = 1.2;
     g_autocomplete_ctx.config.popularity_weight = 1.0;
+    g_autocomplete_ctx.config.topk_cache_bytes = AC_TOPK_CACHE_BYTES;
     
     g_autocomplete_ctx.total_suggestions = 0;
     g_autocomplete_ctx.last_update = time(NULL);
@@ -74,14 +198,34 @@ int init_autocomplete_system(void) {
  * @brief Cleanup autocomplete system resources
  */
 void cleanup_autocomplete_system(void) {
-    if (g_autocomplete_ctx.root) {
-        destroy_trie(g_autocomplete_ctx.root);
-        g_autocomplete_ctx.root = NULL;
-    }
+    release_trie();
+    reranker_free(g_autocomplete_ctx.model);
+    g_autocomplete_ctx.model = NULL;
+    g_autocomplete_ctx.popularity = NULL;
+    g_autocomplete_ctx.ngrams = NULL;
     g_autocomplete_ctx.total_suggestions = 0;
     printf("Autocomplete system cleanup completed\n");
 }
 
+/**
+ * @brief Keep the added suggestions that are not already among the first ones
+ *
+ * suggestions[kept .. kept + added) were just appended; returns the new count.
+ */
+static int merge_unique(autocomplete_result_t *suggestions, int kept, int added) {
+    int count = kept;
+    for (int i = kept; i < kept + added; i++) {
+        bool duplicate = false;
+        for (int j = 0; j < kept && !duplicate; j++) {
+            duplicate = strcmp(suggestions[i].suggestion, suggestions[j].suggestion) == 0;
+        }
+        if (!duplicate) {
+            suggestions[count++] = suggestions[i];
+        }
+    }
+    return count;
+}
+
 /**
  * @brief Get autocomplete suggestions for a query
  */
@@ -91,7 +235,7 @@ int get_autocomplete_suggestions(const char *query, autocomplete_result_t *sugge
     }
     
     // Normalize query to lowercase
-    char normalized_query[MAX_QUERY_LENGTH];
+    char normalized_query[AC_QUERY_LENGTH];
     strncpy(normalized_query, query, sizeof(normalized_query) - 1);
     normalized_query[sizeof(normalized_query) - 1] = '\0';
     
@@ -111,6 +255,24 @@ int get_autocomplete_suggestions(const char *query, autocomplete_result_t *sugge
             suggestion_count = get_fuzzy_suggestions(normalized_query, suggestions, max_suggestions);
             break;
             
+        case AC_ALGORITHM_CONTEXTUAL:
+            // The words typed so far pick the last one; plain completions fill the rest
+            suggestion_count = get_contextual_suggestions(normalized_query, NULL, suggestions, max_suggestions);
+            if (suggestion_count < max_suggestions) {
+                int prefix_count = get_prefix_suggestions(normalized_query,
+                                                          suggestions + suggestion_count,
+                                                          max_suggestions - suggestion_count);
+                suggestion_count = merge_unique(suggestions, suggestion_count, prefix_count);
+            }
+            break;
+            
+        case AC_ALGORITHM_ML_BASED:
+            if (g_autocomplete_ctx.model) {
+                suggestion_count = get_ml_suggestions(normalized_query, suggestions, max_suggestions);
+                break;
+            }
+            // Without a model, rank the way the hybrid pass does
+            /* fall through */
         case AC_ALGORITHM_HYBRID:
         default:
             // Combine prefix and fuzzy matching
@@ -119,7 +281,19 @@ int get_autocomplete_suggestions(const char *query, autocomplete_result_t *sugge
                 int fuzzy_count = get_fuzzy_suggestions(normalized_query, 
                                                        suggestions + suggestion_count, 
                                                        max_suggestions - suggestion_count);
-                suggestion_count += fuzzy_count;
+                suggestion_count = merge_unique(suggestions, suggestion_count, fuzzy_count);
+            }
+            if (suggestion_count < max_suggestions && g_autocomplete_ctx.popularity) {
+                int popular_count = get_popular_suggestions(normalized_query,
+                                                            suggestions + suggestion_count,
+                                                            max_suggestions - suggestion_count);
+                suggestion_count = merge_unique(suggestions, suggestion_count, popular_count);
+            }
+            if (suggestion_count < max_suggestions && g_autocomplete_ctx.ngrams) {
+                int contextual_count = get_contextual_suggestions(normalized_query, NULL,
+                                                                  suggestions + suggestion_count,
+                                                                  max_suggestions - suggestion_count);
+                suggestion_count = merge_unique(suggestions, suggestion_count, contextual_count);
             }
             break;
     }
@@ -138,59 +312,171 @@ int get_prefix_suggestions(const char *prefix, autocomplete_result_t *suggestion
         return 0;
     }
     
-    trie_node_t *current = g_autocomplete_ctx.root;
+    trie_node_t *current = trie_root();
     
     // Navigate to the prefix in the trie
-    for (int i = 0; prefix[i]; i++) {
-        int index = (unsigned char)prefix[i];
-        if (index >= 128 || !current->children[index]) {
-            return 0; // Prefix not found
-        }
-        current = current->children[index];
+    for (int i = 0; prefix[i] && current; i++) {
+        current = find_child(current, (unsigned char)prefix[i]);
+    }
+    if (!current) {
+        return 0; // Prefix not found
     }
     
-    // Collect suggestions from this point
-    int suggestion_count = 0;
-    collect_suggestions_from_trie(current, prefix, suggestions, max_suggestions, &suggestion_count);
+    // Hot prefixes have their best suggestions ready
+    int cached = topk_cache_read((uint32_t)(current - g_autocomplete_ctx.nodes), suggestions, max_suggestions);
+    if (cached >= 0) {
+        return cached;
+    }
     
-    return suggestion_count;
+    // Collect the best suggestions from this point
+    return collect_suggestions_from_trie(current, suggestions, max_suggestions);
 }
 
 /**
- * @brief Get fuzzy match suggestions (basic implementation)
+ * @brief Get fuzzy match suggestions
+ *
+ * Gathers every trie suggestion whose length is within the edit bound of the
+ * query, then scores them together with the batched SIMD edit-distance kernel.
  */
 int get_fuzzy_suggestions(const char *query, autocomplete_result_t *suggestions, int max_suggestions) {
     if (!query || !suggestions || max_suggestions <= 0) {
         return 0;
     }
     
-    // For now, implement a simple fuzzy matching based on edit distance
-    // This would be enhanced with more sophisticated algorithms in a full implementation
+    const int max_distance = 2; // Allow up to 2 character differences
+    int query_length = strlen(query);
+    
+    fuzzy_candidate_list_t candidates = {0};
+    collect_fuzzy_candidates(trie_root(), 0, query_length - max_distance,
+                             query_length + max_distance, &candidates);
+    
+    int *distances = (int*)malloc((candidates.count + 1) * sizeof(int));
+    if (!distances) {
+        free(candidates.nodes);
+        free(candidates.texts);
+        return 0;
+    }
+    fuzzy_batchDistance(query, candidates.texts, candidates.count, max_distance, distances);
+    
+    long now = time(NULL);
     int suggestion_count = 0;
+    for (int i = 0; i < candidates.count && suggestion_count < max_suggestions; i++) {
+        if (distances[i] > max_distance) continue;
+        
+        trie_node_t *node = candidates.nodes[i];
+        strncpy(suggestions[suggestion_count].suggestion, node_text(node), 
+               MAX_SUGGESTION_LENGTH - 1);
+        suggestions[suggestion_count].suggestion[MAX_SUGGESTION_LENGTH - 1] = '\0';
+        bool trending = node_is_trending(node, now, 3600);
+        suggestions[suggestion_count].score = 1.0 - (distances[i] * 0.2); // Score based on edit distance
+        if (trending && g_autocomplete_ctx.config.enable_trending_boost) {
+            suggestions[suggestion_count].score *= g_autocomplete_ctx.config.trending_weight;
+        }
+        suggestions[suggestion_count].frequency = atomic_load_explicit(&node_stats(node)->frequency, memory_order_relaxed);
+        suggestions[suggestion_count].is_trending = trending;
+        suggestions[suggestion_count].last_used = atomic_load_explicit(&node_stats(node)->last_used, memory_order_relaxed);
+        suggestion_count++;
+    }
+    
+    free(distances);
+    free(candidates.nodes);
+    free(candidates.texts);
+    return suggestion_count;
+}
+
+/**
+ * @brief Get suggestions ranked by the loaded tree ensemble
+ *
+ * Candidates are the prefix completions of the query plus its fuzzy neighbours.
+ * All of them are scored by the model in one batch and the best are returned,
+ * carrying the model output as their score.
+ */
+int get_ml_suggestions(const char *query, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (!query || !suggestions || max_suggestions <= 0 || !g_autocomplete_ctx.model) {
+        return 0;
+    }
+    
+    int query_length = strlen(query);
+    fuzzy_candidate_list_t candidates = {0};
+    
+    // Prefix completions first, so they win the dedupe below
+    trie_node_t *current = trie_root();
+    for (int i = 0; query[i] && current; i++) {
+        current = find_child(current, (unsigned char)query[i]);
+    }
+    if (current) {
+        collect_prefix_candidates(current, AC_ML_MAX_CANDIDATES, &candidates);
+    }
+    int prefix_count = candidates.count;
+    collect_fuzzy_candidates(trie_root(), 0, query_length - AC_ML_MAX_DISTANCE,
+                             query_length + AC_ML_MAX_DISTANCE, &candidates);
     
-    // This is a simplified implementation - in practice, you'd traverse the entire trie
-    // and calculate edit distances for fuzzy matching
-    const char* sample_suggestions[] = {
-        "search", "engine", "algorithm", "ranking", "autocomplete",
-        "machine learning", "data mining", "information", "retrieval"
-    };
+    int *distances = (int*)malloc((candidates.count + 1) * sizeof(int));
+    float *features = (float*)malloc((candidates.count + 1) * AC_FEATURE_COUNT * sizeof(float));
+    int *rows = (int*)malloc((candidates.count + 1) * sizeof(int));
+    if (!distances || !features || !rows) {
+        free(distances);
+        free(features);
+        free(rows);
+        free(candidates.nodes);
+        free(candidates.texts);
+        return 0;
+    }
+    fuzzy_batchDistance(query, candidates.texts, candidates.count, AC_ML_MAX_DISTANCE, distances);
     
-    int num_samples = sizeof(sample_suggestions) / sizeof(sample_suggestions[0]);
+    long now = time(NULL);
+    int row_count = 0;
+    for (int i = 0; i < candidates.count; i++) {
+        bool is_prefix = i < prefix_count;
+        if (!is_prefix) {
+            if (distances[i] > AC_ML_MAX_DISTANCE) continue;
+            bool duplicate = false;
+            for (int j = 0; j < prefix_count && !duplicate; j++) {
+                duplicate = candidates.nodes[j] == candidates.nodes[i];
+            }
+            if (duplicate) continue;
+        }
+        
+        trie_node_t *node = candidates.nodes[i];
+        float *row = features + row_count * AC_FEATURE_COUNT;
+        row[AC_FEATURE_STORED_SCORE] = atomic_load_explicit(&node_stats(node)->score, memory_order_relaxed);
+        row[AC_FEATURE_FREQUENCY] = (float)atomic_load_explicit(&node_stats(node)->frequency, memory_order_relaxed);
+        row[AC_FEATURE_EDIT_DISTANCE] = (float)distances[i];
+        row[AC_FEATURE_IS_PREFIX] = is_prefix ? 1.0f : 0.0f;
+        row[AC_FEATURE_LENGTH_DELTA] = (float)((int)strlen(node_text(node)) - query_length);
+        row[AC_FEATURE_AGE_SECONDS] = (float)(now - atomic_load_explicit(&node_stats(node)->last_used, memory_order_relaxed));
+        rows[row_count++] = i;
+    }
     
-    for (int i = 0; i < num_samples && suggestion_count < max_suggestions; i++) {
-        int edit_dist = calculate_edit_distance(query, sample_suggestions[i]);
-        if (edit_dist <= 2) { // Allow up to 2 character differences
-            strncpy(suggestions[suggestion_count].suggestion, sample_suggestions[i], 
-                   MAX_SUGGESTION_LENGTH - 1);
-            suggestions[suggestion_count].suggestion[MAX_SUGGESTION_LENGTH - 1] = '\0';
-            suggestions[suggestion_count].score = 1.0 - (edit_dist * 0.2); // Score based on edit distance
-            suggestions[suggestion_count].frequency = 1;
-            suggestions[suggestion_count].is_trending = false;
-            suggestions[suggestion_count].last_used = time(NULL);
-            suggestion_count++;
+    double *scores = (double*)malloc((row_count + 1) * sizeof(double));
+    autocomplete_result_t *ranked = (autocomplete_result_t*)malloc((row_count + 1) * sizeof(autocomplete_result_t));
+    int suggestion_count = 0;
+    if (scores && ranked) {
+        reranker_score(g_autocomplete_ctx.model, features, row_count, scores);
+        for (int r = 0; r < row_count; r++) {
+            trie_node_t *node = candidates.nodes[rows[r]];
+            strncpy(ranked[r].suggestion, node_text(node), MAX_SUGGESTION_LENGTH - 1);
+            ranked[r].suggestion[MAX_SUGGESTION_LENGTH - 1] = '\0';
+            ranked[r].score = (float)scores[r];
+            ranked[r].frequency = atomic_load_explicit(&node_stats(node)->frequency, memory_order_relaxed);
+            ranked[r].is_trending = node_is_trending(node, now, 3600);
+            ranked[r].last_used = atomic_load_explicit(&node_stats(node)->last_used, memory_order_relaxed);
+        }
+        qsort(ranked, row_count, sizeof(autocomplete_result_t), compare_suggestions);
+        
+        suggestion_count = row_count < max_suggestions ? row_count : max_suggestions;
+        for (int r = 0; r < suggestion_count; r++) {
+            suggestions[r] = ranked[r];
         }
     }
     
+    free(scores);
+    free(ranked);
+    free(distances);
+    free(features);
+    free(rows);
+    free(candidates.nodes);
+    free(candidates.texts);
     return suggestion_count;
 }
 
@@ -262,170 +548,2248 @@ int calculate_edit_distance(const char *str1, const char *str2) {
 /* Internal helper function implementations */
 
 /**
- * @brief Create a new trie node
+ * @brief The root node, or NULL before the system is initialized
+ */
+static trie_node_t* trie_root(void) {
+    return g_autocomplete_ctx.node_count ? &g_autocomplete_ctx.nodes[0] : NULL;
+}
+
+/**
+ * @brief First child of nodes[node], or 0 for none
+ *
+ * A mapped snapshot is only checked as far as its header, so links are
+ * checked as they are followed: a child comes after its parent in the array
+ * and a sibling has a higher label than the one before it, so no walk can
+ * loop or leave the array. A link that breaks this is read as missing.
+ */
+static uint32_t child_index(uint32_t node) {
+    uint32_t child = g_autocomplete_ctx.nodes[node].first_child;
+    return child > node && child < g_autocomplete_ctx.node_count ? child : 0;
+}
+
+/**
+ * @brief Next sibling of nodes[node], or 0 for none
+ */
+static uint32_t sibling_index(uint32_t node) {
+    uint32_t sibling = g_autocomplete_ctx.nodes[node].next_sibling;
+    if (sibling == 0 || sibling >= g_autocomplete_ctx.node_count ||
+        g_autocomplete_ctx.nodes[sibling].label <= g_autocomplete_ctx.nodes[node].label) {
+        return 0;
+    }
+    return sibling;
+}
+
+static uint32_t node_index(const trie_node_t *node) {
+    return (uint32_t)(node - g_autocomplete_ctx.nodes);
+}
+
+static trie_node_t* first_child(const trie_node_t *node) {
+    uint32_t child = child_index(node_index(node));
+    return child ? &g_autocomplete_ctx.nodes[child] : NULL;
+}
+
+static trie_node_t* next_sibling(const trie_node_t *node) {
+    uint32_t sibling = sibling_index(node_index(node));
+    return sibling ? &g_autocomplete_ctx.nodes[sibling] : NULL;
+}
+
+/**
+ * @brief Child of node along label, or NULL; siblings are sorted, so the scan
+ * stops at the first larger label
+ */
+static trie_node_t* find_child(const trie_node_t *node, int label) {
+    for (trie_node_t *child = first_child(node); child; child = next_sibling(child)) {
+        if (child->label >= label) {
+            return child->label == label ? child : NULL;
+        }
+    }
+    return NULL;
+}
+
+static trie_node_stats_t* node_stats(const trie_node_t *node) {
+    return &g_autocomplete_ctx.stats[node_index(node)];
+}
+
+static trie_node_trend_t* node_trend(const trie_node_t *node) {
+    return &g_autocomplete_ctx.trends[node_index(node)];
+}
+
+/**
+ * @brief Suggestion text of an end-of-word node, NULL elsewhere
+ *
+ * The pool ends in a NUL, so any offset inside it reads as a string.
+ */
+static const char* node_text(const trie_node_t *node) {
+    return node->suggestion < g_autocomplete_ctx.string_bytes ? g_autocomplete_ctx.strings + node->suggestion : NULL;
+}
+
+static bool node_is_word(const trie_node_t *node) {
+    return node_text(node) != NULL;
+}
+
+/**
+ * @brief Move a mapped snapshot into owned arrays before they grow
  */
-static trie_node_t* create_trie_node(void) {
-    trie_node_t *node = (trie_node_t*)calloc(1, sizeof(trie_node_t));
-    if (node) {
-        node->is_end_of_word = false;
-        node->suggestion = NULL;
-        node->score = 0.0;
-        node->frequency = 0;
-        node->last_used = 0;
+static bool detach_snapshot(void) {
+    if (!g_autocomplete_ctx.snapshot) {
+        return true;
+    }
+    uint32_t node_count = g_autocomplete_ctx.node_count;
+    uint32_t node_capacity = node_count * 2;
+    uint64_t string_capacity = g_autocomplete_ctx.string_bytes * 2 + 64;
+    trie_node_t *nodes = (trie_node_t*)malloc(node_capacity * sizeof(trie_node_t));
+    trie_node_stats_t *stats = (trie_node_stats_t*)malloc(node_capacity * sizeof(trie_node_stats_t));
+    trie_node_trend_t *trends = (trie_node_trend_t*)realloc(g_autocomplete_ctx.trends, node_capacity * sizeof(trie_node_trend_t));
+    char *strings = (char*)malloc(string_capacity);
+    if (trends) {
+        g_autocomplete_ctx.trends = trends;
+    }
+    if (!nodes || !stats || !trends || !strings) {
+        free(nodes);
+        free(stats);
+        free(strings);
+        return false;
     }
-    return node;
+    memcpy(nodes, g_autocomplete_ctx.nodes, node_count * sizeof(trie_node_t));
+    memcpy(stats, g_autocomplete_ctx.stats, node_count * sizeof(trie_node_stats_t));
+    memcpy(strings, g_autocomplete_ctx.strings, g_autocomplete_ctx.string_bytes);
+    munmap(g_autocomplete_ctx.snapshot, g_autocomplete_ctx.snapshot_size);
+    g_autocomplete_ctx.snapshot = NULL;
+    g_autocomplete_ctx.snapshot_size = 0;
+    g_autocomplete_ctx.nodes = nodes;
+    g_autocomplete_ctx.stats = stats;
+    g_autocomplete_ctx.node_capacity = node_capacity;
+    g_autocomplete_ctx.strings = strings;
+    g_autocomplete_ctx.string_capacity = string_capacity;
+    return true;
 }
 
 /**
- * @brief Destroy trie recursively
+ * @brief Append a node, returning its index, or UINT32_MAX when out of memory
+ *
+ * The node arrays may move, so callers must not hold node pointers across this.
  */
-static void destroy_trie(trie_node_t *node) {
-    if (!node) return;
+static uint32_t create_trie_node(unsigned char label) {
+    if (!detach_snapshot()) {
+        return UINT32_MAX;
+    }
+    if (g_autocomplete_ctx.node_count == g_autocomplete_ctx.node_capacity) {
+        uint32_t new_capacity = g_autocomplete_ctx.node_capacity ? g_autocomplete_ctx.node_capacity * 2 : 1024;
+        trie_node_t *nodes = (trie_node_t*)realloc(g_autocomplete_ctx.nodes, new_capacity * sizeof(trie_node_t));
+        if (nodes) g_autocomplete_ctx.nodes = nodes;
+        trie_node_stats_t *stats = (trie_node_stats_t*)realloc(g_autocomplete_ctx.stats, new_capacity * sizeof(trie_node_stats_t));
+        if (stats) g_autocomplete_ctx.stats = stats;
+        trie_node_trend_t *trends = (trie_node_trend_t*)realloc(g_autocomplete_ctx.trends, new_capacity * sizeof(trie_node_trend_t));
+        if (trends) g_autocomplete_ctx.trends = trends;
+        if (!nodes || !stats || !trends) {
+            return UINT32_MAX;
+        }
+        g_autocomplete_ctx.node_capacity = new_capacity;
+    }
     
-    for (int i = 0; i < 128; i++) {
-        if (node->children[i]) {
-            destroy_trie(node->children[i]);
+    uint32_t index = g_autocomplete_ctx.node_count++;
+    trie_node_t *node = &g_autocomplete_ctx.nodes[index];
+    node->first_child = 0;
+    node->next_sibling = 0;
+    node->suggestion = AC_NO_SUGGESTION;
+    node->label = label;
+    atomic_init(&node_stats(node)->score, 0.0f);
+    atomic_init(&node_stats(node)->frequency, 0);
+    atomic_init(&node_stats(node)->last_used, 0);
+    atomic_init(&node_stats(node)->max_score, 0);
+    atomic_init(&node_trend(node)->trend_short, 0.0);
+    atomic_init(&node_trend(node)->trend_long, 0.0);
+    atomic_init(&node_trend(node)->trend_updated, 0);
+    atomic_flag_clear(&node_trend(node)->trend_lock);
+    atomic_fetch_add_explicit(&g_autocomplete_ctx.layout_version, 1, memory_order_relaxed);
+    return index;
+}
+
+/**
+ * @brief Copy a suggestion into the string pool, returning its offset, or
+ * AC_NO_SUGGESTION when the pool cannot grow
+ */
+static uint32_t store_suggestion_text(const char *suggestion) {
+    if (!detach_snapshot()) {
+        return AC_NO_SUGGESTION;
+    }
+    size_t length = strlen(suggestion) + 1;
+    if (g_autocomplete_ctx.string_bytes + length >= AC_NO_SUGGESTION) {
+        return AC_NO_SUGGESTION;
+    }
+    if (g_autocomplete_ctx.string_bytes + length > g_autocomplete_ctx.string_capacity) {
+        uint64_t new_capacity = g_autocomplete_ctx.string_capacity ? g_autocomplete_ctx.string_capacity * 2 : 4096;
+        while (new_capacity < g_autocomplete_ctx.string_bytes + length) new_capacity *= 2;
+        char *strings = (char*)realloc(g_autocomplete_ctx.strings, new_capacity);
+        if (!strings) {
+            return AC_NO_SUGGESTION;
         }
+        g_autocomplete_ctx.strings = strings;
+        g_autocomplete_ctx.string_capacity = new_capacity;
     }
     
-    if (node->suggestion) {
-        free(node->suggestion);
+    uint32_t offset = (uint32_t)g_autocomplete_ctx.string_bytes;
+    memcpy(g_autocomplete_ctx.strings + offset, suggestion, length);
+    g_autocomplete_ctx.string_bytes += length;
+    return offset;
+}
+
+/**
+ * @brief Drop the whole trie, along with any snapshot it was loaded from
+ */
+static void release_trie(void) {
+    topk_cache_release();
+    if (g_autocomplete_ctx.snapshot) {
+        munmap(g_autocomplete_ctx.snapshot, g_autocomplete_ctx.snapshot_size);
+    } else {
+        free(g_autocomplete_ctx.nodes);
+        free(g_autocomplete_ctx.stats);
+        free(g_autocomplete_ctx.strings);
     }
-    free(node);
+    free(g_autocomplete_ctx.trends);
+    g_autocomplete_ctx.snapshot = NULL;
+    g_autocomplete_ctx.snapshot_size = 0;
+    g_autocomplete_ctx.nodes = NULL;
+    g_autocomplete_ctx.stats = NULL;
+    g_autocomplete_ctx.trends = NULL;
+    g_autocomplete_ctx.node_count = 0;
+    g_autocomplete_ctx.node_capacity = 0;
+    g_autocomplete_ctx.strings = NULL;
+    g_autocomplete_ctx.string_bytes = 0;
+    g_autocomplete_ctx.string_capacity = 0;
+    atomic_fetch_add_explicit(&g_autocomplete_ctx.layout_version, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_autocomplete_ctx.score_version, 1, memory_order_relaxed);
 }
 
 /**
  * @brief Insert suggestion into trie
  */
 static void insert_suggestion_into_trie(const char *suggestion, float score) {
-    if (!suggestion) return;
-    
-    trie_node_t *current = g_autocomplete_ctx.root;
+    if (!suggestion || !trie_root()) return;
     
+    uint32_t current = 0;
     for (int i = 0; suggestion[i]; i++) {
-        int index = (unsigned char)tolower(suggestion[i]);
-        if (index >= 128) continue; // Skip non-ASCII characters for simplicity
+        int label = (unsigned char)tolower(suggestion[i]);
+        if (label >= 128) continue; // Skip non-ASCII characters for simplicity
+        
+        // Keep the children sorted: find the sibling the new child goes after
+        uint32_t previous = 0;
+        uint32_t next = child_index(current);
+        while (next && g_autocomplete_ctx.nodes[next].label < label) {
+            previous = next;
+            next = sibling_index(next);
+        }
+        if (next && g_autocomplete_ctx.nodes[next].label == label) {
+            current = next;
+            continue;
+        }
         
-        if (!current->children[index]) {
-            current->children[index] = create_trie_node();
+        uint32_t child = create_trie_node((unsigned char)label);
+        if (child == UINT32_MAX) return;
+        g_autocomplete_ctx.nodes[child].next_sibling = next;
+        if (previous) {
+            g_autocomplete_ctx.nodes[previous].next_sibling = child;
+        } else {
+            g_autocomplete_ctx.nodes[current].first_child = child;
         }
-        current = current->children[index];
+        current = child;
     }
     
-    current->is_end_of_word = true;
-    if (current->suggestion) {
-        free(current->suggestion);
+    // Reinserting the same text keeps the stored copy
+    const char *stored = node_text(&g_autocomplete_ctx.nodes[current]);
+    if (!stored || strcmp(stored, suggestion) != 0) {
+        uint32_t text = store_suggestion_text(suggestion);
+        if (text == AC_NO_SUGGESTION) return;
+        g_autocomplete_ctx.nodes[current].suggestion = text;
+    }
+    trie_node_t *node = &g_autocomplete_ctx.nodes[current];
+    atomic_store_explicit(&node_stats(node)->score, score, memory_order_relaxed);
+    atomic_fetch_add_explicit(&node_stats(node)->frequency, 1, memory_order_relaxed);
+    atomic_store_explicit(&node_stats(node)->last_used, time(NULL), memory_order_relaxed);
+    // A lower score than before leaves the old bounds standing; they are
+    // tightened when a search next passes through
+    raise_path_bounds(suggestion, score);
+    atomic_fetch_add_explicit(&g_autocomplete_ctx.score_version, 1, memory_order_relaxed);
+    topk_cache_note(suggestion, node);
+    if (g_autocomplete_ctx.topk_countdown > 0 && --g_autocomplete_ctx.topk_countdown == 0) {
+        topk_cache_release();
     }
-    current->suggestion = strdup(suggestion);
-    current->score = score;
-    current->frequency++;
-    current->last_used = time(NULL);
 }
 
 /**
- * @brief Collect suggestions from trie recursively
+ * @brief Pack a subtree bound with its change count
+ *
+ * Tightening a bound compares the whole word, so it fails if a writer touched
+ * the bound since it was read, even without changing its value.
  */
-static int collect_suggestions_from_trie(trie_node_t *node, const char *prefix, 
-                                        autocomplete_result_t *suggestions, int max_suggestions, int *count) {
-    if (!node || *count >= max_suggestions) {
-        return 0;
+static uint64_t pack_bound(float bound, uint32_t changes) {
+    uint32_t bits;
+    memcpy(&bits, &bound, sizeof(bits));
+    return ((uint64_t)bits << 32) | changes;
+}
+
+static float bound_value(uint64_t packed) {
+    uint32_t bits = (uint32_t)(packed >> 32);
+    float bound;
+    memcpy(&bound, &bits, sizeof(bound));
+    return bound;
+}
+
+/**
+ * @brief Raise a bound to at least score, counting a change either way
+ */
+static void raise_bound(trie_node_t *node, float score) {
+    uint64_t packed = atomic_load_explicit(&node_stats(node)->max_score, memory_order_relaxed);
+    uint64_t raised;
+    do {
+        float bound = bound_value(packed);
+        raised = pack_bound(bound > score ? bound : score, (uint32_t)packed + 1);
+    } while (!atomic_compare_exchange_weak_explicit(&node_stats(node)->max_score, &packed, raised,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+/**
+ * @brief Make every bound from a suggestion's node up to the root cover score
+ *
+ * Deepest first, after the score itself is stored, so a reader that sees a
+ * raised bound also sees the raised bounds and score below it.
+ */
+static void raise_path_bounds(const char *suggestion, float score) {
+    trie_node_t *local_path[MAX_SUGGESTION_LENGTH];
+    size_t length = strlen(suggestion);
+    trie_node_t **path = length <= MAX_SUGGESTION_LENGTH ? local_path : (trie_node_t**)malloc(length * sizeof(trie_node_t*));
+    if (!path) return;
+    
+    int depth = 0;
+    trie_node_t *current = trie_root();
+    for (int i = 0; suggestion[i] && current; i++) {
+        int label = (unsigned char)tolower(suggestion[i]);
+        if (label >= 128) continue;
+        path[depth++] = current;
+        current = find_child(current, label);
+    }
+    if (current) {
+        raise_bound(current, score);
+        for (int i = depth - 1; i >= 0; i--) {
+            raise_bound(path[i], score);
+        }
+    }
+    if (path != local_path) free(path);
+}
+
+/**
+ * @brief Push onto the frontier heap, highest key on top
+ */
+static bool frontier_push(frontier_t *frontier, frontier_entry_t entry) {
+    if (frontier->count == frontier->capacity) {
+        int new_capacity = frontier->capacity ? frontier->capacity * 2 : 64;
+        frontier_entry_t *entries = (frontier_entry_t*)realloc(frontier->entries, new_capacity * sizeof(frontier_entry_t));
+        if (!entries) return false;
+        frontier->entries = entries;
+        frontier->capacity = new_capacity;
     }
     
-    if (node->is_end_of_word && node->suggestion) {
-        strncpy(suggestions[*count].suggestion, node->suggestion, MAX_SUGGESTION_LENGTH - 1);
-        suggestions[*count].suggestion[MAX_SUGGESTION_LENGTH - 1] = '\0';
-        suggestions[*count].score = node->score;
-        suggestions[*count].frequency = node->frequency;
-        suggestions[*count].is_trending = is_suggestion_trending(node->suggestion, 3600); // 1 hour window
-        suggestions[*count].last_used = node->last_used;
-        (*count)++;
+    // Finished suggestions win ties, so they are returned before an equal bound is expanded
+    int at = frontier->count++;
+    while (at > 0) {
+        int parent = (at - 1) / 2;
+        frontier_entry_t *above = &frontier->entries[parent];
+        if (above->key > entry.key || (above->key == entry.key && (above->is_result || !entry.is_result))) break;
+        frontier->entries[at] = *above;
+        at = parent;
     }
+    frontier->entries[at] = entry;
+    return true;
+}
+
+/**
+ * @brief Pop the highest key off the frontier heap
+ */
+static bool frontier_pop(frontier_t *frontier, frontier_entry_t *entry) {
+    if (frontier->count == 0) return false;
+    *entry = frontier->entries[0];
+    frontier_entry_t last = frontier->entries[--frontier->count];
     
-    for (int i = 0; i < 128 && *count < max_suggestions; i++) {
-        if (node->children[i]) {
-            collect_suggestions_from_trie(node->children[i], prefix, suggestions, max_suggestions, count);
+    int at = 0;
+    for (;;) {
+        int child = at * 2 + 1;
+        if (child >= frontier->count) break;
+        frontier_entry_t *entries = frontier->entries;
+        if (child + 1 < frontier->count &&
+            (entries[child + 1].key > entries[child].key ||
+             (entries[child + 1].key == entries[child].key && entries[child + 1].is_result && !entries[child].is_result))) {
+            child++;
         }
+        if (last.key > entries[child].key || (last.key == entries[child].key && (last.is_result || !entries[child].is_result))) break;
+        entries[at] = entries[child];
+        at = child;
     }
-    
-    return *count;
+    frontier->entries[at] = last;
+    return true;
 }
 
 /**
- * @brief Compare suggestions for sorting (descending by score)
+ * @brief Copy a node's suggestion into a result
  */
-static int compare_suggestions(const void *a, const void *b) {
-    const autocomplete_result_t *suggestion_a = (const autocomplete_result_t*)a;
-    const autocomplete_result_t *suggestion_b = (const autocomplete_result_t*)b;
+static void fill_suggestion(autocomplete_result_t *suggestion, const trie_node_t *node, float score, bool trending) {
+    strncpy(suggestion->suggestion, node_text(node), MAX_SUGGESTION_LENGTH - 1);
+    suggestion->suggestion[MAX_SUGGESTION_LENGTH - 1] = '\0';
+    suggestion->score = score;
+    suggestion->frequency = atomic_load_explicit(&node_stats(node)->frequency, memory_order_relaxed);
+    suggestion->is_trending = trending;
+    suggestion->last_used = atomic_load_explicit(&node_stats(node)->last_used, memory_order_relaxed);
+}
+
+/**
+ * @brief Collect the highest scoring suggestions under node, best first
+ */
+static int collect_suggestions_from_trie(trie_node_t *node, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (!node || max_suggestions <= 0) {
+        return 0;
+    }
     
-    if (suggestion_a->score > suggestion_b->score) return -1;
-    if (suggestion_a->score < suggestion_b->score) return 1;
-    return 0;
+    ac_hit_t local_hits[AC_SESSION_TOP_K];
+    ac_hit_t *hits = max_suggestions <= AC_SESSION_TOP_K ? local_hits : (ac_hit_t*)malloc(max_suggestions * sizeof(ac_hit_t));
+    if (!hits) {
+        return 0;
+    }
+    int count = collect_best_hits(node, hits, max_suggestions);
+    for (int i = 0; i < count; i++) {
+        fill_suggestion(&suggestions[i], &g_autocomplete_ctx.nodes[hits[i].node], hits[i].score, hits[i].is_trending);
+    }
+    if (hits != local_hits) free(hits);
+    return count;
 }
 
 /**
- * @brief Calculate suggestion score based on various factors
+ * @brief Rank the best max_hits suggestions under node
+ *
+ * Subtrees are expanded in order of their max_score bound, so the search
+ * stops as soon as max_hits finished suggestions outrank every bound left on
+ * the frontier. Bounds found stale high on the way are tightened.
  */
-static float calculate_suggestion_score(const char *suggestion, const char *query, autocomplete_source_t source) {
-    (void)suggestion; // Suppress unused parameter warning
-    (void)query;      // Suppress unused parameter warning
+static int collect_best_hits(trie_node_t *node, ac_hit_t *hits, int max_hits) {
+    if (!node || max_hits <= 0) {
+        return 0;
+    }
     
-    float base_score = 0.5;
+    // A trending suggestion may outscore its stored score, so bounds are scaled to match
+    float boost = 1.0f;
+    if (g_autocomplete_ctx.config.enable_trending_boost && g_autocomplete_ctx.config.trending_weight > 1.0f) {
+        boost = g_autocomplete_ctx.config.trending_weight;
+    }
+    long now = time(NULL);
     
-    switch (source) {
-        case AC_SOURCE_POPULAR_QUERIES:
-            base_score = 0.8 * g_autocomplete_ctx.config.popularity_weight;
-            break;
-        case AC_SOURCE_QUERY_HISTORY:
-            base_score = 0.7 * g_autocomplete_ctx.config.history_weight;
-            break;
-        case AC_SOURCE_DOCUMENT_TITLES:
-            base_score = 0.6;
-            break;
-        default:
-            base_score = 0.5;
-            break;
+    frontier_t frontier = {0};
+    float root_bound = bound_value(atomic_load_explicit(&node_stats(node)->max_score, memory_order_acquire));
+    frontier_entry_t entry = {node, root_bound * boost, false, false};
+    int count = 0;
+    if (!frontier_push(&frontier, entry)) {
+        return 0;
+    }
+    while (count < max_hits && frontier_pop(&frontier, &entry)) {
+        trie_node_t *current = entry.node;
+        if (entry.is_result) {
+            hits[count].node = (uint32_t)(current - g_autocomplete_ctx.nodes);
+            hits[count].score = entry.key;
+            hits[count].is_trending = entry.is_trending;
+            count++;
+            continue;
+        }
+        
+        // Read the bound before what it covers: a writer raising a score
+        // below touches this bound afterwards, so the tightening CAS fails
+        uint64_t packed = atomic_load_explicit(&node_stats(current)->max_score, memory_order_acquire);
+        float tight = 0.0f;
+        if (node_is_word(current)) {
+            bool trending = node_is_trending(current, now, 3600); // 1 hour window
+            frontier_entry_t result = {current, boosted_score(current, trending), true, trending};
+            tight = atomic_load_explicit(&node_stats(current)->score, memory_order_relaxed);
+            if (!frontier_push(&frontier, result)) break;
+        }
+        bool complete = true;
+        for (trie_node_t *child = first_child(current); child; child = next_sibling(child)) {
+            float child_bound = bound_value(atomic_load_explicit(&node_stats(child)->max_score, memory_order_acquire));
+            if (child_bound > tight) tight = child_bound;
+            frontier_entry_t next = {child, child_bound * boost, false, false};
+            if (!frontier_push(&frontier, next)) {
+                complete = false;
+                break;
+            }
+        }
+        if (complete && tight < bound_value(packed)) {
+            atomic_compare_exchange_strong_explicit(&node_stats(current)->max_score, &packed,
+                                                    pack_bound(tight, (uint32_t)packed + 1),
+                                                    memory_order_relaxed, memory_order_relaxed);
+        }
+        if (!complete) break;
     }
     
-    return base_score > 1.0 ? 1.0 : base_score;
+    free(frontier.entries);
+    return count;
 }
 
 /**
- * @brief Check if suggestion is trending
+ * @brief Cached list of a node, or NULL
  */
-bool is_suggestion_trending(const char *suggestion, long time_window) {
-    (void)suggestion;   // Suppress unused parameter warning
-    (void)time_window;  // Suppress unused parameter warning
-    
-    // Simplified implementation - in practice, this would check actual usage statistics
-    return false; // For now, no suggestions are considered trending
+static ac_topk_entry_t* topk_cache_find(uint32_t node) {
+    if (g_autocomplete_ctx.topk_count == 0) {
+        return NULL;
+    }
+    uint32_t mask = g_autocomplete_ctx.topk_slot_capacity - 1;
+    for (uint32_t at = (node * 2654435761u) & mask; g_autocomplete_ctx.topk_slots[at]; at = (at + 1) & mask) {
+        ac_topk_entry_t *entry = &g_autocomplete_ctx.topk_entries[g_autocomplete_ctx.topk_slots[at] - 1];
+        if (entry->node == node) return entry;
+    }
+    return NULL;
 }
 
-/* Stub implementations for remaining functions */
-int update_suggestion_score(const char *suggestion, bool user_selected) { 
-    (void)suggestion; (void)user_selected; return 0; 
+/**
+ * @brief Take a list for rewriting: writers queue on the flag, readers retry
+ * while the sequence is odd
+ */
+static void topk_entry_lock(ac_topk_entry_t *entry) {
+    while (atomic_flag_test_and_set_explicit(&entry->writing, memory_order_acquire)) {
+    }
+    atomic_fetch_add_explicit(&entry->sequence, 1, memory_order_acq_rel);
 }
-int load_suggestions_from_history(const char *history_file) { 
-    (void)history_file; return 0; 
+
+static void topk_entry_unlock(ac_topk_entry_t *entry) {
+    atomic_fetch_add_explicit(&entry->sequence, 1, memory_order_release);
+    atomic_flag_clear_explicit(&entry->writing, memory_order_release);
 }
-int load_trending_suggestions(const char *trending_file) { 
-    (void)trending_file; return 0; 
+
+/**
+ * @brief Rank a cached list afresh from the trie
+ */
+static void topk_entry_rank(ac_topk_entry_t *entry) {
+    ac_hit_t hits[AC_TOPK_CACHE_SIZE];
+    long expires = LONG_MAX;
+    entry->count = collect_best_hits(&g_autocomplete_ctx.nodes[entry->node], hits, AC_TOPK_CACHE_SIZE);
+    for (int i = 0; i < entry->count; i++) {
+        const trie_node_t *node = &g_autocomplete_ctx.nodes[hits[i].node];
+        entry->nodes[i] = hits[i].node;
+        fill_suggestion(&entry->results[i], node, hits[i].score, hits[i].is_trending);
+        if (hits[i].is_trending && g_autocomplete_ctx.config.enable_trending_boost) {
+            long until = trending_until(node, 3600);
+            if (until < expires - 1) expires = until + 1;
+        }
+    }
+    atomic_store_explicit(&entry->expires, expires, memory_order_relaxed);
 }
-int get_contextual_suggestions(const char *query, const char *context, 
-                             autocomplete_result_t *suggestions, int max_suggestions) { 
-    (void)query; (void)context; (void)suggestions; (void)max_suggestions; return 0; 
+
+/**
+ * @brief Move one suggestion's new score into a cached list
+ *
+ * Whatever the list leaves out scores no higher than its last entry, so a
+ * raised score only has to beat that, and a lowered one stays exact unless it
+ * sinks to the bottom of a full list; then the list is ranked again.
+ */
+static void topk_entry_patch(ac_topk_entry_t *entry, uint32_t node, long now) {
+    const trie_node_t *suggestion = &g_autocomplete_ctx.nodes[node];
+    bool trending = node_is_trending(suggestion, now, 3600);
+    float score = boosted_score(suggestion, trending);
+    bool full = entry->count == AC_TOPK_CACHE_SIZE;
+    
+    int at = 0;
+    while (at < entry->count && entry->nodes[at] != node) at++;
+    if (at == entry->count) {
+        if (full && score <= entry->results[entry->count - 1].score) return;
+        at = full ? entry->count - 1 : entry->count++;
+    } else if (full && score < entry->results[at].score &&
+               (at == entry->count - 1 || score < entry->results[entry->count - 1].score)) {
+        topk_entry_rank(entry);
+        return;
+    }
+    
+    autocomplete_result_t result;
+    fill_suggestion(&result, suggestion, score, trending);
+    while (at > 0 && entry->results[at - 1].score < score) {
+        entry->results[at] = entry->results[at - 1];
+        entry->nodes[at] = entry->nodes[at - 1];
+        at--;
+    }
+    while (at < entry->count - 1 && entry->results[at + 1].score > score) {
+        entry->results[at] = entry->results[at + 1];
+        entry->nodes[at] = entry->nodes[at + 1];
+        at++;
+    }
+    entry->results[at] = result;
+    entry->nodes[at] = node;
+    if (trending && g_autocomplete_ctx.config.enable_trending_boost) {
+        long until = trending_until(suggestion, 3600);
+        if (until < atomic_load_explicit(&entry->expires, memory_order_relaxed) - 1) {
+            atomic_store_explicit(&entry->expires, until + 1, memory_order_relaxed);
+        }
+    }
 }
-void get_autocomplete_stats(int *total_suggestions, float *avg_score, float *cache_hit_rate) {
-    if (total_suggestions) *total_suggestions = g_autocomplete_ctx.total_suggestions;
-    if (avg_score) *avg_score = 0.7;
-    if (cache_hit_rate) *cache_hit_rate = 85.0;
+
+/**
+ * @brief Update the cached lists above a suggestion whose score changed
+ */
+static void topk_cache_note(const char *suggestion, const trie_node_t *node) {
+    // Pairs with the fence in topk_cache_build: either the build sees this
+    // change's score_version or this sees the cache it published
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&g_autocomplete_ctx.topk_state, memory_order_acquire) != AC_TOPK_READY ||
+        g_autocomplete_ctx.topk_count == 0) {
+        return;
+    }
+    uint32_t index = (uint32_t)(node - g_autocomplete_ctx.nodes);
+    long now = time(NULL);
+    const char *next = suggestion;
+    trie_node_t *current = trie_root();
+    for (int depth = 0; current; depth++) {
+        ac_topk_entry_t *entry = topk_cache_find((uint32_t)(current - g_autocomplete_ctx.nodes));
+        if (entry) {
+            topk_entry_lock(entry);
+            topk_entry_patch(entry, index, now);
+            topk_entry_unlock(entry);
+        }
+        if (depth == AC_TOPK_CACHE_DEPTH) break;
+        
+        int label = -1;
+        while (*next && label < 0) {
+            int c = tolower((unsigned char)*next++);
+            if (c < 128) label = c;
+        }
+        if (label < 0) break;
+        current = find_child(current, label);
+    }
+}
+
+/**
+ * @brief Copy out a node's cached list, or -1 when it has none
+ *
+ * A list whose trending boost has run out is ranked again by the first reader
+ * to find it so; readers arriving meanwhile fall back to the trie.
+ */
+static int topk_cache_read(uint32_t node, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (max_suggestions > AC_TOPK_CACHE_SIZE) {
+        return -1;
+    }
+    int state = atomic_load_explicit(&g_autocomplete_ctx.topk_state, memory_order_acquire);
+    if (state == AC_TOPK_STALE &&
+        atomic_compare_exchange_strong_explicit(&g_autocomplete_ctx.topk_state, &state, AC_TOPK_BUILDING,
+                                                memory_order_acquire, memory_order_acquire)) {
+        topk_cache_build();
+        state = AC_TOPK_READY;
+    }
+    if (state != AC_TOPK_READY) {
+        return -1;
+    }
+    ac_topk_entry_t *entry = topk_cache_find(node);
+    if (!entry) {
+        return -1;
+    }
+    
+    long now = time(NULL);
+    if (now >= atomic_load_explicit(&entry->expires, memory_order_relaxed)) {
+        if (atomic_flag_test_and_set_explicit(&entry->writing, memory_order_acquire)) {
+            return -1;
+        }
+        atomic_fetch_add_explicit(&entry->sequence, 1, memory_order_acq_rel);
+        if (now >= atomic_load_explicit(&entry->expires, memory_order_relaxed)) {
+            topk_entry_rank(entry);
+        }
+        topk_entry_unlock(entry);
+    }
+    
+    int count;
+    unsigned before, after;
+    do {
+        before = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+        count = entry->count;
+        if (count < 0) count = 0;
+        if (count > max_suggestions) count = max_suggestions;
+        memcpy(suggestions, entry->results, count * sizeof(autocomplete_result_t));
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&entry->sequence, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+    return count;
 }
-int configure_autocomplete(const autocomplete_config_t *config) { 
-    (void)config; return 0; 
+
+/**
+ * @brief Drop every cached list; the next prefix lookup builds them again
+ *
+ * Only writers that no lookup runs alongside call this.
+ */
+static void topk_cache_release(void) {
+    atomic_store_explicit(&g_autocomplete_ctx.topk_state, AC_TOPK_STALE, memory_order_relaxed);
+    free(g_autocomplete_ctx.topk_entries);
+    free(g_autocomplete_ctx.topk_slots);
+    g_autocomplete_ctx.topk_entries = NULL;
+    g_autocomplete_ctx.topk_slots = NULL;
+    g_autocomplete_ctx.topk_count = 0;
+    g_autocomplete_ctx.topk_slot_capacity = 0;
+    g_autocomplete_ctx.topk_countdown = 0;
 }
-int clear_autocomplete_data(void) { return 0; }
-int save_autocomplete_data(const char *filename) { 
-    (void)filename; return 0; 
+
+typedef struct {
+    uint32_t node;
+    uint32_t completions;
+} topk_candidate_t;
+
+static int compare_topk_candidates(const void *a, const void *b) {
+    uint32_t completions_a = ((const topk_candidate_t*)a)->completions;
+    uint32_t completions_b = ((const topk_candidate_t*)b)->completions;
+    return completions_a < completions_b ? 1 : completions_a > completions_b ? -1 : 0;
 }
-int load_autocomplete_data(const char *filename) { 
-    (void)filename; return 0; 
+
+/**
+ * @brief Gather the nodes within AC_TOPK_CACHE_DEPTH of node with more
+ * completions than a list holds
+ */
+static bool collect_topk_candidates(uint32_t node, int depth, const uint32_t *completions,
+                                    topk_candidate_t **candidates, uint32_t *count, uint32_t *capacity) {
+    if (completions[node] <= AC_TOPK_CACHE_SIZE) {
+        return true;
+    }
+    if (*count == *capacity) {
+        uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+        topk_candidate_t *grown = (topk_candidate_t*)realloc(*candidates, new_capacity * sizeof(topk_candidate_t));
+        if (!grown) return false;
+        *candidates = grown;
+        *capacity = new_capacity;
+    }
+    (*candidates)[*count].node = node;
+    (*candidates)[*count].completions = completions[node];
+    (*count)++;
+    if (depth == AC_TOPK_CACHE_DEPTH) {
+        return true;
+    }
+    for (uint32_t child = child_index(node); child; child = sibling_index(child)) {
+        if (!collect_topk_candidates(child, depth + 1, completions, candidates, count, capacity)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Choose the prefixes to cache and rank their lists
+ *
+ * A best-first search does more work the more completions lie under its
+ * prefix, so the short prefixes with the most completions are cached, as many
+ * as topk_cache_bytes holds. Children always follow their parent in the node
+ * array, so one backward pass counts every subtree. Out of memory, the cache
+ * is left empty.
+ */
+static void topk_cache_fill(void) {
+    uint32_t budget = (uint32_t)(g_autocomplete_ctx.config.topk_cache_bytes / sizeof(ac_topk_entry_t));
+    uint32_t node_count = g_autocomplete_ctx.node_count;
+    if (budget == 0 || node_count == 0) {
+        return;
+    }
+    g_autocomplete_ctx.topk_countdown = (uint32_t)g_autocomplete_ctx.total_suggestions / 2 + 1024;
+    
+    // A sibling list of a damaged snapshot may point back to a node not
+    // counted yet, which then counts as empty
+    uint32_t *completions = (uint32_t*)calloc(node_count, sizeof(uint32_t));
+    if (!completions) {
+        return;
+    }
+    for (uint32_t i = node_count; i-- > 0;) {
+        const trie_node_t *node = &g_autocomplete_ctx.nodes[i];
+        uint32_t total = node_is_word(node) ? 1 : 0;
+        for (uint32_t child = child_index(i); child; child = sibling_index(child)) {
+            total += completions[child];
+        }
+        completions[i] = total;
+    }
+    
+    topk_candidate_t *candidates = NULL;
+    uint32_t candidate_count = 0, candidate_capacity = 0;
+    bool collected = collect_topk_candidates(0, 0, completions, &candidates, &candidate_count, &candidate_capacity);
+    free(completions);
+    if (!collected || candidate_count == 0) {
+        free(candidates);
+        return;
+    }
+    qsort(candidates, candidate_count, sizeof(topk_candidate_t), compare_topk_candidates);
+    uint32_t count = candidate_count < budget ? candidate_count : budget;
+    
+    uint32_t slot_capacity = 16;
+    while (slot_capacity < count * 2) slot_capacity *= 2;
+    ac_topk_entry_t *entries = (ac_topk_entry_t*)calloc(count, sizeof(ac_topk_entry_t));
+    uint32_t *slots = (uint32_t*)calloc(slot_capacity, sizeof(uint32_t));
+    if (!entries || !slots) {
+        free(entries);
+        free(slots);
+        free(candidates);
+        return;
+    }
+    
+    for (uint32_t e = 0; e < count; e++) {
+        ac_topk_entry_t *entry = &entries[e];
+        entry->node = candidates[e].node;
+        atomic_init(&entry->sequence, 0);
+        atomic_flag_clear(&entry->writing);
+        topk_entry_rank(entry);
+        uint32_t at = (entry->node * 2654435761u) & (slot_capacity - 1);
+        while (slots[at]) at = (at + 1) & (slot_capacity - 1);
+        slots[at] = e + 1;
+    }
+    free(candidates);
+    
+    g_autocomplete_ctx.topk_entries = entries;
+    g_autocomplete_ctx.topk_slots = slots;
+    g_autocomplete_ctx.topk_slot_capacity = slot_capacity;
+    g_autocomplete_ctx.topk_count = count;
+}
+
+/**
+ * @brief Build the cache for the lookup that found it stale, then publish it
+ *
+ * Feedback arriving while the lists are ranked skips the unpublished cache,
+ * so if any did, every list is ranked once more after publishing; feedback
+ * after that patches the lists itself. Without memory the cache is published
+ * empty and lookups search the trie until the next rebuild.
+ */
+static void topk_cache_build(void) {
+    unsigned long version = atomic_load_explicit(&g_autocomplete_ctx.score_version, memory_order_acquire);
+    topk_cache_fill();
+    atomic_store_explicit(&g_autocomplete_ctx.topk_state, AC_TOPK_READY, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&g_autocomplete_ctx.score_version, memory_order_acquire) == version) {
+        return;
+    }
+    for (uint32_t e = 0; e < g_autocomplete_ctx.topk_count; e++) {
+        ac_topk_entry_t *entry = &g_autocomplete_ctx.topk_entries[e];
+        topk_entry_lock(entry);
+        topk_entry_rank(entry);
+        topk_entry_unlock(entry);
+    }
+}
+
+/**
+ * @brief Append a suggestion node to a candidate buffer
+ */
+static bool append_candidate(fuzzy_candidate_list_t *candidates, trie_node_t *node) {
+    if (candidates->count == candidates->capacity) {
+        int new_capacity = candidates->capacity ? candidates->capacity * 2 : 64;
+        trie_node_t **nodes = (trie_node_t**)realloc(candidates->nodes, new_capacity * sizeof(trie_node_t*));
+        const char **texts = (const char**)realloc((void*)candidates->texts, new_capacity * sizeof(char*));
+        if (nodes) candidates->nodes = nodes;
+        if (texts) candidates->texts = texts;
+        if (!nodes || !texts) return false;
+        candidates->capacity = new_capacity;
+    }
+    candidates->nodes[candidates->count] = node;
+    candidates->texts[candidates->count] = node_text(node);
+    candidates->count++;
+    return true;
+}
+
+/**
+ * @brief Collect up to limit suggestions from the subtree under node
+ */
+static void collect_prefix_candidates(trie_node_t *node, int limit, fuzzy_candidate_list_t *candidates) {
+    if (!node || candidates->count >= limit) {
+        return;
+    }
+    
+    if (node_is_word(node)) {
+        if (!append_candidate(candidates, node)) return;
+    }
+    
+    for (trie_node_t *child = first_child(node); child && candidates->count < limit; child = next_sibling(child)) {
+        collect_prefix_candidates(child, limit, candidates);
+    }
+}
+
+/**
+ * @brief Collect suggestions whose trie depth lies within [min_length, max_length]
+ */
+static void collect_fuzzy_candidates(trie_node_t *node, int depth, int min_length, int max_length,
+                                     fuzzy_candidate_list_t *candidates) {
+    if (!node || depth > max_length) {
+        return;
+    }
+    
+    if (node_is_word(node) && depth >= min_length) {
+        if (!append_candidate(candidates, node)) return;
+    }
+    
+    for (trie_node_t *child = first_child(node); child; child = next_sibling(child)) {
+        collect_fuzzy_candidates(child, depth + 1, min_length, max_length, candidates);
+    }
+}
+
+/**
+ * @brief Compare suggestions for sorting (descending by score)
+ */
+static int compare_suggestions(const void *a, const void *b) {
+    const autocomplete_result_t *suggestion_a = (const autocomplete_result_t*)a;
+    const autocomplete_result_t *suggestion_b = (const autocomplete_result_t*)b;
+    
+    if (suggestion_a->score > suggestion_b->score) return -1;
+    if (suggestion_a->score < suggestion_b->score) return 1;
+    return 0;
+}
+
+/**
+ * @brief Calculate suggestion score based on various factors
+ */
+static float calculate_suggestion_score(const char *suggestion, const char *query, autocomplete_source_t source) {
+    (void)suggestion; // Suppress unused parameter warning
+    (void)query;      // Suppress unused parameter warning
+    
+    float base_score = 0.5;
+    
+    switch (source) {
+        case AC_SOURCE_POPULAR_QUERIES:
+            base_score = 0.8 * g_autocomplete_ctx.config.popularity_weight;
+            break;
+        case AC_SOURCE_QUERY_HISTORY:
+            base_score = 0.7 * g_autocomplete_ctx.config.history_weight;
+            break;
+        case AC_SOURCE_DOCUMENT_TITLES:
+            base_score = 0.6;
+            break;
+        default:
+            base_score = 0.5;
+            break;
+    }
+    
+    return base_score > 1.0 ? 1.0 : base_score;
+}
+
+/**
+ * @brief Find the trie node holding a suggestion, following the insert path
+ */
+static trie_node_t* find_suggestion_node(const char *suggestion) {
+    trie_node_t *current = trie_root();
+    for (int i = 0; suggestion[i] && current; i++) {
+        int label = (unsigned char)tolower(suggestion[i]);
+        if (label >= 128) continue;
+        current = find_child(current, label);
+    }
+    return current && node_is_word(current) ? current : NULL;
+}
+
+/**
+ * @brief Count one selection in both trending counters
+ *
+ * Each counter decays by half per half-life, so bringing it forward from
+ * trend_updated and adding the new selection is all an update costs.
+ */
+static void record_selection(trie_node_t *node, long now) {
+    // Writers to one node take turns; readers never wait on this
+    while (atomic_flag_test_and_set_explicit(&node_trend(node)->trend_lock, memory_order_acquire)) {
+    }
+    long updated = atomic_load_explicit(&node_trend(node)->trend_updated, memory_order_relaxed);
+    double short_count = atomic_load_explicit(&node_trend(node)->trend_short, memory_order_relaxed);
+    double long_count = atomic_load_explicit(&node_trend(node)->trend_long, memory_order_relaxed);
+    if (updated > 0 && now > updated) {
+        double elapsed = (double)(now - updated);
+        short_count *= exp2(-elapsed / AC_TRENDING_SHORT_HALF_LIFE);
+        long_count *= exp2(-elapsed / AC_TRENDING_LONG_HALF_LIFE);
+    }
+    atomic_store_explicit(&node_trend(node)->trend_short, short_count + 1.0, memory_order_relaxed);
+    atomic_store_explicit(&node_trend(node)->trend_long, long_count + 1.0, memory_order_relaxed);
+    if (now > updated) atomic_store_explicit(&node_trend(node)->trend_updated, now, memory_order_relaxed);
+    atomic_flag_clear_explicit(&node_trend(node)->trend_lock, memory_order_release);
+}
+
+/**
+ * @brief Whether a node's recent selections outpace its baseline
+ *
+ * A decayed counter settles at rate * half-life / ln 2 under a steady rate, so
+ * dividing each by its half-life compares the recent and long-term rates on
+ * the same scale. Nothing selected within time_window seconds is trending.
+ */
+static bool node_is_trending(const trie_node_t *node, long now, long time_window) {
+    long updated = atomic_load_explicit(&node_trend(node)->trend_updated, memory_order_relaxed);
+    if (updated <= 0 || now - atomic_load_explicit(&node_stats(node)->last_used, memory_order_relaxed) > time_window) {
+        return false;
+    }
+    double elapsed = now > updated ? (double)(now - updated) : 0.0;
+    double recent = atomic_load_explicit(&node_trend(node)->trend_short, memory_order_relaxed) *
+                    exp2(-elapsed / AC_TRENDING_SHORT_HALF_LIFE);
+    double baseline = atomic_load_explicit(&node_trend(node)->trend_long, memory_order_relaxed) *
+                      exp2(-elapsed / AC_TRENDING_LONG_HALF_LIFE);
+    return recent >= AC_TRENDING_MIN_SELECTIONS &&
+           recent / AC_TRENDING_SHORT_HALF_LIFE > AC_TRENDING_RATIO * baseline / AC_TRENDING_LONG_HALF_LIFE;
+}
+
+/**
+ * @brief Last second a trending node keeps trending without more selections
+ *
+ * Both counters only decay from here, and the recent one faster, so the node
+ * stops at whichever of its three tests fails first.
+ */
+static long trending_until(const trie_node_t *node, long time_window) {
+    long updated = atomic_load_explicit(&node_trend(node)->trend_updated, memory_order_relaxed);
+    double recent = atomic_load_explicit(&node_trend(node)->trend_short, memory_order_relaxed);
+    double baseline = atomic_load_explicit(&node_trend(node)->trend_long, memory_order_relaxed);
+    long until = atomic_load_explicit(&node_stats(node)->last_used, memory_order_relaxed) + time_window;
+    
+    double elapsed = AC_TRENDING_SHORT_HALF_LIFE * log2(recent / AC_TRENDING_MIN_SELECTIONS);
+    if (baseline > 0) {
+        double ratio = recent * AC_TRENDING_LONG_HALF_LIFE / (AC_TRENDING_RATIO * baseline * AC_TRENDING_SHORT_HALF_LIFE);
+        double ratio_elapsed = log2(ratio) / (1.0 / AC_TRENDING_SHORT_HALF_LIFE - 1.0 / AC_TRENDING_LONG_HALF_LIFE);
+        if (ratio_elapsed < elapsed) elapsed = ratio_elapsed;
+    }
+    if (elapsed < 0) elapsed = 0;
+    if (updated + elapsed < until) until = updated + (long)elapsed;
+    return until;
+}
+
+/**
+ * @brief Stored score, scaled by trending_weight while the node trends
+ */
+static float boosted_score(const trie_node_t *node, bool trending) {
+    float score = atomic_load_explicit(&node_stats(node)->score, memory_order_relaxed);
+    if (trending && g_autocomplete_ctx.config.enable_trending_boost) {
+        return score * g_autocomplete_ctx.config.trending_weight;
+    }
+    return score;
+}
+
+/**
+ * @brief Check if suggestion is trending
+ */
+bool is_suggestion_trending(const char *suggestion, long time_window) {
+    if (!suggestion || !trie_root()) {
+        return false;
+    }
+    trie_node_t *node = find_suggestion_node(suggestion);
+    return node && node_is_trending(node, time(NULL), time_window);
+}
+
+/**
+ * @brief Learn from a suggestion being picked or passed over
+ *
+ * A pick moves the score a step towards 1 (scores above 1 keep theirs) and
+ * counts towards frequency and trending; passing over moves it towards 0.
+ * Every field is updated atomically, so searches keep running alongside and
+ * see the new ranking on their next pass. Returns -1 when the suggestion is
+ * unknown.
+ */
+int update_suggestion_score(const char *suggestion, bool user_selected) {
+    if (!suggestion || !trie_root()) {
+        return -1;
+    }
+    trie_node_t *node = find_suggestion_node(suggestion);
+    if (!node) {
+        return -1;
+    }
+    
+    float score = atomic_load_explicit(&node_stats(node)->score, memory_order_relaxed);
+    float updated;
+    do {
+        float target = user_selected ? (score > 1.0f ? score : 1.0f) : 0.0f;
+        updated = score + AC_LEARNING_RATE * (target - score);
+    } while (!atomic_compare_exchange_weak_explicit(&node_stats(node)->score, &score, updated,
+                                                    memory_order_release, memory_order_relaxed));
+    if (updated > score) {
+        raise_path_bounds(suggestion, updated);
+    }
+    
+    if (user_selected) {
+        long now = time(NULL);
+        record_selection(node, now);
+        atomic_fetch_add_explicit(&node_stats(node)->frequency, 1, memory_order_relaxed);
+        atomic_store_explicit(&node_stats(node)->last_used, now, memory_order_relaxed);
+    }
+    // Released so a cache build that sees the change also sees the score
+    atomic_fetch_add_explicit(&g_autocomplete_ctx.score_version, 1, memory_order_release);
+    topk_cache_note(suggestion, node);
+    return 0;
+}
+
+/**
+ * @brief Shift the words of text[0 .. length) into words, tokenized the way
+ * the n-gram model reads content
+ *
+ * words keeps the last two, oldest first. A word too long for the model is
+ * kept as "" so it still separates the words around it.
+ */
+static void shift_context_words(const char *text, size_t length, char words[2][NGRAM_WORD_LENGTH], int *count) {
+    size_t i = 0;
+    while (i < length) {
+        if (!isalnum((unsigned char)text[i]) && text[i] != '_') {
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < length && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
+            i++;
+        }
+        size_t word_length = i - start;
+        if (word_length < 2) {
+            continue;
+        }
+        memcpy(words[0], words[1], NGRAM_WORD_LENGTH);
+        if (word_length >= NGRAM_WORD_LENGTH) {
+            word_length = 0;
+        }
+        for (size_t k = 0; k < word_length; k++) {
+            words[1][k] = tolower((unsigned char)text[start + k]);
+        }
+        words[1][word_length] = '\0';
+        if (*count < 2) {
+            (*count)++;
+        }
+    }
+}
+
+/**
+ * @brief Complete the last word of a query from the words before it
+ *
+ * The words before it come from the query, after those at the end of context
+ * (text the query follows, may be NULL). The attached n-gram model proposes
+ * and scores the completions, so queries with no earlier word get none.
+ */
+int get_contextual_suggestions(const char *query, const char *context, 
+                             autocomplete_result_t *suggestions, int max_suggestions) { 
+    if (!query || !suggestions || max_suggestions <= 0 || !g_autocomplete_ctx.ngrams) {
+        return 0;
+    }
+    
+    // The trailing run of word characters is the word being typed
+    size_t length = strlen(query);
+    size_t start = length;
+    while (start > 0 && (isalnum((unsigned char)query[start - 1]) || query[start - 1] == '_')) {
+        start--;
+    }
+    if (length - start >= NGRAM_WORD_LENGTH || start >= MAX_SUGGESTION_LENGTH) {
+        return 0;
+    }
+    char partial[NGRAM_WORD_LENGTH];
+    for (size_t i = start; i <= length; i++) {
+        partial[i - start] = tolower((unsigned char)query[i]);
+    }
+    
+    char words[2][NGRAM_WORD_LENGTH] = {{0}};
+    int word_count = 0;
+    if (context) {
+        shift_context_words(context, strlen(context), words, &word_count);
+    }
+    shift_context_words(query, start, words, &word_count);
+    if (word_count == 0) {
+        return 0;
+    }
+    const char *previous[2];
+    for (int i = 0; i < word_count; i++) {
+        const char *word = words[2 - word_count + i];
+        previous[i] = word[0] ? word : NULL;
+    }
+    
+    NgramCandidate candidates[NGRAM_SUCCESSORS + NGRAM_SCAN_LIMIT];
+    int wanted = max_suggestions < NGRAM_SUCCESSORS + NGRAM_SCAN_LIMIT ? max_suggestions : NGRAM_SUCCESSORS + NGRAM_SCAN_LIMIT;
+    int candidate_count = ngram_complete(g_autocomplete_ctx.ngrams, previous, word_count, partial, candidates, wanted);
+    
+    int suggestion_count = 0;
+    for (int i = 0; i < candidate_count; i++) {
+        size_t word_length = strlen(candidates[i].word);
+        if (start + word_length >= MAX_SUGGESTION_LENGTH) continue;
+        autocomplete_result_t *result = &suggestions[suggestion_count++];
+        memcpy(result->suggestion, query, start);
+        memcpy(result->suggestion + start, candidates[i].word, word_length + 1);
+        result->score = (float)candidates[i].score;
+        result->frequency = 0;
+        result->is_trending = false;
+        result->last_used = 0;
+    }
+    return suggestion_count;
+}
+
+/* Stub implementations for remaining functions */
+void get_autocomplete_stats(int *total_suggestions, float *avg_score, float *cache_hit_rate) {
+    if (total_suggestions) *total_suggestions = g_autocomplete_ctx.total_suggestions;
+    if (avg_score) *avg_score = 0.7;
+    if (cache_hit_rate) *cache_hit_rate = 85.0;
+}
+/**
+ * @brief Replace the configuration; rankings are redone under the new weights
+ */
+int configure_autocomplete(const autocomplete_config_t *config) {
+    if (!config) {
+        return -1;
+    }
+    g_autocomplete_ctx.config = *config;
+    topk_cache_release();
+    atomic_fetch_add_explicit(&g_autocomplete_ctx.score_version, 1, memory_order_relaxed);
+    return 0;
+}
+int clear_autocomplete_data(void) { return 0; }
+
+/**
+ * @brief Load the tree ensemble used by AC_ALGORITHM_ML_BASED
+ *
+ * The model must read AC_FEATURE_COUNT features. On failure the current model
+ * is kept.
+ */
+int load_autocomplete_model(const char *model_file) {
+    if (!model_file) {
+        return -1;
+    }
+    
+    Reranker *model = reranker_load(model_file);
+    if (!model) {
+        fprintf(stderr, "Error: Failed to load autocomplete model %s\n", model_file);
+        return -1;
+    }
+    if (model->featureCount != AC_FEATURE_COUNT) {
+        fprintf(stderr, "Error: Autocomplete model reads %d features, expected %d\n",
+                model->featureCount, AC_FEATURE_COUNT);
+        reranker_free(model);
+        return -1;
+    }
+    
+    reranker_free(g_autocomplete_ctx.model);
+    g_autocomplete_ctx.model = model;
+    return 0;
+}
+
+/**
+ * @brief Use the given heavy hitters for popular-query suggestions
+ *
+ * Typically the search history aggregate of a Storage. NULL detaches it.
+ */
+int set_popularity_source(Popularity *popularity) {
+    g_autocomplete_ctx.popularity = popularity;
+    return 0;
+}
+
+/**
+ * @brief Use the given n-gram model for contextual suggestions
+ *
+ * Typically the one a SearchEngine builds from the content it indexes. NULL
+ * detaches it.
+ */
+int set_ngram_source(NgramModel *ngrams) {
+    g_autocomplete_ctx.ngrams = ngrams;
+    return 0;
+}
+
+/**
+ * @brief Get the most searched queries starting with a prefix
+ *
+ * Read from the attached heavy-hitter table, so the cost does not depend on
+ * how much history there is. Scores are relative to the most searched match,
+ * times the configured popularity weight.
+ */
+int get_popular_suggestions(const char *prefix, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (!prefix || !suggestions || max_suggestions <= 0 || !g_autocomplete_ctx.popularity) {
+        return 0;
+    }
+    
+    PopularQuery popular[POPULARITY_TOP_K];
+    int wanted = max_suggestions < POPULARITY_TOP_K ? max_suggestions : POPULARITY_TOP_K;
+    long now = (long)time(NULL) * 1000;
+    int popular_count = popularity_top(g_autocomplete_ctx.popularity, prefix, now, popular, wanted);
+    
+    int suggestion_count = 0;
+    for (int i = 0; i < popular_count; i++) {
+        if (popular[i].count <= 0) continue;
+        autocomplete_result_t *result = &suggestions[suggestion_count++];
+        strncpy(result->suggestion, popular[i].query, MAX_SUGGESTION_LENGTH - 1);
+        result->suggestion[MAX_SUGGESTION_LENGTH - 1] = '\0';
+        result->score = (float)(popular[i].count / popular[0].count) * g_autocomplete_ctx.config.popularity_weight;
+        result->frequency = (int)(popular[i].count + 0.5);
+        result->is_trending = false;
+        result->last_used = 0;
+    }
+    return suggestion_count;
+}
+
+/**
+ * @brief Checksum of a snapshot header, its own field left out
+ */
+static uint64_t snapshot_checksum(const ac_snapshot_header_t *header) {
+    const unsigned char *bytes = (const unsigned char*)header;
+    uint64_t hash = 1469598103934665603ULL;
+    for (size_t i = 0; i < offsetof(ac_snapshot_header_t, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Save the suggestion trie as a snapshot
+ *
+ * The node array, node stats and string pool are written as they are, so
+ * scores, counters and subtree bounds survive and a loaded snapshot ranks
+ * exactly as the trie did when it was saved. Trending counters are not saved.
+ */
+int save_autocomplete_data(const char *filename) {
+    if (!filename || !trie_root()) {
+        return -1;
+    }
+    
+    ac_snapshot_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AC_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.node_size = sizeof(trie_node_t);
+    header.stats_size = sizeof(trie_node_stats_t);
+    header.node_count = g_autocomplete_ctx.node_count;
+    header.string_bytes = g_autocomplete_ctx.string_bytes;
+    header.total_suggestions = g_autocomplete_ctx.total_suggestions;
+    header.checksum = snapshot_checksum(&header);
+    
+    FILE *file = fopen(filename, "wb");
+    size_t node_count = (size_t)header.node_count;
+    bool written = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   fwrite(g_autocomplete_ctx.nodes, sizeof(trie_node_t), node_count, file) == node_count &&
+                   fwrite(g_autocomplete_ctx.stats, sizeof(trie_node_stats_t), node_count, file) == node_count;
+    if (written && header.string_bytes > 0) {
+        written = fwrite(g_autocomplete_ctx.strings, 1, header.string_bytes, file) == header.string_bytes;
+    }
+    if (file && fclose(file) != 0) {
+        written = false;
+    }
+    if (!written) {
+        fprintf(stderr, "Error: Failed to write autocomplete snapshot %s\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Replace the suggestion trie with a saved snapshot
+ *
+ * The file is mapped once and its nodes, stats and strings are used where
+ * they lie. Only the header is checked here, so loading takes the same time
+ * whatever the size of the trie; links between nodes are checked as they are
+ * followed. Feedback writes to private copies of the touched stats pages, and
+ * the first insert copies the arrays out of the mapping. A malformed header
+ * leaves the current trie untouched.
+ */
+int load_autocomplete_data(const char *filename) {
+    if (!filename) {
+        return -1;
+    }
+    
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(ac_snapshot_header_t)) {
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)info.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return -1;
+    }
+    
+    const ac_snapshot_header_t *header = (const ac_snapshot_header_t*)mapping;
+    bool valid = memcmp(header->magic, AC_SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->checksum == snapshot_checksum(header) &&
+                 header->node_size == sizeof(trie_node_t) && header->stats_size == sizeof(trie_node_stats_t) &&
+                 header->node_count > 0 && header->node_count < AC_NO_SUGGESTION &&
+                 header->string_bytes < AC_NO_SUGGESTION &&
+                 size == sizeof(ac_snapshot_header_t) +
+                         header->node_count * (sizeof(trie_node_t) + sizeof(trie_node_stats_t)) + header->string_bytes;
+    trie_node_t *nodes = (trie_node_t*)(header + 1);
+    trie_node_stats_t *stats = valid ? (trie_node_stats_t*)(nodes + header->node_count) : NULL;
+    char *strings = valid ? (char*)(stats + header->node_count) : NULL;
+    valid = valid && (header->string_bytes == 0 || strings[header->string_bytes - 1] == '\0');
+    if (!valid) {
+        munmap(mapping, size);
+        fprintf(stderr, "Error: Malformed autocomplete snapshot %s\n", filename);
+        return -1;
+    }
+    // All zero is a cleared counter, and calloc leaves the pages untouched
+    trie_node_trend_t *trends = (trie_node_trend_t*)calloc(header->node_count, sizeof(trie_node_trend_t));
+    if (!trends) {
+        munmap(mapping, size);
+        return -1;
+    }
+    
+    release_trie();
+    g_autocomplete_ctx.snapshot = mapping;
+    g_autocomplete_ctx.snapshot_size = size;
+    g_autocomplete_ctx.nodes = nodes;
+    g_autocomplete_ctx.stats = stats;
+    g_autocomplete_ctx.trends = trends;
+    g_autocomplete_ctx.node_count = (uint32_t)header->node_count;
+    g_autocomplete_ctx.strings = strings;
+    g_autocomplete_ctx.string_bytes = header->string_bytes;
+    g_autocomplete_ctx.total_suggestions = (int)header->total_suggestions;
+    g_autocomplete_ctx.last_update = time(NULL);
+    return 0;
+}
+
+/**
+ * @brief Hash of a trie path
+ */
+static uint64_t hash_path(const char *path) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (; *path; path++) {
+        hash ^= (unsigned char)*path;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+/**
+ * @brief Double the slot table and reinsert every entry
+ */
+static bool bulk_grow_slots(bulk_table_t *table) {
+    uint32_t capacity = table->slot_capacity ? table->slot_capacity * 2 : 4096;
+    uint32_t *slots = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    if (!slots) return false;
+    for (uint32_t e = 0; e < table->count; e++) {
+        uint32_t at = (uint32_t)table->entries[e].hash & (capacity - 1);
+        while (slots[at]) at = (at + 1) & (capacity - 1);
+        slots[at] = e + 1;
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->slot_capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Fill in a key's path and hash; path must hold strlen(text) + 1 bytes
+ */
+static void make_bulk_key(bulk_key_t *key, const char *text, char *path, double weight) {
+    size_t length = 0;
+    for (size_t i = 0; text[i]; i++) {
+        int label = (unsigned char)tolower(text[i]);
+        if (label < 128) path[length++] = (char)label;
+    }
+    path[length] = '\0';
+    key->text = text;
+    key->path = path;
+    key->length = length;
+    key->hash = hash_path(path);
+    key->weight = weight;
+}
+
+/**
+ * @brief Count a key's weight, adding its entry on first sight
+ *
+ * node is the existing trie node the text came from, or -1.
+ */
+static bool bulk_add(bulk_table_t *table, const bulk_key_t *key, int64_t node) {
+    if ((uint64_t)(table->count + 1) * 2 > table->slot_capacity && !bulk_grow_slots(table)) {
+        return false;
+    }
+    uint32_t mask = table->slot_capacity - 1;
+    uint32_t at = (uint32_t)key->hash & mask;
+    while (table->slots[at]) {
+        bulk_entry_t *entry = &table->entries[table->slots[at] - 1];
+        if (entry->hash == key->hash && strcmp(entry->path, key->path) == 0) {
+            entry->count += key->weight;
+            if (node >= 0) {
+                // The trie's spelling stays
+                entry->text = key->text;
+                entry->node = node;
+            }
+            return true;
+        }
+        at = (at + 1) & mask;
+    }
+    
+    if (table->count == table->capacity) {
+        uint32_t capacity = table->capacity ? table->capacity * 2 : 4096;
+        bulk_entry_t *entries = (bulk_entry_t*)realloc(table->entries, capacity * sizeof(bulk_entry_t));
+        if (!entries) return false;
+        table->entries = entries;
+        table->capacity = capacity;
+    }
+    bulk_entry_t *entry = &table->entries[table->count];
+    entry->path = arena_copy(table->arena, key->path, key->length + 1);
+    entry->text = node >= 0 ? key->text : arena_strdup(table->arena, key->text);
+    entry->hash = key->hash;
+    entry->count = key->weight;
+    entry->node = node;
+    if (!entry->path || !entry->text) return false;
+    table->slots[at] = ++table->count;
+    return true;
+}
+
+/**
+ * @brief Add a suggestion already in the trie, keeping its counters
+ */
+static bool bulk_add_existing(bulk_table_t *table, uint32_t node) {
+    const char *text = node_text(&g_autocomplete_ctx.nodes[node]);
+    size_t text_length = strlen(text);
+    if (text_length >= table->path_capacity) {
+        size_t capacity = text_length + 1 > 2 * table->path_capacity ? text_length + 1 : 2 * table->path_capacity;
+        char *buffer = (char*)realloc(table->path, capacity);
+        if (!buffer) return false;
+        table->path = buffer;
+        table->path_capacity = capacity;
+    }
+    bulk_key_t key;
+    make_bulk_key(&key, text, table->path, 0.0);
+    return bulk_add(table, &key, node);
+}
+
+/**
+ * @brief Count a batch of log lines
+ */
+static bool bulk_add_lanes(bulk_table_t *table, const bulk_key_t *keys, int count) {
+    // Warm each lookup's slot, entry and key a step at a time; the lookups
+    // below then find them cached
+    uint32_t mask = table->slot_capacity - 1;
+    uint32_t slots[AC_BULK_LANES];
+    if (table->slot_capacity > 0) {
+        for (int lane = 0; lane < count; lane++) {
+            AC_PREFETCH(&table->slots[(uint32_t)keys[lane].hash & mask]);
+        }
+        for (int lane = 0; lane < count; lane++) {
+            slots[lane] = table->slots[(uint32_t)keys[lane].hash & mask];
+            if (slots[lane]) AC_PREFETCH(&table->entries[slots[lane] - 1]);
+        }
+        for (int lane = 0; lane < count; lane++) {
+            if (slots[lane]) AC_PREFETCH(table->entries[slots[lane] - 1].path);
+        }
+    }
+    for (int lane = 0; lane < count; lane++) {
+        if (!bulk_add(table, &keys[lane], -1)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Aggregate a query log: one query per line, optionally followed by a
+ * tab and its count or weight
+ */
+static int bulk_read_file(bulk_table_t *table, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        return -1;
+    }
+    
+    char (*lines)[AC_BULK_LINE_LENGTH] = malloc(2 * AC_BULK_LANES * AC_BULK_LINE_LENGTH);
+    if (!lines) {
+        fclose(file);
+        return -1;
+    }
+    bulk_key_t keys[AC_BULK_LANES];
+    int lanes = 0;
+    int result = 0;
+    while (result == 0) {
+        char *line = lines[2 * lanes];
+        if (!fgets(line, AC_BULK_LINE_LENGTH, file)) {
+            if (lanes > 0 && !bulk_add_lanes(table, keys, lanes)) result = -1;
+            break;
+        }
+        size_t length = strlen(line);
+        if (length == AC_BULK_LINE_LENGTH - 1 && line[length - 1] != '\n') {
+            // Keep the start of an overlong line and skip the rest of it
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n') {
+            }
+        }
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        
+        double weight = 1.0;
+        char *tab = strrchr(line, '\t');
+        if (tab) {
+            char *end;
+            double parsed = strtod(tab + 1, &end);
+            if (end != tab + 1 && *end == '\0') {
+                weight = parsed;
+                *tab = '\0';
+            }
+        }
+        if (line[0] == '\0' || weight <= 0) continue;
+        make_bulk_key(&keys[lanes], line, lines[2 * lanes + 1], weight);
+        if (++lanes == AC_BULK_LANES) {
+            if (!bulk_add_lanes(table, keys, lanes)) result = -1;
+            lanes = 0;
+        }
+    }
+    free(lines);
+    fclose(file);
+    return result;
+}
+
+static int compare_bulk_entries(const void *a, const void *b) {
+    return strcmp(((const bulk_entry_t*)a)->path, ((const bulk_entry_t*)b)->path);
+}
+
+/**
+ * @brief Lay the sorted entries out as a new trie in one pass
+ *
+ * Consecutive paths share their common prefix, so a stack of the current path
+ * is enough: levels below the shared prefix are closed, folding their score
+ * bounds into their parent, and the rest of the path is appended. Nodes come
+ * out in pre-order with children sorted by label.
+ */
+static bool bulk_build(bulk_table_t *table, autocomplete_source_t source) {
+    const bulk_entry_t *entries = table->entries;
+    uint32_t node_count = 1;
+    uint64_t string_bytes = 0;
+    size_t max_depth = 0;
+    double max_count = 0;
+    for (uint32_t e = 0; e < table->count; e++) {
+        size_t length = strlen(entries[e].path);
+        size_t shared = 0;
+        if (e > 0) {
+            while (entries[e - 1].path[shared] && entries[e - 1].path[shared] == entries[e].path[shared]) shared++;
+        }
+        node_count += (uint32_t)(length - shared);
+        string_bytes += strlen(entries[e].text) + 1;
+        if (length > max_depth) max_depth = length;
+        if (entries[e].count > max_count) max_count = entries[e].count;
+    }
+    if (string_bytes >= AC_NO_SUGGESTION) {
+        return false;
+    }
+    
+    trie_node_t *nodes = (trie_node_t*)malloc(node_count * sizeof(trie_node_t));
+    trie_node_stats_t *stats = (trie_node_stats_t*)calloc(node_count, sizeof(trie_node_stats_t));
+    trie_node_trend_t *trends = (trie_node_trend_t*)calloc(node_count, sizeof(trie_node_trend_t));
+    char *strings = (char*)malloc(string_bytes + 1);
+    uint32_t *stack = (uint32_t*)malloc((max_depth + 1) * sizeof(uint32_t));
+    uint32_t *last_child = (uint32_t*)malloc((max_depth + 1) * sizeof(uint32_t));
+    float *bounds = (float*)malloc((max_depth + 1) * sizeof(float));
+    if (!nodes || !stats || !trends || !strings || !stack || !last_child || !bounds) {
+        free(nodes);
+        free(stats);
+        free(trends);
+        free(strings);
+        free(stack);
+        free(last_child);
+        free(bounds);
+        return false;
+    }
+    
+    const trie_node_stats_t *old_stats = g_autocomplete_ctx.stats;
+    const trie_node_trend_t *old_trends = g_autocomplete_ctx.trends;
+    float base_score = calculate_suggestion_score("", "", source);
+    long now = time(NULL);
+    uint32_t next_node = 0;
+    uint64_t next_string = 0;
+    size_t depth = 0;
+    int added = 0;
+    
+    stack[0] = next_node++;
+    last_child[0] = 0;
+    bounds[0] = 0.0f;
+    memset(&nodes[0], 0, sizeof(trie_node_t));
+    nodes[0].suggestion = AC_NO_SUGGESTION;
+    atomic_flag_clear(&trends[0].trend_lock);
+    
+    for (uint32_t e = 0; e < table->count; e++) {
+        const bulk_entry_t *entry = &entries[e];
+        size_t length = strlen(entry->path);
+        size_t shared = 0;
+        if (e > 0) {
+            while (entries[e - 1].path[shared] && entries[e - 1].path[shared] == entry->path[shared]) shared++;
+        }
+        
+        for (; depth > shared; depth--) {
+            atomic_init(&stats[stack[depth]].max_score, pack_bound(bounds[depth], 0));
+            if (bounds[depth] > bounds[depth - 1]) bounds[depth - 1] = bounds[depth];
+        }
+        for (; depth < length; depth++) {
+            uint32_t child = next_node++;
+            trie_node_t *node = &nodes[child];
+            memset(node, 0, sizeof(trie_node_t));
+            node->suggestion = AC_NO_SUGGESTION;
+            node->label = (unsigned char)entry->path[depth];
+            atomic_flag_clear(&trends[child].trend_lock);
+            if (last_child[depth]) {
+                nodes[last_child[depth]].next_sibling = child;
+            } else {
+                nodes[stack[depth]].first_child = child;
+            }
+            last_child[depth] = child;
+            stack[depth + 1] = child;
+            last_child[depth + 1] = 0;
+            bounds[depth + 1] = 0.0f;
+        }
+        
+        uint32_t word = stack[depth];
+        trie_node_t *node = &nodes[word];
+        size_t text_length = strlen(entry->text) + 1;
+        memcpy(strings + next_string, entry->text, text_length);
+        node->suggestion = (uint32_t)next_string;
+        next_string += text_length;
+        
+        // More frequent queries score higher, up to the source's base score.
+        // max_count covers every logged query, the existing ones included.
+        float loaded_score = 0.0f;
+        if (entry->count > 0 && max_count > 0) {
+            loaded_score = base_score * (float)(0.5 + 0.5 * log1p(entry->count) / log1p(max_count));
+            if (loaded_score > base_score) loaded_score = base_score;
+        }
+        float score = loaded_score;
+        double trend_short = 0.0, trend_long = 0.0;
+        long last_used = now, trend_updated = 0;
+        int frequency = 0;
+        if (entry->node >= 0) {
+            const trie_node_stats_t *old = &old_stats[entry->node];
+            const trie_node_trend_t *old_trend = &old_trends[entry->node];
+            float old_score = atomic_load_explicit(&old->score, memory_order_relaxed);
+            score = old_score > loaded_score ? old_score : loaded_score;
+            frequency = atomic_load_explicit(&old->frequency, memory_order_relaxed);
+            if (entry->count <= 0) last_used = atomic_load_explicit(&old->last_used, memory_order_relaxed);
+            trend_short = atomic_load_explicit(&old_trend->trend_short, memory_order_relaxed);
+            trend_long = atomic_load_explicit(&old_trend->trend_long, memory_order_relaxed);
+            trend_updated = atomic_load_explicit(&old_trend->trend_updated, memory_order_relaxed);
+        } else {
+            added++;
+        }
+        frequency += (int)(entry->count + 0.5);
+        if (source == AC_SOURCE_POPULAR_QUERIES && entry->count > 0) {
+            // Bring the old counters to now, then count the logged weight as
+            // recent selections
+            if (trend_updated > 0 && now > trend_updated) {
+                trend_short *= exp2(-(double)(now - trend_updated) / AC_TRENDING_SHORT_HALF_LIFE);
+                trend_long *= exp2(-(double)(now - trend_updated) / AC_TRENDING_LONG_HALF_LIFE);
+            }
+            trend_short += entry->count;
+            trend_long += entry->count;
+            trend_updated = now;
+        }
+        atomic_init(&stats[word].score, score);
+        atomic_init(&stats[word].frequency, frequency);
+        atomic_init(&stats[word].last_used, last_used);
+        atomic_init(&trends[word].trend_short, trend_short);
+        atomic_init(&trends[word].trend_long, trend_long);
+        atomic_init(&trends[word].trend_updated, trend_updated);
+        if (score > bounds[depth]) bounds[depth] = score;
+    }
+    for (; depth > 0; depth--) {
+        atomic_init(&stats[stack[depth]].max_score, pack_bound(bounds[depth], 0));
+        if (bounds[depth] > bounds[depth - 1]) bounds[depth - 1] = bounds[depth];
+    }
+    atomic_init(&stats[0].max_score, pack_bound(bounds[0], 0));
+    
+    free(stack);
+    free(last_child);
+    free(bounds);
+    
+    release_trie();
+    g_autocomplete_ctx.nodes = nodes;
+    g_autocomplete_ctx.stats = stats;
+    g_autocomplete_ctx.trends = trends;
+    g_autocomplete_ctx.node_count = node_count;
+    g_autocomplete_ctx.node_capacity = node_count;
+    g_autocomplete_ctx.strings = strings;
+    g_autocomplete_ctx.string_bytes = string_bytes;
+    g_autocomplete_ctx.string_capacity = string_bytes + 1;
+    g_autocomplete_ctx.total_suggestions += added;
+    g_autocomplete_ctx.last_update = now;
+    return true;
+}
+
+/**
+ * @brief Merge a query log into the trie, rebuilding it in one pass
+ *
+ * Duplicates are counted in a hash table, the current suggestions join with
+ * their counters intact, and the sorted result replaces the node array, so no
+ * string or node is allocated per line. Returns the number of distinct
+ * queries read, or -1.
+ */
+static int bulk_load(const char *filename, autocomplete_source_t source) {
+    if (!filename || !trie_root()) {
+        return -1;
+    }
+    
+    bulk_table_t table = {0};
+    table.arena = arena_create(AC_BULK_ARENA_BLOCK);
+    int result = table.arena ? bulk_read_file(&table, filename) : -1;
+    int loaded = (int)table.count;
+    
+    for (uint32_t n = 0; n < g_autocomplete_ctx.node_count && result == 0; n++) {
+        const trie_node_t *node = &g_autocomplete_ctx.nodes[n];
+        if (node_is_word(node) && !bulk_add_existing(&table, n)) {
+            result = -1;
+        }
+    }
+    if (result == 0) {
+        qsort(table.entries, table.count, sizeof(bulk_entry_t), compare_bulk_entries);
+        if (!bulk_build(&table, source)) {
+            result = -1;
+        }
+    }
+    
+    free(table.entries);
+    free(table.slots);
+    free(table.path);
+    arena_free(table.arena);
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to load suggestions from %s\n", filename);
+        return -1;
+    }
+    return loaded;
+}
+
+/**
+ * @brief Load a query log: one query per line, repeated as often as it was
+ * searched, or followed by a tab and its count
+ */
+int load_suggestions_from_history(const char *history_file) {
+    return bulk_load(history_file, AC_SOURCE_QUERY_HISTORY);
+}
+
+/**
+ * @brief Load currently trending queries: one per line, optionally followed
+ * by a tab and its recent count, which also feeds trending detection
+ */
+int load_trending_suggestions(const char *trending_file) {
+    return bulk_load(trending_file, AC_SOURCE_POPULAR_QUERIES);
+}
+
+/**
+ * @brief Make room for one more level on the session's stack
+ */
+static bool session_reserve_level(ac_session_t *session) {
+    if (session->length + 2 <= session->level_capacity) {
+        return true;
+    }
+    int capacity = session->level_capacity ? session->level_capacity * 2 : 16;
+    ac_session_level_t *levels = (ac_session_level_t*)realloc(session->levels, capacity * sizeof(ac_session_level_t));
+    if (!levels) return false;
+    session->levels = levels;
+    session->level_capacity = capacity;
+    return true;
+}
+
+/**
+ * @brief Slot of node in the dedupe table: its own for this level's stamp, or
+ * the empty one it goes in
+ */
+static uint32_t session_seen_slot(const ac_session_t *session, uint32_t node) {
+    uint32_t mask = session->seen_capacity - 1;
+    uint32_t at = (node * 2654435761u) & mask;
+    while (session->seen[at * 3 + 1] == session->stamp && session->seen[at * 3] != node) {
+        at = (at + 1) & mask;
+    }
+    return at;
+}
+
+/**
+ * @brief Double the dedupe table, keeping the states of the level being built
+ */
+static bool session_grow_seen(ac_session_t *session, uint32_t level_start) {
+    uint32_t capacity = session->seen_capacity ? session->seen_capacity * 2 : 256;
+    uint32_t *seen = (uint32_t*)calloc((size_t)capacity * 3, sizeof(uint32_t));
+    if (!seen) return false;
+    free(session->seen);
+    session->seen = seen;
+    session->seen_capacity = capacity;
+    session->stamp = 1;
+    for (uint32_t i = level_start; i < session->state_count; i++) {
+        uint32_t at = session_seen_slot(session, session->states[i].node);
+        seen[at * 3] = session->states[i].node;
+        seen[at * 3 + 1] = session->stamp;
+        seen[at * 3 + 2] = i;
+    }
+    return true;
+}
+
+/**
+ * @brief Add node at distance to the level being built, keeping the smaller
+ * distance when it is already there
+ */
+static bool session_add_state(ac_session_t *session, uint32_t level_start, uint32_t node, uint32_t distance) {
+    if ((session->state_count - level_start + 1) * 2 > session->seen_capacity &&
+        !session_grow_seen(session, level_start)) {
+        return false;
+    }
+    uint32_t at = session_seen_slot(session, node);
+    if (session->seen[at * 3 + 1] == session->stamp) {
+        ac_active_state_t *state = &session->states[session->seen[at * 3 + 2]];
+        if (distance < state->distance) state->distance = distance;
+        return true;
+    }
+    
+    if (session->state_count == session->state_capacity) {
+        uint32_t capacity = session->state_capacity ? session->state_capacity * 2 : 256;
+        ac_active_state_t *states = (ac_active_state_t*)realloc(session->states, capacity * sizeof(ac_active_state_t));
+        if (!states) return false;
+        session->states = states;
+        session->state_capacity = capacity;
+    }
+    session->states[session->state_count].node = node;
+    session->states[session->state_count].distance = distance;
+    session->seen[at * 3] = node;
+    session->seen[at * 3 + 1] = session->stamp;
+    session->seen[at * 3 + 2] = session->state_count++;
+    return true;
+}
+
+/**
+ * @brief Start a new dedupe generation for the next level
+ */
+static void session_next_stamp(ac_session_t *session) {
+    if (++session->stamp == 0) {
+        memset(session->seen, 0, (size_t)session->seen_capacity * 3 * sizeof(uint32_t));
+        session->stamp = 1;
+    }
+}
+
+/**
+ * @brief Add every node at most max_depth below node, at its depth plus base
+ */
+static bool session_add_subtree(ac_session_t *session, uint32_t node, uint32_t base, uint32_t max_depth) {
+    if (!session_add_state(session, 0, node, base)) return false;
+    if (max_depth == 0) return true;
+    for (uint32_t child = child_index(node); child; child = sibling_index(child)) {
+        if (!session_add_subtree(session, child, base + 1, max_depth - 1)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Carry one active state over a typed label
+ *
+ * The child one level down matches or substitutes the label; deeper nodes
+ * labelled with it match after skipping (depth - 1) trie characters.
+ */
+static bool session_expand_state(ac_session_t *session, uint32_t level_start, uint32_t node,
+                                 int label, uint32_t distance, uint32_t depth) {
+    for (uint32_t child = child_index(node); child; child = sibling_index(child)) {
+        bool matches = g_autocomplete_ctx.nodes[child].label == label;
+        uint32_t cost = AC_SESSION_MAX_DISTANCE + 1;
+        if (depth == 1) {
+            cost = distance + (matches ? 0 : 1);
+        } else if (matches) {
+            cost = distance + depth - 1;
+        }
+        if (cost <= AC_SESSION_MAX_DISTANCE && !session_add_state(session, level_start, child, cost)) {
+            return false;
+        }
+        if (distance + depth <= AC_SESSION_MAX_DISTANCE &&
+            !session_expand_state(session, level_start, child, label, distance, depth + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Set up the empty query: the root, and every node close enough to it
+ * to be reached by typing AC_SESSION_MAX_DISTANCE characters
+ */
+static bool session_reset(ac_session_t *session) {
+    session->length = 0;
+    session->state_count = 0;
+    session->query[0] = '\0';
+    session->layout_version = atomic_load_explicit(&g_autocomplete_ctx.layout_version, memory_order_relaxed);
+    if (!session_reserve_level(session)) return false;
+    if (session->seen_capacity == 0 && !session_grow_seen(session, 0)) return false;
+    session_next_stamp(session);
+    
+    ac_session_level_t *level = &session->levels[0];
+    level->prefix_node = 0;
+    level->path_length = 0;
+    level->state_start = 0;
+    level->top_count = 0;
+    level->top_complete = false;
+    level->top_version = 0;
+    if (!session_add_subtree(session, 0, 0, AC_SESSION_MAX_DISTANCE)) return false;
+    level->state_count = session->state_count;
+    return true;
+}
+
+/**
+ * @brief Push the level for one more typed character
+ *
+ * The new active states come from the previous level's alone: each state
+ * either skips the character (one edit), or moves down onto it as above.
+ * Trie characters past the typed ones then count as one edit each, so the
+ * children of each new state join one edit further, closest states first so
+ * every node ends at its least distance. The trie skips non-ASCII characters,
+ * so they leave the level unchanged.
+ */
+static bool session_extend(ac_session_t *session, char c) {
+    if (session->length >= AC_SESSION_QUERY_LENGTH - 1 || !session_reserve_level(session)) {
+        return false;
+    }
+    int label = tolower((unsigned char)c);
+    ac_session_level_t *previous = &session->levels[session->length];
+    ac_session_level_t *level = &session->levels[session->length + 1];
+    level->prefix_node = previous->prefix_node;
+    level->path_length = previous->path_length;
+    level->state_start = previous->state_start;
+    level->state_count = previous->state_count;
+    level->top_count = 0;
+    level->top_complete = false;
+    level->top_version = 0;
+    
+    if (label < 128) {
+        if (level->prefix_node != AC_NO_SUGGESTION) {
+            trie_node_t *child = find_child(&g_autocomplete_ctx.nodes[level->prefix_node], label);
+            level->prefix_node = child ? (uint32_t)(child - g_autocomplete_ctx.nodes) : AC_NO_SUGGESTION;
+        }
+        session->path[level->path_length++] = (char)label;
+        
+        uint32_t level_start = session->state_count;
+        session_next_stamp(session);
+        for (uint32_t i = previous->state_start; i < previous->state_start + previous->state_count; i++) {
+            ac_active_state_t state = session->states[i];
+            if (state.distance < AC_SESSION_MAX_DISTANCE &&
+                !session_add_state(session, level_start, state.node, state.distance + 1)) {
+                return false;
+            }
+            if (!session_expand_state(session, level_start, state.node, label, state.distance, 1)) {
+                return false;
+            }
+        }
+        for (uint32_t distance = 0; distance < AC_SESSION_MAX_DISTANCE; distance++) {
+            for (uint32_t i = level_start; i < session->state_count; i++) {
+                if (session->states[i].distance != distance) continue;
+                for (uint32_t child = child_index(session->states[i].node); child; child = sibling_index(child)) {
+                    if (!session_add_state(session, level_start, child, distance + 1)) return false;
+                }
+            }
+        }
+        level->state_start = level_start;
+        level->state_count = session->state_count - level_start;
+    }
+    
+    session->query[session->length++] = (char)label;
+    session->query[session->length] = '\0';
+    return true;
+}
+
+/**
+ * @brief Rebuild every level after the trie was rebuilt or grew under the session
+ */
+static bool session_refresh(ac_session_t *session) {
+    if (!trie_root()) {
+        return false;
+    }
+    if (session->layout_version == atomic_load_explicit(&g_autocomplete_ctx.layout_version, memory_order_relaxed)) {
+        return true;
+    }
+    char query[AC_SESSION_QUERY_LENGTH];
+    memcpy(query, session->query, session->length + 1);
+    if (!session_reset(session)) return false;
+    for (int i = 0; query[i]; i++) {
+        if (!session_extend(session, query[i])) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Whether a suggestion's trie path starts with path[0 .. length)
+ */
+static bool text_has_path_prefix(const char *text, const char *path, int length) {
+    int matched = 0;
+    for (; *text && matched < length; text++) {
+        int label = tolower((unsigned char)*text);
+        if (label >= 128) continue;
+        if (label != (unsigned char)path[matched]) return false;
+        matched++;
+    }
+    return matched == length;
+}
+
+/**
+ * @brief Make sure the level's top list ranks at least needed completions at
+ * the current scores
+ *
+ * The list of the prefix one character shorter serves when it is current:
+ * the completions it holds under the longer prefix keep their order, and any
+ * it left out score no higher than its last entry.
+ */
+static void session_rank_level(ac_session_t *session, int depth, int needed) {
+    ac_session_level_t *level = &session->levels[depth];
+    unsigned long version = atomic_load_explicit(&g_autocomplete_ctx.score_version, memory_order_relaxed);
+    if (level->top_version == version && (level->top_complete || level->top_count >= needed)) {
+        return;
+    }
+    
+    const ac_session_level_t *previous = depth > 0 ? &session->levels[depth - 1] : NULL;
+    if (previous && previous->top_version == version) {
+        int count = 0;
+        for (int i = 0; i < previous->top_count; i++) {
+            const char *text = node_text(&g_autocomplete_ctx.nodes[previous->top[i].node]);
+            if (text_has_path_prefix(text, session->path, level->path_length)) {
+                level->top[count++] = previous->top[i];
+            }
+        }
+        level->top_count = count;
+        level->top_complete = previous->top_complete;
+        level->top_version = version;
+        if (level->top_complete || count >= needed) {
+            return;
+        }
+    }
+    
+    level->top_count = collect_best_hits(&g_autocomplete_ctx.nodes[level->prefix_node], level->top, AC_SESSION_TOP_K);
+    level->top_complete = level->top_count < AC_SESSION_TOP_K;
+    level->top_version = version;
+}
+
+/**
+ * @brief Prefix completions of the typed query, from the level's top list
+ */
+static int session_prefix_suggestions(ac_session_t *session, autocomplete_result_t *suggestions, int max_suggestions) {
+    ac_session_level_t *level = &session->levels[session->length];
+    if (level->prefix_node == AC_NO_SUGGESTION || max_suggestions <= 0) {
+        return 0;
+    }
+    if (max_suggestions > AC_SESSION_TOP_K) {
+        return collect_suggestions_from_trie(&g_autocomplete_ctx.nodes[level->prefix_node], suggestions, max_suggestions);
+    }
+    
+    session_rank_level(session, session->length, max_suggestions);
+    int count = level->top_count < max_suggestions ? level->top_count : max_suggestions;
+    for (int i = 0; i < count; i++) {
+        const ac_hit_t *hit = &level->top[i];
+        fill_suggestion(&suggestions[i], &g_autocomplete_ctx.nodes[hit->node], hit->score, hit->is_trending);
+    }
+    return count;
+}
+
+/**
+ * @brief Suggestions within AC_SESSION_MAX_DISTANCE edits of the typed query,
+ * closest first, scored the way get_fuzzy_suggestions scores them
+ *
+ * They are the level's active states that end a suggestion; distances are
+ * measured on trie paths, so case and non-ASCII characters do not count.
+ * Suggestions already among the first kept results are passed over.
+ */
+static int session_fuzzy_suggestions(ac_session_t *session, autocomplete_result_t *suggestions, int kept,
+                                     int max_suggestions) {
+    const ac_session_level_t *level = &session->levels[session->length];
+    long now = time(NULL);
+    int count = 0;
+    for (uint32_t distance = 0; distance <= AC_SESSION_MAX_DISTANCE && count < max_suggestions; distance++) {
+        for (uint32_t i = level->state_start; i < level->state_start + level->state_count && count < max_suggestions; i++) {
+            const ac_active_state_t *state = &session->states[i];
+            const trie_node_t *node = &g_autocomplete_ctx.nodes[state->node];
+            if (state->distance != distance || !node_is_word(node)) continue;
+            
+            bool trending = node_is_trending(node, now, 3600);
+            float score = 1.0f - distance * 0.2f;
+            if (trending && g_autocomplete_ctx.config.enable_trending_boost) {
+                score *= g_autocomplete_ctx.config.trending_weight;
+            }
+            autocomplete_result_t *suggestion = &suggestions[kept + count];
+            fill_suggestion(suggestion, node, score, trending);
+            bool duplicate = false;
+            for (int j = 0; j < kept && !duplicate; j++) {
+                duplicate = strcmp(suggestion->suggestion, suggestions[j].suggestion) == 0;
+            }
+            if (!duplicate) count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Suggestions for the session's query, combined the way
+ * get_autocomplete_suggestions combines them
+ *
+ * The learned ranker scores its candidates together, so with a model loaded
+ * AC_ALGORITHM_ML_BASED still runs the full lookup.
+ */
+static int session_suggestions(ac_session_t *session, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (!suggestions || max_suggestions <= 0) {
+        return 0;
+    }
+    
+    int suggestion_count = 0;
+    switch (g_autocomplete_ctx.config.algorithm) {
+        case AC_ALGORITHM_PREFIX_MATCH:
+            suggestion_count = session_prefix_suggestions(session, suggestions, max_suggestions);
+            break;
+            
+        case AC_ALGORITHM_FUZZY_MATCH:
+            suggestion_count = session_fuzzy_suggestions(session, suggestions, 0, max_suggestions);
+            break;
+            
+        case AC_ALGORITHM_CONTEXTUAL:
+            suggestion_count = get_contextual_suggestions(session->query, NULL, suggestions, max_suggestions);
+            if (suggestion_count < max_suggestions) {
+                int prefix_count = session_prefix_suggestions(session, suggestions + suggestion_count,
+                                                              max_suggestions - suggestion_count);
+                suggestion_count = merge_unique(suggestions, suggestion_count, prefix_count);
+            }
+            break;
+            
+        case AC_ALGORITHM_ML_BASED:
+            if (g_autocomplete_ctx.model) {
+                return get_ml_suggestions(session->query, suggestions, max_suggestions);
+            }
+            /* fall through */
+        case AC_ALGORITHM_HYBRID:
+        default:
+            suggestion_count = session_prefix_suggestions(session, suggestions, max_suggestions / 2);
+            if (suggestion_count < max_suggestions) {
+                suggestion_count += session_fuzzy_suggestions(session, suggestions, suggestion_count,
+                                                              max_suggestions - suggestion_count);
+            }
+            if (suggestion_count < max_suggestions && g_autocomplete_ctx.popularity) {
+                int popular_count = get_popular_suggestions(session->query,
+                                                            suggestions + suggestion_count,
+                                                            max_suggestions - suggestion_count);
+                suggestion_count = merge_unique(suggestions, suggestion_count, popular_count);
+            }
+            if (suggestion_count < max_suggestions && g_autocomplete_ctx.ngrams) {
+                int contextual_count = get_contextual_suggestions(session->query, NULL,
+                                                                  suggestions + suggestion_count,
+                                                                  max_suggestions - suggestion_count);
+                suggestion_count = merge_unique(suggestions, suggestion_count, contextual_count);
+            }
+            break;
+    }
+    
+    qsort(suggestions, suggestion_count, sizeof(autocomplete_result_t), compare_suggestions);
+    return suggestion_count;
+}
+
+/**
+ * @brief Start a session on the empty query
+ */
+ac_session_t* ac_session_begin(void) {
+    if (!trie_root()) {
+        return NULL;
+    }
+    ac_session_t *session = (ac_session_t*)calloc(1, sizeof(ac_session_t));
+    if (!session) {
+        return NULL;
+    }
+    if (!session_reset(session)) {
+        ac_session_end(session);
+        return NULL;
+    }
+    return session;
+}
+
+/**
+ * @brief Type one character
+ */
+int ac_session_push_char(ac_session_t *session, char c, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (!session || c == '\0' || !session_refresh(session) || !session_extend(session, c)) {
+        return -1;
+    }
+    return session_suggestions(session, suggestions, max_suggestions);
+}
+
+/**
+ * @brief Delete the last character typed; the shorter query's levels are
+ * still there, so this only drops the last one
+ */
+int ac_session_pop_char(ac_session_t *session, autocomplete_result_t *suggestions, int max_suggestions) {
+    if (!session || session->length == 0 || !session_refresh(session)) {
+        return -1;
+    }
+    session->length--;
+    session->query[session->length] = '\0';
+    const ac_session_level_t *level = &session->levels[session->length];
+    session->state_count = level->state_start + level->state_count;
+    return session_suggestions(session, suggestions, max_suggestions);
+}
+
+/**
+ * @brief Free a session
+ */
+void ac_session_end(ac_session_t *session) {
+    if (!session) return;
+    free(session->levels);
+    free(session->states);
+    free(session->seen);
+    free(session);
 }
@@ -7,7 +7,18 @@
 #define AUTOCOMPLETE_H
 
 #include "search_engine.h"
+#include "reranker.h"
+#include "popularity.h"
+#include "ngram.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define MAX_SUGGESTION_LENGTH 128          // Suggestion text, NUL included; longer ones are cut
+#define MAX_AUTOCOMPLETE_SUGGESTIONS 10    // Suggestions returned by default
+#define DEFAULT_SUGGESTION_THRESHOLD 0.1f
+#define AC_QUERY_LENGTH 256                // Query normalized for lookup, NUL included
 
 /* Autocomplete algorithm types */
 typedef enum {
@@ -27,6 +38,26 @@ typedef enum {
     AC_SOURCE_PERSONALIZED          // Personalized
 } autocomplete_source_t;
 
+/* Features the suggestion model reads, one row per candidate */
+typedef enum {
+    AC_FEATURE_STORED_SCORE,        // Score the suggestion was added with
+    AC_FEATURE_FREQUENCY,           // Times it was added
+    AC_FEATURE_EDIT_DISTANCE,       // Distance to the query, capped at 3
+    AC_FEATURE_IS_PREFIX,           // 1 when the suggestion extends the query
+    AC_FEATURE_LENGTH_DELTA,        // Suggestion length minus query length
+    AC_FEATURE_AGE_SECONDS,         // Seconds since last use
+    AC_FEATURE_COUNT
+} autocomplete_feature_t;
+
+/* One suggestion as returned to callers */
+typedef struct {
+    char suggestion[MAX_SUGGESTION_LENGTH];
+    float score;
+    int frequency;
+    bool is_trending;
+    long last_used;
+} autocomplete_result_t;
+
 /* Configuration */
 typedef struct {
     autocomplete_algorithm_t algorithm;
@@ -38,26 +69,153 @@ typedef struct {
     float trending_weight;
     float history_weight;
     float popularity_weight;
+    size_t topk_cache_bytes;         // Memory for cached top completions of hot prefixes
 } autocomplete_config_t;
 
-/* Trie node for prefix matching */
-typedef struct trie_node {
-    struct trie_node *children[128]; // ASCII children
-    char *suggestion;
-    float score;
-    int frequency;
-    bool is_end_of_word;
-    long last_used;
+/* Trending detection: a suggestion trends when its recent selection rate
+ * clearly outpaces its long-term baseline */
+#define AC_TRENDING_SHORT_HALF_LIFE 3600.0     // Seconds
+#define AC_TRENDING_LONG_HALF_LIFE 604800.0    // A week
+#define AC_TRENDING_RATIO 3.0                  // Recent rate over baseline rate
+#define AC_TRENDING_MIN_SELECTIONS 3.0         // Recent decayed selections
+
+/* Online learning: each feedback moves a score this far towards its target */
+#define AC_LEARNING_RATE 0.1f
+
+/* Top-k cache: the prefixes up to AC_TOPK_CACHE_DEPTH characters with the most
+ * completions keep their best AC_TOPK_CACHE_SIZE ready to copy out. Lists are
+ * patched as scores change, and ranked again when a suggestion on them stops
+ * trending. Loading or growing the trie only drops the cache; the first prefix
+ * lookup after that chooses the prefixes again, and lookups meanwhile search
+ * the trie. */
+#define AC_TOPK_CACHE_SIZE 10
+#define AC_TOPK_CACHE_DEPTH 3
+#define AC_TOPK_CACHE_BYTES (1 << 20)
+#define AC_TOPK_STALE 0                        // Dropped; the next lookup builds it
+#define AC_TOPK_BUILDING 1                     // One lookup is building it
+#define AC_TOPK_READY 2
+
+/* Trie node for prefix matching. Nodes live in one array and refer to each
+ * other by index, so the trie holds no pointers and a saved snapshot is used
+ * where it is mapped. A node's children form a sibling list sorted by label.
+ * The node holds only the trie's shape; what feedback changes lives in the
+ * parallel stats and trend arrays, so the node array is never written while
+ * searches read it. Inserts still need the caller to serialize. */
+#define AC_NO_SUGGESTION UINT32_MAX
+
+typedef struct {
+    uint32_t first_child;            // Lowest-labelled child, 0 for none (the root is never a child)
+    uint32_t next_sibling;           // Next child of the same parent by label, 0 for none
+    uint32_t suggestion;             // Offset of the text in the string pool, or AC_NO_SUGGESTION
+                                     // (only end-of-word nodes have one)
+    unsigned char label;             // ASCII character on the edge from the parent
 } trie_node_t;
 
+/* Ranking state of nodes[i], saved with the snapshot. Feedback updates it in
+ * place while other threads read it. */
+typedef struct {
+    _Atomic float score;
+    _Atomic int frequency;
+    _Atomic long last_used;
+    _Atomic uint64_t max_score;      // Float bits of a bound on every score in this subtree
+                                     // (may be stale high) over a count of changes to it
+} trie_node_stats_t;
+
+/* Trending counters of nodes[i]. Kept in memory only: they describe the last
+ * few hours, and a loaded snapshot starts them from zero. */
+typedef struct {
+    _Atomic double trend_short;      // Selections decayed over AC_TRENDING_SHORT_HALF_LIFE
+    _Atomic double trend_long;       // Selections decayed over AC_TRENDING_LONG_HALF_LIFE
+    _Atomic long trend_updated;      // When both counters were last decayed
+    atomic_flag trend_lock;          // Held by a writer decaying the counters
+} trie_node_trend_t;
+
+typedef struct {
+    uint32_t node;
+    _Atomic unsigned sequence;       // Odd while the list is being rewritten
+    atomic_flag writing;             // Held by the writer rewriting it
+    _Atomic long expires;            // When a listed suggestion stops trending
+    int count;
+    uint32_t nodes[AC_TOPK_CACHE_SIZE];
+    autocomplete_result_t results[AC_TOPK_CACHE_SIZE];
+} ac_topk_entry_t;
+
 /* Autocomplete system context */
 typedef struct {
-    trie_node_t *root;
+    trie_node_t *nodes;              // nodes[0] is the root
+    trie_node_stats_t *stats;        // One per node
+    trie_node_trend_t *trends;       // One per node, allocated even for a mapped snapshot
+    uint32_t node_count;
+    uint32_t node_capacity;          // 0 while the nodes lie in a mapped snapshot
+    char *strings;                   // Suggestion texts, NUL terminated
+    uint64_t string_bytes;
+    uint64_t string_capacity;        // 0 while the texts lie in a mapped snapshot
+    void *snapshot;                  // Mapped snapshot, copied out before the first insert
+    size_t snapshot_size;
     autocomplete_config_t config;
     int total_suggestions;
     long last_update;
+    Reranker *model;                 // Scores AC_ALGORITHM_ML_BASED candidates
+    Popularity *popularity;          // Heavy hitters of the search history, not owned
+    NgramModel *ngrams;              // Word sequences of indexed content, not owned
+    _Atomic unsigned long layout_version; // Bumped when nodes are added or the arrays replaced
+    _Atomic unsigned long score_version;  // Bumped whenever a ranking may have changed
+    _Atomic int topk_state;          // AC_TOPK_STALE, AC_TOPK_BUILDING or AC_TOPK_READY
+    ac_topk_entry_t *topk_entries;   // Cached lists, for prefixes chosen by the first lookup
+    uint32_t topk_count;             // after a load, and again once the trie grows by half
+    uint32_t *topk_slots;            // Open-addressed node -> entry index + 1
+    uint32_t topk_slot_capacity;
+    uint32_t topk_countdown;         // Inserts left before the prefixes are chosen again
 } autocomplete_context_t;
 
+/* As-you-type sessions. A session follows one query a keystroke at a time and
+ * keeps, for every prefix typed so far, its trie node, the trie nodes within
+ * AC_SESSION_MAX_DISTANCE edits of it, and its best completions, so a
+ * keystroke only does the work its character adds and deleting one reuses
+ * what was kept. */
+#define AC_SESSION_MAX_DISTANCE 2
+#define AC_SESSION_TOP_K 16
+#define AC_SESSION_QUERY_LENGTH 256      // Longest query a session follows, NUL included
+
+/* A node whose path is within distance edits of the typed prefix */
+typedef struct {
+    uint32_t node;
+    uint32_t distance;
+} ac_active_state_t;
+
+/* A ranked suggestion, by node index */
+typedef struct {
+    uint32_t node;
+    float score;
+    bool is_trending;
+} ac_hit_t;
+
+typedef struct {
+    uint32_t prefix_node;            // Node of the typed prefix, AC_NO_SUGGESTION once it leaves the trie
+    int path_length;                 // Characters of the prefix the trie follows
+    uint32_t state_start;            // This prefix's active states in the session's stack
+    uint32_t state_count;
+    ac_hit_t top[AC_SESSION_TOP_K];  // Best completions of the prefix
+    int top_count;
+    bool top_complete;               // top holds every completion
+    unsigned long top_version;       // score_version top was ranked at, 0 for none
+} ac_session_level_t;
+
+typedef struct {
+    char query[AC_SESSION_QUERY_LENGTH]; // Typed so far, lowercased
+    char path[AC_SESSION_QUERY_LENGTH];  // The ASCII characters of query, the trie path
+    int length;
+    ac_session_level_t *levels;      // levels[i] describes query[0 .. i)
+    int level_capacity;
+    ac_active_state_t *states;       // Active states of every level, shortest prefix first
+    uint32_t state_count;
+    uint32_t state_capacity;
+    uint32_t *seen;                  // Dedupes the level being built: node, stamp and
+    uint32_t seen_capacity;          // state index per slot, live while stamp matches
+    uint32_t stamp;
+    unsigned long layout_version;    // The trie layout the states refer to
+} ac_session_t;
+
 /* Initialization and cleanup */
 int init_autocomplete_system(void);
 void cleanup_autocomplete_system(void);
@@ -72,6 +230,9 @@ int load_suggestions_from_history(const char *history_file);
 int load_trending_suggestions(const char *trending_file);
 int save_autocomplete_data(const char *filename);
 int load_autocomplete_data(const char *filename);
+int load_autocomplete_model(const char *model_file);
+int set_popularity_source(Popularity *popularity);
+int set_ngram_source(NgramModel *ngrams);
 
 /* Suggestion retrieval */
 int get_autocomplete_suggestions(const char *query, autocomplete_result_t *suggestions, int max_suggestions);
@@ -79,8 +240,17 @@ int get_autocomplete_suggestions(const char *query, autocomplete_result_t *sugge
 /* Algorithm-specific retrieval */
 int get_prefix_suggestions(const char *prefix, autocomplete_result_t *suggestions, int max_suggestions);
 int get_fuzzy_suggestions(const char *query, autocomplete_result_t *suggestions, int max_suggestions);
+int get_ml_suggestions(const char *query, autocomplete_result_t *suggestions, int max_suggestions);
+int get_popular_suggestions(const char *prefix, autocomplete_result_t *suggestions, int max_suggestions);
 int get_contextual_suggestions(const char *query, const char *context, autocomplete_result_t *suggestions, int max_suggestions);
 
+/* As-you-type sessions: each call returns the suggestions for the query
+ * typed so far, or -1 */
+ac_session_t* ac_session_begin(void);
+int ac_session_push_char(ac_session_t *session, char c, autocomplete_result_t *suggestions, int max_suggestions);
+int ac_session_pop_char(ac_session_t *session, autocomplete_result_t *suggestions, int max_suggestions);
+void ac_session_end(ac_session_t *session);
+
 /* Utility functions */
 int calculate_edit_distance(const char *str1, const char *str2);
 bool is_suggestion_trending(const char *suggestion, long time_window);
@@ -0,0 +1,350 @@
+#include "bitmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+Bitmap* bitmap_create(void) {
+    Bitmap *bitmap = (Bitmap *)malloc(sizeof(Bitmap));
+    bitmap->containerCapacity = 4;
+    bitmap->containers = (BitmapContainer *)malloc(sizeof(BitmapContainer) * bitmap->containerCapacity);
+    bitmap->containerCount = 0;
+    return bitmap;
+}
+
+// Index of the container for key, or -(insertion point + 1) when absent
+static int findContainer(const Bitmap *bitmap, uint16_t key) {
+    int lo = 0, hi = bitmap->containerCount - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        uint16_t midKey = bitmap->containers[mid].key;
+        if (midKey == key) return mid;
+        if (midKey < key) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -(lo + 1);
+}
+
+static BitmapContainer* insertContainer(Bitmap *bitmap, int pos, uint16_t key) {
+    if (bitmap->containerCount == bitmap->containerCapacity) {
+        bitmap->containerCapacity *= 2;
+        bitmap->containers = (BitmapContainer *)realloc(bitmap->containers,
+                                                        sizeof(BitmapContainer) * bitmap->containerCapacity);
+    }
+    memmove(&bitmap->containers[pos + 1], &bitmap->containers[pos],
+            sizeof(BitmapContainer) * (bitmap->containerCount - pos));
+    bitmap->containerCount++;
+
+    BitmapContainer *container = &bitmap->containers[pos];
+    container->key = key;
+    container->cardinality = 0;
+    container->capacity = 4;
+    container->values = (uint16_t *)malloc(sizeof(uint16_t) * container->capacity);
+    container->bits = NULL;
+    return container;
+}
+
+static void freeContainer(BitmapContainer *container) {
+    free(container->values);
+    free(container->bits);
+}
+
+// Takes ownership of container; keys must arrive in ascending order
+static void appendContainer(Bitmap *bitmap, BitmapContainer *container) {
+    if (container->cardinality == 0) {
+        freeContainer(container);
+        return;
+    }
+    if (bitmap->containerCount == bitmap->containerCapacity) {
+        bitmap->containerCapacity *= 2;
+        bitmap->containers = (BitmapContainer *)realloc(bitmap->containers,
+                                                        sizeof(BitmapContainer) * bitmap->containerCapacity);
+    }
+    bitmap->containers[bitmap->containerCount++] = *container;
+}
+
+static int countBits(const uint64_t *bits) {
+    int count = 0;
+    for (int i = 0; i < BITMAP_WORDS; i++) count += __builtin_popcountll(bits[i]);
+    return count;
+}
+
+static void arrayToBitset(BitmapContainer *container) {
+    container->bits = (uint64_t *)calloc(BITMAP_WORDS, sizeof(uint64_t));
+    for (int i = 0; i < container->cardinality; i++) {
+        uint16_t value = container->values[i];
+        container->bits[value >> 6] |= 1ULL << (value & 63);
+    }
+    free(container->values);
+    container->values = NULL;
+    container->capacity = 0;
+}
+
+static void bitsetToArray(BitmapContainer *container) {
+    container->capacity = container->cardinality > 0 ? container->cardinality : 1;
+    container->values = (uint16_t *)malloc(sizeof(uint16_t) * container->capacity);
+    int n = 0;
+    for (int w = 0; w < BITMAP_WORDS; w++) {
+        uint64_t word = container->bits[w];
+        while (word) {
+            container->values[n++] = (uint16_t)(w * 64 + __builtin_ctzll(word));
+            word &= word - 1;
+        }
+    }
+    free(container->bits);
+    container->bits = NULL;
+}
+
+// Position of value in a sorted array container, or -(insertion point + 1)
+static int findValue(const BitmapContainer *container, uint16_t value) {
+    int lo = 0, hi = container->cardinality - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (container->values[mid] == value) return mid;
+        if (container->values[mid] < value) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -(lo + 1);
+}
+
+void bitmap_add(Bitmap *bitmap, int id) {
+    uint16_t key = (uint16_t)(id >> 16);
+    uint16_t value = (uint16_t)(id & 0xFFFF);
+    int pos = findContainer(bitmap, key);
+    BitmapContainer *container = pos >= 0 ? &bitmap->containers[pos] :
+                                 insertContainer(bitmap, -pos - 1, key);
+
+    if (container->bits) {
+        uint64_t mask = 1ULL << (value & 63);
+        if (!(container->bits[value >> 6] & mask)) {
+            container->bits[value >> 6] |= mask;
+            container->cardinality++;
+        }
+        return;
+    }
+
+    int at = findValue(container, value);
+    if (at >= 0) return;
+    at = -at - 1;
+    if (container->cardinality == BITMAP_ARRAY_MAX) {
+        arrayToBitset(container);
+        container->bits[value >> 6] |= 1ULL << (value & 63);
+        container->cardinality++;
+        return;
+    }
+    if (container->cardinality == container->capacity) {
+        container->capacity *= 2;
+        container->values = (uint16_t *)realloc(container->values,
+                                                sizeof(uint16_t) * container->capacity);
+    }
+    memmove(&container->values[at + 1], &container->values[at],
+            sizeof(uint16_t) * (container->cardinality - at));
+    container->values[at] = value;
+    container->cardinality++;
+}
+
+void bitmap_remove(Bitmap *bitmap, int id) {
+    uint16_t value = (uint16_t)(id & 0xFFFF);
+    int pos = findContainer(bitmap, (uint16_t)(id >> 16));
+    if (pos < 0) return;
+    BitmapContainer *container = &bitmap->containers[pos];
+
+    if (container->bits) {
+        uint64_t mask = 1ULL << (value & 63);
+        if (!(container->bits[value >> 6] & mask)) return;
+        container->bits[value >> 6] &= ~mask;
+        container->cardinality--;
+        if (container->cardinality <= BITMAP_ARRAY_MAX) bitsetToArray(container);
+    } else {
+        int at = findValue(container, value);
+        if (at < 0) return;
+        memmove(&container->values[at], &container->values[at + 1],
+                sizeof(uint16_t) * (container->cardinality - at - 1));
+        container->cardinality--;
+    }
+
+    if (container->cardinality == 0) {
+        freeContainer(container);
+        memmove(&bitmap->containers[pos], &bitmap->containers[pos + 1],
+                sizeof(BitmapContainer) * (bitmap->containerCount - pos - 1));
+        bitmap->containerCount--;
+    }
+}
+
+int bitmap_contains(const Bitmap *bitmap, int id) {
+    uint16_t value = (uint16_t)(id & 0xFFFF);
+    int pos = findContainer(bitmap, (uint16_t)(id >> 16));
+    if (pos < 0) return 0;
+    const BitmapContainer *container = &bitmap->containers[pos];
+    if (container->bits) return (container->bits[value >> 6] >> (value & 63)) & 1;
+    return findValue(container, value) >= 0;
+}
+
+int bitmap_cardinality(const Bitmap *bitmap) {
+    int total = 0;
+    for (int i = 0; i < bitmap->containerCount; i++) {
+        total += bitmap->containers[i].cardinality;
+    }
+    return total;
+}
+
+static BitmapContainer andContainers(const BitmapContainer *a, const BitmapContainer *b) {
+    BitmapContainer out;
+    out.key = a->key;
+    out.cardinality = 0;
+    out.bits = NULL;
+
+    if (a->bits && b->bits) {
+        out.values = NULL;
+        out.capacity = 0;
+        out.bits = (uint64_t *)malloc(sizeof(uint64_t) * BITMAP_WORDS);
+        for (int w = 0; w < BITMAP_WORDS; w++) out.bits[w] = a->bits[w] & b->bits[w];
+        out.cardinality = countBits(out.bits);
+        if (out.cardinality <= BITMAP_ARRAY_MAX) bitsetToArray(&out);
+        return out;
+    }
+
+    // At least one side is an array, so the result fits in the smaller array
+    const BitmapContainer *small = a->bits ? b : a;
+    const BitmapContainer *other = a->bits ? a : b;
+    out.capacity = small->cardinality > 0 ? small->cardinality : 1;
+    out.values = (uint16_t *)malloc(sizeof(uint16_t) * out.capacity);
+
+    if (other->bits) {
+        for (int i = 0; i < small->cardinality; i++) {
+            uint16_t value = small->values[i];
+            if ((other->bits[value >> 6] >> (value & 63)) & 1) out.values[out.cardinality++] = value;
+        }
+        return out;
+    }
+
+    int i = 0, j = 0;
+    while (i < small->cardinality && j < other->cardinality) {
+        if (small->values[i] < other->values[j]) i++;
+        else if (small->values[i] > other->values[j]) j++;
+        else {
+            out.values[out.cardinality++] = small->values[i];
+            i++;
+            j++;
+        }
+    }
+    return out;
+}
+
+static BitmapContainer orContainers(const BitmapContainer *a, const BitmapContainer *b) {
+    BitmapContainer out;
+    out.key = a->key;
+    out.cardinality = 0;
+
+    if (a->bits || b->bits) {
+        out.values = NULL;
+        out.capacity = 0;
+        out.bits = (uint64_t *)calloc(BITMAP_WORDS, sizeof(uint64_t));
+        const BitmapContainer *sides[2] = { a, b };
+        for (int s = 0; s < 2; s++) {
+            if (sides[s]->bits) {
+                for (int w = 0; w < BITMAP_WORDS; w++) out.bits[w] |= sides[s]->bits[w];
+            } else {
+                for (int i = 0; i < sides[s]->cardinality; i++) {
+                    uint16_t value = sides[s]->values[i];
+                    out.bits[value >> 6] |= 1ULL << (value & 63);
+                }
+            }
+        }
+        out.cardinality = countBits(out.bits);
+        return out;
+    }
+
+    out.bits = NULL;
+    out.capacity = a->cardinality + b->cardinality;
+    out.values = (uint16_t *)malloc(sizeof(uint16_t) * (out.capacity > 0 ? out.capacity : 1));
+    int i = 0, j = 0;
+    while (i < a->cardinality || j < b->cardinality) {
+        if (j == b->cardinality || (i < a->cardinality && a->values[i] < b->values[j])) {
+            out.values[out.cardinality++] = a->values[i++];
+        } else if (i == a->cardinality || b->values[j] < a->values[i]) {
+            out.values[out.cardinality++] = b->values[j++];
+        } else {
+            out.values[out.cardinality++] = a->values[i];
+            i++;
+            j++;
+        }
+    }
+    if (out.cardinality > BITMAP_ARRAY_MAX) arrayToBitset(&out);
+    return out;
+}
+
+Bitmap* bitmap_and(const Bitmap *a, const Bitmap *b) {
+    Bitmap *result = bitmap_create();
+    int i = 0, j = 0;
+    while (i < a->containerCount && j < b->containerCount) {
+        uint16_t keyA = a->containers[i].key;
+        uint16_t keyB = b->containers[j].key;
+        if (keyA < keyB) i++;
+        else if (keyA > keyB) j++;
+        else {
+            BitmapContainer container = andContainers(&a->containers[i], &b->containers[j]);
+            appendContainer(result, &container);
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+Bitmap* bitmap_or(const Bitmap *a, const Bitmap *b) {
+    Bitmap *result = bitmap_create();
+    BitmapContainer empty = { 0, 0, NULL, 0, NULL };
+    int i = 0, j = 0;
+    while (i < a->containerCount || j < b->containerCount) {
+        const BitmapContainer *left = i < a->containerCount ? &a->containers[i] : NULL;
+        const BitmapContainer *right = j < b->containerCount ? &b->containers[j] : NULL;
+        BitmapContainer container;
+        if (right == NULL || (left != NULL && left->key < right->key)) {
+            empty.key = left->key;
+            container = orContainers(left, &empty);
+            i++;
+        } else if (left == NULL || right->key < left->key) {
+            empty.key = right->key;
+            container = orContainers(right, &empty);
+            j++;
+        } else {
+            container = orContainers(left, right);
+            i++;
+            j++;
+        }
+        appendContainer(result, &container);
+    }
+    return result;
+}
+
+int* bitmap_toArray(const Bitmap *bitmap, int *count) {
+    int total = bitmap_cardinality(bitmap);
+    int *ids = (int *)malloc(sizeof(int) * (total > 0 ? total : 1));
+    *count = 0;
+    for (int i = 0; i < bitmap->containerCount; i++) {
+        const BitmapContainer *container = &bitmap->containers[i];
+        int high = (int)container->key << 16;
+        if (container->bits) {
+            for (int w = 0; w < BITMAP_WORDS; w++) {
+                uint64_t word = container->bits[w];
+                while (word) {
+                    ids[(*count)++] = high | (w * 64 + __builtin_ctzll(word));
+                    word &= word - 1;
+                }
+            }
+        } else {
+            for (int j = 0; j < container->cardinality; j++) {
+                ids[(*count)++] = high | container->values[j];
+            }
+        }
+    }
+    return ids;
+}
+
+void bitmap_free(Bitmap *bitmap) {
+    if (!bitmap) return;
+    for (int i = 0; i < bitmap->containerCount; i++) {
+        freeContainer(&bitmap->containers[i]);
+    }
+    free(bitmap->containers);
+    free(bitmap);
+}
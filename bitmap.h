@@ -0,0 +1,37 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+
+// Containers switch from a sorted array to a 65536-bit set past this size,
+// which is where the array stops being the smaller of the two (8KB).
+#define BITMAP_ARRAY_MAX 4096
+#define BITMAP_WORDS 1024
+
+// One 2^16-wide chunk of the id space, keyed by the high 16 bits.
+typedef struct {
+    uint16_t key;
+    int cardinality;
+    uint16_t *values;   // array container: sorted low 16 bits
+    int capacity;
+    uint64_t *bits;     // bitset container when non-NULL
+} BitmapContainer;
+
+// Compressed document id set in the style of Roaring bitmaps.
+typedef struct {
+    BitmapContainer *containers; // ascending by key
+    int containerCount;
+    int containerCapacity;
+} Bitmap;
+
+Bitmap* bitmap_create(void);
+void bitmap_add(Bitmap *bitmap, int id);
+void bitmap_remove(Bitmap *bitmap, int id);
+int bitmap_contains(const Bitmap *bitmap, int id);
+int bitmap_cardinality(const Bitmap *bitmap);
+Bitmap* bitmap_and(const Bitmap *a, const Bitmap *b);
+Bitmap* bitmap_or(const Bitmap *a, const Bitmap *b);
+int* bitmap_toArray(const Bitmap *bitmap, int *count);
+void bitmap_free(Bitmap *bitmap);
+
+#endif
@@ -5,6 +5,7 @@
 #include "cli.h"
 #include "minigit.h"
 #include "search_engine.h"
+#include "storage.h"
 #include "autocomplete.h"
 #include "ranking.h"
 
@@ -66,6 +67,12 @@ int main() {
     init_search_engine();
     init_autocomplete_system();
     init_ranking_system();
+    // Contextual suggestions complete words from the indexed content
+    SearchEngine *engine = searchengine_create();
+    set_ngram_source(engine->ngrams);
+    // Popular-query suggestions come from the search history
+    Storage *storage = storage_create();
+    set_popularity_source(storage->popularity);
 
     print_help();
 
@@ -99,6 +106,8 @@ int main() {
 
     cleanup_ranking_system();
     cleanup_autocomplete_system();
+    searchengine_free(engine);
+    storage_free(storage);
     cleanup_search_engine();
     return 0;
 }
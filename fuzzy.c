@@ -1,23 +1,32 @@
 #include "fuzzy.h"
+#include "strsearch.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 FuzzyMatcher* fuzzy_create(void) {
     FuzzyMatcher *matcher = (FuzzyMatcher *)malloc(sizeof(FuzzyMatcher));
+    matcher->termCapacity = 1024;
+    matcher->terms = (char **)malloc(sizeof(char *) * matcher->termCapacity);
+    matcher->termLengths = (int *)malloc(sizeof(int) * matcher->termCapacity);
+    matcher->seen = (unsigned int *)calloc(matcher->termCapacity, sizeof(unsigned int));
+    matcher->termCount = 0;
+    matcher->termSlotCapacity = 2048;
+    matcher->termSlots = (int *)calloc(matcher->termSlotCapacity, sizeof(int));
+    matcher->bucketCapacity = 16384;
+    matcher->buckets = (FuzzyDeleteBucket *)calloc(matcher->bucketCapacity, sizeof(FuzzyDeleteBucket));
+    matcher->bucketCount = 0;
+    matcher->generation = 0;
     return matcher;
 }
 
-static char* strToLower(const char *str) {
-    char *result = (char *)malloc(strlen(str) + 1);
-    for (int i = 0; str[i]; i++) {
-        result[i] = tolower((unsigned char)str[i]);
-    }
-    result[strlen(str)] = '\0';
-    return result;
-}
-
 static int min(int a, int b) {
     return a < b ? a : b;
 }
@@ -27,6 +36,410 @@ static int min3(int a, int b, int c) {
     return m < c ? m : c;
 }
 
+static uint64_t hashBytes(const char *str, int len) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Case-insensitive Levenshtein distance that gives up once every cell of a
+// row exceeds maxDistance; returns maxDistance + 1 in that case.
+static int boundedDistance(const char *a, int lenA, const char *b, int lenB, int maxDistance) {
+    if (abs(lenA - lenB) > maxDistance) return maxDistance + 1;
+
+    int stackRows[2][FUZZY_MAX_TERM_LENGTH + 1];
+    int *prev = stackRows[0];
+    int *curr = stackRows[1];
+    int *heapRows = NULL;
+    if (lenB > FUZZY_MAX_TERM_LENGTH) {
+        heapRows = (int *)malloc(sizeof(int) * 2 * (lenB + 1));
+        prev = heapRows;
+        curr = heapRows + lenB + 1;
+    }
+
+    for (int j = 0; j <= lenB; j++) prev[j] = j;
+
+    for (int i = 1; i <= lenA; i++) {
+        int ca = tolower((unsigned char)a[i - 1]);
+        int rowMin = curr[0] = i;
+        for (int j = 1; j <= lenB; j++) {
+            int cost = ca == tolower((unsigned char)b[j - 1]) ? 0 : 1;
+            curr[j] = min3(prev[j] + 1, curr[j - 1] + 1, prev[j - 1] + cost);
+            rowMin = min(rowMin, curr[j]);
+        }
+        if (rowMin > maxDistance) {
+            free(heapRows);
+            return maxDistance + 1;
+        }
+        int *tmp = prev;
+        prev = curr;
+        curr = tmp;
+    }
+
+    int result = prev[lenB];
+    free(heapRows);
+    return result > maxDistance ? maxDistance + 1 : result;
+}
+
+/*
+ * Inter-sequence batching: each SIMD lane holds the DP column of a different
+ * candidate, so one pass over the query rows advances FUZZY_BATCH_LANES
+ * alignments at once. Values are 16-bit and never exceed the longer string.
+ */
+#if defined(__AVX2__)
+typedef __m256i LaneVector;
+#define laneSet1(x) _mm256_set1_epi16((short)(x))
+#define laneLoad(p) _mm256_loadu_si256((const __m256i *)(p))
+#define laneStore(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define laneAdd(a, b) _mm256_add_epi16((a), (b))
+#define laneMin(a, b) _mm256_min_epi16((a), (b))
+#define laneEq(a, b) _mm256_cmpeq_epi16((a), (b))
+#define laneGt(a, b) _mm256_cmpgt_epi16((a), (b))
+#define laneAndNot(a, b) _mm256_andnot_si256((a), (b))
+#define laneMask(v) (unsigned int)_mm256_movemask_epi8(v)
+#define LANE_ALL_MASK 0xFFFFFFFFu
+#elif defined(__SSE2__)
+typedef __m128i LaneVector;
+#define laneSet1(x) _mm_set1_epi16((short)(x))
+#define laneLoad(p) _mm_loadu_si128((const __m128i *)(p))
+#define laneStore(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define laneAdd(a, b) _mm_add_epi16((a), (b))
+#define laneMin(a, b) _mm_min_epi16((a), (b))
+#define laneEq(a, b) _mm_cmpeq_epi16((a), (b))
+#define laneGt(a, b) _mm_cmpgt_epi16((a), (b))
+#define laneAndNot(a, b) _mm_andnot_si128((a), (b))
+#define laneMask(v) (unsigned int)_mm_movemask_epi8(v)
+#define LANE_ALL_MASK 0xFFFFu
+#endif
+
+#if defined(__AVX2__) || defined(__SSE2__)
+static void batchKernel(const char *query, int queryLen, const char **candidates,
+                        const int *lengths, int laneCount, int maxDistance,
+                        short *columns, int *distances) {
+    int maxLen = 0;
+    for (int lane = 0; lane < laneCount; lane++) {
+        if (lengths[lane] > maxLen) maxLen = lengths[lane];
+    }
+
+    // Transpose: columns[j * lanes + lane] = j-th folded byte of that lane's candidate
+    for (int j = 0; j < maxLen; j++) {
+        for (int lane = 0; lane < FUZZY_BATCH_LANES; lane++) {
+            columns[j * FUZZY_BATCH_LANES + lane] = (lane < laneCount && j < lengths[lane]) ?
+                (short)tolower((unsigned char)candidates[lane][j]) : -1;
+        }
+    }
+
+    short laneLengths[FUZZY_BATCH_LANES];
+    short results[FUZZY_BATCH_LANES];
+    for (int lane = 0; lane < FUZZY_BATCH_LANES; lane++) {
+        laneLengths[lane] = lane < laneCount ? (short)lengths[lane] : 0;
+        results[lane] = 0x3FFF;
+    }
+
+    LaneVector rows[FUZZY_MAX_TERM_LENGTH + 1];
+    LaneVector queryChars[FUZZY_MAX_TERM_LENGTH];
+    for (int i = 0; i <= queryLen; i++) rows[i] = laneSet1(i);
+    for (int i = 0; i < queryLen; i++) queryChars[i] = laneSet1(tolower((unsigned char)query[i]));
+
+    LaneVector one = laneSet1(1);
+    LaneVector bound = laneSet1(maxDistance);
+    LaneVector lengthVector = laneLoad(laneLengths);
+    LaneVector resultVector = laneLoad(results);
+
+    for (int j = 1; j <= maxLen; j++) {
+        LaneVector column = laneLoad(&columns[(j - 1) * FUZZY_BATCH_LANES]);
+        LaneVector diagonal = rows[0];
+        LaneVector left = laneSet1(j);
+        LaneVector columnMin = left;
+        rows[0] = left;
+        for (int i = 1; i <= queryLen; i++) {
+            LaneVector cost = laneAndNot(laneEq(queryChars[i - 1], column), one);
+            LaneVector value = laneMin(laneAdd(rows[i], one), laneAdd(left, one));
+            value = laneMin(value, laneAdd(diagonal, cost));
+            diagonal = rows[i];
+            rows[i] = value;
+            left = value;
+            columnMin = laneMin(columnMin, value);
+        }
+
+        // Lanes whose candidate ends here take the bottom cell as their answer
+        LaneVector ending = laneEq(lengthVector, laneSet1(j));
+        resultVector = laneMin(resultVector, laneAdd(laneAndNot(ending, laneSet1(0x3FFF)), rows[queryLen]));
+
+        // A column minimum never decreases, so lanes above the bound are settled
+        LaneVector finished = laneGt(laneSet1(j + 1), lengthVector);
+        LaneVector hopeless = laneGt(columnMin, bound);
+        if ((laneMask(finished) | laneMask(hopeless)) == LANE_ALL_MASK) break;
+    }
+
+    laneStore(results, resultVector);
+    for (int lane = 0; lane < laneCount; lane++) {
+        distances[lane] = results[lane] > maxDistance ? maxDistance + 1 : results[lane];
+    }
+}
+#endif
+
+void fuzzy_batchDistance(const char *query, const char **candidates, int candidateCount,
+                         int maxDistance, int *distances) {
+    int queryLen = strlen(query);
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    if (queryLen <= FUZZY_MAX_TERM_LENGTH) {
+        const char *laneCandidates[FUZZY_BATCH_LANES];
+        int laneLengths[FUZZY_BATCH_LANES];
+        int laneSlots[FUZZY_BATCH_LANES];
+        int laneResults[FUZZY_BATCH_LANES];
+        int laneCount = 0;
+        short *columns = (short *)malloc(sizeof(short) * FUZZY_BATCH_LANES *
+                                         (queryLen + maxDistance + 1));
+
+        for (int i = 0; i <= candidateCount; i++) {
+            if (i < candidateCount) {
+                int len = strlen(candidates[i]);
+                if (abs(len - queryLen) > maxDistance) {
+                    distances[i] = maxDistance + 1;
+                    continue;
+                }
+                if (len == 0) {
+                    distances[i] = queryLen > maxDistance ? maxDistance + 1 : queryLen;
+                    continue;
+                }
+                laneCandidates[laneCount] = candidates[i];
+                laneLengths[laneCount] = len;
+                laneSlots[laneCount] = i;
+                laneCount++;
+            }
+            if (laneCount == FUZZY_BATCH_LANES || (i == candidateCount && laneCount > 0)) {
+                batchKernel(query, queryLen, laneCandidates, laneLengths, laneCount,
+                            maxDistance, columns, laneResults);
+                for (int lane = 0; lane < laneCount; lane++) {
+                    distances[laneSlots[lane]] = laneResults[lane];
+                }
+                laneCount = 0;
+            }
+        }
+
+        free(columns);
+        return;
+    }
+#endif
+
+    for (int i = 0; i < candidateCount; i++) {
+        distances[i] = boundedDistance(query, queryLen, candidates[i], strlen(candidates[i]),
+                                       maxDistance);
+    }
+}
+
+static int compareMatches(const void *a, const void *b) {
+    const FuzzyMatch *matchA = (const FuzzyMatch *)a;
+    const FuzzyMatch *matchB = (const FuzzyMatch *)b;
+    if (matchA->distance != matchB->distance) return matchA->distance - matchB->distance;
+    return strcmp(matchA->value, matchB->value);
+}
+
+static FuzzyDeleteBucket* findBucket(FuzzyMatcher *matcher, uint64_t hash) {
+    int mask = matcher->bucketCapacity - 1;
+    for (int slot = (int)(hash & mask); ; slot = (slot + 1) & mask) {
+        FuzzyDeleteBucket *bucket = &matcher->buckets[slot];
+        if (!bucket->termIds) return NULL;
+        if (bucket->hash == hash) return bucket;
+    }
+}
+
+static FuzzyDeleteBucket* insertBucket(FuzzyMatcher *matcher, uint64_t hash) {
+    int mask = matcher->bucketCapacity - 1;
+    int slot = (int)(hash & mask);
+    while (matcher->buckets[slot].termIds && matcher->buckets[slot].hash != hash) {
+        slot = (slot + 1) & mask;
+    }
+    FuzzyDeleteBucket *bucket = &matcher->buckets[slot];
+    if (!bucket->termIds) {
+        bucket->hash = hash;
+        bucket->termCapacity = 4;
+        bucket->termIds = (int *)malloc(sizeof(int) * bucket->termCapacity);
+        bucket->termCount = 0;
+        matcher->bucketCount++;
+    }
+    return bucket;
+}
+
+static void growBuckets(FuzzyMatcher *matcher) {
+    FuzzyDeleteBucket *old = matcher->buckets;
+    int oldCapacity = matcher->bucketCapacity;
+    matcher->bucketCapacity *= 2;
+    matcher->buckets = (FuzzyDeleteBucket *)calloc(matcher->bucketCapacity, sizeof(FuzzyDeleteBucket));
+    int mask = matcher->bucketCapacity - 1;
+    for (int i = 0; i < oldCapacity; i++) {
+        if (!old[i].termIds) continue;
+        int slot = (int)(old[i].hash & mask);
+        while (matcher->buckets[slot].termIds) slot = (slot + 1) & mask;
+        matcher->buckets[slot] = old[i];
+    }
+    free(old);
+}
+
+static void addDeleteKey(FuzzyMatcher *matcher, const char *key, int len, int termId) {
+    if (matcher->bucketCount * 2 >= matcher->bucketCapacity) {
+        growBuckets(matcher);
+    }
+    FuzzyDeleteBucket *bucket = insertBucket(matcher, hashBytes(key, len));
+    // All deletes of one term are generated together, so a repeat shows up last
+    if (bucket->termCount > 0 && bucket->termIds[bucket->termCount - 1] == termId) return;
+    if (bucket->termCount == bucket->termCapacity) {
+        bucket->termCapacity *= 2;
+        bucket->termIds = (int *)realloc(bucket->termIds, sizeof(int) * bucket->termCapacity);
+    }
+    bucket->termIds[bucket->termCount++] = termId;
+}
+
+static void indexDeletes(FuzzyMatcher *matcher, const char *word, int len, int start,
+                         int depth, int termId) {
+    addDeleteKey(matcher, word, len, termId);
+    if (depth == 0 || len == 0) return;
+
+    char buffer[FUZZY_MAX_TERM_LENGTH];
+    for (int i = start; i < len; i++) {
+        memcpy(buffer, word, i);
+        memcpy(buffer + i, word + i + 1, len - i - 1);
+        indexDeletes(matcher, buffer, len - 1, i, depth - 1, termId);
+    }
+}
+
+typedef struct {
+    int *termIds;
+    int termCount;
+    int termCapacity;
+} FuzzyCandidates;
+
+static void probeDeletes(FuzzyMatcher *matcher, FuzzyCandidates *found, const char *word,
+                         int len, int start, int depth) {
+    FuzzyDeleteBucket *bucket = findBucket(matcher, hashBytes(word, len));
+    if (bucket) {
+        for (int i = 0; i < bucket->termCount; i++) {
+            int termId = bucket->termIds[i];
+            if (matcher->seen[termId] == matcher->generation) continue;
+            matcher->seen[termId] = matcher->generation;
+
+            if (found->termCount == found->termCapacity) {
+                found->termCapacity *= 2;
+                found->termIds = (int *)realloc(found->termIds, sizeof(int) * found->termCapacity);
+            }
+            found->termIds[found->termCount++] = termId;
+        }
+    }
+    if (depth == 0 || len == 0) return;
+
+    char buffer[FUZZY_MAX_TERM_LENGTH];
+    for (int i = start; i < len; i++) {
+        memcpy(buffer, word, i);
+        memcpy(buffer + i, word + i + 1, len - i - 1);
+        probeDeletes(matcher, found, buffer, len - 1, i, depth - 1);
+    }
+}
+
+int fuzzy_addTerm(FuzzyMatcher *matcher, const char *term) {
+    int len = strlen(term);
+    if (len <= 0 || len > FUZZY_MAX_TERM_LENGTH) return -1;
+
+    char normalized[FUZZY_MAX_TERM_LENGTH + 1];
+    for (int i = 0; i < len; i++) {
+        normalized[i] = tolower((unsigned char)term[i]);
+    }
+    normalized[len] = '\0';
+
+    int mask = matcher->termSlotCapacity - 1;
+    int slot = (int)(hashBytes(normalized, len) & mask);
+    while (matcher->termSlots[slot]) {
+        int termId = matcher->termSlots[slot] - 1;
+        if (matcher->termLengths[termId] == len && memcmp(matcher->terms[termId], normalized, len) == 0) {
+            return termId;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (matcher->termCount == matcher->termCapacity) {
+        matcher->termCapacity *= 2;
+        matcher->terms = (char **)realloc(matcher->terms, sizeof(char *) * matcher->termCapacity);
+        matcher->termLengths = (int *)realloc(matcher->termLengths, sizeof(int) * matcher->termCapacity);
+        matcher->seen = (unsigned int *)realloc(matcher->seen, sizeof(unsigned int) * matcher->termCapacity);
+    }
+
+    int termId = matcher->termCount++;
+    matcher->terms[termId] = (char *)malloc(len + 1);
+    strcpy(matcher->terms[termId], normalized);
+    matcher->termLengths[termId] = len;
+    matcher->seen[termId] = 0;
+    matcher->termSlots[slot] = termId + 1;
+
+    if (matcher->termCount * 2 >= matcher->termSlotCapacity) {
+        free(matcher->termSlots);
+        matcher->termSlotCapacity *= 2;
+        matcher->termSlots = (int *)calloc(matcher->termSlotCapacity, sizeof(int));
+        mask = matcher->termSlotCapacity - 1;
+        for (int i = 0; i < matcher->termCount; i++) {
+            int s = (int)(hashBytes(matcher->terms[i], matcher->termLengths[i]) & mask);
+            while (matcher->termSlots[s]) s = (s + 1) & mask;
+            matcher->termSlots[s] = i + 1;
+        }
+    }
+
+    indexDeletes(matcher, normalized, len, 0, FUZZY_MAX_DISTANCE, termId);
+    return termId;
+}
+
+FuzzyMatch* fuzzy_lookup(FuzzyMatcher *matcher, const char *query, int maxDistance, int *matchCount) {
+    *matchCount = 0;
+    int len = strlen(query);
+    if (len <= 0 || len > FUZZY_MAX_TERM_LENGTH) return NULL;
+    if (maxDistance > FUZZY_MAX_DISTANCE) maxDistance = FUZZY_MAX_DISTANCE;
+    if (maxDistance < 0) maxDistance = 0;
+
+    char normalized[FUZZY_MAX_TERM_LENGTH + 1];
+    for (int i = 0; i < len; i++) {
+        normalized[i] = tolower((unsigned char)query[i]);
+    }
+    normalized[len] = '\0';
+
+    if (++matcher->generation == 0) {
+        memset(matcher->seen, 0, sizeof(unsigned int) * matcher->termCapacity);
+        matcher->generation = 1;
+    }
+
+    FuzzyCandidates found;
+    found.termCapacity = 64;
+    found.termIds = (int *)malloc(sizeof(int) * found.termCapacity);
+    found.termCount = 0;
+
+    probeDeletes(matcher, &found, normalized, len, 0, maxDistance);
+
+    const char **candidates = (const char **)malloc(sizeof(char *) * (found.termCount + 1));
+    int *distances = (int *)malloc(sizeof(int) * (found.termCount + 1));
+    for (int i = 0; i < found.termCount; i++) {
+        candidates[i] = matcher->terms[found.termIds[i]];
+    }
+    fuzzy_batchDistance(normalized, candidates, found.termCount, maxDistance, distances);
+
+    FuzzyMatch *matches = (FuzzyMatch *)malloc(sizeof(FuzzyMatch) * (found.termCount + 1));
+    for (int i = 0; i < found.termCount; i++) {
+        if (distances[i] > maxDistance) continue;
+        int termId = found.termIds[i];
+        matches[*matchCount].value = (char *)malloc(matcher->termLengths[termId] + 1);
+        strcpy(matches[*matchCount].value, matcher->terms[termId]);
+        matches[*matchCount].distance = distances[i];
+        (*matchCount)++;
+    }
+
+    free(candidates);
+    free(distances);
+    free(found.termIds);
+
+    qsort(matches, *matchCount, sizeof(FuzzyMatch), compareMatches);
+    return matches;
+}
+
 int fuzzy_levenshteinDistance(const char *str1, const char *str2) {
     int len1 = strlen(str1);
     int len2 = strlen(str2);
@@ -60,27 +473,43 @@ int fuzzy_levenshteinDistance(const char *str1, const char *str2) {
     return result;
 }
 
-int fuzzy_isFuzzyMatch(const char *query, const char *target, int threshold) {
-    char *queryLower = strToLower(query);
-    char *targetLower = strToLower(target);
+// Smallest edit distance between pattern and any substring of text, capped at maxDistance + 1
+int fuzzy_substringDistance(const char *pattern, const char *text, int maxDistance) {
+    int patternLen = strlen(pattern);
+    if (patternLen <= 0) return 0;
 
-    if (strcmp(queryLower, targetLower) == 0) {
-        free(queryLower);
-        free(targetLower);
-        return 1;
+    int stackColumn[FUZZY_MAX_TERM_LENGTH + 1];
+    int *column = patternLen > FUZZY_MAX_TERM_LENGTH ?
+                  (int *)malloc(sizeof(int) * (patternLen + 1)) : stackColumn;
+    for (int i = 0; i <= patternLen; i++) column[i] = i;
+
+    int best = column[patternLen];
+    for (int j = 0; text[j] && best > 0; j++) {
+        int tc = tolower((unsigned char)text[j]);
+        int diagonal = column[0];
+        column[0] = 0;
+        for (int i = 1; i <= patternLen; i++) {
+            int cost = tolower((unsigned char)pattern[i - 1]) == tc ? 0 : 1;
+            int value = min3(column[i] + 1, column[i - 1] + 1, diagonal + cost);
+            diagonal = column[i];
+            column[i] = value;
+        }
+        best = min(best, column[patternLen]);
     }
 
-    if (strlen(queryLower) < 3) {
-        int result = strstr(targetLower, queryLower) != NULL;
-        free(queryLower);
-        free(targetLower);
-        return result;
+    if (column != stackColumn) free(column);
+    return best > maxDistance ? maxDistance + 1 : best;
+}
+
+int fuzzy_isFuzzyMatch(const char *query, const char *target, int threshold) {
+    int queryLen = strlen(query);
+    int targetLen = strlen(target);
+
+    if (queryLen < 3) {
+        return strsearch_find(target, targetLen, query, queryLen) != NULL;
     }
 
-    int distance = fuzzy_levenshteinDistance(queryLower, targetLower);
-    free(queryLower);
-    free(targetLower);
-    return distance <= threshold;
+    return boundedDistance(query, queryLen, target, targetLen, threshold) <= threshold;
 }
 
 FuzzyMatch* fuzzy_findFuzzyMatches(const char *query, const char **candidates,
@@ -88,60 +517,51 @@ FuzzyMatch* fuzzy_findFuzzyMatches(const char *query, const char **candidates,
     FuzzyMatch *matches = (FuzzyMatch *)malloc(sizeof(FuzzyMatch) * candidateCount);
     *matchCount = 0;
 
-    char *queryLower = strToLower(query);
+    int *distances = (int *)malloc(sizeof(int) * (candidateCount + 1));
+    fuzzy_batchDistance(query, candidates, candidateCount, threshold, distances);
 
     for (int i = 0; i < candidateCount; i++) {
-        char *candidateLower = strToLower(candidates[i]);
-        int distance = fuzzy_levenshteinDistance(queryLower, candidateLower);
-
-        if (distance <= threshold) {
+        if (distances[i] <= threshold) {
             matches[*matchCount].value = (char *)malloc(strlen(candidates[i]) + 1);
             strcpy(matches[*matchCount].value, candidates[i]);
-            matches[*matchCount].distance = distance;
+            matches[*matchCount].distance = distances[i];
             (*matchCount)++;
         }
-        free(candidateLower);
     }
+    free(distances);
 
-    free(queryLower);
-
-    // Sort by distance
-    for (int i = 0; i < *matchCount - 1; i++) {
-        for (int j = 0; j < *matchCount - i - 1; j++) {
-            if (matches[j].distance > matches[j + 1].distance) {
-                FuzzyMatch temp = matches[j];
-                matches[j] = matches[j + 1];
-                matches[j + 1] = temp;
-            }
-        }
-    }
+    qsort(matches, *matchCount, sizeof(FuzzyMatch), compareMatches);
 
     return matches;
 }
 
 double fuzzy_getFuzzyScore(const char *query, const char *target) {
-    char *queryLower = strToLower(query);
-    char *targetLower = strToLower(target);
+    int queryLen = strlen(query);
+    int targetLen = strlen(target);
 
-    if (strstr(targetLower, queryLower) != NULL) {
-        free(queryLower);
-        free(targetLower);
+    if (strsearch_find(target, targetLen, query, queryLen) != NULL) {
         return 1.0;
     }
 
-    int distance = fuzzy_levenshteinDistance(queryLower, targetLower);
-    int maxLen = strlen(queryLower) > strlen(targetLower) ? 
-                 strlen(queryLower) : strlen(targetLower);
-
-    free(queryLower);
-    free(targetLower);
-
+    int maxLen = queryLen > targetLen ? queryLen : targetLen;
     if (maxLen == 0) return 0;
+    int distance = boundedDistance(query, queryLen, target, targetLen, maxLen);
     return 1.0 - (double)distance / maxLen;
 }
 
 void fuzzy_free(FuzzyMatcher *matcher) {
     if (!matcher) return;
+    for (int i = 0; i < matcher->termCount; i++) {
+        free(matcher->terms[i]);
+    }
+    free(matcher->terms);
+    free(matcher->termLengths);
+    free(matcher->termSlots);
+    free(matcher->seen);
+    for (int i = 0; i < matcher->bucketCapacity; i++) {
+        free(matcher->buckets[i].termIds);
+    }
+    free(matcher->buckets);
     free(matcher);
 }
 
@@ -1,22 +1,61 @@
 #ifndef FUZZY_H
 #define FUZZY_H
 
+#include <stdint.h>
+
+#define FUZZY_MAX_DISTANCE 2
+#define FUZZY_MAX_TERM_LENGTH 64
+
+#if defined(__AVX2__)
+#define FUZZY_BATCH_LANES 16
+#elif defined(__SSE2__)
+#define FUZZY_BATCH_LANES 8
+#else
+#define FUZZY_BATCH_LANES 1
+#endif
+
 typedef struct {
     char *value;
     int distance;
 } FuzzyMatch;
 
+// One deletion-neighbourhood key: every dictionary term that reduces to the
+// same string after up to FUZZY_MAX_DISTANCE deletions shares a bucket.
+typedef struct {
+    uint64_t hash;
+    int *termIds;
+    int termCount;
+    int termCapacity;
+} FuzzyDeleteBucket;
+
 typedef struct {
-    int dummy; // placeholder for fuzzy matcher state if needed
+    char **terms;
+    int *termLengths;
+    int termCount;
+    int termCapacity;
+    int *termSlots;           // open-addressed term dictionary, termId + 1
+    int termSlotCapacity;
+    FuzzyDeleteBucket *buckets;
+    int bucketCount;
+    int bucketCapacity;
+    unsigned int *seen;       // per-term lookup stamps, indexed by termId
+    unsigned int generation;
 } FuzzyMatcher;
 
 FuzzyMatcher* fuzzy_create(void);
+int fuzzy_addTerm(FuzzyMatcher *matcher, const char *term);
+FuzzyMatch* fuzzy_lookup(FuzzyMatcher *matcher, const char *query, int maxDistance, int *matchCount);
 int fuzzy_levenshteinDistance(const char *str1, const char *str2);
+// Bounded edit distance of query against every candidate, several candidates per
+// SIMD pass; distances[i] is capped at maxDistance + 1.
+void fuzzy_batchDistance(const char *query, const char **candidates, int candidateCount,
+                         int maxDistance, int *distances);
+int fuzzy_substringDistance(const char *pattern, const char *text, int maxDistance);
 int fuzzy_isFuzzyMatch(const char *query, const char *target, int threshold);
-FuzzyMatch* fuzzy_findFuzzyMatches(const char *query, const char **candidates, 
+FuzzyMatch* fuzzy_findFuzzyMatches(const char *query, const char **candidates,
                                    int candidateCount, int threshold, int *matchCount);
 double fuzzy_getFuzzyScore(const char *query, const char *target);
 void fuzzy_free(FuzzyMatcher *matcher);
 void fuzzy_freeMatches(FuzzyMatch *matches, int count);
 
-#endif
\ No newline at end of file
+#endif
@@ -17,6 +17,7 @@
 // Include your project's backend headers
 #include "minigit.h"
 #include "search_engine.h"
+#include "storage.h"
 #include "autocomplete.h"
 #include "ranking.h"
 
@@ -409,6 +410,12 @@ int main(int argc, char *argv[]) {
     init_search_engine();
     init_autocomplete_system();
     init_ranking_system();
+    // Contextual suggestions complete words from the indexed content
+    SearchEngine *engine = searchengine_create();
+    set_ngram_source(engine->ngrams);
+    // Popular-query suggestions come from the search history
+    Storage *storage = storage_create();
+    set_popularity_source(storage->popularity);
     printf("Backend systems initialized.\n");
     
     // --- Start GTK Application ---
@@ -423,6 +430,8 @@ int main(int argc, char *argv[]) {
     printf("Cleaning up backend systems...\n");
     cleanup_ranking_system();
     cleanup_autocomplete_system();
+    searchengine_free(engine);
+    storage_free(storage);
     cleanup_search_engine();
     printf("Cleanup complete. Exiting.\n");
 
@@ -3,240 +3,541 @@
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
+#include <stdint.h>
 
-static char** tokenize(const char *text, int *count) {
-    char *copy = (char *)malloc(strlen(text) + 1);
-    strcpy(copy, copy);
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BM25_K1 1.2
+#define BM25_B 0.75
+#define IMPACT_LEVELS 65535
+// The BM25 length cache is rebuilt once an average field length moves by more
+// than this fraction, well inside the 1/8 steps norm bytes round lengths to
+#define LENGTH_DRIFT (1.0 / 64)
 
-    char **tokens = (char **)malloc(sizeof(char *) * 1000);
+static char** tokenize(const char *text, int *count) {
+    int capacity = 1000;
+    char **tokens = (char **)malloc(sizeof(char *) * capacity);
     *count = 0;
 
     char *word = (char *)malloc(strlen(text) + 1);
     int wordLen = 0;
 
-    for (int i = 0; text[i]; i++) {
-        if (isalnum((unsigned char)text[i]) || text[i] == '_') {
+    for (int i = 0; ; i++) {
+        if (text[i] && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
             word[wordLen++] = tolower((unsigned char)text[i]);
-        } else {
-            if (wordLen > 1) {
-                word[wordLen] = '\0';
-                tokens[*count] = (char *)malloc(wordLen + 1);
-                strcpy(tokens[*count], word);
-                (*count)++;
-                wordLen = 0;
+            continue;
+        }
+        if (wordLen > 1) {
+            if (*count == capacity) {
+                capacity *= 2;
+                tokens = (char **)realloc(tokens, sizeof(char *) * capacity);
             }
+            word[wordLen] = '\0';
+            tokens[*count] = (char *)malloc(wordLen + 1);
+            strcpy(tokens[*count], word);
+            (*count)++;
         }
-    }
-    if (wordLen > 1) {
-        word[wordLen] = '\0';
-        tokens[*count] = (char *)malloc(wordLen + 1);
-        strcpy(tokens[*count], word);
-        (*count)++;
+        wordLen = 0;
+        if (!text[i]) break;
     }
 
     free(word);
-    free(copy);
     return tokens;
 }
 
+static void freeTokens(char **tokens, int count) {
+    for (int i = 0; i < count; i++) {
+        free(tokens[i]);
+    }
+    free(tokens);
+}
+
+static uint64_t hashTerm(const char *term) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; term[i]; i++) {
+        hash ^= (unsigned char)term[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
 InvertedIndex* invertedindex_create(void) {
     InvertedIndex *index = (InvertedIndex *)malloc(sizeof(InvertedIndex));
-    index->terms = (char **)malloc(sizeof(char *) * 10000);
+    index->termCapacity = 1024;
+    index->terms = (char **)malloc(sizeof(char *) * index->termCapacity);
     index->termCount = 0;
-    index->postings = (char ***)malloc(sizeof(char **) * 10000);
-    index->postingCounts = (int *)calloc(10000, sizeof(int));
-    index->idfCache = (double *)calloc(10000, sizeof(double));
-    index->idfCacheSize = 0;
-    index->documents = (DocumentInfo *)malloc(sizeof(DocumentInfo) * 10000);
+    index->termSlotCapacity = 2048;
+    index->termSlots = (int *)calloc(index->termSlotCapacity, sizeof(int));
+    index->sortedTerms = NULL;
+    index->sortedCount = 0;
+    index->postings = (Posting **)malloc(sizeof(Posting *) * index->termCapacity);
+    index->postingCounts = (int *)calloc(index->termCapacity, sizeof(int));
+    index->postingCapacities = (int *)calloc(index->termCapacity, sizeof(int));
+    index->filenamePostings = (int *)calloc(index->termCapacity, sizeof(int));
+    index->documentCapacity = 1024;
+    index->documents = (DocumentInfo *)malloc(sizeof(DocumentInfo) * index->documentCapacity);
+    index->norms = (unsigned char *)calloc(index->documentCapacity * NORM_SLOTS, 1);
     index->documentCount = 0;
+    index->liveDocuments = 0;
+    index->totalContentLength = 0;
+    index->totalFilenameLength = 0;
+    index->impacts = (unsigned short **)calloc(index->termCapacity * IMPACT_VARIANTS,
+                                               sizeof(unsigned short *));
+    index->impactScales = (double *)calloc(index->termCapacity * IMPACT_VARIANTS, sizeof(double));
+    index->impactWeights = (double *)calloc(index->termCapacity * IMPACT_VARIANTS, sizeof(double));
+    index->impactVersions = (unsigned long *)calloc(index->termCapacity * IMPACT_VARIANTS,
+                                                    sizeof(unsigned long));
+    index->termVersions = (unsigned long *)calloc(index->termCapacity, sizeof(unsigned long));
+    index->version = 0;
+    index->lengthVersion = 0;
+    memset(index->lengthAverages, 0, sizeof(index->lengthAverages));
     return index;
 }
 
-void invertedindex_addDocument(InvertedIndex *index, File *file) {
-    int tokenCount;
-    char *combined = (char *)malloc(strlen(file->content) + strlen(file->filename) + 2);
-    sprintf(combined, "%s %s", file->content, file->filename);
-    char **terms = tokenize(combined, &tokenCount);
-    free(combined);
-
-    DocumentInfo doc;
-    doc.fileId = (char *)malloc(strlen(file->id) + 1);
-    strcpy(doc.fileId, file->id);
-    doc.termFrequencies = (int *)calloc(tokenCount, sizeof(int));
-    doc.termCount = tokenCount;
-    doc.totalTerms = tokenCount;
-
-    for (int i = 0; i < tokenCount; i++) {
-        int termIdx = -1;
-        for (int j = 0; j < index->termCount; j++) {
-            if (strcmp(index->terms[j], terms[i]) == 0) {
-                termIdx = j;
-                break;
-            }
-        }
+int invertedindex_findTerm(InvertedIndex *index, const char *term) {
+    int mask = index->termSlotCapacity - 1;
+    int slot = (int)(hashTerm(term) & mask);
+    while (index->termSlots[slot]) {
+        int termId = index->termSlots[slot] - 1;
+        if (strcmp(index->terms[termId], term) == 0) return termId;
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+typedef struct {
+    const char *term;
+    int termId;
+} SortEntry;
+
+static int compareSortEntries(const void *a, const void *b) {
+    return strcmp(((const SortEntry *)a)->term, ((const SortEntry *)b)->term);
+}
+
+// New terms only invalidate the order; it is rebuilt on the next range lookup
+static void sortTerms(InvertedIndex *index) {
+    if (index->sortedCount == index->termCount && index->sortedTerms) return;
+    SortEntry *entries = (SortEntry *)malloc(sizeof(SortEntry) * (index->termCount + 1));
+    for (int i = 0; i < index->termCount; i++) {
+        entries[i].term = index->terms[i];
+        entries[i].termId = i;
+    }
+    qsort(entries, index->termCount, sizeof(SortEntry), compareSortEntries);
+
+    free(index->sortedTerms);
+    index->sortedTerms = (int *)malloc(sizeof(int) * (index->termCount + 1));
+    for (int i = 0; i < index->termCount; i++) {
+        index->sortedTerms[i] = entries[i].termId;
+    }
+    index->sortedCount = index->termCount;
+    free(entries);
+}
+
+int invertedindex_prefixRange(InvertedIndex *index, const char *prefix, int *first) {
+    sortTerms(index);
+    int prefixLen = strlen(prefix);
+    int lo = 0, hi = index->sortedCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(index->terms[index->sortedTerms[mid]], prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    *first = lo;
+    int last = lo;
+    while (last < index->sortedCount &&
+           strncmp(index->terms[index->sortedTerms[last]], prefix, prefixLen) == 0) {
+        last++;
+    }
+    return last - lo;
+}
+
+static int internTerm(InvertedIndex *index, const char *term) {
+    int termId = invertedindex_findTerm(index, term);
+    if (termId >= 0) return termId;
+
+    if (index->termCount == index->termCapacity) {
+        index->termCapacity *= 2;
+        index->terms = (char **)realloc(index->terms, sizeof(char *) * index->termCapacity);
+        index->postings = (Posting **)realloc(index->postings, sizeof(Posting *) * index->termCapacity);
+        index->postingCounts = (int *)realloc(index->postingCounts, sizeof(int) * index->termCapacity);
+        index->postingCapacities = (int *)realloc(index->postingCapacities,
+                                                  sizeof(int) * index->termCapacity);
+        index->filenamePostings = (int *)realloc(index->filenamePostings, sizeof(int) * index->termCapacity);
+        int variants = index->termCapacity * IMPACT_VARIANTS;
+        index->impacts = (unsigned short **)realloc(index->impacts, sizeof(unsigned short *) * variants);
+        index->impactScales = (double *)realloc(index->impactScales, sizeof(double) * variants);
+        index->impactWeights = (double *)realloc(index->impactWeights, sizeof(double) * variants);
+        index->impactVersions = (unsigned long *)realloc(index->impactVersions, sizeof(unsigned long) * variants);
+        index->termVersions = (unsigned long *)realloc(index->termVersions,
+                                                       sizeof(unsigned long) * index->termCapacity);
+    }
+
+    termId = index->termCount++;
+    index->terms[termId] = (char *)malloc(strlen(term) + 1);
+    strcpy(index->terms[termId], term);
+    index->postingCapacities[termId] = 4;
+    index->postings[termId] = (Posting *)malloc(sizeof(Posting) * index->postingCapacities[termId]);
+    index->postingCounts[termId] = 0;
+    index->filenamePostings[termId] = 0;
+    index->termVersions[termId] = 0;
+    for (int v = 0; v < IMPACT_VARIANTS; v++) {
+        index->impacts[termId * IMPACT_VARIANTS + v] = NULL;
+        index->impactVersions[termId * IMPACT_VARIANTS + v] = 0;
+    }
+
+    int mask = index->termSlotCapacity - 1;
+    int slot = (int)(hashTerm(term) & mask);
+    while (index->termSlots[slot]) slot = (slot + 1) & mask;
+    index->termSlots[slot] = termId + 1;
 
-        if (termIdx == -1) {
-            termIdx = index->termCount;
-            index->terms[termIdx] = (char *)malloc(strlen(terms[i]) + 1);
-            strcpy(index->terms[termIdx], terms[i]);
-            index->postings[termIdx] = (char **)malloc(sizeof(char *) * 10000);
-            index->postingCounts[termIdx] = 0;
-            index->termCount++;
+    if (index->termCount * 2 >= index->termSlotCapacity) {
+        free(index->termSlots);
+        index->termSlotCapacity *= 2;
+        index->termSlots = (int *)calloc(index->termSlotCapacity, sizeof(int));
+        mask = index->termSlotCapacity - 1;
+        for (int i = 0; i < index->termCount; i++) {
+            int s = (int)(hashTerm(index->terms[i]) & mask);
+            while (index->termSlots[s]) s = (s + 1) & mask;
+            index->termSlots[s] = i + 1;
         }
+    }
+    return termId;
+}
+
+// Token lengths below 16 are exact; longer ones keep a 3-bit mantissa under
+// their leading bit, rounding down, so one byte covers the whole int range
+static unsigned char encodeNorm(int length) {
+    if (length < 16) return (unsigned char)length;
+    int exponent = 31 - __builtin_clz((unsigned int)length);
+    int mantissa = (length >> (exponent - 3)) & 7;
+    return (unsigned char)(16 + (exponent - 4) * 8 + mantissa);
+}
 
-        doc.termFrequencies[i]++;
+static long decodeNorm(unsigned char norm) {
+    if (norm < 16) return norm;
+    int exponent = (norm - 16) / 8 + 4;
+    int mantissa = (norm - 16) % 8;
+    return (long)(8 + mantissa) << (exponent - 3);
+}
 
-        int found = 0;
-        for (int j = 0; j < index->postingCounts[termIdx]; j++) {
-            if (strcmp(index->postings[termIdx][j], file->id) == 0) {
-                found = 1;
-                break;
+// The document being added always has the largest docId, so its posting (if
+// any yet) is the last one in the list. Only the terms it holds get a new
+// version; their frequencies are final before any query runs.
+static void addOccurrences(InvertedIndex *index, int docId, char **terms, int count, int field) {
+    for (int i = 0; i < count; i++) {
+        int termId = internTerm(index, terms[i]);
+        Posting *list = index->postings[termId];
+        int n = index->postingCounts[termId];
+        if (n == 0 || list[n - 1].docId != docId) {
+            if (n == index->postingCapacities[termId]) {
+                index->postingCapacities[termId] *= 2;
+                list = (Posting *)realloc(list, sizeof(Posting) * index->postingCapacities[termId]);
+                index->postings[termId] = list;
             }
+            list[n].docId = docId;
+            list[n].contentFrequency = 0;
+            list[n].filenameFrequency = 0;
+            index->postingCounts[termId] = ++n;
+            index->termVersions[termId] = ++index->version;
         }
-        if (!found) {
-            index->postings[termIdx][index->postingCounts[termIdx]] = 
-                (char *)malloc(strlen(file->id) + 1);
-            strcpy(index->postings[termIdx][index->postingCounts[termIdx]], file->id);
-            index->postingCounts[termIdx]++;
+        if (field == FIELD_CONTENT) {
+            list[n - 1].contentFrequency++;
+        } else if (list[n - 1].filenameFrequency++ == 0) {
+            index->filenamePostings[termId]++;
         }
     }
+}
 
-    index->documents[index->documentCount] = doc;
-    index->documentCount++;
+void invertedindex_addDocument(InvertedIndex *index, int docId, File *file) {
+    int contentCount;
+    char **contentTerms = tokenize(file->content, &contentCount);
+    int filenameCount;
+    char **filenameTerms = tokenize(file->filename, &filenameCount);
 
-    index->idfCacheSize = 0;
+    addOccurrences(index, docId, contentTerms, contentCount, FIELD_CONTENT);
+    addOccurrences(index, docId, filenameTerms, filenameCount, FIELD_FILENAME);
 
-    for (int i = 0; i < tokenCount; i++) {
-        free(terms[i]);
+    if (docId >= index->documentCapacity) {
+        int capacity = index->documentCapacity;
+        while (docId >= capacity) capacity *= 2;
+        index->documents = (DocumentInfo *)realloc(index->documents, sizeof(DocumentInfo) * capacity);
+        index->norms = (unsigned char *)realloc(index->norms, (size_t)capacity * NORM_SLOTS);
+        index->documentCapacity = capacity;
     }
-    free(terms);
+    while (index->documentCount < docId) {
+        index->documents[index->documentCount].fileId = NULL;
+        index->documents[index->documentCount].contentLength = 0;
+        index->documents[index->documentCount].filenameLength = 0;
+        memset(&index->norms[index->documentCount * NORM_SLOTS], 0, NORM_SLOTS);
+        index->documentCount++;
+    }
+    DocumentInfo *doc = &index->documents[docId];
+    doc->fileId = (char *)malloc(strlen(file->id) + 1);
+    strcpy(doc->fileId, file->id);
+    doc->contentLength = contentCount;
+    doc->filenameLength = filenameCount;
+    unsigned char *norms = &index->norms[docId * NORM_SLOTS];
+    norms[0] = 0;
+    norms[FIELD_CONTENT] = encodeNorm(contentCount);
+    norms[FIELD_FILENAME] = encodeNorm(filenameCount);
+    index->documentCount = docId + 1;
+    index->liveDocuments++;
+    index->totalContentLength += contentCount;
+    index->totalFilenameLength += filenameCount;
+
+    freeTokens(contentTerms, contentCount);
+    freeTokens(filenameTerms, filenameCount);
 }
 
 double* invertedindex_search(InvertedIndex *index, const char *query, int *fileCount) {
     int queryTokenCount;
     char **queryTerms = tokenize(query, &queryTokenCount);
-    double *scores = (double *)calloc(10000, sizeof(double));
-    *fileCount = 0;
+    double *scores = (double *)calloc(index->documentCount + 1, sizeof(double));
+    *fileCount = index->documentCount;
 
     for (int i = 0; i < queryTokenCount; i++) {
-        int termIdx = -1;
-        for (int j = 0; j < index->termCount; j++) {
-            if (strcmp(index->terms[j], queryTerms[i]) == 0) {
-                termIdx = j;
-                break;
-            }
-        }
-
-        if (termIdx != -1) {
-            double idf = invertedindex_getIDF(index, queryTerms[i]);
-            for (int j = 0; j < index->postingCounts[termIdx]; j++) {
-                // Add TF-IDF score
-                scores[j] += idf;
-            }
+        int termId = invertedindex_findTerm(index, queryTerms[i]);
+        if (termId < 0) continue;
+        for (int j = 0; j < index->postingCounts[termId]; j++) {
+            const Posting *posting = &index->postings[termId][j];
+            scores[posting->docId] += invertedindex_scorePosting(index, termId, posting, FIELD_ALL, 1.0, 0);
         }
     }
 
-    for (int i = 0; i < queryTokenCount; i++) {
-        free(queryTerms[i]);
-    }
-    free(queryTerms);
-
+    freeTokens(queryTerms, queryTokenCount);
     return scores;
 }
 
 char** invertedindex_getAllUniqueTerms(InvertedIndex *index, int *count) {
-    *count = index->termCount;
-    char **result = (char **)malloc(sizeof(char *) * index->termCount);
+    *count = 0;
+    char **result = (char **)malloc(sizeof(char *) * (index->termCount + 1));
     for (int i = 0; i < index->termCount; i++) {
-        result[i] = (char *)malloc(strlen(index->terms[i]) + 1);
-        strcpy(result[i], index->terms[i]);
+        if (index->postingCounts[i] == 0) continue;
+        result[*count] = (char *)malloc(strlen(index->terms[i]) + 1);
+        strcpy(result[*count], index->terms[i]);
+        (*count)++;
     }
     return result;
 }
 
-double invertedindex_getIDF(InvertedIndex *index, const char *term) {
-    for (int i = 0; i < index->termCount; i++) {
-        if (strcmp(index->terms[i], term) == 0) {
-            if (index->idfCache[i] > 0) {
-                return index->idfCache[i];
-            }
+static double termIDF(InvertedIndex *index, int termId, int useBM25) {
+    double docFreq = index->postingCounts[termId];
+    double totalDocs = index->liveDocuments;
+    if (docFreq <= 0) return 0;
+    if (useBM25) return log(1.0 + (totalDocs - docFreq + 0.5) / (docFreq + 0.5));
+    return log(1.0 + totalDocs / docFreq);
+}
 
-            int docFreq = index->postingCounts[i];
-            int totalDocs = index->documentCount;
+double invertedindex_getIDF(InvertedIndex *index, const char *term) {
+    int termId = invertedindex_findTerm(index, term);
+    return termId < 0 ? 0 : termIDF(index, termId, 0);
+}
 
-            double idf = docFreq > 0 ? log((double)totalDocs / docFreq) : 0;
-            index->idfCache[i] = idf;
-            return idf;
+// 1 - b + b * length / averageLength for every norm byte of each field,
+// rebuilt when an average length drifts past LENGTH_DRIFT
+static void refreshLengthCache(InvertedIndex *index) {
+    double averages[NORM_SLOTS] = {0};
+    int drifted = index->lengthVersion == 0;
+    for (int f = FIELD_CONTENT; f <= FIELD_FILENAME; f++) {
+        long totalLength = f == FIELD_CONTENT ? index->totalContentLength : index->totalFilenameLength;
+        averages[f] = index->liveDocuments > 0 ? (double)totalLength / index->liveDocuments : 0;
+        if (fabs(averages[f] - index->lengthAverages[f]) > index->lengthAverages[f] * LENGTH_DRIFT) drifted = 1;
+    }
+    if (!drifted) return;
+    for (int f = FIELD_CONTENT; f <= FIELD_FILENAME; f++) {
+        for (int n = 0; n < 256; n++) {
+            double lengthRatio = averages[f] > 0 ? decodeNorm((unsigned char)n) / averages[f] : 1.0;
+            index->lengthCache[f][n] = 1 - BM25_B + BM25_B * lengthRatio;
         }
+        index->lengthAverages[f] = averages[f];
     }
-    return 0;
+    index->lengthVersion = ++index->version;
 }
 
-int invertedindex_getTermFrequency(InvertedIndex *index, const char *fileId, const char *term) {
-    for (int i = 0; i < index->documentCount; i++) {
-        if (strcmp(index->documents[i].fileId, fileId) == 0) {
-            for (int j = 0; j < index->documents[i].termCount; j++) {
-                // Simplified - would need to track term names in DocumentInfo
-                if (index->documents[i].termFrequencies[j] > 0) {
-                    return index->documents[i].termFrequencies[j];
-                }
-            }
-        }
+// The per-posting part of the score, before idf. Fields are combined BM25F
+// style: each field's frequency is normalized by that field's own length and
+// weighted before the sum is saturated, so with a single field this is plain
+// BM25. TF-IDF sums the weighted log frequency of each field. Content counts
+// at weight 1.
+static double termWeight(InvertedIndex *index, const Posting *posting, int fields,
+                         double filenameWeight, int useBM25) {
+    int contentFrequency = (fields & FIELD_CONTENT) ? posting->contentFrequency : 0;
+    int filenameFrequency = (fields & FIELD_FILENAME) ? posting->filenameFrequency : 0;
+    if (contentFrequency == 0 && filenameFrequency == 0) return 0;
+
+    if (!useBM25) {
+        return (contentFrequency ? 1.0 + log(contentFrequency) : 0) +
+               (filenameFrequency ? filenameWeight * (1.0 + log(filenameFrequency)) : 0);
+    }
+    const unsigned char *norms = &index->norms[posting->docId * NORM_SLOTS];
+    double tf = 0;
+    if (contentFrequency) {
+        tf += contentFrequency / index->lengthCache[FIELD_CONTENT][norms[FIELD_CONTENT]];
+    }
+    if (filenameFrequency) {
+        tf += filenameWeight * filenameFrequency / index->lengthCache[FIELD_FILENAME][norms[FIELD_FILENAME]];
     }
-    return 0;
+    return tf * (BM25_K1 + 1) / (BM25_K1 + tf);
 }
 
-int invertedindex_getDocumentLength(InvertedIndex *index, const char *fileId) {
-    for (int i = 0; i < index->documentCount; i++) {
-        if (strcmp(index->documents[i].fileId, fileId) == 0) {
-            return index->documents[i].totalTerms;
+double invertedindex_scorePosting(InvertedIndex *index, int termId, const Posting *posting,
+                                  int fields, double filenameWeight, int useBM25) {
+    if (useBM25) refreshLengthCache(index);
+    double weight = termWeight(index, posting, fields, filenameWeight, useBM25);
+    return weight > 0 ? weight * termIDF(index, termId, useBM25) : 0;
+}
+
+const unsigned short* invertedindex_getImpacts(InvertedIndex *index, int termId, int fields,
+                                               double filenameWeight, int useBM25, double *scale) {
+    // A variant stays valid until the term's own postings change, it is asked
+    // for under another filename weight or, for BM25, the length cache is
+    // rebuilt; one query may hold several at once
+    int variant = termId * IMPACT_VARIANTS + (fields - 1) + (useBM25 ? 3 : 0);
+    int count = index->postingCounts[termId];
+    if (useBM25) refreshLengthCache(index);
+    unsigned long built = index->impactVersions[variant];
+    if (!index->impacts[variant] || built < index->termVersions[termId] ||
+        ((fields & FIELD_FILENAME) && index->impactWeights[variant] != filenameWeight) ||
+        (useBM25 && built < index->lengthVersion)) {
+        const Posting *postings = index->postings[termId];
+        double *weights = (double *)malloc(sizeof(double) * (count + 1));
+        double maxWeight = 0;
+        for (int j = 0; j < count; j++) {
+            weights[j] = termWeight(index, &postings[j], fields, filenameWeight, useBM25);
+            if (weights[j] > maxWeight) maxWeight = weights[j];
         }
+
+        double step = maxWeight > 0 ? maxWeight / IMPACT_LEVELS : 1.0;
+        unsigned short *impacts = (unsigned short *)realloc(index->impacts[variant],
+                                                            sizeof(unsigned short) * (count + 1));
+        for (int j = 0; j < count; j++) {
+            long level = lround(weights[j] / step);
+            // A posting that scores at all never quantizes to zero
+            if (level == 0 && weights[j] > 0) level = 1;
+            impacts[j] = (unsigned short)level;
+        }
+        free(weights);
+
+        index->impacts[variant] = impacts;
+        index->impactScales[variant] = step;
+        index->impactWeights[variant] = filenameWeight;
+        index->impactVersions[variant] = index->version;
     }
-    return 0;
+    *scale = index->impactScales[variant] * termIDF(index, termId, useBM25);
+    return index->impacts[variant];
 }
 
-double invertedindex_getAverageDocumentLength(InvertedIndex *index) {
-    if (index->documentCount == 0) return 0;
-    int total = 0;
-    for (int i = 0; i < index->documentCount; i++) {
-        total += index->documents[i].totalTerms;
+void invertedindex_decodeImpacts(const unsigned short *impacts, int count, double scale, double *out) {
+    int j = 0;
+#if defined(__AVX2__)
+    __m256d factor = _mm256_set1_pd(scale);
+    for (; j + 8 <= count; j += 8) {
+        __m256i wide = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(impacts + j)));
+        __m256d lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(wide));
+        __m256d hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(wide, 1));
+        _mm256_storeu_pd(out + j, _mm256_mul_pd(lo, factor));
+        _mm256_storeu_pd(out + j + 4, _mm256_mul_pd(hi, factor));
+    }
+#elif defined(__SSE2__)
+    __m128d factor = _mm_set1_pd(scale);
+    __m128i zero = _mm_setzero_si128();
+    for (; j + 8 <= count; j += 8) {
+        __m128i raw = _mm_loadu_si128((const __m128i *)(impacts + j));
+        __m128i lo = _mm_unpacklo_epi16(raw, zero);
+        __m128i hi = _mm_unpackhi_epi16(raw, zero);
+        _mm_storeu_pd(out + j, _mm_mul_pd(_mm_cvtepi32_pd(lo), factor));
+        _mm_storeu_pd(out + j + 2, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(lo, 0xEE)), factor));
+        _mm_storeu_pd(out + j + 4, _mm_mul_pd(_mm_cvtepi32_pd(hi), factor));
+        _mm_storeu_pd(out + j + 6, _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(hi, 0xEE)), factor));
+    }
+#endif
+    for (; j < count; j++) {
+        out[j] = impacts[j] * scale;
     }
-    return (double)total / index->documentCount;
 }
 
-void invertedindex_removeDocument(InvertedIndex *index, const char *fileId) {
-    for (int i = 0; i < index->documentCount; i++) {
-        if (strcmp(index->documents[i].fileId, fileId) == 0) {
-            free(index->documents[i].fileId);
-            free(index->documents[i].termFrequencies);
-            // Shift remaining documents
-            for (int j = i; j < index->documentCount - 1; j++) {
-                index->documents[j] = index->documents[j + 1];
-            }
-            index->documentCount--;
-            index->idfCacheSize = 0;
-            break;
-        }
+static int findPosting(const Posting *list, int count, int docId) {
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (list[mid].docId == docId) return mid;
+        if (list[mid].docId < docId) lo = mid + 1;
+        else hi = mid - 1;
     }
+    return -1;
+}
+
+int invertedindex_getTermFrequency(InvertedIndex *index, int docId, const char *term) {
+    int termId = invertedindex_findTerm(index, term);
+    if (termId < 0) return 0;
+    int at = findPosting(index->postings[termId], index->postingCounts[termId], docId);
+    if (at < 0) return 0;
+    return index->postings[termId][at].contentFrequency + index->postings[termId][at].filenameFrequency;
+}
+
+int invertedindex_getDocumentLength(InvertedIndex *index, int docId) {
+    if (docId < 0 || docId >= index->documentCount || !index->documents[docId].fileId) return 0;
+    return index->documents[docId].contentLength + index->documents[docId].filenameLength;
+}
+
+double invertedindex_getAverageDocumentLength(InvertedIndex *index) {
+    if (index->liveDocuments == 0) return 0;
+    return (double)(index->totalContentLength + index->totalFilenameLength) / index->liveDocuments;
+}
+
+void invertedindex_removeDocument(InvertedIndex *index, int docId) {
+    if (docId < 0 || docId >= index->documentCount || !index->documents[docId].fileId) return;
+
+    // Drop the document's postings so document frequencies stay exact
+    for (int i = 0; i < index->termCount; i++) {
+        Posting *list = index->postings[i];
+        int at = findPosting(list, index->postingCounts[i], docId);
+        if (at < 0) continue;
+        if (list[at].filenameFrequency > 0) index->filenamePostings[i]--;
+        memmove(&list[at], &list[at + 1], sizeof(Posting) * (index->postingCounts[i] - at - 1));
+        index->postingCounts[i]--;
+        index->termVersions[i] = ++index->version;
+    }
+
+    DocumentInfo *doc = &index->documents[docId];
+    index->totalContentLength -= doc->contentLength;
+    index->totalFilenameLength -= doc->filenameLength;
+    index->liveDocuments--;
+    free(doc->fileId);
+    doc->fileId = NULL;
+    doc->contentLength = 0;
+    doc->filenameLength = 0;
 }
 
 void invertedindex_free(InvertedIndex *index) {
     if (!index) return;
     for (int i = 0; i < index->termCount; i++) {
         free(index->terms[i]);
-        for (int j = 0; j < index->postingCounts[i]; j++) {
-            free(index->postings[i][j]);
-        }
         free(index->postings[i]);
+        for (int v = 0; v < IMPACT_VARIANTS; v++) {
+            free(index->impacts[i * IMPACT_VARIANTS + v]);
+        }
     }
     free(index->terms);
+    free(index->termSlots);
+    free(index->sortedTerms);
     free(index->postings);
     free(index->postingCounts);
-    free(index->idfCache);
+    free(index->postingCapacities);
+    free(index->filenamePostings);
+    free(index->impacts);
+    free(index->impactScales);
+    free(index->impactWeights);
+    free(index->impactVersions);
+    free(index->termVersions);
+    free(index->norms);
     for (int i = 0; i < index->documentCount; i++) {
         free(index->documents[i].fileId);
-        free(index->documents[i].termFrequencies);
     }
     free(index->documents);
     free(index);
-}
\ No newline at end of file
+}
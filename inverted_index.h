@@ -3,33 +3,83 @@
 
 #include "schema.h"
 
+#define FIELD_CONTENT 1
+#define FIELD_FILENAME 2
+#define FIELD_ALL (FIELD_CONTENT | FIELD_FILENAME)
+
 typedef struct {
-    char *fileId;
-    int *termFrequencies;
-    int termCount;
-    int totalTerms;
+    int docId;
+    int contentFrequency;
+    int filenameFrequency;
+} Posting;
+
+// norms[docId * NORM_SLOTS + field] is the quantized token length of that
+// field, FIELD_CONTENT or FIELD_FILENAME
+#define NORM_SLOTS 3
+// One impact list per field mask and scoring model
+#define IMPACT_VARIANTS 6
+
+typedef struct {
+    char *fileId;       // NULL once the document is removed
+    int contentLength;  // tokens per field
+    int filenameLength;
 } DocumentInfo;
 
 typedef struct {
     char **terms;
     int termCount;
-    char ***postings; // postings[i] = fileIds for term i
+    int termCapacity;
+    int *termSlots;         // open-addressed term dictionary, termId + 1
+    int termSlotCapacity;
+    int *sortedTerms;       // termIds in byte order, rebuilt lazily for range lookups
+    int sortedCount;
+    Posting **postings;     // postings[i] = documents holding term i, ascending docId
     int *postingCounts;
-    double *idfCache;
-    int idfCacheSize;
-    DocumentInfo *documents;
-    int documentCount;
+    int *postingCapacities;
+    int *filenamePostings;  // postings of each term with a filename occurrence
+    DocumentInfo *documents; // indexed by docId
+    unsigned char *norms;    // one byte per document and field
+    int documentCount;       // docId slots handed out, live or not
+    int documentCapacity;    // documents and norms grow to hold any docId
+    int liveDocuments;
+    long totalContentLength;
+    long totalFilenameLength;
+    unsigned short **impacts; // per-posting scores quantized to 16 bits, built on demand,
+                              // IMPACT_VARIANTS slots per term
+    double *impactScales;     // impacts[v][j] * impactScales[v] * idf scores posting j
+    double *impactWeights;    // filename weight each impact list was quantized under
+    unsigned long *impactVersions; // version each impact list was built at
+    unsigned long *termVersions;   // version of each term's last posting change
+    unsigned long version;         // bumped by every change impacts depend on
+    unsigned long lengthVersion;   // of the last length cache rebuild, 0 = never built
+    double lengthCache[NORM_SLOTS][256]; // BM25 length normalization per field and norm byte
+    double lengthAverages[NORM_SLOTS];   // average field lengths the cache was built for
 } InvertedIndex;
 
 InvertedIndex* invertedindex_create(void);
-void invertedindex_addDocument(InvertedIndex *index, File *file);
+// docIds must be handed out in ascending order
+void invertedindex_addDocument(InvertedIndex *index, int docId, File *file);
+int invertedindex_findTerm(InvertedIndex *index, const char *term);
+// Terms starting with prefix occupy sortedTerms[*first .. *first + return value)
+int invertedindex_prefixRange(InvertedIndex *index, const char *prefix, int *first);
 double* invertedindex_search(InvertedIndex *index, const char *query, int *fileCount);
 char** invertedindex_getAllUniqueTerms(InvertedIndex *index, int *count);
 double invertedindex_getIDF(InvertedIndex *index, const char *term);
-int invertedindex_getTermFrequency(InvertedIndex *index, const char *fileId, const char *term);
-int invertedindex_getDocumentLength(InvertedIndex *index, const char *fileId);
+// TF-IDF or BM25F contribution of one posting, counting only the given fields;
+// filenameWeight weighs filename occurrences against content ones
+double invertedindex_scorePosting(InvertedIndex *index, int termId, const Posting *posting,
+                                  int fields, double filenameWeight, int useBM25);
+// Quantized scores for every posting of termId over the given fields: posting
+// j scores impacts[j] * *scale. Built on first use and reused until the index
+// changes or a caller asks for another filename weight.
+const unsigned short* invertedindex_getImpacts(InvertedIndex *index, int termId, int fields,
+                                               double filenameWeight, int useBM25, double *scale);
+// out[j] = impacts[j] * scale, several postings per SIMD step
+void invertedindex_decodeImpacts(const unsigned short *impacts, int count, double scale, double *out);
+int invertedindex_getTermFrequency(InvertedIndex *index, int docId, const char *term);
+int invertedindex_getDocumentLength(InvertedIndex *index, int docId);
 double invertedindex_getAverageDocumentLength(InvertedIndex *index);
-void invertedindex_removeDocument(InvertedIndex *index, const char *fileId);
+void invertedindex_removeDocument(InvertedIndex *index, int docId);
 void invertedindex_free(InvertedIndex *index);
 
-#endif
\ No newline at end of file
+#endif
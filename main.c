@@ -14,6 +14,7 @@
 #include "autocomplete.h"
 #include "ranking.h"
 #include "search_engine.h"
+#include "storage.h"
 
 #define MAX_QUERY_LENGTH 256
 #define MAX_RESULTS 10
@@ -150,6 +151,13 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
     
+    // Contextual suggestions complete words from the indexed content
+    SearchEngine *engine = searchengine_create();
+    set_ngram_source(engine->ngrams);
+    // Popular-query suggestions come from the search history
+    Storage *storage = storage_create();
+    set_popularity_source(storage->popularity);
+    
     // Parse command line arguments
     if (argc == 1) {
         // No arguments - enter interactive mode
@@ -181,6 +189,8 @@ int main(int argc, char *argv[]) {
     // Cleanup
     cleanup_ranking_system();
     cleanup_autocomplete_system();
+    searchengine_free(engine);
+    storage_free(storage);
     cleanup_search_engine();
     
     return EXIT_SUCCESS;
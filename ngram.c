@@ -0,0 +1,379 @@
+#include "ngram.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#define NGRAM_INITIAL_WORDS 1024
+#define NGRAM_INITIAL_SLOTS 4096   // power of two
+
+static uint64_t hashWord(const char *word) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (; *word; word++) {
+        hash ^= (unsigned char)*word;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Bigrams pass NGRAM_NONE as first
+static uint64_t ngramKey(uint32_t first, uint32_t second, uint32_t third) {
+    uint64_t key = mix(((uint64_t)first << 32 | second) ^ mix(third));
+    return key ? key : 1;
+}
+
+static uint32_t nextRandom(NgramModel *model) {
+    model->random ^= model->random >> 12;
+    model->random ^= model->random << 25;
+    model->random ^= model->random >> 27;
+    return (uint32_t)((model->random * 2685821657736338717ULL) >> 32);
+}
+
+static void tableInit(NgramTable *table) {
+    table->capacity = NGRAM_INITIAL_SLOTS;
+    table->keys = (uint64_t *)calloc(table->capacity, sizeof(uint64_t));
+    table->counts = (unsigned char *)calloc(table->capacity, 1);
+    table->used = 0;
+}
+
+static uint32_t tableSlot(const NgramTable *table, uint64_t key) {
+    uint32_t mask = table->capacity - 1;
+    uint32_t slot = (uint32_t)key & mask;
+    while (table->keys[slot] && table->keys[slot] != key) slot = (slot + 1) & mask;
+    return slot;
+}
+
+static void tableGrow(NgramTable *table) {
+    NgramTable grown;
+    grown.capacity = table->capacity * 2;
+    grown.keys = (uint64_t *)calloc(grown.capacity, sizeof(uint64_t));
+    grown.counts = (unsigned char *)calloc(grown.capacity, 1);
+    grown.used = table->used;
+    for (uint32_t i = 0; i < table->capacity; i++) {
+        if (!table->keys[i]) continue;
+        uint32_t slot = tableSlot(&grown, table->keys[i]);
+        grown.keys[slot] = table->keys[i];
+        grown.counts[slot] = table->counts[i];
+    }
+    free(table->keys);
+    free(table->counts);
+    *table = grown;
+}
+
+static double tableCount(const NgramModel *model, const NgramTable *table, uint64_t key) {
+    uint32_t slot = tableSlot(table, key);
+    return table->keys[slot] ? model->estimates[table->counts[slot]] : 0;
+}
+
+// Morris counting: the stored value goes up with probability BASE^-value, so
+// it tracks the log of the count and one byte reaches billions. Returns the
+// stored value after the add.
+static unsigned char tableAdd(NgramModel *model, NgramTable *table, uint64_t key) {
+    if ((table->used + 1) * 2 > table->capacity) tableGrow(table);
+    uint32_t slot = tableSlot(table, key);
+    if (!table->keys[slot]) {
+        table->keys[slot] = key;
+        table->used++;
+    }
+    unsigned char value = table->counts[slot];
+    if (value < 255 && nextRandom(model) <= model->thresholds[value]) {
+        table->counts[slot] = ++value;
+    }
+    return value;
+}
+
+static void tableFree(NgramTable *table) {
+    free(table->keys);
+    free(table->counts);
+}
+
+NgramModel* ngram_create(void) {
+    NgramModel *model = (NgramModel *)calloc(1, sizeof(NgramModel));
+    model->wordCapacity = NGRAM_INITIAL_WORDS;
+    model->words = (char **)malloc(sizeof(char *) * model->wordCapacity);
+    model->wordCounts = (uint32_t *)malloc(sizeof(uint32_t) * model->wordCapacity);
+    model->successors = (uint32_t *)malloc(sizeof(uint32_t) * model->wordCapacity * NGRAM_SUCCESSORS);
+    model->successorCounts = (unsigned char *)malloc((size_t)model->wordCapacity * NGRAM_SUCCESSORS);
+    model->sortedWords = (uint32_t *)malloc(sizeof(uint32_t) * model->wordCapacity);
+    model->wordSlotCapacity = NGRAM_INITIAL_WORDS * 2;
+    model->wordSlots = (uint32_t *)calloc(model->wordSlotCapacity, sizeof(uint32_t));
+    tableInit(&model->bigrams);
+    tableInit(&model->trigrams);
+    model->random = 0x9e3779b97f4a7c15ULL;
+    for (int v = 0; v < 256; v++) {
+        model->thresholds[v] = (uint32_t)(pow(NGRAM_COUNT_BASE, -v) * 4294967295.0);
+        model->estimates[v] = (pow(NGRAM_COUNT_BASE, v) - 1) / (NGRAM_COUNT_BASE - 1);
+    }
+    return model;
+}
+
+static uint32_t findWord(const NgramModel *model, const char *word) {
+    uint32_t mask = model->wordSlotCapacity - 1;
+    uint32_t slot = (uint32_t)hashWord(word) & mask;
+    while (model->wordSlots[slot]) {
+        uint32_t id = model->wordSlots[slot] - 1;
+        if (strcmp(model->words[id], word) == 0) return id;
+        slot = (slot + 1) & mask;
+    }
+    return NGRAM_NONE;
+}
+
+static uint32_t internWord(NgramModel *model, const char *word) {
+    uint32_t id = findWord(model, word);
+    if (id != NGRAM_NONE) return id;
+
+    if (model->wordCount == model->wordCapacity) {
+        model->wordCapacity *= 2;
+        model->words = (char **)realloc(model->words, sizeof(char *) * model->wordCapacity);
+        model->wordCounts = (uint32_t *)realloc(model->wordCounts, sizeof(uint32_t) * model->wordCapacity);
+        model->successors = (uint32_t *)realloc(model->successors,
+                                                sizeof(uint32_t) * model->wordCapacity * NGRAM_SUCCESSORS);
+        model->successorCounts = (unsigned char *)realloc(model->successorCounts,
+                                                          (size_t)model->wordCapacity * NGRAM_SUCCESSORS);
+        model->sortedWords = (uint32_t *)realloc(model->sortedWords, sizeof(uint32_t) * model->wordCapacity);
+    }
+
+    id = model->wordCount++;
+    model->words[id] = (char *)malloc(strlen(word) + 1);
+    strcpy(model->words[id], word);
+    model->wordCounts[id] = 0;
+    for (int i = 0; i < NGRAM_SUCCESSORS; i++) {
+        model->successors[(size_t)id * NGRAM_SUCCESSORS + i] = NGRAM_NONE;
+        model->successorCounts[(size_t)id * NGRAM_SUCCESSORS + i] = 0;
+    }
+
+    uint32_t mask = model->wordSlotCapacity - 1;
+    uint32_t slot = (uint32_t)hashWord(word) & mask;
+    while (model->wordSlots[slot]) slot = (slot + 1) & mask;
+    model->wordSlots[slot] = id + 1;
+
+    if (model->wordCount * 2 >= model->wordSlotCapacity) {
+        free(model->wordSlots);
+        model->wordSlotCapacity *= 2;
+        model->wordSlots = (uint32_t *)calloc(model->wordSlotCapacity, sizeof(uint32_t));
+        mask = model->wordSlotCapacity - 1;
+        for (uint32_t i = 0; i < model->wordCount; i++) {
+            uint32_t s = (uint32_t)hashWord(model->words[i]) & mask;
+            while (model->wordSlots[s]) s = (s + 1) & mask;
+            model->wordSlots[s] = i + 1;
+        }
+    }
+    return id;
+}
+
+// Keeps the followers of word with the highest bigram counts; count is the
+// stored value of word -> next after its latest add
+static void noteSuccessor(NgramModel *model, uint32_t word, uint32_t next, unsigned char count) {
+    uint32_t *successors = &model->successors[(size_t)word * NGRAM_SUCCESSORS];
+    unsigned char *counts = &model->successorCounts[(size_t)word * NGRAM_SUCCESSORS];
+    int smallest = 0;
+    for (int i = 0; i < NGRAM_SUCCESSORS; i++) {
+        // Filled from the front, so an unused slot means next is not listed
+        if (successors[i] == next || successors[i] == NGRAM_NONE) {
+            successors[i] = next;
+            counts[i] = count;
+            return;
+        }
+        if (counts[i] < counts[smallest]) smallest = i;
+    }
+    if (count > counts[smallest]) {
+        successors[smallest] = next;
+        counts[smallest] = count;
+    }
+}
+
+typedef struct {
+    const char *word;
+    uint32_t id;
+} SortEntry;
+
+static int compareSortEntries(const void *a, const void *b) {
+    return strcmp(((const SortEntry *)a)->word, ((const SortEntry *)b)->word);
+}
+
+// Folds the ids from firstNew on into sortedWords, so lookups never sort
+static void mergeNewWords(NgramModel *model, uint32_t firstNew) {
+    uint32_t added = model->wordCount - firstNew;
+    if (added == 0) return;
+    SortEntry *entries = (SortEntry *)malloc(sizeof(SortEntry) * added);
+    for (uint32_t i = 0; i < added; i++) {
+        entries[i].word = model->words[firstNew + i];
+        entries[i].id = firstNew + i;
+    }
+    qsort(entries, added, sizeof(SortEntry), compareSortEntries);
+
+    // From the back, so the old order shifts in place
+    uint32_t *sorted = model->sortedWords;
+    long old = (long)firstNew - 1;
+    long fresh = (long)added - 1;
+    long out = (long)model->wordCount - 1;
+    while (fresh >= 0) {
+        if (old >= 0 && strcmp(model->words[sorted[old]], entries[fresh].word) > 0) {
+            sorted[out--] = sorted[old--];
+        } else {
+            sorted[out--] = entries[fresh--].id;
+        }
+    }
+    free(entries);
+}
+
+// Sentence punctuation, or a blank line
+static int endsSentence(const char *text) {
+    if (*text == '.' || *text == '!' || *text == '?') {
+        return !text[1] || isspace((unsigned char)text[1]);
+    }
+    return *text == '\n' && (text[1] == '\n' || (text[1] == '\r' && text[2] == '\n'));
+}
+
+void ngram_addText(NgramModel *model, const char *text) {
+    if (!text) return;
+    uint32_t firstNew = model->wordCount;
+    uint32_t previous = NGRAM_NONE;
+    uint32_t beforePrevious = NGRAM_NONE;
+    char word[NGRAM_WORD_LENGTH];
+    int wordLen = 0;
+
+    for (int i = 0; ; i++) {
+        if (text[i] && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
+            if (wordLen < NGRAM_WORD_LENGTH - 1) word[wordLen] = tolower((unsigned char)text[i]);
+            wordLen++;
+            continue;
+        }
+        if (wordLen >= NGRAM_WORD_LENGTH) {
+            previous = beforePrevious = NGRAM_NONE;
+        } else if (wordLen > 1) {
+            word[wordLen] = '\0';
+            uint32_t id = internWord(model, word);
+            model->wordCounts[id]++;
+            model->totalWords++;
+            if (previous != NGRAM_NONE) {
+                unsigned char count = tableAdd(model, &model->bigrams, ngramKey(NGRAM_NONE, previous, id));
+                noteSuccessor(model, previous, id, count);
+                if (beforePrevious != NGRAM_NONE) {
+                    tableAdd(model, &model->trigrams, ngramKey(beforePrevious, previous, id));
+                }
+            }
+            beforePrevious = previous;
+            previous = id;
+        }
+        wordLen = 0;
+        if (!text[i]) break;
+        if (endsSentence(text + i)) previous = beforePrevious = NGRAM_NONE;
+    }
+    mergeNewWords(model, firstNew);
+}
+
+// Stupid backoff: the highest order with a count decides, each order dropped
+// costing a factor of NGRAM_BACKOFF. pairCount is the count of first second.
+static double scoreWord(const NgramModel *model, uint32_t first, uint32_t second, double pairCount,
+                        uint32_t word) {
+    double weight = 1.0;
+    if (first != NGRAM_NONE) {
+        double triple = tableCount(model, &model->trigrams, ngramKey(first, second, word));
+        if (triple > 0 && pairCount > 0) return fmin(triple / pairCount, 1.0);
+        weight = NGRAM_BACKOFF;
+    }
+    double pair = tableCount(model, &model->bigrams, ngramKey(NGRAM_NONE, second, word));
+    if (pair > 0) return weight * fmin(pair / model->wordCounts[second], 1.0);
+    return weight * NGRAM_BACKOFF * model->wordCounts[word] / (double)model->totalWords;
+}
+
+int ngram_complete(NgramModel *model, const char **context, int contextCount, const char *partial,
+                   NgramCandidate *out, int max) {
+    if (!model || !out || max <= 0 || contextCount <= 0 || !context[contextCount - 1]) return 0;
+    uint32_t second = findWord(model, context[contextCount - 1]);
+    if (second == NGRAM_NONE) return 0;
+    uint32_t first = contextCount > 1 && context[contextCount - 2] ? findWord(model, context[contextCount - 2])
+                                                                   : NGRAM_NONE;
+    double pairCount = first != NGRAM_NONE ? tableCount(model, &model->bigrams, ngramKey(NGRAM_NONE, first, second)) : 0;
+    if (!partial) partial = "";
+    size_t partialLen = strlen(partial);
+
+    uint32_t candidates[NGRAM_SUCCESSORS + NGRAM_SCAN_LIMIT];
+    int candidateCount = 0;
+    const uint32_t *successors = &model->successors[(size_t)second * NGRAM_SUCCESSORS];
+    int successorCount = 0;
+    while (successorCount < NGRAM_SUCCESSORS && successors[successorCount] != NGRAM_NONE) successorCount++;
+    for (int i = 0; i < successorCount; i++) {
+        if (strncmp(model->words[successors[i]], partial, partialLen) == 0) {
+            candidates[candidateCount++] = successors[i];
+        }
+    }
+
+    // Rarer followers of the previous word, when partial narrows the words enough
+    if (partialLen > 0) {
+        uint32_t lo = 0, hi = model->wordCount;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (strcmp(model->words[model->sortedWords[mid]], partial) < 0) lo = mid + 1;
+            else hi = mid;
+        }
+        uint32_t last = lo;
+        while (last < model->wordCount && last - lo <= NGRAM_SCAN_LIMIT &&
+               strncmp(model->words[model->sortedWords[last]], partial, partialLen) == 0) {
+            last++;
+        }
+        for (uint32_t s = lo; last - lo <= NGRAM_SCAN_LIMIT && s < last; s++) {
+            uint32_t id = model->sortedWords[s];
+            int listed = 0;
+            for (int i = 0; i < successorCount && !listed; i++) listed = successors[i] == id;
+            if (!listed) candidates[candidateCount++] = id;
+        }
+    }
+
+    int count = 0;
+    for (int c = 0; c < candidateCount; c++) {
+        double score = scoreWord(model, first, second, pairCount, candidates[c]);
+        if (count == max && score <= out[count - 1].score) continue;
+        int at = count < max ? count++ : count - 1;
+        while (at > 0 && out[at - 1].score < score) {
+            out[at] = out[at - 1];
+            at--;
+        }
+        out[at].word = model->words[candidates[c]];
+        out[at].score = score;
+    }
+    return count;
+}
+
+void ngram_clear(NgramModel *model) {
+    if (!model) return;
+    for (uint32_t i = 0; i < model->wordCount; i++) {
+        free(model->words[i]);
+    }
+    model->wordCount = 0;
+    model->totalWords = 0;
+    memset(model->wordSlots, 0, sizeof(uint32_t) * model->wordSlotCapacity);
+    memset(model->bigrams.keys, 0, sizeof(uint64_t) * model->bigrams.capacity);
+    memset(model->bigrams.counts, 0, model->bigrams.capacity);
+    model->bigrams.used = 0;
+    memset(model->trigrams.keys, 0, sizeof(uint64_t) * model->trigrams.capacity);
+    memset(model->trigrams.counts, 0, model->trigrams.capacity);
+    model->trigrams.used = 0;
+}
+
+void ngram_free(NgramModel *model) {
+    if (!model) return;
+    for (uint32_t i = 0; i < model->wordCount; i++) {
+        free(model->words[i]);
+    }
+    free(model->words);
+    free(model->wordCounts);
+    free(model->successors);
+    free(model->successorCounts);
+    free(model->wordSlots);
+    free(model->sortedWords);
+    tableFree(&model->bigrams);
+    tableFree(&model->trigrams);
+    free(model);
+}
@@ -0,0 +1,70 @@
+#ifndef NGRAM_H
+#define NGRAM_H
+
+#include <stdint.h>
+
+#define NGRAM_WORD_LENGTH 64     // longer tokens are skipped
+#define NGRAM_SUCCESSORS 16      // followers kept per word as next-word candidates
+#define NGRAM_SCAN_LIMIT 64      // a partial word matching more words than this is
+                                 // completed from the followers alone
+#define NGRAM_COUNT_BASE 1.08    // a stored count v stands for (BASE^v - 1) / (BASE - 1)
+#define NGRAM_BACKOFF 0.4        // weight of each order dropped when scoring
+#define NGRAM_NONE UINT32_MAX
+
+// One table per order. Keys are 64-bit hashes of the n-gram's word ids, 0 for
+// an empty slot, so n-grams are never stored by name; counts[i] is a Morris
+// counter for keys[i], a byte that grows with the log of the count. An n-gram
+// costs nine bytes and a lookup is one probe sequence.
+typedef struct {
+    uint64_t *keys;
+    unsigned char *counts;
+    uint32_t capacity;      // power of two
+    uint32_t used;
+} NgramTable;
+
+// Bigram and trigram model of indexed text, for completing the last word of a
+// query from the ones before it. Candidates come from the NGRAM_SUCCESSORS
+// most frequent followers of the previous word, plus every word starting with
+// the partial one when that is few enough; each is scored by stupid backoff
+// over the trigram, bigram and word counts, one table probe per order.
+//
+// Morris counters cannot be taken back, so text leaves the model only by
+// clearing it and adding back what remains. One thread adds or clears at a
+// time, and not while others look up.
+typedef struct {
+    char **words;
+    uint32_t *wordCounts;        // exact, per word id
+    uint32_t *successors;        // NGRAM_SUCCESSORS per word, NGRAM_NONE when unused
+    unsigned char *successorCounts; // their bigram counts, as stored
+    uint32_t wordCount;
+    uint32_t wordCapacity;
+    uint32_t *wordSlots;         // open-addressed word -> id + 1
+    uint32_t wordSlotCapacity;
+    uint32_t *sortedWords;       // every id, words in byte order
+    NgramTable bigrams;
+    NgramTable trigrams;
+    uint64_t totalWords;
+    uint64_t random;             // xorshift state deciding counter increments
+    uint32_t thresholds[256];    // a counter at v moves up when random < thresholds[v]
+    double estimates[256];       // count a stored value stands for
+} NgramModel;
+
+typedef struct {
+    const char *word;   // owned by the model
+    double score;       // stupid backoff score, at most 1
+} NgramCandidate;
+
+NgramModel* ngram_create(void);
+// Tokenized the way the index tokenizes content; sentence ends and skipped
+// tokens break the n-grams
+void ngram_addText(NgramModel *model, const char *text);
+// Up to max words starting with partial that follow the given words, best
+// first. Only the last two words count; a NULL one is unknown. None when the
+// model has never seen the last word.
+int ngram_complete(NgramModel *model, const char **context, int contextCount, const char *partial,
+                   NgramCandidate *out, int max);
+// Forgets every word and n-gram; the model stays at the same address
+void ngram_clear(NgramModel *model);
+void ngram_free(NgramModel *model);
+
+#endif
@@ -0,0 +1,179 @@
+#include "popularity.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+// Weights are rebased onto a new landmark before exp() of the gap grows past
+// this, which keeps sums of them well inside double range
+#define POPULARITY_RESCALE_SPAN 64.0
+
+static int normalize(const char *query, char *out) {
+    while (isspace((unsigned char)*query)) query++;
+    int length = 0;
+    for (; *query && length < POPULARITY_QUERY_LENGTH - 1; query++) {
+        out[length++] = (char)tolower((unsigned char)*query);
+    }
+    while (length > 0 && isspace((unsigned char)out[length - 1])) length--;
+    out[length] = '\0';
+    return length;
+}
+
+static uint64_t hashQuery(const char *query) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (; *query; query++) {
+        hash ^= (unsigned char)*query;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Row r uses h1 + r * h2, so one hash serves every row
+static size_t sketchCell(uint64_t hash, int row) {
+    uint32_t h1 = (uint32_t)hash;
+    uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+    return (size_t)row * POPULARITY_SKETCH_WIDTH + ((h1 + (uint32_t)row * h2) & (POPULARITY_SKETCH_WIDTH - 1));
+}
+
+static double sketchEstimate(Popularity *popularity, uint64_t hash) {
+    double estimate = INFINITY;
+    for (int row = 0; row < POPULARITY_SKETCH_DEPTH; row++) {
+        double cell = popularity->sketch[sketchCell(hash, row)];
+        if (cell < estimate) estimate = cell;
+    }
+    return estimate;
+}
+
+static void rescale(Popularity *popularity, long time) {
+    double factor = exp(-(double)(time - popularity->landmark) / popularity->tau);
+    for (size_t i = 0; i < (size_t)POPULARITY_SKETCH_DEPTH * POPULARITY_SKETCH_WIDTH; i++) {
+        popularity->sketch[i] *= factor;
+    }
+    for (int i = 0; i < popularity->entryCount; i++) {
+        popularity->entries[i].count *= factor;
+        popularity->entries[i].error *= factor;
+    }
+    popularity->landmark = time;
+}
+
+Popularity* popularity_create(void) {
+    Popularity *popularity = (Popularity *)calloc(1, sizeof(Popularity));
+    popularity->sketch = (double *)calloc((size_t)POPULARITY_SKETCH_DEPTH * POPULARITY_SKETCH_WIDTH, sizeof(double));
+    popularity->tau = POPULARITY_HALF_LIFE_MS / log(2.0);
+    popularity->landmark = -1;
+    atomic_init(&popularity->version, 0);
+    return popularity;
+}
+
+void popularity_record(Popularity *popularity, const char *query, long time) {
+    char normalized[POPULARITY_QUERY_LENGTH];
+    if (!query || normalize(query, normalized) == 0) return;
+    uint64_t hash = hashQuery(normalized);
+
+    atomic_fetch_add_explicit(&popularity->version, 1, memory_order_acq_rel);
+    if (popularity->landmark < 0) popularity->landmark = time;
+    if ((double)(time - popularity->landmark) / popularity->tau > POPULARITY_RESCALE_SPAN) {
+        rescale(popularity, time);
+    }
+    // Out-of-order times weigh less than a fresh search, never more
+    double weight = exp((double)(time - popularity->landmark) / popularity->tau);
+
+    // Conservative update: only the cells at the current minimum grow, which
+    // keeps collisions from inflating the estimate more than they must
+    double estimate = sketchEstimate(popularity, hash) + weight;
+    for (int row = 0; row < POPULARITY_SKETCH_DEPTH; row++) {
+        double *cell = &popularity->sketch[sketchCell(hash, row)];
+        if (*cell < estimate) *cell = estimate;
+    }
+
+    int slot = -1;
+    int smallest = 0;
+    for (int i = 0; i < popularity->entryCount; i++) {
+        if (popularity->entries[i].hash == hash && strcmp(popularity->entries[i].query, normalized) == 0) {
+            slot = i;
+            break;
+        }
+        if (popularity->entries[i].count < popularity->entries[smallest].count) smallest = i;
+    }
+    if (slot >= 0) {
+        popularity->entries[slot].count += weight;
+    } else if (popularity->entryCount < POPULARITY_TOP_K) {
+        HeavyHitter *entry = &popularity->entries[popularity->entryCount++];
+        strcpy(entry->query, normalized);
+        entry->hash = hash;
+        entry->count = estimate;
+        entry->error = estimate - weight;
+    } else if (estimate > popularity->entries[smallest].count) {
+        // Space-Saving admission, with the sketch standing in for the count the
+        // newcomer had before it was tracked, so one-off queries cannot churn
+        // the table
+        HeavyHitter *entry = &popularity->entries[smallest];
+        strcpy(entry->query, normalized);
+        entry->hash = hash;
+        entry->count = estimate;
+        entry->error = estimate - weight;
+    }
+    atomic_fetch_add_explicit(&popularity->version, 1, memory_order_release);
+}
+
+double popularity_estimate(Popularity *popularity, const char *query, long now) {
+    char normalized[POPULARITY_QUERY_LENGTH];
+    if (!query || normalize(query, normalized) == 0) return 0;
+    uint64_t hash = hashQuery(normalized);
+
+    double estimate;
+    long landmark;
+    unsigned int before, after;
+    do {
+        before = atomic_load_explicit(&popularity->version, memory_order_acquire);
+        estimate = sketchEstimate(popularity, hash);
+        landmark = popularity->landmark;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&popularity->version, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    if (landmark < 0) return 0;
+    return estimate * exp(-(double)(now - landmark) / popularity->tau);
+}
+
+static int compareHitters(const void *a, const void *b) {
+    double countA = ((const HeavyHitter *)a)->count;
+    double countB = ((const HeavyHitter *)b)->count;
+    return (countA < countB) - (countA > countB);
+}
+
+int popularity_top(Popularity *popularity, const char *prefix, long now, PopularQuery *out, int max) {
+    if (max <= 0) return 0;
+    char normalizedPrefix[POPULARITY_QUERY_LENGTH] = "";
+    int prefixLength = prefix ? normalize(prefix, normalizedPrefix) : 0;
+
+    HeavyHitter entries[POPULARITY_TOP_K];
+    int entryCount;
+    long landmark;
+    unsigned int before, after;
+    do {
+        before = atomic_load_explicit(&popularity->version, memory_order_acquire);
+        entryCount = popularity->entryCount;
+        memcpy(entries, popularity->entries, sizeof(HeavyHitter) * entryCount);
+        landmark = popularity->landmark;
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&popularity->version, memory_order_relaxed);
+    } while ((before & 1) || before != after);
+
+    qsort(entries, entryCount, sizeof(HeavyHitter), compareHitters);
+    double scale = landmark < 0 ? 0 : exp(-(double)(now - landmark) / popularity->tau);
+    int count = 0;
+    for (int i = 0; i < entryCount && count < max; i++) {
+        if (prefixLength > 0 && strncmp(entries[i].query, normalizedPrefix, prefixLength) != 0) continue;
+        strcpy(out[count].query, entries[i].query);
+        out[count].count = entries[i].count * scale;
+        count++;
+    }
+    return count;
+}
+
+void popularity_free(Popularity *popularity) {
+    if (!popularity) return;
+    free(popularity->sketch);
+    free(popularity);
+}
@@ -0,0 +1,56 @@
+#ifndef POPULARITY_H
+#define POPULARITY_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+#define POPULARITY_SKETCH_DEPTH 4
+#define POPULARITY_SKETCH_WIDTH 4096   // power of two
+#define POPULARITY_TOP_K 128
+#define POPULARITY_QUERY_LENGTH 128
+// A query's weight halves every day it is not searched again
+#define POPULARITY_HALF_LIFE_MS (1000.0 * 60 * 60 * 24)
+
+typedef struct {
+    char query[POPULARITY_QUERY_LENGTH];  // normalized: lowercased, trimmed
+    uint64_t hash;
+    double count;   // decayed searches, scaled to the landmark
+    double error;   // how much of count may belong to queries it displaced
+} HeavyHitter;
+
+// Streaming heavy hitters with exponential time decay. Every query lands in a
+// Count-Min sketch; the POPULARITY_TOP_K highest sketch estimates are kept by
+// name in a Space-Saving table, so the popular queries are read straight from
+// that table without any history scan.
+//
+// Decay is forward: a search at time t adds exp((t - landmark) / tau), and a
+// count read at time now is scaled by exp(-(now - landmark) / tau). Counters
+// are rescaled and the landmark moved before the weights could overflow.
+//
+// One thread records at a time (callers serialize that); readers may run
+// concurrently and retry when version moved under them.
+typedef struct {
+    double *sketch;                 // POPULARITY_SKETCH_DEPTH rows
+    HeavyHitter entries[POPULARITY_TOP_K];
+    int entryCount;
+    long landmark;
+    double tau;
+    _Atomic unsigned int version;   // odd while a record is in progress
+} Popularity;
+
+typedef struct {
+    char query[POPULARITY_QUERY_LENGTH];
+    double count;   // decayed searches at the time asked for
+} PopularQuery;
+
+Popularity* popularity_create(void);
+// One search for query at time (ms)
+void popularity_record(Popularity *popularity, const char *query, long time);
+// Sketch estimate of query's decayed count; never below the true count
+double popularity_estimate(Popularity *popularity, const char *query, long now);
+// Up to max heavy hitters, most popular first, optionally only those
+// starting with prefix (NULL for all)
+int popularity_top(Popularity *popularity, const char *prefix, long now, PopularQuery *out, int max);
+void popularity_free(Popularity *popularity);
+
+#endif
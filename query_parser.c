@@ -0,0 +1,276 @@
+#include "query_parser.h"
+#include "inverted_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+typedef struct {
+    const char *input;
+    int pos;
+    int depth;      // groups open at pos
+    int malformed;  // a ')' without its '(' or the reverse
+} Parser;
+
+static char** tokenize(const char *text, int length, int *count) {
+    int capacity = 8;
+    char **tokens = (char **)malloc(sizeof(char *) * capacity);
+    *count = 0;
+
+    char *word = (char *)malloc(length + 1);
+    int wordLen = 0;
+
+    for (int i = 0; ; i++) {
+        if (i < length && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
+            word[wordLen++] = tolower((unsigned char)text[i]);
+            continue;
+        }
+        if (wordLen > 1) {
+            if (*count == capacity) {
+                capacity *= 2;
+                tokens = (char **)realloc(tokens, sizeof(char *) * capacity);
+            }
+            word[wordLen] = '\0';
+            tokens[*count] = (char *)malloc(wordLen + 1);
+            strcpy(tokens[*count], word);
+            (*count)++;
+        }
+        wordLen = 0;
+        if (i >= length) break;
+    }
+
+    free(word);
+    return tokens;
+}
+
+static QueryNode* createNode(QueryNodeType type) {
+    QueryNode *node = (QueryNode *)calloc(1, sizeof(QueryNode));
+    node->type = type;
+    return node;
+}
+
+static void addChild(QueryNode *parent, QueryNode *child) {
+    if (!child) return;
+    parent->children = (QueryNode **)realloc(parent->children,
+                                             sizeof(QueryNode *) * (parent->childCount + 1));
+    parent->children[parent->childCount++] = child;
+}
+
+// Collapses single-child operators and drops empty ones
+static QueryNode* simplify(QueryNode *node) {
+    if (node->childCount == 0) {
+        queryparser_free(node);
+        return NULL;
+    }
+    if (node->childCount == 1 && node->type != QUERY_NOT) {
+        QueryNode *child = node->children[0];
+        free(node->children);
+        free(node);
+        return child;
+    }
+    return node;
+}
+
+static void setFields(QueryNode *node, int fields) {
+    if (!node) return;
+    if (node->fields == 0) node->fields = fields;
+    for (int i = 0; i < node->childCount; i++) {
+        setFields(node->children[i], fields);
+    }
+}
+
+static int isBoundary(char c) {
+    return c == '\0' || isspace((unsigned char)c) || c == '(' || c == ')' || c == '"';
+}
+
+static void skipSpaces(Parser *p) {
+    while (isspace((unsigned char)p->input[p->pos])) p->pos++;
+}
+
+static int acceptKeyword(Parser *p, const char *keyword) {
+    skipSpaces(p);
+    int length = strlen(keyword);
+    if (strncmp(p->input + p->pos, keyword, length) != 0) return 0;
+    if (!isBoundary(p->input[p->pos + length])) return 0;
+    p->pos += length;
+    return 1;
+}
+
+static int atClauseEnd(Parser *p) {
+    skipSpaces(p);
+    return p->input[p->pos] == '\0' || p->input[p->pos] == ')';
+}
+
+// Words and phrases become a TERM when they hold one token, a PHRASE otherwise
+static QueryNode* textNode(const char *text, int length) {
+    int tokenCount;
+    char **tokens = tokenize(text, length, &tokenCount);
+    if (tokenCount == 0) {
+        free(tokens);
+        return NULL;
+    }
+
+    QueryNode *node;
+    if (tokenCount == 1) {
+        node = createNode(QUERY_TERM);
+        node->text = tokens[0];
+        free(tokens);
+        return node;
+    }
+    node = createNode(QUERY_PHRASE);
+    node->text = (char *)malloc(length + 1);
+    memcpy(node->text, text, length);
+    node->text[length] = '\0';
+    node->terms = tokens;
+    node->termCount = tokenCount;
+    return node;
+}
+
+static QueryNode* parseQuery(Parser *p);
+
+static QueryNode* parsePrimary(Parser *p) {
+    skipSpaces(p);
+    const char *at = p->input + p->pos;
+
+    if (strncmp(at, "filename:", 9) == 0 || strncmp(at, "content:", 8) == 0) {
+        int isFilename = at[0] == 'f';
+        p->pos += isFilename ? 9 : 8;
+        QueryNode *child = parsePrimary(p);
+        setFields(child, isFilename ? FIELD_FILENAME : FIELD_CONTENT);
+        return child;
+    }
+
+    if (*at == '(') {
+        p->pos++;
+        p->depth++;
+        QueryNode *group = parseQuery(p);
+        skipSpaces(p);
+        if (p->input[p->pos] == ')') {
+            p->pos++;
+            p->depth--;
+        } else {
+            p->malformed = 1;
+        }
+        return group;
+    }
+
+    if (*at == '"') {
+        int start = ++p->pos;
+        while (p->input[p->pos] && p->input[p->pos] != '"') p->pos++;
+        int end = p->pos;
+        if (p->input[p->pos] == '"') p->pos++;
+        return textNode(p->input + start, end - start);
+    }
+
+    int start = p->pos;
+    while (!isBoundary(p->input[p->pos])) p->pos++;
+    int length = p->pos - start;
+    if (length == 0) {
+        // A ')' here is left to the group it closes, if any
+        if (p->input[p->pos] == ')' && p->depth == 0) p->malformed = 1;
+        return NULL;
+    }
+
+    int wildcards = 0, literals = 0, other = 0;
+    for (int i = start; i < start + length; i++) {
+        char c = p->input[i];
+        if (c == '*' || c == '?') wildcards++;
+        else if (isalnum((unsigned char)c) || c == '_') literals++;
+        else other++;
+    }
+    if (wildcards > 0) {
+        // Patterns must stay inside one token and start with a literal, which
+        // bounds their expansion to one range of the dictionary
+        if (other > 0 || literals == 0 || p->input[start] == '*' || p->input[start] == '?') return NULL;
+        int prefixOnly = p->input[start + length - 1] == '*' && wildcards == 1;
+        QueryNode *node = createNode(prefixOnly ? QUERY_PREFIX : QUERY_WILDCARD);
+        int textLen = prefixOnly ? length - 1 : length;
+        node->text = (char *)malloc(textLen + 1);
+        for (int i = 0; i < textLen; i++) {
+            node->text[i] = tolower((unsigned char)p->input[start + i]);
+        }
+        node->text[textLen] = '\0';
+        return node;
+    }
+    return textNode(p->input + start, length);
+}
+
+static QueryNode* parseUnary(Parser *p) {
+    skipSpaces(p);
+    if (p->input[p->pos] == '-' || acceptKeyword(p, "NOT")) {
+        if (p->input[p->pos] == '-') p->pos++;
+        QueryNode *operand = parseUnary(p);
+        if (!operand) return NULL;
+        QueryNode *node = createNode(QUERY_NOT);
+        addChild(node, operand);
+        return node;
+    }
+    if (p->input[p->pos] == '+') p->pos++;
+    return parsePrimary(p);
+}
+
+static QueryNode* parseClause(Parser *p) {
+    QueryNode *node = createNode(QUERY_AND);
+    addChild(node, parseUnary(p));
+    while (acceptKeyword(p, "AND")) {
+        addChild(node, parseUnary(p));
+    }
+    return simplify(node);
+}
+
+static QueryNode* parseQuery(Parser *p) {
+    QueryNode *positive = createNode(QUERY_OR);
+    QueryNode *excluded = createNode(QUERY_AND);
+
+    while (!atClauseEnd(p) && !p->malformed) {
+        int before = p->pos;
+        while (acceptKeyword(p, "OR")) {}
+        QueryNode *clause = parseClause(p);
+        if (clause && clause->type == QUERY_NOT) addChild(excluded, clause);
+        else addChild(positive, clause);
+        if (p->pos == before) p->pos++;
+    }
+
+    QueryNode *result = simplify(positive);
+    if (excluded->childCount == 0) {
+        queryparser_free(excluded);
+        return result;
+    }
+    // "a b -c" keeps the OR of the positives and removes c from it
+    QueryNode *node = createNode(QUERY_AND);
+    addChild(node, result);
+    for (int i = 0; i < excluded->childCount; i++) {
+        addChild(node, excluded->children[i]);
+    }
+    excluded->childCount = 0;
+    queryparser_free(excluded);
+    return node;
+}
+
+QueryNode* queryparser_parse(const char *query, int *malformed) {
+    if (malformed) *malformed = 0;
+    if (!query) return NULL;
+    Parser parser = { query, 0, 0, 0 };
+    QueryNode *root = parseQuery(&parser);
+    // parseQuery stops at the first ')' outside any group
+    if (parser.input[parser.pos] == ')') parser.malformed = 1;
+    if (parser.malformed) {
+        queryparser_free(root);
+        if (malformed) *malformed = 1;
+        return NULL;
+    }
+    return root;
+}
+
+void queryparser_free(QueryNode *node) {
+    if (!node) return;
+    free(node->text);
+    for (int i = 0; i < node->termCount; i++) {
+        free(node->terms[i]);
+    }
+    free(node->terms);
+    for (int i = 0; i < node->childCount; i++) {
+        queryparser_free(node->children[i]);
+    }
+    free(node->children);
+    free(node);
+}
@@ -0,0 +1,36 @@
+#ifndef QUERY_PARSER_H
+#define QUERY_PARSER_H
+
+typedef enum {
+    QUERY_TERM,
+    QUERY_PREFIX,   // term*
+    QUERY_WILDCARD, // '?' matches one character, '*' any run
+    QUERY_PHRASE,   // "quoted words", or a bare word the tokenizer splits
+    QUERY_AND,
+    QUERY_OR,
+    QUERY_NOT
+} QueryNodeType;
+
+typedef struct QueryNode {
+    QueryNodeType type;
+    int fields;          // FIELD_* mask from filename:/content:, 0 = request scope
+    char *text;          // lowercased term, prefix or pattern; phrase as typed
+    char **terms;        // phrase tokens
+    int termCount;
+    struct QueryNode **children;
+    int childCount;
+} QueryNode;
+
+// Grammar, loosest binding first:
+//   query  := clause ((OR)? clause)*     juxtaposition is OR; -x / NOT x excludes
+//   clause := unary (AND unary)*
+//   unary  := (NOT | -) unary | primary
+//   primary:= (filename: | content:) primary | ( query ) | "phrase" | term | term* | te?m
+// A pattern must start with a literal: one opening with * or ? would scan the
+// whole dictionary on every query, so it is dropped like an empty word.
+// Returns NULL when the query holds nothing searchable, or when its
+// parentheses do not pair up, which also sets *malformed when given.
+QueryNode* queryparser_parse(const char *query, int *malformed);
+void queryparser_free(QueryNode *node);
+
+#endif
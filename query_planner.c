@@ -0,0 +1,524 @@
+#include "query_planner.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+
+// Clearing and sweeping a dense accumulator costs about this many docId slots
+// per posting read
+#define ACCUMULATE_SLOTS_PER_POSTING 8
+// Terms shown per operator in explain output
+#define EXPLAIN_MAX_TERMS 8
+
+static PlanNode* createPlan(PlanType type, int fields) {
+    PlanNode *plan = (PlanNode *)calloc(1, sizeof(PlanNode));
+    plan->type = type;
+    plan->fields = fields;
+    return plan;
+}
+
+static void addTerm(PlanNode *plan, InvertedIndex *index, int termId, double weight) {
+    plan->termIds = (int *)realloc(plan->termIds, sizeof(int) * (plan->termCount + 1));
+    plan->weights = (double *)realloc(plan->weights, sizeof(double) * (plan->termCount + 1));
+    plan->termIds[plan->termCount] = termId;
+    plan->weights[plan->termCount] = weight;
+    plan->termCount++;
+    plan->postings += index->postingCounts[termId];
+}
+
+static void addChild(PlanNode ***children, int *count, PlanNode *child) {
+    *children = (PlanNode **)realloc(*children, sizeof(PlanNode *) * (*count + 1));
+    (*children)[(*count)++] = child;
+}
+
+static char* copyText(const char *text) {
+    char *copy = (char *)malloc(strlen(text) + 1);
+    strcpy(copy, text);
+    return copy;
+}
+
+static int nodeFields(const PlanContext *ctx, QueryNode *node) {
+    return node->fields ? node->fields : ctx->fields;
+}
+
+static PlanNode* emptyPlan(PlanNode *plan) {
+    int fields = plan->fields;
+    queryplan_free(plan);
+    return createPlan(PLAN_EMPTY, fields);
+}
+
+static int findLiveTerm(InvertedIndex *index, const char *text) {
+    int termId = invertedindex_findTerm(index, text);
+    return termId >= 0 && index->postingCounts[termId] > 0 ? termId : -1;
+}
+
+typedef struct {
+    int termId;
+    int docFrequency;
+} Expansion;
+
+static int compareExpansions(const void *a, const void *b) {
+    const Expansion *x = (const Expansion *)a;
+    const Expansion *y = (const Expansion *)b;
+    if (x->docFrequency != y->docFrequency) return y->docFrequency - x->docFrequency;
+    return x->termId - y->termId;
+}
+
+// '?' matches one character, '*' any run, with single-star backtracking
+static int matchesPattern(const char *pattern, const char *text) {
+    const char *star = NULL;
+    const char *resume = NULL;
+    while (*text) {
+        if (*pattern == '?' || *pattern == *text) {
+            pattern++;
+            text++;
+        } else if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (star) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+// Restores the heap below slot i, least wanted expansion on top
+static void siftDown(Expansion *heap, int count, int i) {
+    for (;;) {
+        int worst = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < count && compareExpansions(&heap[left], &heap[worst]) > 0) worst = left;
+        if (right < count && compareExpansions(&heap[right], &heap[worst]) > 0) worst = right;
+        if (worst == i) return;
+        Expansion swap = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = swap;
+        i = worst;
+    }
+}
+
+// Only the dictionary range sharing the pattern's literal prefix is scanned,
+// and only the best maxExpansions terms seen so far are kept, in a heap whose
+// top is the one to drop next.
+int queryplan_expand(const PlanContext *ctx, const QueryNode *node, int **termIds) {
+    InvertedIndex *index = ctx->index;
+    int cap = ctx->maxExpansions;
+    *termIds = NULL;
+    if (cap <= 0) return 0;
+    int literalLen = strcspn(node->text, "?*");
+    // The parser never builds one, and it would range over every term
+    if (literalLen == 0) return 0;
+    char *literal = (char *)malloc(literalLen + 1);
+    memcpy(literal, node->text, literalLen);
+    literal[literalLen] = '\0';
+
+    int first;
+    int rangeCount = invertedindex_prefixRange(index, literal, &first);
+    free(literal);
+
+    Expansion *heap = (Expansion *)malloc(sizeof(Expansion) * (rangeCount < cap ? rangeCount + 1 : cap));
+    int heapCount = 0;
+    for (int i = first; i < first + rangeCount; i++) {
+        int termId = index->sortedTerms[i];
+        if (index->postingCounts[termId] == 0) continue;
+        Expansion candidate = { termId, index->postingCounts[termId] };
+        // Cheaper than the pattern match, so losers are dropped first
+        if (heapCount == cap && compareExpansions(&candidate, &heap[0]) >= 0) continue;
+        if (node->type == QUERY_WILDCARD && !matchesPattern(node->text, index->terms[termId])) continue;
+        if (heapCount < cap) {
+            int at = heapCount++;
+            heap[at] = candidate;
+            while (at > 0 && compareExpansions(&heap[at], &heap[(at - 1) / 2]) > 0) {
+                Expansion swap = heap[at];
+                heap[at] = heap[(at - 1) / 2];
+                heap[(at - 1) / 2] = swap;
+                at = (at - 1) / 2;
+            }
+        } else {
+            heap[0] = candidate;
+            siftDown(heap, heapCount, 0);
+        }
+    }
+    qsort(heap, heapCount, sizeof(Expansion), compareExpansions);
+
+    *termIds = (int *)malloc(sizeof(int) * (heapCount + 1));
+    for (int i = 0; i < heapCount; i++) {
+        (*termIds)[i] = heap[i].termId;
+    }
+    free(heap);
+    return heapCount;
+}
+
+static void expandPattern(const PlanContext *ctx, QueryNode *node, PlanNode *plan) {
+    int *termIds;
+    int count = queryplan_expand(ctx, node, &termIds);
+    for (int i = 0; i < count; i++) {
+        addTerm(plan, ctx->index, termIds[i], 1.0);
+    }
+    free(termIds);
+}
+
+// Exact term at full weight, plus dictionary neighbours within edit distance
+// at a discount when fuzzy matching is on
+static void resolveTerm(const PlanContext *ctx, QueryNode *node, PlanNode *plan) {
+    int termId = findLiveTerm(ctx->index, node->text);
+    if (termId >= 0) addTerm(plan, ctx->index, termId, 1.0);
+
+    int length = strlen(node->text);
+    int maxDistance = length <= 3 ? 0 : (length <= 6 ? 1 : FUZZY_MAX_DISTANCE);
+    if (!ctx->fuzzy || maxDistance == 0) return;
+
+    int matchCount;
+    FuzzyMatch *matches = fuzzy_lookup(ctx->fuzzy, node->text, maxDistance, &matchCount);
+    for (int m = 0; m < matchCount; m++) {
+        if (matches[m].distance == 0) continue;
+        int neighbour = findLiveTerm(ctx->index, matches[m].value);
+        if (neighbour >= 0) addTerm(plan, ctx->index, neighbour, 1.0 / (1 + matches[m].distance));
+    }
+    fuzzy_freeMatches(matches, matchCount);
+}
+
+static PlanNode* buildNode(QueryNode *node, const PlanContext *ctx);
+
+static PlanNode* buildAnd(QueryNode *node, const PlanContext *ctx) {
+    PlanNode *plan = createPlan(PLAN_INTERSECT, nodeFields(ctx, node));
+    for (int i = 0; i < node->childCount; i++) {
+        QueryNode *child = node->children[i];
+        int negated = child->type == QUERY_NOT;
+        PlanNode *operand = buildNode(negated ? child->children[0] : child, ctx);
+        if (operand->type == PLAN_EMPTY) {
+            queryplan_free(operand);
+            // Excluding nothing is a no-op; requiring nothing empties the conjunction
+            if (negated) continue;
+            return emptyPlan(plan);
+        }
+        if (negated) {
+            addChild(&plan->excluded, &plan->excludedCount, operand);
+        } else if (operand->type == PLAN_INTERSECT) {
+            // Nested conjunctions flatten so all their operands are ordered together
+            for (int c = 0; c < operand->childCount; c++) {
+                addChild(&plan->children, &plan->childCount, operand->children[c]);
+            }
+            for (int c = 0; c < operand->excludedCount; c++) {
+                addChild(&plan->excluded, &plan->excludedCount, operand->excluded[c]);
+            }
+            plan->postings += operand->postings;
+            operand->childCount = 0;
+            operand->excludedCount = 0;
+            queryplan_free(operand);
+        } else {
+            plan->postings += operand->postings;
+            addChild(&plan->children, &plan->childCount, operand);
+        }
+    }
+    if (plan->childCount == 0) return emptyPlan(plan);
+    if (plan->childCount == 1 && plan->excludedCount == 0) {
+        PlanNode *only = plan->children[0];
+        plan->childCount = 0;
+        queryplan_free(plan);
+        return only;
+    }
+    return plan;
+}
+
+// Term lists over the same fields merge into one operator, so "a b c" is a
+// single multi-way union rather than a chain of pairwise merges
+static PlanNode* buildOr(QueryNode *node, const PlanContext *ctx) {
+    PlanNode *plan = createPlan(PLAN_UNION, nodeFields(ctx, node));
+    PlanNode *terms = NULL;
+    for (int i = 0; i < node->childCount; i++) {
+        if (node->children[i]->type == QUERY_NOT) continue;
+        PlanNode *child = buildNode(node->children[i], ctx);
+        if (child->type == PLAN_EMPTY) {
+            queryplan_free(child);
+            continue;
+        }
+        plan->postings += child->postings;
+        if (child->type == PLAN_TERMS && terms && terms->fields == child->fields) {
+            for (int t = 0; t < child->termCount; t++) {
+                addTerm(terms, ctx->index, child->termIds[t], child->weights[t]);
+            }
+            free(terms->text);
+            terms->text = NULL;
+            queryplan_free(child);
+            continue;
+        }
+        if (child->type == PLAN_TERMS && !terms) terms = child;
+        addChild(&plan->children, &plan->childCount, child);
+    }
+    if (plan->childCount == 0) return emptyPlan(plan);
+    if (plan->childCount == 1) {
+        PlanNode *only = plan->children[0];
+        plan->childCount = 0;
+        queryplan_free(plan);
+        return only;
+    }
+    return plan;
+}
+
+static PlanNode* buildNode(QueryNode *node, const PlanContext *ctx) {
+    int fields = nodeFields(ctx, node);
+    PlanNode *plan;
+    switch (node->type) {
+        case QUERY_TERM:
+        case QUERY_PREFIX:
+        case QUERY_WILDCARD:
+            plan = createPlan(PLAN_TERMS, fields);
+            if (node->type == QUERY_TERM) resolveTerm(ctx, node, plan);
+            else expandPattern(ctx, node, plan);
+            if (node->type != QUERY_TERM) plan->text = copyText(node->text);
+            return plan->termCount > 0 ? plan : emptyPlan(plan);
+        case QUERY_PHRASE:
+            plan = createPlan(PLAN_PHRASE, fields);
+            plan->text = copyText(node->text);
+            for (int i = 0; i < node->termCount; i++) {
+                int termId = findLiveTerm(ctx->index, node->terms[i]);
+                if (termId < 0) return emptyPlan(plan);
+                PlanNode *term = createPlan(PLAN_TERMS, fields);
+                addTerm(term, ctx->index, termId, 1.0);
+                plan->postings += term->postings;
+                addChild(&plan->children, &plan->childCount, term);
+            }
+            return plan;
+        case QUERY_AND:
+            return buildAnd(node, ctx);
+        case QUERY_OR:
+            return buildOr(node, ctx);
+        case QUERY_NOT:
+            // A bare exclusion matches nothing on its own
+            return createPlan(PLAN_EMPTY, fields);
+    }
+    return createPlan(PLAN_EMPTY, fields);
+}
+
+PlanNode* queryplan_build(QueryNode *root, const PlanContext *ctx) {
+    if (!root) return createPlan(PLAN_EMPTY, ctx->fields);
+    return buildNode(root, ctx);
+}
+
+// Work to gallop `probes` ascending docIds into a sorted list of `size`
+static double gallopCost(double probes, double size) {
+    if (probes <= 0) return 0;
+    return probes * (1 + log2(1 + size / probes));
+}
+
+static int compareEstimates(const void *a, const void *b) {
+    const PlanNode *x = *(const PlanNode * const *)a;
+    const PlanNode *y = *(const PlanNode * const *)b;
+    if (x->estimate != y->estimate) return x->estimate < y->estimate ? -1 : 1;
+    return (x->postings > y->postings) - (x->postings < y->postings);
+}
+
+static void optimizeTerms(PlanNode *plan, const PlanContext *ctx, double selectivity) {
+    double live = ctx->index->liveDocuments > 0 ? ctx->index->liveDocuments : 1;
+    double postings = (double)plan->postings;
+    plan->estimate = (postings < live ? postings : live) * selectivity;
+
+    double filterDriven = -1;
+    if (ctx->filterCount >= 0) {
+        filterDriven = plan->termCount * gallopCost(ctx->filterCount, postings / plan->termCount);
+    }
+
+    if (plan->termCount == 1) {
+        plan->strategy = STRATEGY_SCAN;
+        plan->cost = postings;
+    } else {
+        double accumulate = postings + (double)ctx->index->documentCount / ACCUMULATE_SLOTS_PER_POSTING;
+        double merge = postings * (1 + log2(plan->termCount));
+        plan->strategy = accumulate < merge ? STRATEGY_ACCUMULATE : STRATEGY_MERGE;
+        plan->cost = accumulate < merge ? accumulate : merge;
+    }
+    if (filterDriven >= 0 && filterDriven < plan->cost) {
+        plan->strategy = STRATEGY_FILTER_DRIVEN;
+        plan->cost = filterDriven;
+    }
+}
+
+// Lone terms are galloped into in place rather than materialized
+static int probeable(const PlanNode *plan) {
+    return plan->type == PLAN_TERMS && plan->termCount == 1;
+}
+
+static double operandCost(PlanNode *operand, double driverEstimate) {
+    if (probeable(operand)) {
+        operand->strategy = STRATEGY_PROBE;
+        operand->cost = gallopCost(driverEstimate, (double)operand->postings);
+        return operand->cost;
+    }
+    return operand->cost + gallopCost(driverEstimate, operand->estimate);
+}
+
+static void optimizeNode(PlanNode *plan, const PlanContext *ctx, double selectivity) {
+    double live = ctx->index->liveDocuments > 0 ? ctx->index->liveDocuments : 1;
+    double passing = live * selectivity > 1 ? live * selectivity : 1;
+    switch (plan->type) {
+        case PLAN_EMPTY:
+            plan->estimate = 0;
+            plan->cost = 0;
+            return;
+        case PLAN_TERMS:
+            optimizeTerms(plan, ctx, selectivity);
+            return;
+        case PLAN_INTERSECT:
+        case PLAN_PHRASE: {
+            for (int i = 0; i < plan->childCount; i++) optimizeNode(plan->children[i], ctx, selectivity);
+            for (int i = 0; i < plan->excludedCount; i++) optimizeNode(plan->excluded[i], ctx, selectivity);
+            // The smallest operand drives: it is the only one read in full and
+            // everything after it, exclusions included, only sees its survivors
+            qsort(plan->children, plan->childCount, sizeof(PlanNode *), compareEstimates);
+            PlanNode *driver = plan->children[0];
+            plan->estimate = driver->estimate;
+            plan->cost = driver->cost;
+            for (int i = 1; i < plan->childCount; i++) {
+                plan->cost += operandCost(plan->children[i], plan->estimate);
+                plan->estimate *= plan->children[i]->estimate / passing;
+            }
+            for (int i = 0; i < plan->excludedCount; i++) {
+                plan->cost += operandCost(plan->excluded[i], plan->estimate);
+            }
+            // Every phrase candidate is confirmed against the document text
+            if (plan->type == PLAN_PHRASE) plan->cost += plan->estimate;
+            plan->strategy = STRATEGY_NONE;
+            return;
+        }
+        case PLAN_UNION:
+            plan->estimate = 0;
+            plan->cost = 0;
+            for (int i = 0; i < plan->childCount; i++) {
+                optimizeNode(plan->children[i], ctx, selectivity);
+                plan->estimate += plan->children[i]->estimate;
+                // Each child is merged into the running union
+                plan->cost += plan->children[i]->cost + plan->estimate;
+            }
+            if (plan->estimate > passing) plan->estimate = passing;
+            plan->strategy = STRATEGY_MERGE;
+            return;
+    }
+}
+
+void queryplan_optimize(PlanNode *plan, const PlanContext *ctx) {
+    double selectivity = 1.0;
+    if (ctx->filterCount >= 0 && ctx->index->liveDocuments > 0) {
+        selectivity = (double)ctx->filterCount / ctx->index->liveDocuments;
+        if (selectivity > 1.0) selectivity = 1.0;
+    }
+    optimizeNode(plan, ctx, selectivity);
+}
+
+int queryplan_usesStrategy(const PlanNode *plan, PlanStrategy strategy) {
+    if (plan->strategy == strategy) return 1;
+    for (int i = 0; i < plan->childCount; i++) {
+        if (queryplan_usesStrategy(plan->children[i], strategy)) return 1;
+    }
+    for (int i = 0; i < plan->excludedCount; i++) {
+        if (queryplan_usesStrategy(plan->excluded[i], strategy)) return 1;
+    }
+    return 0;
+}
+
+typedef struct {
+    char *data;
+    int length;
+    int capacity;
+} TextBuffer;
+
+static void appendf(TextBuffer *buffer, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (buffer->length + needed + 1 > buffer->capacity) {
+        while (buffer->length + needed + 1 > buffer->capacity) buffer->capacity *= 2;
+        buffer->data = (char *)realloc(buffer->data, buffer->capacity);
+    }
+    va_start(args, format);
+    vsnprintf(buffer->data + buffer->length, needed + 1, format, args);
+    va_end(args);
+    buffer->length += needed;
+}
+
+static const char* typeName(PlanType type) {
+    switch (type) {
+        case PLAN_EMPTY: return "empty";
+        case PLAN_TERMS: return "terms";
+        case PLAN_INTERSECT: return "intersect";
+        case PLAN_PHRASE: return "phrase";
+        case PLAN_UNION: return "union";
+    }
+    return "?";
+}
+
+static const char* strategyName(PlanStrategy strategy) {
+    switch (strategy) {
+        case STRATEGY_NONE: return NULL;
+        case STRATEGY_SCAN: return "scan";
+        case STRATEGY_FILTER_DRIVEN: return "filter-driven";
+        case STRATEGY_ACCUMULATE: return "accumulate";
+        case STRATEGY_MERGE: return "merge";
+        case STRATEGY_PROBE: return "probe";
+    }
+    return NULL;
+}
+
+static const char* fieldsName(int fields) {
+    if (fields == FIELD_CONTENT) return "content";
+    if (fields == FIELD_FILENAME) return "filename";
+    return "all";
+}
+
+static void explainNode(const PlanNode *plan, const InvertedIndex *index, int depth,
+                        const char *role, TextBuffer *buffer) {
+    appendf(buffer, "%*s%s%s", depth * 2, "", role, typeName(plan->type));
+    const char *strategy = strategyName(plan->strategy);
+    if (strategy) appendf(buffer, " [%s]", strategy);
+    if (plan->type == PLAN_TERMS || plan->type == PLAN_PHRASE) {
+        appendf(buffer, " %s:", fieldsName(plan->fields));
+    }
+    if (plan->text) appendf(buffer, " \"%s\"", plan->text);
+    if (plan->type == PLAN_TERMS) {
+        int shown = plan->termCount < EXPLAIN_MAX_TERMS ? plan->termCount : EXPLAIN_MAX_TERMS;
+        appendf(buffer, " {");
+        for (int i = 0; i < shown; i++) {
+            appendf(buffer, "%s%s", i ? " " : "", index->terms[plan->termIds[i]]);
+            if (plan->weights[i] != 1.0) appendf(buffer, "^%.2g", plan->weights[i]);
+        }
+        if (shown < plan->termCount) appendf(buffer, " +%d more", plan->termCount - shown);
+        appendf(buffer, "}");
+    }
+    appendf(buffer, " postings=%ld est=%.0f cost=%.0f\n", plan->postings, plan->estimate, plan->cost);
+
+    for (int i = 0; i < plan->childCount; i++) {
+        const char *childRole = plan->type == PLAN_UNION ? "" : (i == 0 ? "drive " : "then ");
+        explainNode(plan->children[i], index, depth + 1, childRole, buffer);
+    }
+    for (int i = 0; i < plan->excludedCount; i++) {
+        explainNode(plan->excluded[i], index, depth + 1, "exclude ", buffer);
+    }
+}
+
+char* queryplan_explain(const PlanNode *plan, const InvertedIndex *index) {
+    TextBuffer buffer;
+    buffer.capacity = 256;
+    buffer.data = (char *)malloc(buffer.capacity);
+    buffer.data[0] = '\0';
+    buffer.length = 0;
+    explainNode(plan, index, 0, "", &buffer);
+    return buffer.data;
+}
+
+void queryplan_free(PlanNode *plan) {
+    if (!plan) return;
+    free(plan->text);
+    free(plan->termIds);
+    free(plan->weights);
+    for (int i = 0; i < plan->childCount; i++) queryplan_free(plan->children[i]);
+    for (int i = 0; i < plan->excludedCount; i++) queryplan_free(plan->excluded[i]);
+    free(plan->children);
+    free(plan->excluded);
+    free(plan);
+}
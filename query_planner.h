@@ -0,0 +1,65 @@
+#ifndef QUERY_PLANNER_H
+#define QUERY_PLANNER_H
+
+#include "query_parser.h"
+#include "inverted_index.h"
+#include "fuzzy.h"
+
+typedef enum {
+    PLAN_EMPTY,      // provably matches nothing
+    PLAN_TERMS,      // union of resolved dictionary terms
+    PLAN_INTERSECT,  // children in evaluation order, driver first, then exclusions
+    PLAN_PHRASE,     // intersection of the phrase terms, verified against the text
+    PLAN_UNION       // union of sub-plans
+} PlanType;
+
+typedef enum {
+    STRATEGY_NONE,
+    STRATEGY_SCAN,          // walk the posting list, filter tested per posting
+    STRATEGY_FILTER_DRIVEN, // gallop from each filter member into the postings
+    STRATEGY_ACCUMULATE,    // term-at-a-time into a dense docId-indexed accumulator
+    STRATEGY_MERGE,         // document-at-a-time k-way merge through a cursor heap
+    STRATEGY_PROBE          // never materialized; the parent intersection gallops into it
+} PlanStrategy;
+
+typedef struct PlanNode {
+    PlanType type;
+    PlanStrategy strategy;
+    int fields;
+    char *text;                  // phrase or pattern as typed
+    int *termIds;                // PLAN_TERMS
+    double *weights;
+    int termCount;
+    struct PlanNode **children;
+    int childCount;
+    struct PlanNode **excluded;  // PLAN_INTERSECT
+    int excludedCount;
+    long postings;               // postings the subtree can touch
+    double estimate;             // expected matching documents
+    double cost;                 // postings read or galloped over
+} PlanNode;
+
+typedef struct {
+    InvertedIndex *index;
+    FuzzyMatcher *fuzzy;  // NULL when fuzzy matching is off
+    int fields;           // request scope, for nodes without a field prefix
+    int maxExpansions;
+    long filterCount;     // documents passing the request filter, -1 when unfiltered
+} PlanContext;
+
+// Dictionary terms a prefix or wildcard node stands for, most frequent first
+// and capped at maxExpansions. Returns their count; *termIds is the caller's
+// to free.
+int queryplan_expand(const PlanContext *ctx, const QueryNode *node, int **termIds);
+// Resolves every leaf against the dictionary and folds away branches that
+// cannot match. No postings are read.
+PlanNode* queryplan_build(QueryNode *root, const PlanContext *ctx);
+// Costs each operator against the filter cardinality and fixes its strategy
+// and the order its intersections are evaluated in
+void queryplan_optimize(PlanNode *plan, const PlanContext *ctx);
+int queryplan_usesStrategy(const PlanNode *plan, PlanStrategy strategy);
+// One line per operator, children indented under their parent
+char* queryplan_explain(const PlanNode *plan, const InvertedIndex *index);
+void queryplan_free(PlanNode *plan);
+
+#endif
@@ -1,53 +1,69 @@
 #include "ranking.h"
+#include "strsearch.h"
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <math.h>
 #include <time.h>
+#include <stdio.h>
+#include <stdint.h>
+
+// Recency decays by 1/e every 30 days
+#define RECENCY_DECAY_MS (1000.0 * 60 * 60 * 24 * 30)
+// Uploads further than this many decay periods past the anchor would overflow
+// the column, so the anchor moves forward to them
+#define RECENCY_ANCHOR_SPAN 500
+#define SIZE_SCORE_LEVELS 255
+// Candidates a learned model scores when the request sets no rerank depth
+#define RANKING_MODEL_DEPTH 1000
 
 Ranking* ranking_create(InvertedIndex *index) {
     Ranking *ranking = (Ranking *)malloc(sizeof(Ranking));
     ranking->index = index;
+    ranking->columnCapacity = 1024;
+    ranking->columnCount = 0;
+    ranking->live = (unsigned char *)malloc(ranking->columnCapacity);
+    ranking->contentLengths = (int *)malloc(sizeof(int) * ranking->columnCapacity);
+    ranking->filenameLengths = (int *)malloc(sizeof(int) * ranking->columnCapacity);
+    ranking->uploadedAt = (long *)malloc(sizeof(long) * ranking->columnCapacity);
+    ranking->sizeScores = (unsigned char *)malloc(ranking->columnCapacity);
+    ranking->recencyAtAnchor = (double *)malloc(sizeof(double) * ranking->columnCapacity);
+    ranking->recencyAnchor = 0;
+    ranking->reranker = NULL;
     return ranking;
 }
 
 static char** tokenize(const char *text, int *count) {
-    char **tokens = (char **)malloc(sizeof(char *) * 1000);
+    int capacity = 1000;
+    char **tokens = (char **)malloc(sizeof(char *) * capacity);
     *count = 0;
 
     char *word = (char *)malloc(strlen(text) + 1);
     int wordLen = 0;
 
-    for (int i = 0; text[i]; i++) {
-        if (isalnum((unsigned char)text[i]) || text[i] == '_') {
+    for (int i = 0; ; i++) {
+        if (text[i] && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
             word[wordLen++] = tolower((unsigned char)text[i]);
-        } else {
-            if (wordLen > 1) {
-                word[wordLen] = '\0';
-                tokens[*count] = (char *)malloc(wordLen + 1);
-                strcpy(tokens[*count], word);
-                (*count)++;
-                wordLen = 0;
+            continue;
+        }
+        if (wordLen > 1) {
+            if (*count == capacity) {
+                capacity *= 2;
+                tokens = (char **)realloc(tokens, sizeof(char *) * capacity);
             }
+            word[wordLen] = '\0';
+            tokens[*count] = (char *)malloc(wordLen + 1);
+            strcpy(tokens[*count], word);
+            (*count)++;
         }
-    }
-    if (wordLen > 1) {
-        word[wordLen] = '\0';
-        tokens[*count] = (char *)malloc(wordLen + 1);
-        strcpy(tokens[*count], word);
-        (*count)++;
+        wordLen = 0;
+        if (!text[i]) break;
     }
 
     free(word);
     return tokens;
 }
 
-static double calculateRecencyScore(long uploadedAt) {
-    long now = time(NULL) * 1000;
-    double ageInDays = (now - uploadedAt) / (1000.0 * 60 * 60 * 24);
-    return exp(-ageInDays / 30);
-}
-
 static double calculateFileSizeScore(int size) {
     const int maxSize = 100000;
     const int minSize = 100;
@@ -55,118 +71,388 @@ static double calculateFileSizeScore(int size) {
     return 1.0 - (double)(normalizedSize - minSize) / (maxSize - minSize);
 }
 
-static char* extractSnippet(const char *content, char **queryTerms, int termCount) {
-    char *snippet = (char *)malloc(201);
-    strncpy(snippet, content, 200);
-    snippet[200] = '\0';
-    if (strlen(content) > 200) {
-        strcat(snippet, "...");
+static double dequantizeSizeScore(unsigned char level) {
+    return level / (double)SIZE_SCORE_LEVELS;
+}
+
+static void growColumns(Ranking *ranking, int needed) {
+    if (needed <= ranking->columnCapacity) return;
+    while (ranking->columnCapacity < needed) ranking->columnCapacity *= 2;
+    int capacity = ranking->columnCapacity;
+    ranking->live = (unsigned char *)realloc(ranking->live, capacity);
+    ranking->contentLengths = (int *)realloc(ranking->contentLengths, sizeof(int) * capacity);
+    ranking->filenameLengths = (int *)realloc(ranking->filenameLengths, sizeof(int) * capacity);
+    ranking->uploadedAt = (long *)realloc(ranking->uploadedAt, sizeof(long) * capacity);
+    ranking->sizeScores = (unsigned char *)realloc(ranking->sizeScores, capacity);
+    ranking->recencyAtAnchor = (double *)realloc(ranking->recencyAtAnchor, sizeof(double) * capacity);
+}
+
+static void setRecencyAnchor(Ranking *ranking, long anchor) {
+    ranking->recencyAnchor = anchor;
+    for (int i = 0; i < ranking->columnCount; i++) {
+        ranking->recencyAtAnchor[i] = exp(-(anchor - ranking->uploadedAt[i]) / RECENCY_DECAY_MS);
     }
-    return snippet;
 }
 
-SearchResult* ranking_rankResults(Ranking *ranking, File *files, int fileCount,
-                                  const char *query, double *tfidfScores,
-                                  const char **fuzzyMatchedFiles, int fuzzyCount,
-                                  RankingOptions *options, int *resultCount) {
-    SearchResult *results = (SearchResult *)malloc(sizeof(SearchResult) * fileCount);
-    *resultCount = 0;
+void ranking_addDocument(Ranking *ranking, int docId, File *file) {
+    growColumns(ranking, docId + 1);
+    for (int i = ranking->columnCount; i < docId; i++) ranking->live[i] = 0;
+    if (ranking->columnCount == 0) ranking->recencyAnchor = file->uploadedAt;
+
+    ranking->live[docId] = 1;
+    ranking->contentLengths[docId] = strlen(file->content);
+    ranking->filenameLengths[docId] = strlen(file->filename);
+    ranking->uploadedAt[docId] = file->uploadedAt;
+    ranking->sizeScores[docId] = (unsigned char)lround(calculateFileSizeScore(file->size) * SIZE_SCORE_LEVELS);
+    ranking->columnCount = docId + 1;
 
-    char *queryLower = (char *)malloc(strlen(query) + 1);
-    strcpy(queryLower, query);
-    for (int i = 0; queryLower[i]; i++) {
-        queryLower[i] = tolower((unsigned char)queryLower[i]);
+    if ((file->uploadedAt - ranking->recencyAnchor) / RECENCY_DECAY_MS > RECENCY_ANCHOR_SPAN) {
+        setRecencyAnchor(ranking, file->uploadedAt);
+    } else {
+        ranking->recencyAtAnchor[docId] = exp(-(ranking->recencyAnchor - file->uploadedAt) / RECENCY_DECAY_MS);
     }
+}
 
-    int queryTermCount;
-    char **queryTerms = tokenize(query, &queryTermCount);
-
-    for (int i = 0; i < fileCount; i++) {
-        SearchResult result;
-        result.fileId = (char *)malloc(strlen(files[i].id) + 1);
-        strcpy(result.fileId, files[i].id);
-        result.filename = (char *)malloc(strlen(files[i].filename) + 1);
-        strcpy(result.filename, files[i].filename);
-        result.type = (char *)malloc(strlen(files[i].type) + 1);
-        strcpy(result.type, files[i].type);
-
-        double baseScore = tfidfScores[i];
-        double relevanceScore = baseScore;
-
-        char *filenameLower = (char *)malloc(strlen(files[i].filename) + 1);
-        strcpy(filenameLower, files[i].filename);
-        for (int j = 0; filenameLower[j]; j++) {
-            filenameLower[j] = tolower((unsigned char)filenameLower[j]);
-        }
+void ranking_removeDocument(Ranking *ranking, int docId) {
+    if (docId < ranking->columnCount) ranking->live[docId] = 0;
+}
 
-        char *contentLower = (char *)malloc(strlen(files[i].content) + 1);
-        strcpy(contentLower, files[i].content);
-        for (int j = 0; contentLower[j]; j++) {
-            contentLower[j] = tolower((unsigned char)contentLower[j]);
-        }
+int ranking_setReranker(Ranking *ranking, Reranker *model) {
+    if (model && model->featureCount != RANKING_FEATURE_COUNT) return 0;
+    reranker_free(ranking->reranker);
+    ranking->reranker = model;
+    return 1;
+}
 
-        int exactFilenameMatch = strstr(filenameLower, queryLower) != NULL;
-        int exactContentMatch = strstr(contentLower, queryLower) != NULL;
+typedef struct {
+    int fileIndex;
+    double baseScore;
+    double relevanceScore;
+    double recencyScore;
+    double fileSizeScore;
+    int exactFilenameMatch;
+    int exactContentMatch;
+} ScoredFile;
 
-        result.matchedInFilename = exactFilenameMatch;
-        result.matchedInContent = exactContentMatch;
+static int compareScoredFiles(const void *a, const void *b) {
+    const ScoredFile *fileA = (const ScoredFile *)a;
+    const ScoredFile *fileB = (const ScoredFile *)b;
+    if (fileA->relevanceScore > fileB->relevanceScore) return -1;
+    if (fileA->relevanceScore < fileB->relevanceScore) return 1;
+    return fileA->fileIndex - fileB->fileIndex;
+}
 
-        double filenameBoostMultiplier = result.matchedInFilename ? options->filenameBoost : 1.0;
-        double exactMatchBoostMultiplier = (exactFilenameMatch || exactContentMatch) ? 
-                                           options->exactMatchBoost : 1.0;
+// The heap keeps the weakest retained hit at the root
+static void siftDown(ScoredFile *heap, int count, int i) {
+    for (;;) {
+        int worst = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < count && compareScoredFiles(&heap[left], &heap[worst]) > 0) worst = left;
+        if (right < count && compareScoredFiles(&heap[right], &heap[worst]) > 0) worst = right;
+        if (worst == i) return;
+        ScoredFile tmp = heap[i];
+        heap[i] = heap[worst];
+        heap[worst] = tmp;
+        i = worst;
+    }
+}
 
-        double recencyScore = calculateRecencyScore(files[i].uploadedAt);
-        double fileSizeScore = calculateFileSizeScore(files[i].size);
+static void siftUp(ScoredFile *heap, int i) {
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (compareScoredFiles(&heap[i], &heap[parent]) <= 0) return;
+        ScoredFile tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+typedef struct {
+    double bound;   // score with every boost applied
+    int fileIndex;
+} Candidate;
 
-        relevanceScore *= filenameBoostMultiplier * exactMatchBoostMultiplier;
-        relevanceScore += (recencyScore * options->recencyWeight) + 
-                         (fileSizeScore * options->fileSizeWeight);
+static int candidateBefore(const Candidate *a, const Candidate *b) {
+    if (a->bound != b->bound) return a->bound > b->bound;
+    return a->fileIndex < b->fileIndex;
+}
 
-        result.relevanceScore = relevanceScore;
-        result.uploadedAt = files[i].uploadedAt;
+// Max-heap on bound, lowest docId first among equals
+static void siftCandidate(Candidate *heap, int count, int i) {
+    for (;;) {
+        int best = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < count && candidateBefore(&heap[left], &heap[best])) best = left;
+        if (right < count && candidateBefore(&heap[right], &heap[best])) best = right;
+        if (best == i) return;
+        Candidate tmp = heap[i];
+        heap[i] = heap[best];
+        heap[best] = tmp;
+        i = best;
+    }
+}
 
-        strcpy(result.matchType, "partial");
-        if (exactFilenameMatch || exactContentMatch) {
-            strcpy(result.matchType, "exact");
+// A field matches exactly when each group searching it has some text in it;
+// a field no group searches never does.
+static int matchesGroups(const char *text, int length, const MatchGroup *groups, int groupCount,
+                         int field) {
+    int searched = 0;
+    for (int g = 0; g < groupCount; g++) {
+        if (!(groups[g].fields & field)) continue;
+        searched = 1;
+        int found = 0;
+        for (int t = 0; t < groups[g].textCount && !found; t++) {
+            found = strsearch_find(text, length, groups[g].texts[t],
+                                   strlen(groups[g].texts[t])) != NULL;
         }
+        if (!found) return 0;
+    }
+    return searched;
+}
 
-        result.contentSnippet = extractSnippet(files[i].content, queryTerms, queryTermCount);
-        result.highlightedSnippet = (char *)malloc(strlen(result.contentSnippet) + 1);
-        strcpy(result.highlightedSnippet, result.contentSnippet);
+// Verifies exact matches and applies the hand-tuned boosts. Filename hits are
+// already weighted inside baseScore by the index.
+static void scoreCandidate(Ranking *ranking, File *files, int i, const MatchGroup *groups,
+                           int groupCount, double baseScore, double recencyFactor, RankingOptions *options,
+                           ScoredFile *entry) {
+    entry->fileIndex = i;
+    entry->baseScore = baseScore;
 
-        result.rankingBreakdown = (RankingBreakdown *)malloc(sizeof(RankingBreakdown));
-        result.rankingBreakdown->baseScore = baseScore;
-        result.rankingBreakdown->recencyBonus = recencyScore * options->recencyWeight;
-        result.rankingBreakdown->fileSizeBonus = fileSizeScore * options->fileSizeWeight;
-        result.rankingBreakdown->filenameBoost = filenameBoostMultiplier;
-        result.rankingBreakdown->exactMatchBoost = exactMatchBoostMultiplier;
-        strcpy(result.rankingBreakdown->algorithm, "tfidf");
+    entry->exactFilenameMatch = matchesGroups(files[i].filename, ranking->filenameLengths[i],
+                                              groups, groupCount, FIELD_FILENAME);
+    entry->exactContentMatch = matchesGroups(files[i].content, ranking->contentLengths[i],
+                                             groups, groupCount, FIELD_CONTENT);
 
-        results[(*resultCount)++] = result;
+    double exactMatchBoostMultiplier = (entry->exactFilenameMatch || entry->exactContentMatch) ? 
+                                       options->exactMatchBoost : 1.0;
+
+    entry->recencyScore = recencyFactor * ranking->recencyAtAnchor[i];
+    entry->fileSizeScore = dequantizeSizeScore(ranking->sizeScores[i]);
+
+    entry->relevanceScore = entry->baseScore * exactMatchBoostMultiplier;
+    // Same expression as the phase one bound, so the bound is never undercut
+    entry->relevanceScore += (entry->recencyScore * options->recencyWeight) +
+                             (ranking->sizeScores[i] * (options->fileSizeWeight / SIZE_SCORE_LEVELS));
+}
 
-        free(filenameLower);
-        free(contentLower);
+static void candidateFeatures(Ranking *ranking, const ScoredFile *entry, float *row) {
+    int i = entry->fileIndex;
+    row[RANKING_FEATURE_BASE_SCORE] = (float)entry->baseScore;
+    row[RANKING_FEATURE_FILENAME_MATCH] = (float)entry->exactFilenameMatch;
+    row[RANKING_FEATURE_CONTENT_MATCH] = (float)entry->exactContentMatch;
+    row[RANKING_FEATURE_RECENCY] = (float)entry->recencyScore;
+    row[RANKING_FEATURE_SIZE_SCORE] = (float)entry->fileSizeScore;
+    row[RANKING_FEATURE_FILENAME_LENGTH] = (float)ranking->filenameLengths[i];
+    row[RANKING_FEATURE_CONTENT_LENGTH] = (float)ranking->contentLengths[i];
+    row[RANKING_FEATURE_HEURISTIC_SCORE] = (float)entry->relevanceScore;
+}
+
+// Returns 0 for an entry at or before the cursor, which earlier pages served
+static int keepScored(ScoredFile *scored, int *scoredCount, int capacity, const ScoredFile *entry,
+                      RankingOptions *options, const ScoredFile *cursor) {
+    if (options->hasCursor && compareScoredFiles(entry, cursor) <= 0) return 0;
+
+    if (*scoredCount < capacity) {
+        scored[*scoredCount] = *entry;
+        siftUp(scored, (*scoredCount)++);
+    } else if (capacity > 0 && compareScoredFiles(entry, &scored[0]) < 0) {
+        scored[0] = *entry;
+        siftDown(scored, *scoredCount, 0);
+    }
+    return 1;
+}
+
+void ranking_formatCursor(char *cursor, double score, int docId, long now) {
+    uint64_t bits;
+    memcpy(&bits, &score, sizeof(bits));
+    snprintf(cursor, SEARCH_CURSOR_LENGTH, "%016llx.%x.%lx", (unsigned long long)bits,
+             (unsigned int)docId, (unsigned long)now);
+}
+
+int ranking_parseCursor(const char *cursor, RankingOptions *options) {
+    unsigned long long bits;
+    unsigned int docId;
+    unsigned long now;
+    if (!cursor || sscanf(cursor, "%16llx.%x.%lx", &bits, &docId, &now) != 3) return 0;
+    uint64_t scoreBits = bits;
+    memcpy(&options->cursorScore, &scoreBits, sizeof(double));
+    options->cursorDocId = (int)docId;
+    options->now = (long)now;
+    options->hasCursor = 1;
+    return 1;
+}
+
+RankedHit* ranking_rankResults(Ranking *ranking, File *files, int fileCount,
+                               const MatchGroup *groups, int groupCount, double *tfidfScores,
+                               const char **fuzzyMatchedFiles, int fuzzyCount,
+                               RankingOptions *options, int *hitCount) {
+    // Fuzzy matches arrive already folded into tfidfScores
+    (void)fuzzyMatchedFiles;
+    (void)fuzzyCount;
+    int capacity = (options->maxResults > 0 && options->maxResults < fileCount) ?
+                   options->maxResults : fileCount;
+    ScoredFile *scored = (ScoredFile *)malloc(sizeof(ScoredFile) * (capacity + 1));
+    int scoredCount = 0;
+    *hitCount = 0;
+
+    long now = options->now > 0 ? options->now : (long)time(NULL) * 1000;
+    ScoredFile cursor;
+    cursor.relevanceScore = options->cursorScore;
+    cursor.fileIndex = options->cursorDocId;
+
+    // The only transcendental call of the query; per document recency is a multiply
+    double recencyFactor = exp(-(now - ranking->recencyAnchor) / RECENCY_DECAY_MS);
+    // Weights come from the request, never from the shared columns
+    double sizeWeight = options->fileSizeWeight / SIZE_SCORE_LEVELS;
+    int columnCount = fileCount < ranking->columnCount ? fileCount : ranking->columnCount;
+
+    // Phase one: bound every match using column features only. The exact-match
+    // boost multiplies the base score, so the bound assumes it fires. Without
+    // it the score is at its floor; a hit whose floor already sorts at or
+    // before the cursor was served on an earlier page and is never verified.
+    double maxExactBoost = options->exactMatchBoost > 1.0 ? options->exactMatchBoost : 1.0;
+    double minExactBoost = options->exactMatchBoost < 1.0 ? options->exactMatchBoost : 1.0;
+    int skipServed = options->hasCursor && !ranking->reranker;
+    Candidate *candidates = (Candidate *)malloc(sizeof(Candidate) * (columnCount + 1));
+    int candidateCount = 0;
+    for (int i = 0; i < columnCount; i++) {
+        if (tfidfScores[i] <= 0 || !ranking->live[i]) continue;
+        double staticScore = (recencyFactor * ranking->recencyAtAnchor[i] * options->recencyWeight) +
+                             (ranking->sizeScores[i] * sizeWeight);
+        if (skipServed) {
+            ScoredFile floor;
+            floor.relevanceScore = tfidfScores[i] * minExactBoost + staticScore;
+            floor.fileIndex = i;
+            if (compareScoredFiles(&floor, &cursor) <= 0) continue;
+        }
+        candidates[candidateCount].bound = tfidfScores[i] * maxExactBoost + staticScore;
+        candidates[candidateCount].fileIndex = i;
+        candidateCount++;
     }
+    for (int i = candidateCount / 2 - 1; i >= 0; i--) siftCandidate(candidates, candidateCount, i);
 
-    for (int i = 0; i < queryTermCount; i++) {
-        free(queryTerms[i]);
+    // Phase two: verify exact matches best bound first, stopping at the rerank
+    // depth or once no remaining bound can displace the weakest kept hit. A
+    // learned model has no bound, so it scores a fixed window of candidates
+    // after the cursor. Whether a hit was served is only known once the model
+    // has scored it, so batches continue until the window is filled.
+    if (ranking->reranker) {
+        int window = options->rerankDepth > 0 ? options->rerankDepth : RANKING_MODEL_DEPTH;
+        if (window > candidateCount) window = candidateCount;
+        ScoredFile *batch = (ScoredFile *)malloc(sizeof(ScoredFile) * (window + 1));
+        float *features = (float *)malloc(sizeof(float) * RANKING_FEATURE_COUNT * (window + 1));
+        double *modelScores = (double *)malloc(sizeof(double) * (window + 1));
+        int kept = 0;
+        while (kept < window && candidateCount > 0) {
+            int batchSize = window - kept < candidateCount ? window - kept : candidateCount;
+            for (int b = 0; b < batchSize; b++) {
+                int i = candidates[0].fileIndex;
+                candidates[0] = candidates[--candidateCount];
+                siftCandidate(candidates, candidateCount, 0);
+                scoreCandidate(ranking, files, i, groups, groupCount, tfidfScores[i], recencyFactor,
+                               options, &batch[b]);
+                candidateFeatures(ranking, &batch[b], features + b * RANKING_FEATURE_COUNT);
+            }
+            reranker_score(ranking->reranker, features, batchSize, modelScores);
+            for (int b = 0; b < batchSize; b++) {
+                batch[b].relevanceScore = modelScores[b];
+                kept += keepScored(scored, &scoredCount, capacity, &batch[b], options, &cursor);
+            }
+        }
+        free(batch);
+        free(features);
+        free(modelScores);
+    }
+
+    int reranked = 0;
+    while (!ranking->reranker && candidateCount > 0) {
+        if (options->rerankDepth > 0 && reranked == options->rerankDepth) break;
+        Candidate next = candidates[0];
+        if (scoredCount == capacity && capacity > 0 && next.bound < scored[0].relevanceScore) break;
+        candidates[0] = candidates[--candidateCount];
+        siftCandidate(candidates, candidateCount, 0);
+
+        ScoredFile candidate;
+        scoreCandidate(ranking, files, next.fileIndex, groups, groupCount, tfidfScores[next.fileIndex],
+                       recencyFactor, options, &candidate);
+        // Only hits this page can serve use up the depth
+        reranked += keepScored(scored, &scoredCount, capacity, &candidate, options, &cursor);
+    }
+    free(candidates);
+
+    qsort(scored, scoredCount, sizeof(ScoredFile), compareScoredFiles);
+    int first = options->offset < scoredCount ? options->offset : scoredCount;
+    options->now = now;
+    options->reranked = ranking->reranker != NULL;
+
+    RankedHit *hits = (RankedHit *)malloc(sizeof(RankedHit) * (scoredCount - first + 1));
+    for (int k = first; k < scoredCount; k++) {
+        RankedHit *hit = &hits[(*hitCount)++];
+        hit->docId = scored[k].fileIndex;
+        hit->score = scored[k].relevanceScore;
+        hit->baseScore = scored[k].baseScore;
+        hit->exactFilenameMatch = scored[k].exactFilenameMatch;
+        hit->exactContentMatch = scored[k].exactContentMatch;
     }
-    free(queryTerms);
-    free(queryLower);
+    free(scored);
+    return hits;
+}
 
-    return results;
+void ranking_explain(Ranking *ranking, const RankedHit *hit, const RankingOptions *options,
+                     RankingBreakdown *breakdown) {
+    int i = hit->docId;
+    double recencyFactor = exp(-(options->now - ranking->recencyAnchor) / RECENCY_DECAY_MS);
+    breakdown->baseScore = hit->baseScore;
+    breakdown->recencyBonus = recencyFactor * ranking->recencyAtAnchor[i] * options->recencyWeight;
+    breakdown->fileSizeBonus = dequantizeSizeScore(ranking->sizeScores[i]) * options->fileSizeWeight;
+    breakdown->filenameBoost = options->filenameBoost;
+    breakdown->exactMatchBoost = (hit->exactFilenameMatch || hit->exactContentMatch) ?
+                                 options->exactMatchBoost : 1.0;
+    breakdown->reranked = options->reranked;
+    breakdown->modelScore = options->reranked ? hit->score : 0;
+    strcpy(breakdown->algorithm, options->algorithm);
 }
 
-SearchResult* ranking_rankWithBM25(Ranking *ranking, File *files, int fileCount,
-                                   const char *query, const char **fuzzyMatchedFiles,
-                                   int fuzzyCount, RankingOptions *options, int *resultCount) {
-    // Simplified BM25 implementation
-    return ranking_rankResults(ranking, files, fileCount, query, 
-                              (double *)calloc(fileCount, sizeof(double)),
-                              fuzzyMatchedFiles, fuzzyCount, options, resultCount);
+RankedHit* ranking_rankWithBM25(Ranking *ranking, File *files, int fileCount,
+                                const char *query, const char **fuzzyMatchedFiles,
+                                int fuzzyCount, RankingOptions *options, int *hitCount) {
+    InvertedIndex *index = ranking->index;
+    double *scores = (double *)calloc(fileCount + 1, sizeof(double));
+
+    int termCount;
+    char **terms = tokenize(query, &termCount);
+    for (int t = 0; t < termCount; t++) {
+        int termId = invertedindex_findTerm(index, terms[t]);
+        if (termId < 0) continue;
+        for (int j = 0; j < index->postingCounts[termId]; j++) {
+            const Posting *posting = &index->postings[termId][j];
+            if (posting->docId >= fileCount) break;
+            scores[posting->docId] += invertedindex_scorePosting(index, termId, posting, FIELD_ALL,
+                                                                options->filenameBoost, 1);
+        }
+        free(terms[t]);
+    }
+    free(terms);
+
+    // The whole query string is the one text an exact match has to contain
+    const char *texts[1] = { query };
+    MatchGroup whole = { FIELD_ALL, texts, 1 };
+    strcpy(options->algorithm, "bm25");
+    RankedHit *hits = ranking_rankResults(ranking, files, fileCount, &whole, 1, scores,
+                                          fuzzyMatchedFiles, fuzzyCount, options, hitCount);
+    free(scores);
+    return hits;
 }
 
 void ranking_free(Ranking *ranking) {
     if (!ranking) return;
+    free(ranking->live);
+    free(ranking->contentLengths);
+    free(ranking->filenameLengths);
+    free(ranking->uploadedAt);
+    free(ranking->sizeScores);
+    free(ranking->recencyAtAnchor);
+    reranker_free(ranking->reranker);
     free(ranking);
 }
\ No newline at end of file
@@ -3,29 +3,107 @@
 
 #include "schema.h"
 #include "inverted_index.h"
+#include "reranker.h"
+
+// Feature row handed to a learned reranker, one per candidate
+#define RANKING_FEATURE_BASE_SCORE 0
+#define RANKING_FEATURE_FILENAME_MATCH 1
+#define RANKING_FEATURE_CONTENT_MATCH 2
+#define RANKING_FEATURE_RECENCY 3
+#define RANKING_FEATURE_SIZE_SCORE 4
+#define RANKING_FEATURE_FILENAME_LENGTH 5
+#define RANKING_FEATURE_CONTENT_LENGTH 6
+#define RANKING_FEATURE_HEURISTIC_SCORE 7  // hand-tuned relevance
+#define RANKING_FEATURE_COUNT 8
 
 typedef struct {
     char algorithm[10]; // "tfidf" or "bm25"
-    double filenameBoost;
+    double filenameBoost;   // BM25F weight of filename occurrences, passed to the index
     double exactMatchBoost;
     double recencyWeight;
     double fileSizeWeight;
+    int maxResults; // top-k to materialize; 0 keeps every file
+    int offset;     // leading ranked results to skip before materializing
+    int rerankDepth; // candidates after the cursor, best bound first, that get
+                     // the exact-match pass; 0 reranks until no bound can enter
+                     // the top-k, or the first RANKING_MODEL_DEPTH when a model is set
+    long now;       // ms reference time for recency; 0 means the current time
+    int reranked;   // set by ranking when a loaded model scored the hits
+    int hasCursor;  // only rank hits strictly after (cursorScore, cursorDocId)
+    double cursorScore;
+    int cursorDocId;
 } RankingOptions;
 
+// Per-document scoring inputs live in parallel columns indexed by docId, so
+// the ranking loop streams flat arrays instead of chasing File pointers.
+// Recency is kept relative to an anchor time: exp(-(now - t)/tau) factors into
+// exp(-(now - anchor)/tau), once per query, times a per-document column.
 typedef struct {
     InvertedIndex *index;
+    unsigned char *live;
+    int *contentLengths;         // bytes, so exact-match checks skip strlen
+    int *filenameLengths;
+    long *uploadedAt;
+    unsigned char *sizeScores;   // file size score quantized to 0..255
+    double *recencyAtAnchor;     // exp(-(recencyAnchor - uploadedAt) / tau)
+    int columnCount;
+    int columnCapacity;
+    long recencyAnchor;
+    Reranker *reranker;          // owned; replaces the hand-tuned score when set
 } Ranking;
 
 Ranking* ranking_create(InvertedIndex *index);
+// docIds must be handed out in ascending order
+void ranking_addDocument(Ranking *ranking, int docId, File *file);
+void ranking_removeDocument(Ranking *ranking, int docId);
+// Takes ownership of model, or clears it when NULL. Returns 0 and keeps the
+// current model when model does not read RANKING_FEATURE_COUNT features.
+int ranking_setReranker(Ranking *ranking, Reranker *model);
+
+// Literal text one positive query leaf asks for: a term or phrase is its
+// group's only text, a prefix or wildcard lists the terms it expanded to. A
+// field is an exact match when every group over it has a text occurring there.
+typedef struct {
+    int fields;          // FIELD_* mask the leaf searches
+    const char **texts;  // alternatives, any one of which satisfies the group
+    int textCount;
+} MatchGroup;
+
+// One ranked document. Result fields, snippets and the score breakdown are
+// derived from it only when a caller asks for them.
+typedef struct {
+    int docId;
+    double score;
+    double baseScore;          // index score before boosts
+    int exactFilenameMatch;
+    int exactContentMatch;
+} RankedHit;
+
+// Ranks the files with a positive score; files[i] is scored by tfidfScores[i]
+// and documents not live in the ranking columns are skipped. Phase one orders
+// candidates by an upper bound built from column features alone; phase two
+// verifies exact matches and applies the boosts in that order. Hits come back
+// best first, options->offset already skipped, and options->now is set to
+// the reference time the recency scores used.
+RankedHit* ranking_rankResults(Ranking *ranking, File *files, int fileCount,
+                               const MatchGroup *groups, int groupCount, double *tfidfScores,
+                               const char **fuzzyMatchedFiles, int fuzzyCount,
+                               RankingOptions *options, int *hitCount);
+
+RankedHit* ranking_rankWithBM25(Ranking *ranking, File *files, int fileCount,
+                                const char *query, const char **fuzzyMatchedFiles,
+                                int fuzzyCount, RankingOptions *options, int *hitCount);
 
-SearchResult* ranking_rankResults(Ranking *ranking, File *files, int fileCount,
-                                  const char *query, double *tfidfScores,
-                                  const char **fuzzyMatchedFiles, int fuzzyCount,
-                                  RankingOptions *options, int *resultCount);
+// Splits a hit's score into its components, for options as returned by the
+// ranking call that produced it. When a loaded model scored the hit, its
+// output is the score and the components are the features it was given.
+void ranking_explain(Ranking *ranking, const RankedHit *hit, const RankingOptions *options,
+                     RankingBreakdown *breakdown);
 
-SearchResult* ranking_rankWithBM25(Ranking *ranking, File *files, int fileCount,
-                                   const char *query, const char **fuzzyMatchedFiles,
-                                   int fuzzyCount, RankingOptions *options, int *resultCount);
+// Cursor tokens carry the exact score bits, the docId tie-breaker and the
+// recency reference time, so a following page ranks against the same clock.
+void ranking_formatCursor(char *cursor, double score, int docId, long now);
+int ranking_parseCursor(const char *cursor, RankingOptions *options);
 
 void ranking_free(Ranking *ranking);
 
@@ -0,0 +1,222 @@
+#include "reranker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+// Rows are walked through every tree a batch at a time, so a tree's nodes stay
+// cached across the batch and the batch's rows stay cached across the trees
+#define RERANKER_BATCH 256
+// Rows descending one tree in lockstep; their loads are independent, so they
+// overlap instead of each step waiting on the previous one
+#define RERANKER_LANES 16
+// Larger counts in a model file are treated as malformed, not allocated
+#define RERANKER_MAX_TREES 65536
+#define RERANKER_MAX_NODES (1 << 20)    // per tree
+
+typedef struct {
+    int feature;
+    float threshold;
+    int left;
+    int right;
+    float value;
+    int seen;
+} RawNode;
+
+static int nextLine(FILE *file, char *line, int size) {
+    while (fgets(line, size, file)) {
+        const char *at = line;
+        while (*at == ' ' || *at == '\t') at++;
+        if (*at == '#' || *at == '\n' || *at == '\r' || *at == '\0') continue;
+        return 1;
+    }
+    return 0;
+}
+
+// Returns 0 when out of memory; the arrays that did grow are kept
+static int growNodes(Reranker *model, int needed) {
+    int *features = (int *)realloc(model->features, sizeof(int) * needed);
+    if (features) model->features = features;
+    float *thresholds = (float *)realloc(model->thresholds, sizeof(float) * needed);
+    if (thresholds) model->thresholds = thresholds;
+    int *children = (int *)realloc(model->children, sizeof(int) * needed);
+    if (children) model->children = children;
+    float *values = (float *)realloc(model->values, sizeof(float) * needed);
+    if (values) model->values = values;
+    return features && thresholds && children && values;
+}
+
+// Appends the nodes reachable from raw[0] breadth first, giving each split's
+// children consecutive slots. Returns the tree's depth, or -1 when the nodes
+// do not form a tree.
+static int layoutTree(Reranker *model, RawNode *raw, int rawCount) {
+    int base = model->nodeCount;
+    if (rawCount > INT_MAX - base || !growNodes(model, base + rawCount)) return -1;
+    int *queue = (int *)malloc(sizeof(int) * rawCount);
+    int *depths = (int *)malloc(sizeof(int) * rawCount);
+    if (!queue || !depths) {
+        free(queue);
+        free(depths);
+        return -1;
+    }
+    int head = 0, tail = 0;
+    int valid = 1;
+    int depth = 0;
+
+    depths[tail] = 0;
+    queue[tail++] = 0;
+    raw[0].seen = 1;
+    while (head < tail && valid) {
+        RawNode *node = &raw[queue[head]];
+        if (depths[head] > depth) depth = depths[head];
+        int at = base + head++;
+        if (node->feature < 0) {
+            // A leaf sends every row back to itself, so a walk can take the
+            // tree's full depth in steps without testing for leaves
+            model->features[at] = 0;
+            model->thresholds[at] = INFINITY;
+            model->children[at] = at;
+            model->values[at] = node->value;
+            continue;
+        }
+        model->features[at] = node->feature;
+        model->thresholds[at] = node->threshold;
+        model->values[at] = 0;
+
+        if (node->feature >= model->featureCount ||
+            node->left < 0 || node->left >= rawCount || raw[node->left].seen ||
+            node->right < 0 || node->right >= rawCount || raw[node->right].seen ||
+            node->left == node->right) {
+            valid = 0;
+            break;
+        }
+        model->children[at] = base + tail;
+        depths[tail] = depths[head - 1] + 1;
+        queue[tail++] = node->left;
+        depths[tail] = depths[head - 1] + 1;
+        queue[tail++] = node->right;
+        raw[node->left].seen = 1;
+        raw[node->right].seen = 1;
+    }
+
+    free(queue);
+    free(depths);
+    if (valid) model->nodeCount = base + tail;
+    return valid ? depth : -1;
+}
+
+Reranker* reranker_load(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) return NULL;
+
+    char line[512];
+    Reranker *model = (Reranker *)calloc(1, sizeof(Reranker));
+    if (!model) {
+        fclose(file);
+        return NULL;
+    }
+    if (!nextLine(file, line, sizeof(line)) ||
+        sscanf(line, "gbdt %d %d %lf", &model->featureCount, &model->treeCount, &model->baseScore) != 3 ||
+        model->featureCount <= 0 || model->treeCount < 0 || model->treeCount > RERANKER_MAX_TREES) {
+        fclose(file);
+        reranker_free(model);
+        return NULL;
+    }
+    model->treeRoots = (int *)malloc(sizeof(int) * (model->treeCount + 1));
+    model->treeDepths = (int *)malloc(sizeof(int) * (model->treeCount + 1));
+
+    int valid = model->treeRoots && model->treeDepths;
+    for (int t = 0; t < model->treeCount && valid; t++) {
+        int rawCount;
+        if (!nextLine(file, line, sizeof(line)) || sscanf(line, "tree %d", &rawCount) != 1 ||
+            rawCount <= 0 || rawCount > RERANKER_MAX_NODES) {
+            valid = 0;
+            break;
+        }
+        RawNode *raw = (RawNode *)calloc(rawCount, sizeof(RawNode));
+        int *defined = (int *)calloc(rawCount, sizeof(int));
+        if (!raw || !defined) valid = 0;
+        for (int n = 0; n < rawCount && valid; n++) {
+            int id;
+            RawNode node;
+            if (!nextLine(file, line, sizeof(line)) ||
+                sscanf(line, "%d %d %f %d %d %f", &id, &node.feature, &node.threshold,
+                       &node.left, &node.right, &node.value) != 6 ||
+                id < 0 || id >= rawCount || defined[id]) {
+                valid = 0;
+                break;
+            }
+            node.seen = 0;
+            raw[id] = node;
+            defined[id] = 1;
+        }
+        if (valid) {
+            model->treeRoots[t] = model->nodeCount;
+            model->treeDepths[t] = layoutTree(model, raw, rawCount);
+            valid = model->treeDepths[t] >= 0;
+        }
+        free(raw);
+        free(defined);
+    }
+
+    fclose(file);
+    if (!valid) {
+        reranker_free(model);
+        return NULL;
+    }
+    return model;
+}
+
+void reranker_score(const Reranker *model, const float *features, int rowCount, double *scores) {
+    const int *splitFeatures = model->features;
+    const float *thresholds = model->thresholds;
+    const int *children = model->children;
+    int featureCount = model->featureCount;
+
+    for (int i = 0; i < rowCount; i++) {
+        scores[i] = model->baseScore;
+    }
+    for (int start = 0; start < rowCount; start += RERANKER_BATCH) {
+        int end = rowCount - start < RERANKER_BATCH ? rowCount : start + RERANKER_BATCH;
+        for (int t = 0; t < model->treeCount; t++) {
+            int root = model->treeRoots[t];
+            int depth = model->treeDepths[t];
+            int i = start;
+            for (; i + RERANKER_LANES <= end; i += RERANKER_LANES) {
+                const float *rows = features + (size_t)i * featureCount;
+                int nodes[RERANKER_LANES];
+                for (int lane = 0; lane < RERANKER_LANES; lane++) nodes[lane] = root;
+                for (int d = 0; d < depth; d++) {
+                    for (int lane = 0; lane < RERANKER_LANES; lane++) {
+                        int node = nodes[lane];
+                        float value = rows[lane * featureCount + splitFeatures[node]];
+                        nodes[lane] = children[node] + (value > thresholds[node]);
+                    }
+                }
+                for (int lane = 0; lane < RERANKER_LANES; lane++) {
+                    scores[i + lane] += model->values[nodes[lane]];
+                }
+            }
+            for (; i < end; i++) {
+                const float *row = features + (size_t)i * featureCount;
+                int node = root;
+                for (int d = 0; d < depth; d++) {
+                    node = children[node] + (row[splitFeatures[node]] > thresholds[node]);
+                }
+                scores[i] += model->values[node];
+            }
+        }
+    }
+}
+
+void reranker_free(Reranker *model) {
+    if (!model) return;
+    free(model->treeRoots);
+    free(model->treeDepths);
+    free(model->features);
+    free(model->thresholds);
+    free(model->children);
+    free(model->values);
+    free(model);
+}
@@ -0,0 +1,39 @@
+#ifndef RERANKER_H
+#define RERANKER_H
+
+// Gradient-boosted tree ensemble. Model files are plain text:
+//
+//   gbdt <featureCount> <treeCount> <baseScore>
+//   tree <nodeCount>
+//   <node> <feature> <threshold> <left> <right> <value>     one line per node
+//
+// Nodes are numbered from 0 within their tree, 0 being the root. A node whose
+// feature is -1 is a leaf worth value; any other node sends rows whose feature
+// is greater than threshold right and the rest left. Lines starting with '#'
+// are ignored.
+//
+// All trees share flat node arrays laid out breadth first, with both children
+// of a node stored next to each other, so a step down the tree is one load.
+// Leaves point back at themselves, so every row takes exactly treeDepths[t]
+// steps through tree t and rows can descend it side by side without branches.
+typedef struct {
+    int featureCount;
+    int treeCount;
+    double baseScore;
+    int *treeRoots;     // first node of each tree
+    int *treeDepths;    // longest root-to-leaf path of each tree
+    int nodeCount;
+    int *features;      // split feature, 0 at leaves
+    float *thresholds;  // +infinity at leaves
+    int *children;      // left child, the right child follows it; leaves hold their own index
+    float *values;      // leaf outputs, 0 at splits
+} Reranker;
+
+// NULL when the file is missing or malformed, declares more than 65536 trees
+// or 2^20 nodes in one, or does not fit in memory
+Reranker* reranker_load(const char *path);
+// scores[i] = ensemble output for the row at features + i * featureCount
+void reranker_score(const Reranker *model, const float *features, int rowCount, double *scores);
+void reranker_free(Reranker *model);
+
+#endif
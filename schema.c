@@ -11,19 +11,32 @@ void free_file(File *file) {
     free(file);
 }
 
-void free_search_result(SearchResult *result) {
-    if (!result) return;
+static void free_search_result_fields(SearchResult *result) {
     free(result->fileId);
     free(result->filename);
     free(result->type);
     free(result->contentSnippet);
     free(result->highlightedSnippet);
+    free(result->highlights);
     if (result->rankingBreakdown) {
         free(result->rankingBreakdown);
     }
+}
+
+void free_search_result(SearchResult *result) {
+    if (!result) return;
+    free_search_result_fields(result);
     free(result);
 }
 
+void free_search_results(SearchResult *results, int count) {
+    if (!results) return;
+    for (int i = 0; i < count; i++) {
+        free_search_result_fields(&results[i]);
+    }
+    free(results);
+}
+
 void free_autocomplete_suggestion(AutocompleteSuggestion *suggestion) {
     if (!suggestion) return;
     free(suggestion->text);
@@ -43,5 +56,6 @@ void free_search_request(SearchRequest *request) {
         free(request->fileTypes);
     }
     free(request->rankingAlgorithm);
+    free(request->searchAfter);
     free(request);
 }
\ No newline at end of file
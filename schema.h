@@ -3,6 +3,8 @@
 
 #include <time.h>
 
+#define SEARCH_CURSOR_LENGTH 48
+
 typedef struct {
     char *id;
     char *filename;
@@ -16,12 +18,20 @@ typedef struct {
     double baseScore;
     double recencyBonus;
     double fileSizeBonus;
-    double filenameBoost;
+    double filenameBoost;   // weight filename occurrences carried inside baseScore
     double exactMatchBoost;
+    int reranked;           // a loaded model's output replaced the hand-tuned total,
+    double modelScore;      // which the components above fed as features; 0 otherwise
     char algorithm[10]; // "tfidf" or "bm25"
 } RankingBreakdown;
 
 typedef struct {
+    int start;  // byte offset into contentSnippet
+    int length;
+} HighlightRange;
+
+typedef struct {
+    int docId;
     char *fileId;
     char *filename;
     char *type;
@@ -30,9 +40,12 @@ typedef struct {
     int matchedInContent;
     char *contentSnippet;
     char *highlightedSnippet;
+    HighlightRange *highlights;
+    int highlightCount;
     long uploadedAt;
     char matchType[10]; // "exact", "partial", "fuzzy"
     RankingBreakdown *rankingBreakdown;
+    char cursor[SEARCH_CURSOR_LENGTH]; // pass as searchAfter to continue after this hit
 } SearchResult;
 
 typedef struct {
@@ -52,7 +65,10 @@ typedef struct {
     long dateTo;
     int limit;
     int offset;
+    char *searchAfter; // cursor of the last hit already seen; offset then counts from it
     char *rankingAlgorithm; // "tfidf", "bm25"
+    int rerankDepth; // best-bound candidates given the exact-match pass or the
+                     // loaded model, 0 = as many as needed
 } SearchRequest;
 
 typedef struct {
@@ -71,6 +87,7 @@ typedef struct {
 // Memory cleanup functions
 void free_file(File *file);
 void free_search_result(SearchResult *result);
+void free_search_results(SearchResult *results, int count);
 void free_autocomplete_suggestion(AutocompleteSuggestion *suggestion);
 void free_search_request(SearchRequest *request);
 
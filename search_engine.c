@@ -1,55 +1,113 @@
 #include "search_engine.h"
+#include "strsearch.h"
+#include "snippet.h"
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
 
 SearchEngine* searchengine_create(void) {
     SearchEngine *engine = (SearchEngine *)malloc(sizeof(SearchEngine));
-    engine->filenameTrie = trie_create();
-    engine->contentTrie = trie_create();
     engine->invertedIndex = invertedindex_create();
     engine->ranking = ranking_create(engine->invertedIndex);
     engine->fuzzyMatcher = fuzzy_create();
-    engine->files = (File *)malloc(sizeof(File) * 10000);
+    engine->fileCapacity = 1024;
+    engine->files = (File *)malloc(sizeof(File) * engine->fileCapacity);
     engine->fileCount = 0;
-    engine->filenameToIdMap = (char **)malloc(sizeof(char *) * 10000);
+    engine->filenameToIdMap = (char **)malloc(sizeof(char *) * engine->fileCapacity);
     engine->mapCount = 0;
-    engine->filenameTokens = (char **)malloc(sizeof(char *) * 10000);
-    engine->tokenCount = 0;
+    engine->filenameTrigrams = trigramindex_create();
+    engine->typeFilterCapacity = 16;
+    engine->typeFilters = (TypeFilter *)malloc(sizeof(TypeFilter) * engine->typeFilterCapacity);
+    engine->typeFilterCount = 0;
+    engine->timestamps = (TimestampEntry *)malloc(sizeof(TimestampEntry) * engine->fileCapacity);
+    engine->timestampCount = 0;
+    engine->maxExpansions = SEARCH_MAX_EXPANSIONS;
+    engine->ngrams = ngram_create();
+    engine->ngramStaleDocs = 0;
     return engine;
 }
 
 static char** tokenize(const char *text, int *count) {
-    char **tokens = (char **)malloc(sizeof(char *) * 1000);
+    int capacity = 1000;
+    char **tokens = (char **)malloc(sizeof(char *) * capacity);
     *count = 0;
 
     char *word = (char *)malloc(strlen(text) + 1);
     int wordLen = 0;
 
-    for (int i = 0; text[i]; i++) {
-        if (isalnum((unsigned char)text[i]) || text[i] == '_') {
+    for (int i = 0; ; i++) {
+        if (text[i] && (isalnum((unsigned char)text[i]) || text[i] == '_')) {
             word[wordLen++] = tolower((unsigned char)text[i]);
-        } else {
-            if (wordLen > 1) {
-                word[wordLen] = '\0';
-                tokens[*count] = (char *)malloc(wordLen + 1);
-                strcpy(tokens[*count], word);
-                (*count)++;
-                wordLen = 0;
+            continue;
+        }
+        if (wordLen > 1) {
+            if (*count == capacity) {
+                capacity *= 2;
+                tokens = (char **)realloc(tokens, sizeof(char *) * capacity);
             }
+            word[wordLen] = '\0';
+            tokens[*count] = (char *)malloc(wordLen + 1);
+            strcpy(tokens[*count], word);
+            (*count)++;
         }
-    }
-    if (wordLen > 1) {
-        word[wordLen] = '\0';
-        tokens[*count] = (char *)malloc(wordLen + 1);
-        strcpy(tokens[*count], word);
-        (*count)++;
+        wordLen = 0;
+        if (!text[i]) break;
     }
 
     free(word);
     return tokens;
 }
 
+static TypeFilter* findTypeFilter(SearchEngine *engine, const char *type, int create) {
+    const char *key = type ? type : "";
+    for (int i = 0; i < engine->typeFilterCount; i++) {
+        if (strcmp(engine->typeFilters[i].type, key) == 0) return &engine->typeFilters[i];
+    }
+    if (!create) return NULL;
+
+    if (engine->typeFilterCount == engine->typeFilterCapacity) {
+        engine->typeFilterCapacity *= 2;
+        engine->typeFilters = (TypeFilter *)realloc(engine->typeFilters,
+                                                    sizeof(TypeFilter) * engine->typeFilterCapacity);
+    }
+    TypeFilter *filter = &engine->typeFilters[engine->typeFilterCount++];
+    filter->type = (char *)malloc(strlen(key) + 1);
+    strcpy(filter->type, key);
+    filter->docs = bitmap_create();
+    return filter;
+}
+
+// First entry whose (uploadedAt, docId) is not less than the given pair
+static int lowerBoundTimestamp(SearchEngine *engine, long uploadedAt, int docId) {
+    int lo = 0, hi = engine->timestampCount;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        const TimestampEntry *entry = &engine->timestamps[mid];
+        if (entry->uploadedAt < uploadedAt || (entry->uploadedAt == uploadedAt && entry->docId < docId)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// A file's slot in engine->files doubles as its document id: slots are
+// append-only and removal leaves a tombstone (id == NULL) behind, so the
+// arrays keyed by slot grow with every add rather than with the live count.
 void searchengine_indexFile(SearchEngine *engine, File *file) {
+    if (engine->fileCount == engine->fileCapacity) {
+        engine->fileCapacity *= 2;
+        engine->files = (File *)realloc(engine->files, sizeof(File) * engine->fileCapacity);
+        engine->filenameToIdMap = (char **)realloc(engine->filenameToIdMap,
+                                                   sizeof(char *) * engine->fileCapacity);
+        engine->timestamps = (TimestampEntry *)realloc(engine->timestamps,
+                                                       sizeof(TimestampEntry) * engine->fileCapacity);
+    }
+    int docId = engine->fileCount;
     engine->files[engine->fileCount] = *file;
     engine->fileCount++;
 
@@ -61,83 +119,944 @@ void searchengine_indexFile(SearchEngine *engine, File *file) {
 
     engine->filenameToIdMap[engine->mapCount] = filenameLower;
     engine->mapCount++;
+    trigramindex_addDocument(engine->filenameTrigrams, docId, filenameLower);
+
+    // The index tokenizes both fields once; only terms it has never seen
+    // before are new to the fuzzy matcher
+    int knownTerms = engine->invertedIndex->termCount;
+    invertedindex_addDocument(engine->invertedIndex, docId, file);
+    for (int t = knownTerms; t < engine->invertedIndex->termCount; t++) {
+        fuzzy_addTerm(engine->fuzzyMatcher, engine->invertedIndex->terms[t]);
+    }
+    ranking_addDocument(engine->ranking, docId, file);
+    ngram_addText(engine->ngrams, file->content);
+
+    bitmap_add(findTypeFilter(engine, file->type, 1)->docs, docId);
+
+    // Uploads mostly arrive in time order, so this rarely shifts more than a few entries
+    int at = engine->timestampCount++;
+    while (at > 0 && engine->timestamps[at - 1].uploadedAt > file->uploadedAt) {
+        engine->timestamps[at] = engine->timestamps[at - 1];
+        at--;
+    }
+    engine->timestamps[at].uploadedAt = file->uploadedAt;
+    engine->timestamps[at].docId = docId;
+}
+
+#define DEFAULT_SEARCH_LIMIT 20
+#define FILENAME_SUBSTRING_SCORE 0.5
+// Holds the materialized fields and snippets of about a page of results
+#define SEARCH_ARENA_BLOCK 16384
+// Postings whose impacts are decoded per SIMD pass
+#define IMPACT_BLOCK 128
+
+typedef struct {
+    Bitmap *docs;    // NULL when every live document passes
+    int checkDates;  // date range tested per posting rather than folded into docs
+    long dateFrom;
+    long dateTo;
+} SearchFilter;
+
+typedef struct {
+    int *docIds;    // ascending
+    double *scores;
+    int count;
+    int capacity;
+} DocList;
+
+typedef struct {
+    SearchEngine *engine;
+    int useBM25;
+    double filenameWeight; // of filename occurrences against content ones
+    SearchFilter *filter;
+    const int *filterDocs; // sorted filter members, set when the plan drives from them
+    int filterCount;
+} EvalContext;
+
+// One conjunct: either a term whose postings are probed in place, or a
+// materialized list
+typedef struct {
+    int termId;
+    const unsigned short *impacts;
+    double scale;
+    DocList list;
+    int cursor;
+} Operand;
 
-    int filenameWordCount;
-    char **filenameWords = tokenize(file->filename, &filenameWordCount);
-    for (int i = 0; i < filenameWordCount; i++) {
-        trie_insert(engine->filenameTrie, filenameWords[i], file->id);
-        free(filenameWords[i]);
+static int compareInts(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+static int passesFilter(SearchEngine *engine, const SearchFilter *filter, int docId) {
+    if (filter->docs && !bitmap_contains(filter->docs, docId)) return 0;
+    if (filter->checkDates) {
+        long uploadedAt = engine->ranking->uploadedAt[docId];
+        if (uploadedAt < filter->dateFrom || uploadedAt > filter->dateTo) return 0;
     }
-    free(filenameWords);
+    return 1;
+}
+
+// Folds the type and date restrictions into one docId bitmap. The date range
+// comes off the sorted timestamp column and is only materialized when it is
+// smaller than the postings it would otherwise be tested against. Returns 0
+// when nothing can match.
+static int buildFilter(SearchEngine *engine, SearchRequest *request, long postingWork,
+                       SearchFilter *filter) {
+    filter->docs = NULL;
+    filter->checkDates = 0;
+    filter->dateFrom = request->dateFrom;
+    filter->dateTo = request->dateTo > 0 ? request->dateTo : LONG_MAX;
 
-    int contentWordCount;
-    char **contentWords = tokenize(file->content, &contentWordCount);
-    for (int i = 0; i < contentWordCount; i++) {
-        trie_insert(engine->contentTrie, contentWords[i], file->id);
-        free(contentWords[i]);
+    if (request->fileTypes && request->fileTypesCount > 0) {
+        Bitmap *types = bitmap_create();
+        for (int i = 0; i < request->fileTypesCount; i++) {
+            TypeFilter *typeFilter = findTypeFilter(engine, request->fileTypes[i], 0);
+            if (!typeFilter) continue;
+            Bitmap *merged = bitmap_or(types, typeFilter->docs);
+            bitmap_free(types);
+            types = merged;
+        }
+        filter->docs = types;
     }
-    free(contentWords);
 
-    invertedindex_addDocument(engine->invertedIndex, file);
+    if (request->dateFrom > 0 || request->dateTo > 0) {
+        int first = lowerBoundTimestamp(engine, filter->dateFrom, 0);
+        int last = filter->dateTo == LONG_MAX ? engine->timestampCount :
+                   lowerBoundTimestamp(engine, filter->dateTo + 1, 0);
+        int inRange = last - first;
+        if (inRange <= 0) return 0;
+
+        if (inRange < engine->timestampCount && inRange <= postingWork) {
+            int *docIds = (int *)malloc(sizeof(int) * inRange);
+            for (int i = 0; i < inRange; i++) docIds[i] = engine->timestamps[first + i].docId;
+            qsort(docIds, inRange, sizeof(int), compareInts);
+            Bitmap *dates = bitmap_create();
+            for (int i = 0; i < inRange; i++) bitmap_add(dates, docIds[i]);
+            free(docIds);
+
+            if (filter->docs) {
+                Bitmap *both = bitmap_and(filter->docs, dates);
+                bitmap_free(filter->docs);
+                bitmap_free(dates);
+                filter->docs = both;
+            } else {
+                filter->docs = dates;
+            }
+        } else if (inRange < engine->timestampCount) {
+            filter->checkDates = 1;
+        }
+    }
+
+    return !filter->docs || bitmap_cardinality(filter->docs) > 0;
+}
+
+static void docListInit(DocList *list, int capacity) {
+    list->capacity = capacity > 0 ? capacity : 1;
+    list->docIds = (int *)malloc(sizeof(int) * list->capacity);
+    list->scores = (double *)malloc(sizeof(double) * list->capacity);
+    list->count = 0;
+}
+
+static void docListPush(DocList *list, int docId, double score) {
+    if (list->count == list->capacity) {
+        list->capacity *= 2;
+        list->docIds = (int *)realloc(list->docIds, sizeof(int) * list->capacity);
+        list->scores = (double *)realloc(list->scores, sizeof(double) * list->capacity);
+    }
+    list->docIds[list->count] = docId;
+    list->scores[list->count] = score;
+    list->count++;
+}
+
+static void docListFree(DocList *list) {
+    free(list->docIds);
+    free(list->scores);
+    list->docIds = NULL;
+    list->scores = NULL;
+    list->count = 0;
+}
+
+// Merges b into a, summing the scores of documents found in both
+static void docListUnion(DocList *a, DocList *b) {
+    DocList merged;
+    docListInit(&merged, a->count + b->count);
+    int i = 0, j = 0;
+    while (i < a->count || j < b->count) {
+        if (j == b->count || (i < a->count && a->docIds[i] < b->docIds[j])) {
+            docListPush(&merged, a->docIds[i], a->scores[i]);
+            i++;
+        } else if (i == a->count || b->docIds[j] < a->docIds[i]) {
+            docListPush(&merged, b->docIds[j], b->scores[j]);
+            j++;
+        } else {
+            docListPush(&merged, a->docIds[i], a->scores[i] + b->scores[j]);
+            i++;
+            j++;
+        }
+    }
+    docListFree(a);
+    docListFree(b);
+    *a = merged;
+}
+
+// First position at or after from whose docId is >= docId, probing 1, 2, 4...
+// ahead before binary searching the bracketed run
+static int gallopPostings(const Posting *postings, int count, int from, int docId) {
+    int step = 1;
+    int hi = from;
+    while (hi < count && postings[hi].docId < docId) {
+        from = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > count) hi = count;
+    while (from < hi) {
+        int mid = (from + hi) / 2;
+        if (postings[mid].docId < docId) from = mid + 1;
+        else hi = mid;
+    }
+    return from;
+}
+
+static int gallopDocs(const int *docIds, int count, int from, int docId) {
+    int step = 1;
+    int hi = from;
+    while (hi < count && docIds[hi] < docId) {
+        from = hi + 1;
+        hi += step;
+        step *= 2;
+    }
+    if (hi > count) hi = count;
+    while (from < hi) {
+        int mid = (from + hi) / 2;
+        if (docIds[mid] < docId) from = mid + 1;
+        else hi = mid;
+    }
+    return from;
+}
+
+static void materializeTerm(EvalContext *ctx, int termId, double weight, int fields,
+                            int filterDriven, DocList *out) {
+    InvertedIndex *index = ctx->engine->invertedIndex;
+    const Posting *postings = index->postings[termId];
+    int postingCount = index->postingCounts[termId];
+    double scale;
+    const unsigned short *impacts = invertedindex_getImpacts(index, termId, fields, ctx->filenameWeight,
+                                                                ctx->useBM25, &scale);
+    scale *= weight;
+
+    if (filterDriven) {
+        docListInit(out, ctx->filterCount < postingCount ? ctx->filterCount : postingCount);
+        int pos = 0;
+        for (int i = 0; i < ctx->filterCount && pos < postingCount; i++) {
+            int docId = ctx->filterDocs[i];
+            pos = gallopPostings(postings, postingCount, pos, docId);
+            if (pos == postingCount || postings[pos].docId != docId) continue;
+            if (!passesFilter(ctx->engine, ctx->filter, docId)) continue;
+            double score = impacts[pos] * scale;
+            if (score > 0) docListPush(out, docId, score);
+        }
+        return;
+    }
+
+    double block[IMPACT_BLOCK];
+    docListInit(out, postingCount);
+    for (int start = 0; start < postingCount; start += IMPACT_BLOCK) {
+        int blockCount = postingCount - start < IMPACT_BLOCK ? postingCount - start : IMPACT_BLOCK;
+        invertedindex_decodeImpacts(impacts + start, blockCount, scale, block);
+        for (int k = 0; k < blockCount; k++) {
+            int docId = postings[start + k].docId;
+            if (block[k] > 0 && passesFilter(ctx->engine, ctx->filter, docId)) {
+                docListPush(out, docId, block[k]);
+            }
+        }
+    }
+}
+
+// Whether docId is in the operand, advancing its cursor; operands are probed
+// with ascending docIds
+static int probeOperand(EvalContext *ctx, Operand *operand, int docId, double *score) {
+    if (operand->termId >= 0) {
+        InvertedIndex *index = ctx->engine->invertedIndex;
+        const Posting *postings = index->postings[operand->termId];
+        int count = index->postingCounts[operand->termId];
+        operand->cursor = gallopPostings(postings, count, operand->cursor, docId);
+        if (operand->cursor == count || postings[operand->cursor].docId != docId) return 0;
+        *score = operand->impacts[operand->cursor] * operand->scale;
+        return *score > 0;
+    }
+    operand->cursor = gallopDocs(operand->list.docIds, operand->list.count, operand->cursor, docId);
+    if (operand->cursor == operand->list.count || operand->list.docIds[operand->cursor] != docId) return 0;
+    *score = operand->list.scores[operand->cursor];
+    return 1;
+}
+
+typedef struct {
+    int termId;
+    const unsigned short *impacts;
+    double scale;
+    int pos;
+} UnionCursor;
+
+static int cursorDoc(InvertedIndex *index, const UnionCursor *cursor) {
+    return index->postings[cursor->termId][cursor->pos].docId;
+}
+
+static void siftCursor(InvertedIndex *index, UnionCursor *heap, int count, int i) {
+    for (;;) {
+        int smallest = i;
+        int left = 2 * i + 1, right = left + 1;
+        if (left < count && cursorDoc(index, &heap[left]) < cursorDoc(index, &heap[smallest])) smallest = left;
+        if (right < count && cursorDoc(index, &heap[right]) < cursorDoc(index, &heap[smallest])) smallest = right;
+        if (smallest == i) return;
+        UnionCursor tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+// Term-at-a-time: every list is decoded a block at a time and added into a
+// docId-indexed accumulator, and the hits are read back off a bitset in docId
+// order
+static void accumulateTerms(EvalContext *ctx, PlanNode *plan, DocList *out) {
+    InvertedIndex *index = ctx->engine->invertedIndex;
+    double *accumulated = (double *)calloc(index->documentCount + 1, sizeof(double));
+    int words = index->documentCount / 64 + 1;
+    uint64_t *touched = (uint64_t *)calloc(words, sizeof(uint64_t));
+    double block[IMPACT_BLOCK];
+    int hits = 0;
+    for (int i = 0; i < plan->termCount; i++) {
+        int termId = plan->termIds[i];
+        const Posting *postings = index->postings[termId];
+        int postingCount = index->postingCounts[termId];
+        double scale;
+        const unsigned short *impacts = invertedindex_getImpacts(index, termId, plan->fields,
+                                                                 ctx->filenameWeight, ctx->useBM25,
+                                                                 &scale);
+        scale *= plan->weights[i];
+        for (int start = 0; start < postingCount; start += IMPACT_BLOCK) {
+            int blockCount = postingCount - start < IMPACT_BLOCK ? postingCount - start : IMPACT_BLOCK;
+            invertedindex_decodeImpacts(impacts + start, blockCount, scale, block);
+            for (int k = 0; k < blockCount; k++) {
+                int docId = postings[start + k].docId;
+                if (block[k] <= 0 || !passesFilter(ctx->engine, ctx->filter, docId)) continue;
+                if (!(touched[docId >> 6] & (1ULL << (docId & 63)))) hits++;
+                touched[docId >> 6] |= 1ULL << (docId & 63);
+                accumulated[docId] += block[k];
+            }
+        }
+    }
+    docListInit(out, hits);
+    for (int w = 0; w < words; w++) {
+        uint64_t word = touched[w];
+        while (word) {
+            int docId = w * 64 + __builtin_ctzll(word);
+            docListPush(out, docId, accumulated[docId]);
+            word &= word - 1;
+        }
+    }
+    free(accumulated);
+    free(touched);
+}
+
+// Document-at-a-time: a k-way merge over a heap of posting cursors
+static void mergeTerms(EvalContext *ctx, PlanNode *plan, DocList *out) {
+    InvertedIndex *index = ctx->engine->invertedIndex;
+    UnionCursor *heap = (UnionCursor *)malloc(sizeof(UnionCursor) * (plan->termCount + 1));
+    int heapCount = 0;
+    for (int i = 0; i < plan->termCount; i++) {
+        if (index->postingCounts[plan->termIds[i]] == 0) continue;
+        UnionCursor *cursor = &heap[heapCount++];
+        cursor->termId = plan->termIds[i];
+        cursor->impacts = invertedindex_getImpacts(index, cursor->termId, plan->fields,
+                                                   ctx->filenameWeight, ctx->useBM25, &cursor->scale);
+        cursor->scale *= plan->weights[i];
+        cursor->pos = 0;
+    }
+    for (int i = heapCount / 2 - 1; i >= 0; i--) siftCursor(index, heap, heapCount, i);
+
+    docListInit(out, plan->postings < 1024 ? plan->postings : 1024);
+    while (heapCount > 0) {
+        UnionCursor *top = &heap[0];
+        int docId = index->postings[top->termId][top->pos].docId;
+        double score = top->impacts[top->pos] * top->scale;
+        if (score > 0 && passesFilter(ctx->engine, ctx->filter, docId)) {
+            if (out->count > 0 && out->docIds[out->count - 1] == docId) out->scores[out->count - 1] += score;
+            else docListPush(out, docId, score);
+        }
+        if (++top->pos == index->postingCounts[top->termId]) heap[0] = heap[--heapCount];
+        siftCursor(index, heap, heapCount, 0);
+    }
+    free(heap);
+}
+
+static void evaluateTerms(EvalContext *ctx, PlanNode *plan, DocList *out) {
+    switch (plan->strategy) {
+        case STRATEGY_ACCUMULATE: accumulateTerms(ctx, plan, out); return;
+        case STRATEGY_MERGE: mergeTerms(ctx, plan, out); return;
+        default: break;
+    }
+    int filterDriven = plan->strategy == STRATEGY_FILTER_DRIVEN;
+    materializeTerm(ctx, plan->termIds[0], plan->weights[0], plan->fields, filterDriven, out);
+    for (int i = 1; i < plan->termCount; i++) {
+        DocList expansion;
+        materializeTerm(ctx, plan->termIds[i], plan->weights[i], plan->fields, filterDriven, &expansion);
+        docListUnion(out, &expansion);
+    }
+}
+
+static void evaluate(EvalContext *ctx, PlanNode *plan, DocList *out);
+
+// Probed terms are galloped into in place; anything else is evaluated to a
+// list first
+static void planOperand(EvalContext *ctx, PlanNode *plan, Operand *operand) {
+    operand->cursor = 0;
+    if (plan->strategy == STRATEGY_PROBE) {
+        operand->termId = plan->termIds[0];
+        operand->impacts = invertedindex_getImpacts(ctx->engine->invertedIndex, operand->termId,
+                                                    plan->fields, ctx->filenameWeight, ctx->useBM25,
+                                                    &operand->scale);
+        operand->scale *= plan->weights[0];
+        operand->list.docIds = NULL;
+        operand->list.scores = NULL;
+        operand->list.count = 0;
+        return;
+    }
+    operand->termId = -1;
+    evaluate(ctx, plan, &operand->list);
+}
+
+// Operands come in the planner's order: the first drives and is the only one
+// materialized in full, every other conjunct is galloped into, and exclusions
+// only ever see survivors
+static void evaluateIntersect(EvalContext *ctx, PlanNode *plan, DocList *out) {
+    int count = plan->childCount + plan->excludedCount;
+    Operand *operands = (Operand *)malloc(sizeof(Operand) * count);
+    int ready = 0;
+    int empty = 0;
+    for (int i = 0; i < count && !empty; i++) {
+        PlanNode *child = i < plan->childCount ? plan->children[i] : plan->excluded[i - plan->childCount];
+        planOperand(ctx, child, &operands[ready]);
+        if (i < plan->childCount && operands[ready].termId < 0 && operands[ready].list.count == 0) empty = 1;
+        ready++;
+    }
+
+    Operand *driver = &operands[0];
+    docListInit(out, empty ? 1 : driver->list.count);
+    for (int i = 0; i < driver->list.count && !empty; i++) {
+        int docId = driver->list.docIds[i];
+        double total = driver->list.scores[i];
+        double score;
+        int matched = 1;
+        for (int k = 1; k < plan->childCount && matched; k++) {
+            matched = probeOperand(ctx, &operands[k], docId, &score);
+            total += score;
+        }
+        for (int k = plan->childCount; k < count && matched; k++) {
+            matched = !probeOperand(ctx, &operands[k], docId, &score);
+        }
+        if (matched) docListPush(out, docId, total);
+    }
+
+    for (int i = 0; i < ready; i++) docListFree(&operands[i].list);
+    free(operands);
+}
+
+// Conjunction of the phrase's terms, then each survivor is confirmed by
+// searching its text for the phrase itself
+static void evaluatePhrase(EvalContext *ctx, PlanNode *plan, DocList *out) {
+    DocList candidates;
+    evaluateIntersect(ctx, plan, &candidates);
+
+    size_t phraseLen = strlen(plan->text);
+    docListInit(out, candidates.count);
+    for (int i = 0; i < candidates.count; i++) {
+        File *file = &ctx->engine->files[candidates.docIds[i]];
+        int found = ((plan->fields & FIELD_CONTENT) &&
+                     strsearch_find(file->content, strlen(file->content), plan->text, phraseLen)) ||
+                    ((plan->fields & FIELD_FILENAME) &&
+                     strsearch_find(file->filename, strlen(file->filename), plan->text, phraseLen));
+        if (found) docListPush(out, candidates.docIds[i], candidates.scores[i]);
+    }
+    docListFree(&candidates);
+}
+
+static void evaluate(EvalContext *ctx, PlanNode *plan, DocList *out) {
+    switch (plan->type) {
+        case PLAN_EMPTY: docListInit(out, 1); return;
+        case PLAN_TERMS: evaluateTerms(ctx, plan, out); return;
+        case PLAN_INTERSECT: evaluateIntersect(ctx, plan, out); return;
+        case PLAN_PHRASE: evaluatePhrase(ctx, plan, out); return;
+        case PLAN_UNION:
+            docListInit(out, 1);
+            for (int i = 0; i < plan->childCount; i++) {
+                DocList child;
+                evaluate(ctx, plan->children[i], &child);
+                docListUnion(out, &child);
+            }
+            return;
+    }
+}
+
+static int requestFields(SearchRequest *request) {
+    if (request->scope && strcmp(request->scope, "filename") == 0) return FIELD_FILENAME;
+    if (request->scope && strcmp(request->scope, "content") == 0) return FIELD_CONTENT;
+    return FIELD_ALL;
+}
+
+// Resolves the query against the dictionary, builds the filter sized by the
+// postings the plan can touch, then costs the plan against that filter.
+// Returns NULL when nothing can match.
+static void initPlanContext(SearchEngine *engine, SearchRequest *request, PlanContext *planContext) {
+    planContext->index = engine->invertedIndex;
+    planContext->fuzzy = request->fuzzy ? engine->fuzzyMatcher : NULL;
+    planContext->fields = requestFields(request);
+    planContext->maxExpansions = engine->maxExpansions;
+    planContext->filterCount = -1;
+}
+
+static PlanNode* planSearch(SearchEngine *engine, SearchRequest *request, QueryNode *root,
+                            SearchFilter *filter) {
+    PlanContext planContext;
+    initPlanContext(engine, request, &planContext);
+
+    PlanNode *plan = queryplan_build(root, &planContext);
+    if (!buildFilter(engine, request, plan->postings, filter)) {
+        bitmap_free(filter->docs);
+        filter->docs = NULL;
+        queryplan_free(plan);
+        return NULL;
+    }
+    if (filter->docs) planContext.filterCount = bitmap_cardinality(filter->docs);
+    queryplan_optimize(plan, &planContext);
+    return plan;
+}
+
+// One match group per positive leaf; leaves under NOT ask for nothing. Texts
+// point into the query tree and the dictionary, so groups live no longer than
+// either.
+static void collectMatchGroups(const PlanContext *planContext, QueryNode *node,
+                               MatchGroup **groups, int *count, int *capacity) {
+    if (node->type == QUERY_NOT) return;
+    if (node->type == QUERY_AND || node->type == QUERY_OR) {
+        for (int i = 0; i < node->childCount; i++) {
+            collectMatchGroups(planContext, node->children[i], groups, count, capacity);
+        }
+        return;
+    }
+
+    if (*count == *capacity) {
+        *capacity *= 2;
+        *groups = (MatchGroup *)realloc(*groups, sizeof(MatchGroup) * *capacity);
+    }
+    MatchGroup *group = &(*groups)[(*count)++];
+    group->fields = node->fields ? node->fields : planContext->fields;
+    if (node->type == QUERY_PREFIX || node->type == QUERY_WILDCARD) {
+        int *termIds;
+        group->textCount = queryplan_expand(planContext, node, &termIds);
+        group->texts = (const char **)malloc(sizeof(char *) * (group->textCount + 1));
+        for (int i = 0; i < group->textCount; i++) {
+            group->texts[i] = planContext->index->terms[termIds[i]];
+        }
+        free(termIds);
+    } else {
+        group->texts = (const char **)malloc(sizeof(char *));
+        group->texts[0] = node->text;
+        group->textCount = 1;
+    }
+}
+
+static void freeMatchGroups(MatchGroup *groups, int count) {
+    for (int i = 0; i < count; i++) {
+        free((void *)groups[i].texts);
+    }
+    free(groups);
+}
+
+// Words of the groups that search content, once each, for snippet highlighting
+static char** snippetTerms(const MatchGroup *groups, int groupCount, int *count) {
+    int capacity = 16;
+    char **terms = (char **)malloc(sizeof(char *) * capacity);
+    *count = 0;
+    for (int g = 0; g < groupCount; g++) {
+        if (!(groups[g].fields & FIELD_CONTENT)) continue;
+        for (int t = 0; t < groups[g].textCount; t++) {
+            int wordCount;
+            char **words = tokenize(groups[g].texts[t], &wordCount);
+            for (int w = 0; w < wordCount; w++) {
+                int seen = 0;
+                for (int k = 0; k < *count && !seen; k++) {
+                    seen = strcmp(terms[k], words[w]) == 0;
+                }
+                if (seen) {
+                    free(words[w]);
+                    continue;
+                }
+                if (*count == capacity) {
+                    capacity *= 2;
+                    terms = (char **)realloc(terms, sizeof(char *) * capacity);
+                }
+                terms[(*count)++] = words[w];
+            }
+            free(words);
+        }
+    }
+    return terms;
+}
+
+static SearchResponse* createResponse(SearchEngine *engine, RankingOptions *options) {
+    SearchResponse *response = (SearchResponse *)malloc(sizeof(SearchResponse));
+    response->engine = engine;
+    response->hits = NULL;
+    response->hitCount = 0;
+    response->options = *options;
+    response->queryTerms = NULL;
+    response->queryTermCount = 0;
+    response->results = NULL;
+    response->breakdowns = NULL;
+    response->arena = arena_create(SEARCH_ARENA_BLOCK);
+    return response;
+}
+
+SearchResponse* searchengine_execute(SearchEngine *engine, SearchRequest *request) {
+    if (!request || !request->query) return NULL;
+
+    int useBM25 = request->rankingAlgorithm && strcmp(request->rankingAlgorithm, "bm25") == 0;
+    int limit = request->limit > 0 ? request->limit : DEFAULT_SEARCH_LIMIT;
+    RankingOptions options;
+    strcpy(options.algorithm, useBM25 ? "bm25" : "tfidf");
+    options.filenameBoost = 2.0;
+    options.exactMatchBoost = 1.5;
+    options.recencyWeight = 0.1;
+    options.fileSizeWeight = 0.05;
+    options.offset = request->offset > 0 ? request->offset : 0;
+    options.maxResults = options.offset + limit;
+    options.rerankDepth = request->rerankDepth > 0 ? request->rerankDepth : 0;
+    options.now = 0;
+    options.reranked = 0;
+    options.hasCursor = 0;
+    options.cursorScore = 0;
+    options.cursorDocId = 0;
+    if (request->searchAfter && !ranking_parseCursor(request->searchAfter, &options)) return NULL;
+
+    int malformed;
+    QueryNode *root = queryparser_parse(request->query, &malformed);
+    if (malformed) return NULL;
+    if (!root) return createResponse(engine, &options);
+
+    SearchFilter filter;
+    PlanNode *plan = planSearch(engine, request, root, &filter);
+    if (!plan) {
+        queryparser_free(root);
+        return createResponse(engine, &options);
+    }
+
+    EvalContext ctx;
+    ctx.engine = engine;
+    ctx.useBM25 = useBM25;
+    // Filename hits are weighted inside the index scores rather than boosted afterwards
+    ctx.filenameWeight = options.filenameBoost;
+    ctx.filter = &filter;
+    ctx.filterDocs = NULL;
+    ctx.filterCount = 0;
+    int *filterDocs = NULL;
+    if (filter.docs && queryplan_usesStrategy(plan, STRATEGY_FILTER_DRIVEN)) {
+        filterDocs = bitmap_toArray(filter.docs, &ctx.filterCount);
+        ctx.filterDocs = filterDocs;
+    }
+
+    DocList matches;
+    evaluate(&ctx, plan, &matches);
+    double *scores = (double *)calloc(engine->fileCount + 1, sizeof(double));
+    for (int i = 0; i < matches.count; i++) {
+        scores[matches.docIds[i]] = matches.scores[i];
+    }
+    docListFree(&matches);
+
+    // A lone word or phrase also matches filenames holding it mid-word
+    int rootFields = root->fields ? root->fields : requestFields(request);
+    if ((root->type == QUERY_TERM || root->type == QUERY_PHRASE) && (rootFields & FIELD_FILENAME) &&
+        strlen(root->text) >= 3) {
+        int maxDistance = request->fuzzy && strlen(root->text) >= 6 ? 1 : 0;
+        int matchCount;
+        int *filenameMatches = searchengine_findFilenames(engine, root->text, maxDistance, &matchCount);
+        for (int i = 0; i < matchCount; i++) {
+            int docId = filenameMatches[i];
+            if (scores[docId] == 0 && passesFilter(engine, &filter, docId)) {
+                scores[docId] = FILENAME_SUBSTRING_SCORE;
+            }
+        }
+        free(filenameMatches);
+    }
+
+    // Exact matches and highlights follow what the query asks for, not its syntax
+    PlanContext planContext;
+    initPlanContext(engine, request, &planContext);
+    int groupCount = 0;
+    int groupCapacity = 8;
+    MatchGroup *groups = (MatchGroup *)malloc(sizeof(MatchGroup) * groupCapacity);
+    collectMatchGroups(&planContext, root, &groups, &groupCount, &groupCapacity);
+
+    int hitCount;
+    RankedHit *hits = ranking_rankResults(engine->ranking, engine->files, engine->fileCount,
+                                          groups, groupCount, scores, NULL, 0, &options, &hitCount);
+    SearchResponse *response = createResponse(engine, &options);
+    response->hits = hits;
+    response->hitCount = hitCount;
+    response->queryTerms = snippetTerms(groups, groupCount, &response->queryTermCount);
+    freeMatchGroups(groups, groupCount);
+    response->results = (SearchResult **)calloc(hitCount + 1, sizeof(SearchResult *));
+    response->breakdowns = (RankingBreakdown **)calloc(hitCount + 1, sizeof(RankingBreakdown *));
+
+    free(scores);
+    free(filterDocs);
+    bitmap_free(filter.docs);
+    queryplan_free(plan);
+    queryparser_free(root);
+    return response;
+}
+
+SearchResult* searchresponse_result(SearchResponse *response, int i) {
+    if (i < 0 || i >= response->hitCount) return NULL;
+    if (response->results[i]) return response->results[i];
+    const RankedHit *hit = &response->hits[i];
+    File *file = &response->engine->files[hit->docId];
+    if (!file->id) return NULL;
+
+    Arena *arena = response->arena;
+    SearchResult *result = (SearchResult *)arena_alloc(arena, sizeof(SearchResult));
+    result->docId = hit->docId;
+    ranking_formatCursor(result->cursor, hit->score, hit->docId, response->options.now);
+    result->fileId = arena_strdup(arena, file->id);
+    result->filename = arena_strdup(arena, file->filename);
+    result->type = arena_strdup(arena, file->type);
+    result->relevanceScore = hit->score;
+    result->matchedInFilename = hit->exactFilenameMatch;
+    result->matchedInContent = hit->exactContentMatch;
+    result->uploadedAt = file->uploadedAt;
+    strcpy(result->matchType, (hit->exactFilenameMatch || hit->exactContentMatch) ? "exact" : "partial");
+
+    Snippet *snippet = snippet_create(file->content, response->queryTerms, response->queryTermCount,
+                                      SNIPPET_WINDOW_SIZE);
+    result->contentSnippet = arena_strdup(arena, snippet->text);
+    result->highlightedSnippet = arena_strdup(arena, snippet->highlighted);
+    result->highlights = (HighlightRange *)arena_copy(arena, snippet->highlights,
+                                                      sizeof(HighlightRange) * snippet->highlightCount);
+    result->highlightCount = snippet->highlightCount;
+    snippet_free(snippet);
+
+    result->rankingBreakdown = response->breakdowns[i];
+    response->results[i] = result;
+    return result;
+}
+
+RankingBreakdown* searchresponse_explain(SearchResponse *response, int i) {
+    if (i < 0 || i >= response->hitCount) return NULL;
+    if (!response->breakdowns[i]) {
+        RankingBreakdown *breakdown = (RankingBreakdown *)arena_alloc(response->arena, sizeof(RankingBreakdown));
+        ranking_explain(response->engine->ranking, &response->hits[i], &response->options, breakdown);
+        response->breakdowns[i] = breakdown;
+        if (response->results[i]) response->results[i]->rankingBreakdown = breakdown;
+    }
+    return response->breakdowns[i];
+}
+
+void searchresponse_free(SearchResponse *response) {
+    if (!response) return;
+    for (int i = 0; i < response->queryTermCount; i++) {
+        free(response->queryTerms[i]);
+    }
+    free(response->queryTerms);
+    free(response->hits);
+    free(response->results);
+    free(response->breakdowns);
+    arena_free(response->arena);
+    free(response);
+}
+
+static char* copyString(const char *text) {
+    char *copy = (char *)malloc(strlen(text) + 1);
+    strcpy(copy, text);
+    return copy;
 }
 
 SearchResult* searchengine_search(SearchEngine *engine, SearchRequest *request, int *resultCount) {
-    // Simplified implementation
-    return NULL;
+    *resultCount = 0;
+    SearchResponse *response = searchengine_execute(engine, request);
+    if (!response) return NULL;
+
+    SearchResult *results = (SearchResult *)malloc(sizeof(SearchResult) * (response->hitCount + 1));
+    for (int i = 0; i < response->hitCount; i++) {
+        SearchResult *view = searchresponse_result(response, i);
+        if (!view) continue;
+        SearchResult *result = &results[(*resultCount)++];
+        *result = *view;
+        result->fileId = copyString(view->fileId);
+        result->filename = copyString(view->filename);
+        result->type = copyString(view->type);
+        result->contentSnippet = copyString(view->contentSnippet);
+        result->highlightedSnippet = copyString(view->highlightedSnippet);
+        result->highlights = (HighlightRange *)malloc(sizeof(HighlightRange) * (view->highlightCount + 1));
+        memcpy(result->highlights, view->highlights, sizeof(HighlightRange) * view->highlightCount);
+        result->rankingBreakdown = (RankingBreakdown *)malloc(sizeof(RankingBreakdown));
+        *result->rankingBreakdown = *searchresponse_explain(response, i);
+    }
+    searchresponse_free(response);
+    return results;
 }
 
+char* searchengine_explain(SearchEngine *engine, SearchRequest *request) {
+    if (!request || !request->query) return NULL;
+    int malformed;
+    QueryNode *root = queryparser_parse(request->query, &malformed);
+    if (!root) {
+        const char *message = malformed ? "unbalanced parentheses\n" : "empty query\n";
+        char *text = (char *)malloc(strlen(message) + 1);
+        strcpy(text, message);
+        return text;
+    }
+
+    SearchFilter filter;
+    PlanNode *plan = planSearch(engine, request, root, &filter);
+    queryparser_free(root);
+    if (!plan) {
+        char *text = (char *)malloc(32);
+        strcpy(text, "filter matches nothing\n");
+        return text;
+    }
+
+    char header[96];
+    if (filter.docs) {
+        snprintf(header, sizeof(header), "filter docs=%d%s\n", bitmap_cardinality(filter.docs),
+                 filter.checkDates ? " dates=per-posting" : "");
+    } else {
+        snprintf(header, sizeof(header), "filter %s\n", filter.checkDates ? "dates=per-posting" : "none");
+    }
+    char *body = queryplan_explain(plan, engine->invertedIndex);
+    char *text = (char *)malloc(strlen(header) + strlen(body) + 1);
+    strcpy(text, header);
+    strcat(text, body);
+
+    free(body);
+    bitmap_free(filter.docs);
+    queryplan_free(plan);
+    return text;
+}
+
+static void addSuggestion(AutocompleteSuggestion *suggestion, const char *text, const char *type,
+                          int frequency) {
+    suggestion->text = (char *)malloc(strlen(text) + 1);
+    strcpy(suggestion->text, text);
+    suggestion->type = (char *)malloc(strlen(type) + 1);
+    strcpy(suggestion->type, type);
+    suggestion->frequency = frequency;
+}
+
+// Completions come straight from the index dictionary: terms seen in a
+// filename first, then terms only found in content
 AutocompleteSuggestion* searchengine_getAutocompleteSuggestions(SearchEngine *engine,
                                                                 const char *query, int *count) {
     AutocompleteSuggestion *suggestions = 
         (AutocompleteSuggestion *)malloc(sizeof(AutocompleteSuggestion) * 10);
     *count = 0;
 
-    int filenameWordCount;
-    char **filenameWords = trie_startsWith(engine->filenameTrie, query, &filenameWordCount);
-    
-    for (int i = 0; i < filenameWordCount && *count < 10; i++) {
-        suggestions[*count].text = (char *)malloc(strlen(filenameWords[i]) + 1);
-        strcpy(suggestions[*count].text, filenameWords[i]);
-        suggestions[*count].type = (char *)malloc(9);
-        strcpy(suggestions[*count].type, "filename");
-        suggestions[*count].frequency = 1;
-        (*count)++;
-        free(filenameWords[i]);
-    }
-    free(filenameWords);
-
-    int contentWordCount;
-    char **contentWords = trie_startsWith(engine->contentTrie, query, &contentWordCount);
-    
-    for (int i = 0; i < contentWordCount && *count < 10; i++) {
-        suggestions[*count].text = (char *)malloc(strlen(contentWords[i]) + 1);
-        strcpy(suggestions[*count].text, contentWords[i]);
-        suggestions[*count].type = (char *)malloc(8);
-        strcpy(suggestions[*count].type, "content");
-        (*count)++;
-        free(contentWords[i]);
-    }
-    free(contentWords);
+    InvertedIndex *index = engine->invertedIndex;
+    int first;
+    int termCount = invertedindex_prefixRange(index, query, &first);
+
+    for (int i = first; i < first + termCount && *count < 10; i++) {
+        int termId = index->sortedTerms[i];
+        if (index->filenamePostings[termId] == 0) continue;
+        addSuggestion(&suggestions[(*count)++], index->terms[termId], "filename",
+                      index->filenamePostings[termId]);
+    }
+    for (int i = first; i < first + termCount && *count < 10; i++) {
+        int termId = index->sortedTerms[i];
+        if (index->postingCounts[termId] == 0 || index->filenamePostings[termId] > 0) continue;
+        addSuggestion(&suggestions[(*count)++], index->terms[termId], "content",
+                      index->postingCounts[termId]);
+    }
 
     return suggestions;
 }
 
+int* searchengine_findFilenames(SearchEngine *engine, const char *query, int maxDistance, int *count) {
+    size_t queryLen = strlen(query);
+    int candidateCount;
+    int *candidates = trigramindex_getCandidates(engine->filenameTrigrams, query,
+                                                 maxDistance, &candidateCount);
+    int scanAll = candidateCount < 0;
+    int total = scanAll ? engine->mapCount : candidateCount;
+
+    int *matches = (int *)malloc(sizeof(int) * (total > 0 ? total : 1));
+    *count = 0;
+    for (int i = 0; i < total; i++) {
+        int docId = scanAll ? i : candidates[i];
+        const char *filename = engine->filenameToIdMap[docId];
+        if (!filename) continue;
+        int matched = maxDistance > 0 ?
+                      fuzzy_substringDistance(query, filename, maxDistance) <= maxDistance :
+                      strsearch_find(filename, strlen(filename), query, queryLen) != NULL;
+        if (matched) matches[(*count)++] = docId;
+    }
+
+    free(candidates);
+    return matches;
+}
+
+int searchengine_loadReranker(SearchEngine *engine, const char *path) {
+    if (!path) return ranking_setReranker(engine->ranking, NULL);
+    Reranker *model = reranker_load(path);
+    if (!model) return 0;
+    if (!ranking_setReranker(engine->ranking, model)) {
+        reranker_free(model);
+        return 0;
+    }
+    return 1;
+}
+
 void searchengine_removeFile(SearchEngine *engine, const char *fileId) {
     for (int i = 0; i < engine->fileCount; i++) {
-        if (strcmp(engine->files[i].id, fileId) == 0) {
-            for (int j = i; j < engine->fileCount - 1; j++) {
-                engine->files[j] = engine->files[j + 1];
+        if (engine->files[i].id && strcmp(engine->files[i].id, fileId) == 0) {
+            trigramindex_removeDocument(engine->filenameTrigrams, i, engine->filenameToIdMap[i]);
+            free(engine->filenameToIdMap[i]);
+            engine->filenameToIdMap[i] = NULL;
+            invertedindex_removeDocument(engine->invertedIndex, i);
+            ranking_removeDocument(engine->ranking, i);
+
+            TypeFilter *typeFilter = findTypeFilter(engine, engine->files[i].type, 0);
+            if (typeFilter) bitmap_remove(typeFilter->docs, i);
+            int at = lowerBoundTimestamp(engine, engine->files[i].uploadedAt, i);
+            if (at < engine->timestampCount && engine->timestamps[at].docId == i) {
+                memmove(&engine->timestamps[at], &engine->timestamps[at + 1],
+                        sizeof(TimestampEntry) * (engine->timestampCount - at - 1));
+                engine->timestampCount--;
+            }
+
+            engine->files[i].id = NULL;
+
+            // The n-gram counts cannot drop a document, so they are rebuilt
+            // from the live ones once enough removed text has piled up
+            engine->ngramStaleDocs++;
+            if ((long)engine->ngramStaleDocs * SEARCH_NGRAM_STALE_RATIO >= engine->timestampCount) {
+                ngram_clear(engine->ngrams);
+                for (int d = 0; d < engine->fileCount; d++) {
+                    if (engine->files[d].id) ngram_addText(engine->ngrams, engine->files[d].content);
+                }
+                engine->ngramStaleDocs = 0;
             }
-            engine->fileCount--;
             break;
         }
     }
-    invertedindex_removeDocument(engine->invertedIndex, fileId);
 }
 
 int searchengine_getIndexSize(SearchEngine *engine) {
     int size = 0;
     for (int i = 0; i < engine->fileCount; i++) {
+        if (!engine->files[i].id) continue;
         size += engine->files[i].size;
     }
     return size;
@@ -146,6 +1065,7 @@ int searchengine_getIndexSize(SearchEngine *engine) {
 int searchengine_getTotalWords(SearchEngine *engine) {
     int total = 0;
     for (int i = 0; i < engine->fileCount; i++) {
+        if (!engine->files[i].id) continue;
         int wordCount;
         char **words = tokenize(engine->files[i].content, &wordCount);
         total += wordCount;
@@ -159,8 +1079,6 @@ int searchengine_getTotalWords(SearchEngine *engine) {
 
 void searchengine_free(SearchEngine *engine) {
     if (!engine) return;
-    trie_free(engine->filenameTrie);
-    trie_free(engine->contentTrie);
     invertedindex_free(engine->invertedIndex);
     ranking_free(engine->ranking);
     fuzzy_free(engine->fuzzyMatcher);
@@ -168,7 +1086,14 @@ void searchengine_free(SearchEngine *engine) {
         free(engine->filenameToIdMap[i]);
     }
     free(engine->filenameToIdMap);
-    free(engine->filenameTokens);
+    trigramindex_free(engine->filenameTrigrams);
+    for (int i = 0; i < engine->typeFilterCount; i++) {
+        free(engine->typeFilters[i].type);
+        bitmap_free(engine->typeFilters[i].docs);
+    }
+    free(engine->typeFilters);
+    free(engine->timestamps);
+    ngram_free(engine->ngrams);
     free(engine->files);
     free(engine);
 }
\ No newline at end of file
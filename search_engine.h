@@ -2,34 +2,94 @@
 #define SEARCH_ENGINE_H
 
 #include "schema.h"
-#include "trie.h"
 #include "inverted_index.h"
 #include "ranking.h"
 #include "fuzzy.h"
+#include "trigram_index.h"
+#include "bitmap.h"
+#include "query_parser.h"
+#include "query_planner.h"
+#include "arena.h"
+#include "ngram.h"
+
+#define SEARCH_MAX_EXPANSIONS 64
+#define SEARCH_NGRAM_STALE_RATIO 4  // n-grams are rebuilt once removed documents
+                                    // reach 1/RATIO of the live ones
+
+typedef struct {
+    char *type;
+    Bitmap *docs;
+} TypeFilter;
+
+typedef struct {
+    long uploadedAt;
+    int docId;
+} TimestampEntry;
 
 typedef struct {
-    Trie *filenameTrie;
-    Trie *contentTrie;
     InvertedIndex *invertedIndex;
     Ranking *ranking;
     FuzzyMatcher *fuzzyMatcher;
     File *files;
     int fileCount;
+    int fileCapacity;            // of files, filenameToIdMap and timestamps
     char **filenameToIdMap;
     int mapCount;
-    char **filenameTokens;
-    int tokenCount;
+    TrigramIndex *filenameTrigrams;
+    TypeFilter *typeFilters;     // one docId bitmap per distinct file type
+    int typeFilterCount;
+    int typeFilterCapacity;
+    TimestampEntry *timestamps;  // live docs ordered by (uploadedAt, docId)
+    int timestampCount;
+    int maxExpansions;           // terms a prefix or wildcard may expand to
+    NgramModel *ngrams;          // word sequences of indexed content, for next-word suggestions
+    int ngramStaleDocs;          // removed documents still counted in ngrams
 } SearchEngine;
 
 SearchEngine* searchengine_create(void);
 
 void searchengine_indexFile(SearchEngine *engine, File *file);
 
+// The ranked hits of one request. Result fields and snippets are built only
+// for the hits a caller reads, inside the response's arena, and the score
+// breakdown only when explained; searchresponse_free releases all of it.
+typedef struct {
+    SearchEngine *engine;
+    RankedHit *hits;
+    int hitCount;
+    RankingOptions options;      // as ranked, for cursors and explain
+    char **queryTerms;           // snippet terms
+    int queryTermCount;
+    SearchResult **results;      // materialized on first access
+    RankingBreakdown **breakdowns;
+    Arena *arena;
+} SearchResponse;
+
+// NULL when the request carries a malformed cursor or a query whose
+// parentheses do not pair up
+SearchResponse* searchengine_execute(SearchEngine *engine, SearchRequest *request);
+// NULL when i is out of range or the file was removed since the search ran
+SearchResult* searchresponse_result(SearchResponse *response, int i);
+RankingBreakdown* searchresponse_explain(SearchResponse *response, int i);
+void searchresponse_free(SearchResponse *response);
+
+// Standalone copies of every hit with its breakdown, freed by free_search_results
 SearchResult* searchengine_search(SearchEngine *engine, SearchRequest *request, int *resultCount);
 
+// The operator tree searchengine_search would run for this request, with the
+// strategy, cardinality estimate and cost chosen for each operator
+char* searchengine_explain(SearchEngine *engine, SearchRequest *request);
+
+// Ranks with the tree ensemble in path (see reranker.h) from now on, reading
+// the RANKING_FEATURE_* row; NULL goes back to the hand-tuned score. Returns 0
+// and keeps the current ranking when the model cannot be loaded.
+int searchengine_loadReranker(SearchEngine *engine, const char *path);
+
 AutocompleteSuggestion* searchengine_getAutocompleteSuggestions(SearchEngine *engine,
                                                                 const char *query, int *count);
 
+int* searchengine_findFilenames(SearchEngine *engine, const char *query, int maxDistance, int *count);
+
 void searchengine_removeFile(SearchEngine *engine, const char *fileId);
 
 int searchengine_getIndexSize(SearchEngine *engine);
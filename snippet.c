@@ -0,0 +1,178 @@
+#include "snippet.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+
+typedef struct {
+    int offset;
+    int length;
+    int term;
+} TermHit;
+
+static int isWordChar(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+static uint32_t foldHash(uint32_t hash, char c) {
+    return (hash ^ (unsigned char)tolower((unsigned char)c)) * 16777619u;
+}
+
+static int equalsFolded(const char *text, const char *term, int length) {
+    for (int i = 0; i < length; i++) {
+        if (tolower((unsigned char)text[i]) != (unsigned char)term[i]) return 0;
+    }
+    return 1;
+}
+
+static TermHit* findHits(const char *content, int contentLen, char **queryTerms, int termCount,
+                         int *hitCount) {
+    uint32_t *termHashes = (uint32_t *)malloc(sizeof(uint32_t) * (termCount + 1));
+    int *termLengths = (int *)malloc(sizeof(int) * (termCount + 1));
+    for (int t = 0; t < termCount; t++) {
+        uint32_t hash = 2166136261u;
+        for (int i = 0; queryTerms[t][i]; i++) hash = foldHash(hash, queryTerms[t][i]);
+        termHashes[t] = hash;
+        termLengths[t] = strlen(queryTerms[t]);
+    }
+
+    int capacity = 16;
+    TermHit *hits = (TermHit *)malloc(sizeof(TermHit) * capacity);
+    *hitCount = 0;
+
+    uint32_t hash = 2166136261u;
+    int wordStart = -1;
+    for (int i = 0; i <= contentLen; i++) {
+        if (i < contentLen && isWordChar(content[i])) {
+            if (wordStart < 0) {
+                wordStart = i;
+                hash = 2166136261u;
+            }
+            hash = foldHash(hash, content[i]);
+            continue;
+        }
+        if (wordStart < 0) continue;
+
+        int length = i - wordStart;
+        for (int t = 0; t < termCount; t++) {
+            if (termHashes[t] != hash || termLengths[t] != length) continue;
+            if (!equalsFolded(content + wordStart, queryTerms[t], length)) continue;
+            if (*hitCount == capacity) {
+                capacity *= 2;
+                hits = (TermHit *)realloc(hits, sizeof(TermHit) * capacity);
+            }
+            hits[*hitCount].offset = wordStart;
+            hits[*hitCount].length = length;
+            hits[*hitCount].term = t;
+            (*hitCount)++;
+            break;
+        }
+        wordStart = -1;
+    }
+
+    free(termHashes);
+    free(termLengths);
+    return hits;
+}
+
+static char* escapeMarkup(char *out, const char *text, int length) {
+    for (int i = 0; i < length; i++) {
+        switch (text[i]) {
+            case '&': memcpy(out, "&amp;", 5); out += 5; break;
+            case '<': memcpy(out, "&lt;", 4); out += 4; break;
+            case '>': memcpy(out, "&gt;", 4); out += 4; break;
+            default: *out++ = text[i]; break;
+        }
+    }
+    return out;
+}
+
+Snippet* snippet_create(const char *content, char **queryTerms, int termCount, int windowSize) {
+    int contentLen = strlen(content);
+    int hitCount;
+    TermHit *hits = findHits(content, contentLen, queryTerms, termCount, &hitCount);
+
+    // Slide over the hits, keeping the span that covers the most distinct terms
+    int bestFirst = 0, bestLast = -1, bestDistinct = 0, bestHits = 0;
+    int *inWindow = (int *)calloc(termCount + 1, sizeof(int));
+    int distinct = 0;
+    for (int first = 0, last = 0; last < hitCount; last++) {
+        if (inWindow[hits[last].term]++ == 0) distinct++;
+        while (first < last && hits[last].offset + hits[last].length - hits[first].offset > windowSize) {
+            if (--inWindow[hits[first].term] == 0) distinct--;
+            first++;
+        }
+        int windowHits = last - first + 1;
+        if (distinct > bestDistinct || (distinct == bestDistinct && windowHits > bestHits)) {
+            bestDistinct = distinct;
+            bestHits = windowHits;
+            bestFirst = first;
+            bestLast = last;
+        }
+    }
+    free(inWindow);
+
+    int start = 0;
+    if (bestLast >= 0) {
+        int spanStart = hits[bestFirst].offset;
+        int spanEnd = hits[bestLast].offset + hits[bestLast].length;
+        start = spanStart - (windowSize - (spanEnd - spanStart)) / 2;
+        if (start + windowSize > contentLen) start = contentLen - windowSize;
+        if (start < 0) start = 0;
+        // Don't open the excerpt in the middle of a word
+        while (start > 0 && start < spanStart && isWordChar(content[start - 1])) start++;
+    }
+    int end = start + windowSize < contentLen ? start + windowSize : contentLen;
+    int keepUntil = bestLast >= 0 ? hits[bestLast].offset + hits[bestLast].length : start;
+    while (end < contentLen && end > keepUntil && isWordChar(content[end])) end--;
+    int lead = start > 0 ? 3 : 0;
+    int trail = end < contentLen ? 3 : 0;
+
+    Snippet *snippet = (Snippet *)malloc(sizeof(Snippet));
+    snippet->text = (char *)malloc(lead + (end - start) + trail + 1);
+    char *out = snippet->text;
+    if (lead) { memcpy(out, "...", 3); out += 3; }
+    memcpy(out, content + start, end - start);
+    out += end - start;
+    if (trail) { memcpy(out, "...", 3); out += 3; }
+    *out = '\0';
+
+    int inside = 0;
+    for (int h = 0; h < hitCount; h++) {
+        if (hits[h].offset >= start && hits[h].offset + hits[h].length <= end) inside++;
+    }
+    snippet->highlights = (HighlightRange *)malloc(sizeof(HighlightRange) * (inside + 1));
+    snippet->highlightCount = 0;
+
+    // Worst case every byte is '&' (5 bytes escaped) plus 7 bytes of tags per hit
+    snippet->highlighted = (char *)malloc(lead + (end - start) * 5 + inside * 7 + trail + 1);
+    out = snippet->highlighted;
+    if (lead) { memcpy(out, "...", 3); out += 3; }
+    int cursor = start;
+    for (int h = 0; h < hitCount; h++) {
+        if (hits[h].offset < start || hits[h].offset + hits[h].length > end) continue;
+        snippet->highlights[snippet->highlightCount].start = lead + hits[h].offset - start;
+        snippet->highlights[snippet->highlightCount].length = hits[h].length;
+        snippet->highlightCount++;
+
+        out = escapeMarkup(out, content + cursor, hits[h].offset - cursor);
+        memcpy(out, "<b>", 3); out += 3;
+        out = escapeMarkup(out, content + hits[h].offset, hits[h].length);
+        memcpy(out, "</b>", 4); out += 4;
+        cursor = hits[h].offset + hits[h].length;
+    }
+    out = escapeMarkup(out, content + cursor, end - cursor);
+    if (trail) { memcpy(out, "...", 3); out += 3; }
+    *out = '\0';
+
+    free(hits);
+    return snippet;
+}
+
+void snippet_free(Snippet *snippet) {
+    if (!snippet) return;
+    free(snippet->text);
+    free(snippet->highlighted);
+    free(snippet->highlights);
+    free(snippet);
+}
@@ -0,0 +1,20 @@
+#ifndef SNIPPET_H
+#define SNIPPET_H
+
+#include "schema.h"
+
+#define SNIPPET_WINDOW_SIZE 200
+
+typedef struct {
+    char *text;              // plain excerpt, with "..." where it was cut
+    char *highlighted;       // excerpt with matches wrapped in <b></b>, markup-escaped
+    HighlightRange *highlights; // match offsets within text
+    int highlightCount;
+} Snippet;
+
+// Picks the window of content holding the most distinct query terms (then the
+// most hits) in a single pass; content is never copied or lowercased whole.
+Snippet* snippet_create(const char *content, char **queryTerms, int termCount, int windowSize);
+void snippet_free(Snippet *snippet);
+
+#endif
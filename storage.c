@@ -1,27 +1,104 @@
 #include "storage.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <uuid/uuid.h>
 
+// Marks a removed key, so probes for keys inserted after it keep going
+#define ID_SLOT_DELETED -1
+// Set in a history slot's sequence while its writer is filling it in
+#define HISTORY_WRITING (~(~0UL >> 1))
+
+static uint64_t hashId(const char *id) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; id[i]; i++) {
+        hash ^= (unsigned char)id[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int countWords(const char *content) {
+    int wordCount = 0;
+    for (int i = 0; content[i]; i++) {
+        if (content[i] == ' ' || content[i] == '\n') wordCount++;
+    }
+    return wordCount;
+}
+
 Storage* storage_create(void) {
     Storage *storage = (Storage *)malloc(sizeof(Storage));
-    storage->files = (File *)malloc(sizeof(File) * 10000);
+    storage->files = (File *)malloc(sizeof(File) * STORAGE_MAX_FILES);
     storage->fileCount = 0;
-    storage->history = (SearchHistory *)malloc(sizeof(SearchHistory) * 1000);
-    storage->historyCount = 0;
+    storage->slotCount = 0;
+    storage->freeSlots = (int *)malloc(sizeof(int) * STORAGE_MAX_FILES);
+    storage->freeCount = 0;
+    storage->idSlotCapacity = 1024;
+    storage->idSlots = (int *)calloc(storage->idSlotCapacity, sizeof(int));
+    storage->idSlotsUsed = 0;
+    storage->lastIndexed = 0;
+    storage->history = (HistorySlot *)malloc(sizeof(HistorySlot) * SEARCH_HISTORY_CAPACITY);
+    for (int i = 0; i < SEARCH_HISTORY_CAPACITY; i++) {
+        atomic_init(&storage->history[i].sequence, 0);
+    }
+    atomic_init(&storage->historyHead, 0);
+    storage->historyDrained = 0;
+    atomic_flag_clear(&storage->draining);
+    storage->popularity = popularity_create();
     storage->indexSize = 0;
     storage->totalWords = 0;
     return storage;
 }
 
+// Position of id in idSlots, or -1 when absent
+static int findIdSlot(Storage *storage, const char *id) {
+    int mask = storage->idSlotCapacity - 1;
+    int at = (int)(hashId(id) & mask);
+    while (storage->idSlots[at]) {
+        int slot = storage->idSlots[at] - 1;
+        if (slot >= 0 && strcmp(storage->files[slot].id, id) == 0) return at;
+        at = (at + 1) & mask;
+    }
+    return -1;
+}
+
+static void insertId(Storage *storage, int slot) {
+    int mask = storage->idSlotCapacity - 1;
+    int at = (int)(hashId(storage->files[slot].id) & mask);
+    while (storage->idSlots[at] > 0) at = (at + 1) & mask;
+    if (storage->idSlots[at] == 0) storage->idSlotsUsed++;
+    storage->idSlots[at] = slot + 1;
+}
+
+// Rebuilds the table from the live files, dropping removed keys and growing
+// it until live keys fill less than half of it
+static void rehashIds(Storage *storage) {
+    while (storage->fileCount * 2 >= storage->idSlotCapacity) storage->idSlotCapacity *= 2;
+    free(storage->idSlots);
+    storage->idSlots = (int *)calloc(storage->idSlotCapacity, sizeof(int));
+    storage->idSlotsUsed = 0;
+    for (int slot = 0; slot < storage->slotCount; slot++) {
+        if (storage->files[slot].id) insertId(storage, slot);
+    }
+}
+
 File* storage_addFile(Storage *storage, const char *filename, const char *content,
                       int size, const char *type) {
+    int slot;
+    if (storage->freeCount > 0) {
+        slot = storage->freeSlots[--storage->freeCount];
+    } else if (storage->slotCount < STORAGE_MAX_FILES) {
+        slot = storage->slotCount++;
+    } else {
+        return NULL;
+    }
+
     uuid_t uuid;
     uuid_generate(uuid);
     char uuidStr[37];
     uuid_unparse(uuid, uuidStr);
 
-    File *file = &storage->files[storage->fileCount];
+    File *file = &storage->files[slot];
     file->id = (char *)malloc(37);
     strcpy(file->id, uuidStr);
     file->filename = (char *)malloc(strlen(filename) + 1);
@@ -34,55 +111,45 @@ File* storage_addFile(Storage *storage, const char *filename, const char *conten
     file->uploadedAt = time(NULL) * 1000;
 
     storage->fileCount++;
-    storage->indexSize += size;
+    insertId(storage, slot);
+    if (storage->idSlotsUsed * 2 >= storage->idSlotCapacity) rehashIds(storage);
 
-    int wordCount = 0;
-    for (int i = 0; content[i]; i++) {
-        if (content[i] == ' ' || content[i] == '\n') wordCount++;
-    }
-    storage->totalWords += wordCount;
+    storage->indexSize += size;
+    storage->totalWords += countWords(content);
+    storage->lastIndexed = file->uploadedAt;
 
     return file;
 }
 
 File* storage_getFile(Storage *storage, const char *id) {
-    for (int i = 0; i < storage->fileCount; i++) {
-        if (strcmp(storage->files[i].id, id) == 0) {
-            return &storage->files[i];
-        }
-    }
-    return NULL;
+    int at = findIdSlot(storage, id);
+    return at < 0 ? NULL : &storage->files[storage->idSlots[at] - 1];
 }
 
 File* storage_getAllFiles(Storage *storage, int *count) {
-    *count = storage->fileCount;
+    *count = storage->slotCount;
     return storage->files;
 }
 
 int storage_deleteFile(Storage *storage, const char *id) {
-    for (int i = 0; i < storage->fileCount; i++) {
-        if (strcmp(storage->files[i].id, id) == 0) {
-            storage->indexSize -= storage->files[i].size;
-            
-            int wordCount = 0;
-            for (int j = 0; storage->files[i].content[j]; j++) {
-                if (storage->files[i].content[j] == ' ') wordCount++;
-            }
-            storage->totalWords -= wordCount;
-
-            free(storage->files[i].id);
-            free(storage->files[i].filename);
-            free(storage->files[i].content);
-            free(storage->files[i].type);
-
-            for (int j = i; j < storage->fileCount - 1; j++) {
-                storage->files[j] = storage->files[j + 1];
-            }
-            storage->fileCount--;
-            return 1;
-        }
-    }
-    return 0;
+    int at = findIdSlot(storage, id);
+    if (at < 0) return 0;
+    int slot = storage->idSlots[at] - 1;
+    storage->idSlots[at] = ID_SLOT_DELETED;
+
+    File *file = &storage->files[slot];
+    storage->indexSize -= file->size;
+    storage->totalWords -= countWords(file->content);
+
+    free(file->id);
+    free(file->filename);
+    free(file->content);
+    free(file->type);
+    memset(file, 0, sizeof(File));
+
+    storage->freeSlots[storage->freeCount++] = slot;
+    storage->fileCount--;
+    return 1;
 }
 
 SearchStats* storage_getStats(Storage *storage) {
@@ -90,36 +157,99 @@ SearchStats* storage_getStats(Storage *storage) {
     stats->totalFiles = storage->fileCount;
     stats->totalWords = storage->totalWords;
     stats->indexSize = storage->indexSize;
-    stats->lastIndexed = storage->fileCount > 0 ? storage->files[storage->fileCount - 1].uploadedAt : 0;
+    stats->lastIndexed = storage->fileCount > 0 ? storage->lastIndexed : 0;
     return stats;
 }
 
-void storage_addSearchHistory(Storage *storage, const char *query, int resultsCount) {
-    if (storage->historyCount >= 1000) {
-        for (int i = 0; i < 999; i++) {
-            storage->history[i] = storage->history[i + 1];
+// Copies the entry written under ticket into *out, or returns 0 when the slot
+// is still being written or a later search has already overwritten it
+static int readHistorySlot(Storage *storage, unsigned long ticket, HistorySlot *out) {
+    HistorySlot *slot = &storage->history[ticket % SEARCH_HISTORY_CAPACITY];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != ticket + 1) return 0;
+    out->timestamp = slot->timestamp;
+    out->resultsCount = slot->resultsCount;
+    memcpy(out->query, slot->query, SEARCH_HISTORY_QUERY_LENGTH);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->sequence, memory_order_relaxed) == ticket + 1;
+}
+
+// Feeds searches not yet counted into popularity. Only one caller drains at a
+// time; the others return straight away and leave their entries to it or to
+// the next caller.
+static void drainHistory(Storage *storage) {
+    if (atomic_flag_test_and_set_explicit(&storage->draining, memory_order_acquire)) return;
+    unsigned long head = atomic_load_explicit(&storage->historyHead, memory_order_acquire);
+    if (head - storage->historyDrained > SEARCH_HISTORY_CAPACITY) {
+        storage->historyDrained = head - SEARCH_HISTORY_CAPACITY;
+    }
+    while (storage->historyDrained < head) {
+        unsigned long ticket = storage->historyDrained;
+        HistorySlot entry;
+        if (!readHistorySlot(storage, ticket, &entry)) {
+            unsigned long sequence = atomic_load_explicit(
+                &storage->history[ticket % SEARCH_HISTORY_CAPACITY].sequence, memory_order_acquire);
+            // Not written yet: pick it up next time
+            if ((sequence & ~HISTORY_WRITING) <= ticket + 1) break;
+            // Overwritten by a later lap: it is lost to the counts
+            storage->historyDrained++;
+            continue;
         }
-        storage->historyCount = 999;
+        popularity_record(storage->popularity, entry.query, entry.timestamp);
+        storage->historyDrained++;
     }
+    atomic_flag_clear_explicit(&storage->draining, memory_order_release);
+}
 
-    SearchHistory *hist = &storage->history[storage->historyCount];
-    hist->query = (char *)malloc(strlen(query) + 1);
-    strcpy(hist->query, query);
-    hist->timestamp = time(NULL) * 1000;
-    hist->resultsCount = resultsCount;
+void storage_addSearchHistory(Storage *storage, const char *query, int resultsCount) {
+    unsigned long ticket = atomic_fetch_add_explicit(&storage->historyHead, 1, memory_order_relaxed);
+    HistorySlot *slot = &storage->history[ticket % SEARCH_HISTORY_CAPACITY];
 
-    storage->historyCount++;
+    // A writer a whole lap behind or ahead may hold the same slot; rather than
+    // wait for it, the older search is dropped
+    unsigned long seen = atomic_load_explicit(&slot->sequence, memory_order_relaxed);
+    do {
+        if ((seen & HISTORY_WRITING) || seen >= ticket + 1) return;
+    } while (!atomic_compare_exchange_weak_explicit(&slot->sequence, &seen, (ticket + 1) | HISTORY_WRITING,
+                                                    memory_order_acquire, memory_order_relaxed));
+    atomic_thread_fence(memory_order_release);
+    strncpy(slot->query, query, SEARCH_HISTORY_QUERY_LENGTH - 1);
+    slot->query[SEARCH_HISTORY_QUERY_LENGTH - 1] = '\0';
+    slot->timestamp = time(NULL) * 1000;
+    slot->resultsCount = resultsCount;
+    atomic_store_explicit(&slot->sequence, ticket + 1, memory_order_release);
+
+    drainHistory(storage);
 }
 
 SearchHistory* storage_getSearchHistory(Storage *storage, int limit, int *count) {
-    *count = storage->historyCount < limit ? storage->historyCount : limit;
-    SearchHistory *result = (SearchHistory *)malloc(sizeof(SearchHistory) * (*count));
-    for (int i = 0; i < *count; i++) {
-        result[i] = storage->history[i];
+    unsigned long head = atomic_load_explicit(&storage->historyHead, memory_order_acquire);
+    unsigned long oldest = head > SEARCH_HISTORY_CAPACITY ? head - SEARCH_HISTORY_CAPACITY : 0;
+    int retained = (int)(head - oldest);
+    int wanted = retained < limit ? retained : limit;
+    if (wanted < 0) wanted = 0;
+
+    SearchHistory *result = (SearchHistory *)malloc(
+        (sizeof(SearchHistory) + SEARCH_HISTORY_QUERY_LENGTH) * (wanted > 0 ? wanted : 1));
+    char *queries = (char *)(result + wanted);
+    *count = 0;
+    for (unsigned long ticket = oldest; ticket < head && *count < wanted; ticket++) {
+        HistorySlot entry;
+        if (!readHistorySlot(storage, ticket, &entry)) continue;
+        char *query = queries + (size_t)*count * SEARCH_HISTORY_QUERY_LENGTH;
+        memcpy(query, entry.query, SEARCH_HISTORY_QUERY_LENGTH);
+        result[*count].query = query;
+        result[*count].timestamp = entry.timestamp;
+        result[*count].resultsCount = entry.resultsCount;
+        (*count)++;
     }
     return result;
 }
 
+int storage_getPopularQueries(Storage *storage, const char *prefix, PopularQuery *out, int max) {
+    drainHistory(storage);
+    return popularity_top(storage->popularity, prefix, time(NULL) * 1000, out, max);
+}
+
 void storage_setIndexSize(Storage *storage, int size) {
     storage->indexSize = size;
 }
@@ -130,16 +260,17 @@ void storage_setTotalWords(Storage *storage, int words) {
 
 void storage_free(Storage *storage) {
     if (!storage) return;
-    for (int i = 0; i < storage->fileCount; i++) {
+    for (int i = 0; i < storage->slotCount; i++) {
+        if (!storage->files[i].id) continue;
         free(storage->files[i].id);
         free(storage->files[i].filename);
         free(storage->files[i].content);
         free(storage->files[i].type);
     }
     free(storage->files);
-    for (int i = 0; i < storage->historyCount; i++) {
-        free(storage->history[i].query);
-    }
+    free(storage->freeSlots);
+    free(storage->idSlots);
     free(storage->history);
+    popularity_free(storage->popularity);
     free(storage);
 }
\ No newline at end of file
@@ -1,34 +1,71 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
+#include <stdatomic.h>
 #include "schema.h"
+#include "popularity.h"
 
+#define STORAGE_MAX_FILES 10000
+#define SEARCH_HISTORY_CAPACITY 1000
+#define SEARCH_HISTORY_QUERY_LENGTH 256   // longer queries are truncated
+
+// One ring entry. sequence is the ticket it was written under plus one, with
+// the top bit set while a writer is filling it in, so readers can tell a
+// stable entry from one being overwritten. 0 before the first write.
+typedef struct {
+    _Atomic unsigned long sequence;
+    long timestamp;
+    int resultsCount;
+    char query[SEARCH_HISTORY_QUERY_LENGTH];
+} HistorySlot;
+
+// Files live in fixed slots, so a File* stays valid until that file is
+// deleted. A deleted slot is left with id == NULL and reused by a later add.
 typedef struct {
     File *files;
-    int fileCount;
-    SearchHistory *history;
-    int historyCount;
+    int fileCount;       // live files
+    int slotCount;       // slots handed out, live or not
+    int *freeSlots;      // deleted slots, reused last-freed first
+    int freeCount;
+    int *idSlots;        // open-addressed id -> slot + 1, -1 where a key was removed
+    int idSlotCapacity;
+    int idSlotsUsed;     // live and deleted keys, which both lengthen probes
+    long lastIndexed;
+    HistorySlot *history;             // ring, ticket % SEARCH_HISTORY_CAPACITY
+    _Atomic unsigned long historyHead; // tickets handed out
+    unsigned long historyDrained;      // tickets already fed to popularity
+    atomic_flag draining;
+    Popularity *popularity;            // decayed heavy hitters of the history
     int indexSize;
     int totalWords;
 } Storage;
 
 Storage* storage_create(void);
 
+// NULL once STORAGE_MAX_FILES files are live
 File* storage_addFile(Storage *storage, const char *filename, const char *content,
                       int size, const char *type);
 
 File* storage_getFile(Storage *storage, const char *id);
 
+// All slotCount slots; deleted ones have id == NULL
 File* storage_getAllFiles(Storage *storage, int *count);
 
 int storage_deleteFile(Storage *storage, const char *id);
 
 SearchStats* storage_getStats(Storage *storage);
 
+// Safe to call from several threads at once; never blocks
 void storage_addSearchHistory(Storage *storage, const char *query, int resultsCount);
 
+// Up to limit of the retained searches, oldest first. The array and its query
+// strings are one allocation: free the array only.
 SearchHistory* storage_getSearchHistory(Storage *storage, int limit, int *count);
 
+// Up to max popular queries starting with prefix (NULL for all), most
+// searched first, without scanning the history
+int storage_getPopularQueries(Storage *storage, const char *prefix, PopularQuery *out, int max);
+
 void storage_setIndexSize(Storage *storage, int size);
 
 void storage_setTotalWords(Storage *storage, int words);
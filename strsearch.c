@@ -0,0 +1,89 @@
+#include "strsearch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static unsigned char foldByte(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c | 0x20) : c;
+}
+
+static int equalsFolded(const char *a, const char *b, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (foldByte((unsigned char)a[i]) != foldByte((unsigned char)b[i])) return 0;
+    }
+    return 1;
+}
+
+#if defined(__AVX2__)
+#define BLOCK_SIZE 32
+typedef __m256i ByteBlock;
+#define blockLoad(p) _mm256_loadu_si256((const __m256i *)(p))
+#define blockSet1(x) _mm256_set1_epi8((char)(x))
+#define blockAdd(a, b) _mm256_add_epi8((a), (b))
+#define blockLess(a, b) _mm256_cmpgt_epi8((b), (a))
+#define blockAnd(a, b) _mm256_and_si256((a), (b))
+#define blockOr(a, b) _mm256_or_si256((a), (b))
+#define blockEq(a, b) _mm256_cmpeq_epi8((a), (b))
+#define blockMask(v) (unsigned int)_mm256_movemask_epi8(v)
+#elif defined(__SSE2__)
+#define BLOCK_SIZE 16
+typedef __m128i ByteBlock;
+#define blockLoad(p) _mm_loadu_si128((const __m128i *)(p))
+#define blockSet1(x) _mm_set1_epi8((char)(x))
+#define blockAdd(a, b) _mm_add_epi8((a), (b))
+#define blockLess(a, b) _mm_cmplt_epi8((a), (b))
+#define blockAnd(a, b) _mm_and_si128((a), (b))
+#define blockOr(a, b) _mm_or_si128((a), (b))
+#define blockEq(a, b) _mm_cmpeq_epi8((a), (b))
+#define blockMask(v) (unsigned int)_mm_movemask_epi8(v)
+#endif
+
+#ifdef BLOCK_SIZE
+// Shifting by 0x80 - 'A' maps 'A'..'Z' onto the 26 smallest signed bytes,
+// so one signed compare finds the uppercase letters to OR with 0x20.
+static ByteBlock foldBlock(ByteBlock block) {
+    ByteBlock shifted = blockAdd(block, blockSet1(0x80 - 'A'));
+    ByteBlock upper = blockLess(shifted, blockSet1(0x80 + 26));
+    return blockOr(block, blockAnd(upper, blockSet1(0x20)));
+}
+#endif
+
+const char* strsearch_find(const char *haystack, size_t haystackLen,
+                           const char *needle, size_t needleLen) {
+    if (needleLen == 0) return haystack;
+    if (needleLen > haystackLen) return NULL;
+
+    unsigned char first = foldByte((unsigned char)needle[0]);
+    unsigned char last = foldByte((unsigned char)needle[needleLen - 1]);
+    size_t lastStart = haystackLen - needleLen;
+    size_t i = 0;
+
+#ifdef BLOCK_SIZE
+    ByteBlock firstBlock = blockSet1(first);
+    ByteBlock lastBlock = blockSet1(last);
+    for (; i + BLOCK_SIZE - 1 <= lastStart; i += BLOCK_SIZE) {
+        ByteBlock head = foldBlock(blockLoad(haystack + i));
+        ByteBlock tail = foldBlock(blockLoad(haystack + i + needleLen - 1));
+        unsigned int mask = blockMask(blockAnd(blockEq(head, firstBlock), blockEq(tail, lastBlock)));
+        while (mask) {
+            int bit = __builtin_ctz(mask);
+            if (needleLen <= 2 || equalsFolded(haystack + i + bit + 1, needle + 1, needleLen - 2)) {
+                return haystack + i + bit;
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; i <= lastStart; i++) {
+        if (foldByte((unsigned char)haystack[i]) == first &&
+            foldByte((unsigned char)haystack[i + needleLen - 1]) == last &&
+            equalsFolded(haystack + i, needle, needleLen)) {
+            return haystack + i;
+        }
+    }
+    return NULL;
+}
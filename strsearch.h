@@ -0,0 +1,12 @@
+#ifndef STRSEARCH_H
+#define STRSEARCH_H
+
+#include <stddef.h>
+
+// ASCII case-insensitive substring search that never allocates. Candidate
+// positions are found by comparing the needle's first and last bytes against
+// a whole SSE2/AVX2 register of the haystack, with case folded in-register.
+const char* strsearch_find(const char *haystack, size_t haystackLen,
+                           const char *needle, size_t needleLen);
+
+#endif
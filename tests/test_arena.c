@@ -0,0 +1,71 @@
+#include "arena.h"
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static int aligned(const void *p) {
+    return (uintptr_t)p % alignof(max_align_t) == 0;
+}
+
+static void testAllocationsStayAligned(void) {
+    Arena *arena = arena_create(64);
+    char *previous = NULL;
+    for (size_t size = 1; size < 40; size++) {
+        char *p = (char *)arena_alloc(arena, size);
+        CHECK(p != NULL && aligned(p));
+        memset(p, (int)size, size);
+        if (previous) CHECK(previous[0] == (char)(size - 1));
+        previous = p;
+    }
+    char *text = arena_strdup(arena, "merge conflict");
+    CHECK(strcmp(text, "merge conflict") == 0 && aligned(text));
+    CHECK(arena_copy(arena, "", 0) != NULL);
+    arena_free(arena);
+}
+
+static void testOversizedRequests(void) {
+    Arena *arena = arena_create(128);
+    char *small = (char *)arena_alloc(arena, 16);
+    ArenaBlock *current = arena->blocks;
+
+    // A request past the block size gets a block of its own, and the block
+    // being filled keeps taking small requests
+    char *large = (char *)arena_alloc(arena, 1000);
+    CHECK(large != NULL && aligned(large));
+    memset(large, 'x', 1000);
+    CHECK(arena->blocks == current);
+    CHECK(current->next != NULL && current->next->size >= 1000);
+    char *next = (char *)arena_alloc(arena, 16);
+    CHECK(next > small && next < small + 128);
+    CHECK(arena->blocks == current);
+
+    // Once full, a fresh block takes over
+    for (int i = 0; i < 10; i++) arena_alloc(arena, 32);
+    CHECK(arena->blocks != current);
+    CHECK(large[999] == 'x');
+    arena_free(arena);
+    arena_free(NULL);
+}
+
+int main(void) {
+    testAllocationsStayAligned();
+    testOversizedRequests();
+    if (failures) {
+        fprintf(stderr, "test_arena: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_arena: ok\n");
+    return 0;
+}
@@ -0,0 +1,403 @@
+#define _POSIX_C_SOURCE 200809L
+#include "autocomplete.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static void testPrefixSuggestions(void) {
+    CHECK(init_autocomplete_system() == 0);
+    CHECK(add_autocomplete_suggestion("merge conflict", 0.9f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(add_autocomplete_suggestion("merge request", 0.5f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(add_autocomplete_suggestion("rebase", 0.7f, AC_SOURCE_QUERY_HISTORY) == 0);
+
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    int count = get_prefix_suggestions("merge", results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    CHECK(count == 2);
+    if (count == 2) {
+        CHECK(strcmp(results[0].suggestion, "merge conflict") == 0);
+        CHECK(strcmp(results[1].suggestion, "merge request") == 0);
+        CHECK(results[0].score >= results[1].score);
+    }
+    CHECK(get_prefix_suggestions("zzz", results, MAX_AUTOCOMPLETE_SUGGESTIONS) == 0);
+    cleanup_autocomplete_system();
+}
+
+static void testLongSuggestionIsCut(void) {
+    CHECK(init_autocomplete_system() == 0);
+    char text[MAX_SUGGESTION_LENGTH * 2];
+    memset(text, 'q', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+    CHECK(add_autocomplete_suggestion(text, 0.8f, AC_SOURCE_QUERY_HISTORY) == 0);
+
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    int count = get_prefix_suggestions("qqq", results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    CHECK(count == 1);
+    if (count == 1) {
+        CHECK(strlen(results[0].suggestion) == MAX_SUGGESTION_LENGTH - 1);
+    }
+    cleanup_autocomplete_system();
+}
+
+static void testSelectionsMakeTrending(void) {
+    CHECK(init_autocomplete_system() == 0);
+    CHECK(add_autocomplete_suggestion("alpha", 0.2f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(add_autocomplete_suggestion("alphabet", 0.9f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(!is_suggestion_trending("alpha", 3600));
+
+    for (int i = 0; i < 6; i++) {
+        CHECK(update_suggestion_score("alpha", true) == 0);
+    }
+    CHECK(update_suggestion_score("alphabet", false) == 0);
+    CHECK(update_suggestion_score("missing", true) == -1);
+    CHECK(is_suggestion_trending("alpha", 3600));
+    CHECK(!is_suggestion_trending("alphabet", 3600));
+
+    // Six picks lift 0.2 to about 0.575; the 1.5 trending weight then puts
+    // it above the passed-over 0.81
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    int count = get_prefix_suggestions("alp", results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    CHECK(count == 2);
+    if (count == 2) {
+        CHECK(strcmp(results[0].suggestion, "alpha") == 0);
+        CHECK(results[0].is_trending);
+        CHECK(results[0].frequency == 7);
+        CHECK(results[0].score > 0.85f && results[0].score < 0.87f);
+        CHECK(!results[1].is_trending);
+        CHECK(results[1].score < 0.9f);
+    }
+    cleanup_autocomplete_system();
+}
+
+static int compareScores(const void *a, const void *b) {
+    float scoreA = *(const float *)a;
+    float scoreB = *(const float *)b;
+    return (scoreA < scoreB) - (scoreA > scoreB);
+}
+
+static void testBestFirstMatchesFullSort(void) {
+    CHECK(init_autocomplete_system() == 0);
+    srand(7);
+    float scores[300];
+    char text[16];
+    for (int i = 0; i < 300; i++) {
+        snprintf(text, sizeof(text), "zq%03d", i);
+        scores[i] = (float)(rand() % 1000 + 1) / 1000.0f;
+        CHECK(add_autocomplete_suggestion(text, scores[i], AC_SOURCE_QUERY_HISTORY) == 0);
+    }
+    // Some scores move after insertion, which only ever raises bounds
+    for (int i = 0; i < 300; i += 7) {
+        snprintf(text, sizeof(text), "zq%03d", i);
+        CHECK(update_suggestion_score(text, false) == 0);
+        scores[i] -= AC_LEARNING_RATE * scores[i];
+    }
+    qsort(scores, 300, sizeof(float), compareScores);
+
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    int count = get_prefix_suggestions("zq", results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    CHECK(count == MAX_AUTOCOMPLETE_SUGGESTIONS);
+    for (int i = 0; i < count; i++) {
+        CHECK(results[i].score > scores[i] - 1e-6f && results[i].score < scores[i] + 1e-6f);
+    }
+    cleanup_autocomplete_system();
+}
+
+static float suggestionScore(const char *text, int *frequency) {
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    int count = get_prefix_suggestions(text, results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    for (int i = 0; i < count; i++) {
+        if (strcmp(results[i].suggestion, text) == 0) {
+            if (frequency) *frequency = results[i].frequency;
+            return results[i].score;
+        }
+    }
+    return -1.0f;
+}
+
+static void testBulkLoadOverExistingSuggestions(void) {
+    CHECK(init_autocomplete_system() == 0);
+    char path[] = "/tmp/test_autocomplete_logXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    FILE *log = fdopen(fd, "w");
+    // Only suggestions init already added
+    fprintf(log, "search engine\t1000\nsearch ranking\t10\n");
+    fclose(log);
+
+    // History scores top out at 0.7 * history_weight 1.2
+    float base = 0.84f;
+    CHECK(load_suggestions_from_history(path) == 2);
+    int frequency = 0;
+    float score = suggestionScore("search engine", &frequency);
+    // The most logged query reaches the base score from its old 0.8
+    CHECK(score > base - 1e-6f && score < base + 1e-6f);
+    CHECK(frequency == 1001);
+    // Logged less often than the top query, so it keeps its higher old score
+    CHECK(suggestionScore("search ranking", NULL) > 0.9f - 1e-6f);
+    CHECK(suggestionScore("search ranking", NULL) < 0.9f + 1e-6f);
+
+    // A pick moves towards 1, not towards an inflated loaded score
+    CHECK(update_suggestion_score("search engine", true) == 0);
+    score = suggestionScore("search engine", NULL);
+    CHECK(score > base && score <= 1.0f);
+
+    // New queries scale against the top count of existing ones too, and no
+    // existing query is lifted past where its pick left it
+    float picked = score;
+    log = fopen(path, "w");
+    fprintf(log, "search engine\t1000\nmerge conflict\t10\n");
+    fclose(log);
+    CHECK(load_suggestions_from_history(path) == 2);
+    score = suggestionScore("merge conflict", NULL);
+    CHECK(score > base * 0.5f && score < base * 0.7f);
+    score = suggestionScore("search engine", NULL);
+    CHECK(score > picked - 1e-6f && score < picked + 1e-6f);
+
+    unlink(path);
+    cleanup_autocomplete_system();
+}
+
+// A snapshot header is the magic, two sizes and four 64-bit fields
+#define SNAPSHOT_HEADER_BYTES 48
+
+static void patchFile(const char *path, long offset, const void *bytes, size_t length) {
+    FILE *file = fopen(path, "r+b");
+    if (!file) return;
+    fseek(file, offset, SEEK_SET);
+    fwrite(bytes, 1, length, file);
+    fclose(file);
+}
+
+static void testSnapshotRoundTrip(void) {
+    CHECK(init_autocomplete_system() == 0);
+    CHECK(add_autocomplete_suggestion("snapshot saved", 0.6f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(update_suggestion_score("snapshot saved", true) == 0);
+    int frequency = 0;
+    float saved = suggestionScore("snapshot saved", &frequency);
+    char path[] = "/tmp/test_autocomplete_snapshotXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    close(fd);
+    CHECK(save_autocomplete_data(path) == 0);
+    cleanup_autocomplete_system();
+    
+    CHECK(init_autocomplete_system() == 0);
+    CHECK(load_autocomplete_data(path) == 0);
+    int loaded_frequency = 0;
+    CHECK(suggestionScore("snapshot saved", &loaded_frequency) == saved);
+    CHECK(loaded_frequency == frequency);
+    // Trending starts afresh, but feedback and inserts go on as before
+    CHECK(!is_suggestion_trending("snapshot saved", 3600));
+    CHECK(update_suggestion_score("snapshot saved", true) == 0);
+    CHECK(add_autocomplete_suggestion("snapshot grown", 0.5f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(suggestionScore("snapshot grown", NULL) >= 0.0f);
+    CHECK(suggestionScore("snapshot saved", NULL) > saved);
+    
+    // A damaged header is refused and leaves the trie as it was; only the
+    // checksum covers total_suggestions, 32 bytes in
+    unsigned char byte = 0;
+    FILE *file = fopen(path, "rb");
+    CHECK(file && fseek(file, 32, SEEK_SET) == 0 && fread(&byte, 1, 1, file) == 1);
+    if (file) fclose(file);
+    byte ^= 1;
+    patchFile(path, 32, &byte, 1);
+    CHECK(load_autocomplete_data(path) == -1);
+    CHECK(suggestionScore("snapshot grown", NULL) >= 0.0f);
+    byte ^= 1;
+    patchFile(path, 32, &byte, 1);
+    CHECK(truncate(path, SNAPSHOT_HEADER_BYTES + 8) == 0);
+    CHECK(load_autocomplete_data(path) == -1);
+    cleanup_autocomplete_system();
+    unlink(path);
+}
+
+static void testDamagedLinksReadAsMissing(void) {
+    CHECK(init_autocomplete_system() == 0);
+    char path[] = "/tmp/test_autocomplete_snapshotXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    close(fd);
+    CHECK(save_autocomplete_data(path) == 0);
+    
+    // The root's first child points past the array, and node 1 links to
+    // itself both ways; neither is checked until a search follows it
+    uint32_t past_end = 0xfffffff0u;
+    uint32_t self[2] = { 1, 1 };
+    patchFile(path, SNAPSHOT_HEADER_BYTES, &past_end, sizeof(past_end));
+    patchFile(path, SNAPSHOT_HEADER_BYTES + (long)sizeof(trie_node_t), self, sizeof(self));
+    CHECK(load_autocomplete_data(path) == 0);
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    CHECK(get_prefix_suggestions("s", results, MAX_AUTOCOMPLETE_SUGGESTIONS) == 0);
+    CHECK(get_fuzzy_suggestions("serch", results, MAX_AUTOCOMPLETE_SUGGESTIONS) == 0);
+    CHECK(add_autocomplete_suggestion("rebuilt", 0.5f, AC_SOURCE_QUERY_HISTORY) == 0);
+    CHECK(suggestionScore("rebuilt", NULL) >= 0.0f);
+    cleanup_autocomplete_system();
+    unlink(path);
+}
+
+// The first count of expected, ranked the same way; equal scores may come
+// in either order, or swap in a tied suggestion just past the cut
+static void checkSameRanking(const autocomplete_result_t *results, int count,
+                             const autocomplete_result_t *expected, int expectedCount) {
+    for (int i = 0; i < count; i++) {
+        CHECK(results[i].score == expected[i].score && results[i].is_trending == expected[i].is_trending);
+        int found = 0;
+        for (int j = 0; j < expectedCount && !found; j++) {
+            found = expected[j].score == results[i].score &&
+                    strcmp(results[i].suggestion, expected[j].suggestion) == 0;
+        }
+        CHECK(found);
+    }
+}
+
+// The session's answer for what it has typed, against a fresh lookup
+static void checkSessionAnswer(int count, const autocomplete_result_t *results, const char *typed,
+                               int max_suggestions) {
+    autocomplete_result_t expected[32];
+    int expectedCount = get_prefix_suggestions(typed, expected, max_suggestions);
+    CHECK(count == expectedCount);
+    if (count != expectedCount) fprintf(stderr, "  after typing \"%s\"\n", typed);
+    else checkSameRanking(results, count, expected, expectedCount);
+}
+
+static void testSessionMatchesPrefixLookup(void) {
+    CHECK(init_autocomplete_system() == 0);
+    autocomplete_config_t config = {
+        AC_ALGORITHM_PREFIX_MATCH, DEFAULT_SUGGESTION_THRESHOLD, MAX_AUTOCOMPLETE_SUGGESTIONS,
+        true, true, false, 1.5f, 1.2f, 1.0f, AC_TOPK_CACHE_BYTES
+    };
+    CHECK(configure_autocomplete(&config) == 0);
+    srand(11);
+    char text[16];
+    for (int i = 0; i < 400; i++) {
+        int length = 1 + rand() % 6;
+        for (int j = 0; j < length; j++) text[j] = "abc"[rand() % 3];
+        text[length] = '\0';
+        add_autocomplete_suggestion(text, (float)((i * 7919) % 400 + 1) / 401.0f, AC_SOURCE_QUERY_HISTORY);
+    }
+
+    // Random keystrokes and deletions, some running off the trie, with the
+    // answer checked after each one at sizes below, at and past the session's
+    // own top list
+    int sizes[] = { 1, 5, AC_SESSION_TOP_K, AC_SESSION_TOP_K + 4 };
+    autocomplete_result_t results[32];
+    char typed[AC_SESSION_QUERY_LENGTH] = "";
+    int length = 0;
+    ac_session_t *session = ac_session_begin();
+    CHECK(session != NULL);
+    CHECK(ac_session_pop_char(session, results, 10) == -1);
+    int count = 0;
+    for (int step = 0; step < 300; step++) {
+        int max_suggestions = sizes[step % 4];
+        if (length > 0 && (rand() % 3 == 0 || (count == 0 && rand() % 2 == 0) || length == 8)) {
+            typed[--length] = '\0';
+            count = ac_session_pop_char(session, results, max_suggestions);
+        } else {
+            char c = "abcabcad"[rand() % 8];
+            typed[length++] = c;
+            typed[length] = '\0';
+            count = ac_session_push_char(session, c, results, max_suggestions);
+        }
+        checkSessionAnswer(count, results, typed, max_suggestions);
+
+        // Feedback and new suggestions between keystrokes are picked up
+        if (step % 10 == 5 && count > 0 && length > 1) {
+            CHECK(update_suggestion_score(results[count - 1].suggestion, true) == 0);
+            char c = typed[length - 1];
+            typed[--length] = '\0';
+            checkSessionAnswer(ac_session_pop_char(session, results, max_suggestions), results, typed,
+                               max_suggestions);
+            typed[length++] = c;
+            checkSessionAnswer(ac_session_push_char(session, c, results, max_suggestions), results, typed,
+                               max_suggestions);
+        }
+        if (step % 50 == 45) {
+            snprintf(text, sizeof(text), "%.8sa", typed);
+            CHECK(add_autocomplete_suggestion(text, 0.99f - step * 1e-4f, AC_SOURCE_QUERY_HISTORY) == 0);
+        }
+    }
+
+    // Deleting everything lands back on the empty query
+    while (length > 0) {
+        typed[--length] = '\0';
+        checkSessionAnswer(ac_session_pop_char(session, results, 10), results, typed, 10);
+    }
+    ac_session_end(session);
+    cleanup_autocomplete_system();
+}
+
+// A cached prefix list against a lookup too long for the cache to answer
+static void checkCachedList(const char *prefix) {
+    autocomplete_result_t cached[AC_TOPK_CACHE_SIZE];
+    autocomplete_result_t searched[AC_TOPK_CACHE_SIZE + 1];
+    int count = get_prefix_suggestions(prefix, cached, AC_TOPK_CACHE_SIZE);
+    int all = get_prefix_suggestions(prefix, searched, AC_TOPK_CACHE_SIZE + 1);
+    CHECK(count == (all < AC_TOPK_CACHE_SIZE ? all : AC_TOPK_CACHE_SIZE));
+    checkSameRanking(cached, count, searched, all);
+}
+
+static void testTopkCacheFollowsFeedback(void) {
+    CHECK(init_autocomplete_system() == 0);
+    char text[16];
+    const char *prefixes[] = { "", "a", "ab", "abc", "b", "ba", "c" };
+    for (int i = 0; i < 300; i++) {
+        snprintf(text, sizeof(text), "%c%c%c%d", "abc"[i % 3], "abc"[i / 3 % 3], "abc"[i / 9 % 3], i);
+        CHECK(add_autocomplete_suggestion(text, (float)((i * 7919) % 300 + 1) / 301.0f,
+                                          AC_SOURCE_QUERY_HISTORY) == 0);
+    }
+    for (int p = 0; p < 7; p++) checkCachedList(prefixes[p]);
+
+    // Passing over the best suggestions sinks them out of their lists, and
+    // picking low ones lifts them in, until some trend
+    srand(5);
+    autocomplete_result_t results[AC_TOPK_CACHE_SIZE];
+    for (int round = 0; round < 200; round++) {
+        const char *prefix = prefixes[round % 7];
+        int count = get_prefix_suggestions(prefix, results, AC_TOPK_CACHE_SIZE);
+        if (count > 0 && round % 2 == 0) {
+            CHECK(update_suggestion_score(results[0].suggestion, false) == 0);
+        } else {
+            int i = rand() % 300;
+            snprintf(text, sizeof(text), "%c%c%c%d", "abc"[i % 3], "abc"[i / 3 % 3], "abc"[i / 9 % 3], i);
+            for (int k = 0; k < 1 + round % 4; k++) CHECK(update_suggestion_score(text, true) == 0);
+        }
+        for (int p = 0; p < 7; p++) checkCachedList(prefixes[p]);
+    }
+
+    // A new suggestion that beats a cached list joins it
+    CHECK(add_autocomplete_suggestion("abzz", 5.0f, AC_SOURCE_QUERY_HISTORY) == 0);
+    int count = get_prefix_suggestions("ab", results, AC_TOPK_CACHE_SIZE);
+    CHECK(count > 0 && strcmp(results[0].suggestion, "abzz") == 0);
+    for (int p = 0; p < 7; p++) checkCachedList(prefixes[p]);
+    cleanup_autocomplete_system();
+}
+
+int main(void) {
+    testPrefixSuggestions();
+    testLongSuggestionIsCut();
+    testSelectionsMakeTrending();
+    testBestFirstMatchesFullSort();
+    testBulkLoadOverExistingSuggestions();
+    testSnapshotRoundTrip();
+    testDamagedLinksReadAsMissing();
+    testSessionMatchesPrefixLookup();
+    testTopkCacheFollowsFeedback();
+    if (failures) {
+        fprintf(stderr, "test_autocomplete: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_autocomplete: ok\n");
+    return 0;
+}
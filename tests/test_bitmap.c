@@ -0,0 +1,111 @@
+#include "bitmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+#define ID_SPACE (3 * 65536)
+
+// The bitmap holds exactly the ids flagged in expected, in ascending order
+static void checkMembers(const Bitmap *bitmap, const unsigned char *expected) {
+    int expectedCount = 0;
+    for (int id = 0; id < ID_SPACE; id++) expectedCount += expected[id];
+    CHECK(bitmap_cardinality(bitmap) == expectedCount);
+
+    int count;
+    int *ids = bitmap_toArray(bitmap, &count);
+    CHECK(count == expectedCount);
+    for (int i = 0; i < count; i++) {
+        CHECK(expected[ids[i]]);
+        if (i > 0) CHECK(ids[i - 1] < ids[i]);
+    }
+    free(ids);
+    for (int id = 0; id < ID_SPACE; id += 97) CHECK(bitmap_contains(bitmap, id) == expected[id]);
+}
+
+static void testContainerConversion(void) {
+    Bitmap *bitmap = bitmap_create();
+    unsigned char *expected = (unsigned char *)calloc(ID_SPACE, 1);
+
+    // Every other id of the second chunk, up to the array limit
+    for (int i = 0; i < BITMAP_ARRAY_MAX; i++) {
+        bitmap_add(bitmap, 65536 + 2 * i);
+        expected[65536 + 2 * i] = 1;
+    }
+    CHECK(bitmap->containerCount == 1 && bitmap->containers[0].bits == NULL);
+    bitmap_add(bitmap, 65536 + 2 * 10);  // already present: still an array
+    CHECK(bitmap->containers[0].bits == NULL);
+
+    // One more turns the array into a bitset
+    bitmap_add(bitmap, 65537);
+    expected[65537] = 1;
+    CHECK(bitmap->containers[0].bits != NULL);
+    checkMembers(bitmap, expected);
+
+    // Dropping back to the limit turns it into an array again
+    bitmap_remove(bitmap, 65536);
+    expected[65536] = 0;
+    CHECK(bitmap->containers[0].bits == NULL);
+    bitmap_remove(bitmap, 65536);   // absent: nothing changes
+    checkMembers(bitmap, expected);
+
+    free(expected);
+    bitmap_free(bitmap);
+}
+
+static void testSetOperations(void) {
+    unsigned char *inA = (unsigned char *)calloc(ID_SPACE, 1);
+    unsigned char *inB = (unsigned char *)calloc(ID_SPACE, 1);
+    Bitmap *a = bitmap_create();
+    Bitmap *b = bitmap_create();
+    // Chunk 0: bitset and array. Chunk 1: both bitsets. Chunk 2: a alone.
+    for (int id = 0; id < 65536; id += 3) { bitmap_add(a, id); inA[id] = 1; }
+    for (int id = 0; id < 65536; id += 40) { bitmap_add(b, id); inB[id] = 1; }
+    for (int id = 65536; id < 2 * 65536; id += 5) { bitmap_add(a, id); inA[id] = 1; }
+    for (int id = 65536; id < 2 * 65536; id += 7) { bitmap_add(b, id); inB[id] = 1; }
+    for (int id = 2 * 65536; id < 2 * 65536 + 100; id++) { bitmap_add(a, id); inA[id] = 1; }
+
+    unsigned char *both = (unsigned char *)calloc(ID_SPACE, 1);
+    unsigned char *either = (unsigned char *)calloc(ID_SPACE, 1);
+    for (int id = 0; id < ID_SPACE; id++) {
+        both[id] = inA[id] && inB[id];
+        either[id] = inA[id] || inB[id];
+    }
+    Bitmap *and = bitmap_and(a, b);
+    Bitmap *or = bitmap_or(a, b);
+    checkMembers(and, both);
+    checkMembers(or, either);
+    // Chunk 1 shares 65536 / 35 ids: small enough to come back as an array
+    for (int c = 0; c < and->containerCount; c++) {
+        if (and->containers[c].cardinality <= BITMAP_ARRAY_MAX) CHECK(and->containers[c].bits == NULL);
+        else CHECK(and->containers[c].bits != NULL);
+    }
+
+    bitmap_free(and);
+    bitmap_free(or);
+    bitmap_free(a);
+    bitmap_free(b);
+    free(inA);
+    free(inB);
+    free(both);
+    free(either);
+}
+
+int main(void) {
+    testContainerConversion();
+    testSetOperations();
+    if (failures) {
+        fprintf(stderr, "test_bitmap: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_bitmap: ok\n");
+    return 0;
+}
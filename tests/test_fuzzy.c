@@ -0,0 +1,150 @@
+#include "fuzzy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned int seed = 12345;
+
+// Words over a small alphabet, so many lie within a couple of edits
+static void randomWord(char *word, int minLength, int maxLength) {
+    seed = seed * 1103515245 + 12345;
+    int length = minLength + (int)((seed >> 16) % (unsigned int)(maxLength - minLength + 1));
+    for (int i = 0; i < length; i++) {
+        seed = seed * 1103515245 + 12345;
+        word[i] = "abcd"[(seed >> 16) % 4];
+    }
+    word[length] = '\0';
+}
+
+static void testLookupMatchesLevenshtein(void) {
+    FuzzyMatcher *matcher = fuzzy_create();
+    char terms[400][8];
+    int termCount = 0;
+    for (int i = 0; i < 400; i++) {
+        randomWord(terms[termCount], 1, 7);
+        int known = 0;
+        for (int k = 0; k < termCount && !known; k++) known = strcmp(terms[k], terms[termCount]) == 0;
+        if (known) continue;
+        fuzzy_addTerm(matcher, terms[termCount]);
+        termCount++;
+    }
+
+    // Every term within maxDistance is found, with its exact distance, and
+    // nothing else is
+    for (int q = 0; q < 60; q++) {
+        char query[9];
+        randomWord(query, 1, 8);
+        if (q % 4 == 0) query[0] = 'A' + (query[0] - 'a');
+        char lowered[9];
+        for (int i = 0; ; i++) {
+            lowered[i] = (char)(query[i] >= 'A' && query[i] <= 'Z' ? query[i] - 'A' + 'a' : query[i]);
+            if (!query[i]) break;
+        }
+        for (int maxDistance = 0; maxDistance <= FUZZY_MAX_DISTANCE; maxDistance++) {
+            int matchCount;
+            FuzzyMatch *matches = fuzzy_lookup(matcher, query, maxDistance, &matchCount);
+            int expected = 0;
+            for (int t = 0; t < termCount; t++) {
+                int distance = fuzzy_levenshteinDistance(lowered, terms[t]);
+                if (distance > maxDistance) continue;
+                expected++;
+                int found = 0;
+                for (int m = 0; m < matchCount && !found; m++) {
+                    found = strcmp(matches[m].value, terms[t]) == 0 && matches[m].distance == distance;
+                }
+                CHECK(found);
+                if (!found) fprintf(stderr, "  missed %s for %s at %d\n", terms[t], query, maxDistance);
+            }
+            CHECK(matchCount == expected);
+            for (int m = 1; m < matchCount; m++) CHECK(matches[m - 1].distance <= matches[m].distance);
+            fuzzy_freeMatches(matches, matchCount);
+        }
+    }
+    fuzzy_free(matcher);
+}
+
+static int expectedDistance(const char *query, const char *candidate, int maxDistance) {
+    int distance = fuzzy_levenshteinDistance(query, candidate);
+    return distance > maxDistance ? maxDistance + 1 : distance;
+}
+
+// A mutated copy of query: a few substitutions, insertions or deletions
+static void mutate(const char *query, char *out, int edits) {
+    int length = (int)strlen(query);
+    memcpy(out, query, length + 1);
+    for (int e = 0; e < edits; e++) {
+        seed = seed * 1103515245 + 12345;
+        int at = length ? (int)((seed >> 16) % (unsigned int)length) : 0;
+        switch ((seed >> 8) % 3) {
+            case 0:
+                if (length) out[at] = "abcd"[(seed >> 4) % 4];
+                break;
+            case 1:
+                memmove(out + at + 1, out + at, length - at + 1);
+                out[at] = "abcd"[(seed >> 4) % 4];
+                length++;
+                break;
+            default:
+                if (length) {
+                    memmove(out + at, out + at + 1, length - at);
+                    length--;
+                }
+                break;
+        }
+    }
+}
+
+static void testBatchMatchesScalar(void) {
+    // Batches one short of, exactly at and one past the lane count, and
+    // queries up to and past the longest the SIMD kernel takes
+    int counts[] = { 1, FUZZY_BATCH_LANES - 1, FUZZY_BATCH_LANES, FUZZY_BATCH_LANES + 1,
+                     2 * FUZZY_BATCH_LANES + 1 };
+    int lengths[] = { 1, 2, 7, 8, 9, 15, 16, 17, FUZZY_MAX_TERM_LENGTH - 1, FUZZY_MAX_TERM_LENGTH,
+                      FUZZY_MAX_TERM_LENGTH + 1 };
+    char query[FUZZY_MAX_TERM_LENGTH + 2];
+    char storage[2 * FUZZY_BATCH_LANES + 1][FUZZY_MAX_TERM_LENGTH + 8];
+    const char *candidates[2 * FUZZY_BATCH_LANES + 1];
+    int distances[2 * FUZZY_BATCH_LANES + 1];
+
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        randomWord(query, lengths[l], lengths[l]);
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+            for (int i = 0; i < counts[c]; i++) {
+                if (i % 5 == 4) storage[i][0] = '\0';
+                else mutate(query, storage[i], i % 4);
+                candidates[i] = storage[i];
+            }
+            for (int maxDistance = 0; maxDistance <= FUZZY_MAX_DISTANCE; maxDistance++) {
+                fuzzy_batchDistance(query, candidates, counts[c], maxDistance, distances);
+                for (int i = 0; i < counts[c]; i++) {
+                    int expected = expectedDistance(query, candidates[i], maxDistance);
+                    CHECK(distances[i] == expected);
+                    if (distances[i] != expected) {
+                        fprintf(stderr, "  %s vs %s: %d, expected %d\n", query, candidates[i],
+                                distances[i], expected);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(void) {
+    testLookupMatchesLevenshtein();
+    testBatchMatchesScalar();
+    if (failures) {
+        fprintf(stderr, "test_fuzzy: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_fuzzy: ok\n");
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include "ngram.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static void addTimes(NgramModel *model, const char *text, int times) {
+    for (int i = 0; i < times; i++) ngram_addText(model, text);
+}
+
+static int complete(NgramModel *model, const char *first, const char *second, const char *partial,
+                    NgramCandidate *out, int max) {
+    const char *context[2] = { first, second };
+    int count = first ? 2 : 1;
+    int found = ngram_complete(model, first ? context : context + 1, count, partial, out, max);
+    for (int i = 0; i < found; i++) {
+        CHECK(out[i].score > 0 && out[i].score <= 1);
+        if (i > 0) CHECK(out[i - 1].score >= out[i].score);
+    }
+    return found;
+}
+
+static void testFollowersByCount(void) {
+    NgramModel *model = ngram_create();
+    addTimes(model, "git merge conflict", 30);
+    addTimes(model, "open merge request", 8);
+    addTimes(model, "Merge Commit", 2);
+    addTimes(model, "rebase onto main", 10);
+
+    // Followers of the last word, most frequent first
+    NgramCandidate out[8];
+    int count = complete(model, NULL, "merge", "", out, 8);
+    CHECK(count == 3);
+    if (count == 3) {
+        CHECK(strcmp(out[0].word, "conflict") == 0);
+        CHECK(strcmp(out[1].word, "request") == 0);
+        CHECK(strcmp(out[2].word, "commit") == 0);
+    }
+    CHECK(complete(model, NULL, "merge", "", out, 2) == 2);
+
+    // A word that follows beats a more frequent one that only starts right
+    count = complete(model, NULL, "merge", "re", out, 8);
+    CHECK(count == 2);
+    if (count == 2) {
+        CHECK(strcmp(out[0].word, "request") == 0);
+        CHECK(strcmp(out[1].word, "rebase") == 0);
+    }
+    CHECK(complete(model, NULL, "merge", "x", out, 8) == 0);
+    CHECK(complete(model, NULL, "unseen", "", out, 8) == 0);
+    ngram_free(model);
+}
+
+static void testTrigramsOutrankBigrams(void) {
+    NgramModel *model = ngram_create();
+    addTimes(model, "git merge conflict", 30);
+    addTimes(model, "pr merge request", 3);
+
+    // "conflict" follows "merge" far more often, but never after "pr merge"
+    NgramCandidate out[4];
+    int count = complete(model, "pr", "merge", "", out, 4);
+    CHECK(count == 2);
+    if (count == 2) CHECK(strcmp(out[0].word, "request") == 0 && out[0].score == 1.0);
+    count = complete(model, "git", "merge", "", out, 4);
+    CHECK(count == 2);
+    if (count == 2) CHECK(strcmp(out[0].word, "conflict") == 0);
+
+    // An unknown earlier word falls back to the bigrams
+    count = complete(model, "unseen", "merge", "", out, 4);
+    CHECK(count == 2);
+    if (count == 2) CHECK(strcmp(out[0].word, "conflict") == 0);
+    ngram_free(model);
+}
+
+static void testSentencesBreakNgrams(void) {
+    NgramModel *model = ngram_create();
+    addTimes(model, "resolve the conflict. Then push", 5);
+    NgramCandidate out[4];
+    int count = complete(model, NULL, "conflict", "", out, 4);
+    CHECK(count == 0);
+    count = complete(model, NULL, "then", "", out, 4);
+    CHECK(count == 1);
+    if (count == 1) CHECK(strcmp(out[0].word, "push") == 0);
+
+    // Clearing forgets everything; the model takes new text afterwards
+    ngram_clear(model);
+    CHECK(complete(model, NULL, "then", "", out, 4) == 0);
+    addTimes(model, "then merge", 1);
+    count = complete(model, NULL, "then", "", out, 4);
+    CHECK(count == 1);
+    if (count == 1) CHECK(strcmp(out[0].word, "merge") == 0);
+    ngram_free(model);
+}
+
+int main(void) {
+    testFollowersByCount();
+    testTrigramsOutrankBigrams();
+    testSentencesBreakNgrams();
+    if (failures) {
+        fprintf(stderr, "test_ngram: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_ngram: ok\n");
+    return 0;
+}
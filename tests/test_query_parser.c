@@ -0,0 +1,75 @@
+#include "query_parser.h"
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static void testGroups(void) {
+    int malformed = 1;
+    QueryNode *root = queryparser_parse("(merge OR rebase) AND conflict", &malformed);
+    CHECK(!malformed);
+    CHECK(root && root->type == QUERY_AND && root->childCount == 2);
+    if (root && root->childCount == 2) {
+        CHECK(root->children[0]->type == QUERY_OR);
+        CHECK(root->children[1]->type == QUERY_TERM && strcmp(root->children[1]->text, "conflict") == 0);
+    }
+    queryparser_free(root);
+
+    root = queryparser_parse("((merge)) -(rebase)", &malformed);
+    CHECK(!malformed);
+    CHECK(root && root->type == QUERY_AND && root->childCount == 2);
+    queryparser_free(root);
+
+    // Nothing searchable is not an error
+    root = queryparser_parse("()", &malformed);
+    CHECK(!root && !malformed);
+}
+
+static void testPatterns(void) {
+    QueryNode *root = queryparser_parse("Conf*", NULL);
+    CHECK(root && root->type == QUERY_PREFIX && strcmp(root->text, "conf") == 0);
+    queryparser_free(root);
+    root = queryparser_parse("c?nf*g", NULL);
+    CHECK(root && root->type == QUERY_WILDCARD && strcmp(root->text, "c?nf*g") == 0);
+    queryparser_free(root);
+
+    // A leading wildcard is dropped rather than scanning every term
+    CHECK(queryparser_parse("*fig", NULL) == NULL);
+    CHECK(queryparser_parse("?onfig", NULL) == NULL);
+    root = queryparser_parse("merge *fig", NULL);
+    CHECK(root && root->type == QUERY_TERM && strcmp(root->text, "merge") == 0);
+    queryparser_free(root);
+}
+
+static void testUnbalancedParentheses(void) {
+    const char *queries[] = { "merge ) rebase", "(merge ) rebase)", ")", "merge )", "(merge", "((merge)" };
+    for (size_t i = 0; i < sizeof(queries) / sizeof(queries[0]); i++) {
+        int malformed = 0;
+        QueryNode *root = queryparser_parse(queries[i], &malformed);
+        CHECK(root == NULL);
+        CHECK(malformed);
+        if (!malformed) fprintf(stderr, "  accepted: %s\n", queries[i]);
+        queryparser_free(root);
+    }
+    // The flag is optional
+    CHECK(queryparser_parse("merge ) rebase", NULL) == NULL);
+}
+
+int main(void) {
+    testGroups();
+    testPatterns();
+    testUnbalancedParentheses();
+    if (failures) {
+        fprintf(stderr, "test_query_parser: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_query_parser: ok\n");
+    return 0;
+}
@@ -0,0 +1,92 @@
+#include "query_planner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+// conf<k> is held by k + 1 of the 30 documents
+static InvertedIndex* buildIndex(char contents[30][256]) {
+    InvertedIndex *index = invertedindex_create();
+    for (int d = 0; d < 30; d++) {
+        contents[d][0] = '\0';
+        for (int k = 29 - d; k < 30; k++) {
+            char word[16];
+            snprintf(word, sizeof(word), "conf%02d ", k);
+            strcat(contents[d], word);
+        }
+        strcat(contents[d], "other");
+        File file = { "id", "doc.txt", contents[d], (int)strlen(contents[d]), "txt", d };
+        invertedindex_addDocument(index, d, &file);
+    }
+    return index;
+}
+
+static int expand(InvertedIndex *index, const char *query, int maxExpansions, char out[][8]) {
+    PlanContext context = { index, NULL, FIELD_ALL, maxExpansions, -1 };
+    QueryNode *node = queryparser_parse(query, NULL);
+    int *termIds;
+    int count = queryplan_expand(&context, node, &termIds);
+    for (int i = 0; i < count; i++) {
+        strncpy(out[i], index->terms[termIds[i]], 7);
+        out[i][7] = '\0';
+    }
+    free(termIds);
+    queryparser_free(node);
+    return count;
+}
+
+static void testExpansionCap(void) {
+    char contents[30][256];
+    InvertedIndex *index = buildIndex(contents);
+    char terms[64][8];
+
+    // The most frequent terms win, however the dictionary orders them
+    int count = expand(index, "conf*", 5, terms);
+    CHECK(count == 5);
+    for (int i = 0; i < count; i++) {
+        char expected[16];
+        snprintf(expected, sizeof(expected), "conf%02d", 29 - i);
+        CHECK(strcmp(terms[i], expected) == 0);
+    }
+    CHECK(expand(index, "conf*", 64, terms) == 30);
+    CHECK(expand(index, "conf*", 0, terms) == 0);
+
+    // Wildcards keep only matching terms before the cap applies
+    count = expand(index, "conf?5", 2, terms);
+    CHECK(count == 2);
+    if (count == 2) CHECK(strcmp(terms[0], "conf25") == 0 && strcmp(terms[1], "conf15") == 0);
+    CHECK(expand(index, "c*f0*", 64, terms) == 10);
+    CHECK(expand(index, "oth*", 64, terms) == 1);
+    CHECK(expand(index, "zz*", 64, terms) == 0);
+
+    // The plan searches the same capped set
+    PlanContext context = { index, NULL, FIELD_ALL, 5, -1 };
+    QueryNode *node = queryparser_parse("conf*", NULL);
+    PlanNode *plan = queryplan_build(node, &context);
+    CHECK(plan->type == PLAN_TERMS && plan->termCount == 5);
+    queryplan_free(plan);
+    queryparser_free(node);
+
+    // Terms whose documents are all gone are not expanded to
+    for (int d = 0; d < 30; d++) invertedindex_removeDocument(index, d);
+    CHECK(expand(index, "conf*", 64, terms) == 0);
+    invertedindex_free(index);
+}
+
+int main(void) {
+    testExpansionCap();
+    if (failures) {
+        fprintf(stderr, "test_query_planner: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_query_planner: ok\n");
+    return 0;
+}
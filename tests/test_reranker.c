@@ -0,0 +1,63 @@
+#define _POSIX_C_SOURCE 200809L
+#include "reranker.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static Reranker* loadText(const char *text) {
+    char path[] = "/tmp/test_rerankerXXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) return NULL;
+    FILE *file = fdopen(fd, "w");
+    fputs(text, file);
+    fclose(file);
+    Reranker *model = reranker_load(path);
+    unlink(path);
+    return model;
+}
+
+static void testScoresStump(void) {
+    Reranker *model = loadText("# one split\n"
+                               "gbdt 2 1 0.5\n"
+                               "tree 3\n"
+                               "0 1 0.25 1 2 0\n"
+                               "1 -1 0 0 0 -1\n"
+                               "2 -1 0 0 0 2\n");
+    CHECK(model != NULL);
+    if (!model) return;
+    float rows[] = { 9.0f, 0.0f, 0.0f, 1.0f };
+    double scores[2];
+    reranker_score(model, rows, 2, scores);
+    CHECK(scores[0] == -0.5);
+    CHECK(scores[1] == 2.5);
+    reranker_free(model);
+}
+
+static void testRejectsOversizedCounts(void) {
+    // Declared sizes are refused before anything that large is allocated
+    CHECK(loadText("gbdt 2 1 0\ntree 2000000000\n0 -1 0 0 0 1\n") == NULL);
+    CHECK(loadText("gbdt 2 2000000000 0\ntree 1\n0 -1 0 0 0 1\n") == NULL);
+    CHECK(loadText("gbdt 2 1 0\ntree -3\n") == NULL);
+    // Fewer nodes than declared
+    CHECK(loadText("gbdt 2 1 0\ntree 3\n0 1 0.5 1 2 0\n1 -1 0 0 0 1\n") == NULL);
+}
+
+int main(void) {
+    testScoresStump();
+    testRejectsOversizedCounts();
+    if (failures) {
+        fprintf(stderr, "test_reranker: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_reranker: ok\n");
+    return 0;
+}
@@ -0,0 +1,595 @@
+#define _POSIX_C_SOURCE 200809L
+#include "search_engine.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+// The engine keeps the file's strings, not copies of them
+static File makeFile(char *id, char *filename, char *content, long uploadedAt) {
+    File file = { id, filename, content, (int)strlen(content), "txt", uploadedAt };
+    return file;
+}
+
+static SearchResponse* run(SearchEngine *engine, char *query) {
+    SearchRequest request = {0};
+    request.query = query;
+    request.scope = "all";
+    request.limit = 10;
+    return searchengine_execute(engine, &request);
+}
+
+static void testChurnPastInitialCapacity(void) {
+    SearchEngine *engine = searchengine_create();
+    File kept = makeFile("kept", "kept.txt", "a rebase that stays", 1);
+    searchengine_indexFile(engine, &kept);
+
+    // Every add takes a new slot, so this runs well past the slots a fresh
+    // engine starts with while never holding more than two files
+    File churned = makeFile("churned", "churned.txt", "a merge that comes and goes", 2);
+    for (int i = 0; i < 10005; i++) {
+        searchengine_indexFile(engine, &churned);
+        searchengine_removeFile(engine, "churned");
+    }
+    File last = makeFile("last", "last.txt", "a merge that stays", 3);
+    searchengine_indexFile(engine, &last);
+    CHECK(engine->fileCount == 10007);
+
+    SearchResponse *response = run(engine, "merge");
+    CHECK(response != NULL);
+    if (response) {
+        CHECK(response->hitCount == 1);
+        SearchResult *result = searchresponse_result(response, 0);
+        CHECK(result && strcmp(result->fileId, "last") == 0);
+        searchresponse_free(response);
+    }
+    response = run(engine, "stays");
+    CHECK(response != NULL);
+    if (response) {
+        CHECK(response->hitCount == 2);
+        searchresponse_free(response);
+    }
+    searchengine_free(engine);
+}
+
+static void testUnbalancedQueryIsRejected(void) {
+    SearchEngine *engine = searchengine_create();
+    File file = makeFile("one", "one.txt", "a merge and a rebase", 1);
+    searchengine_indexFile(engine, &file);
+    CHECK(run(engine, "merge ) rebase") == NULL);
+
+    SearchResponse *response = run(engine, "(merge) rebase");
+    CHECK(response && response->hitCount == 1);
+    searchresponse_free(response);
+    searchengine_free(engine);
+}
+
+static void testImpactsFollowTheirTerm(void) {
+    SearchEngine *engine = searchengine_create();
+    InvertedIndex *index = engine->invertedIndex;
+    File first = makeFile("first", "first.txt", "merge conflict", 1);
+    searchengine_indexFile(engine, &first);
+    int merge = invertedindex_findTerm(index, "merge");
+    double scale;
+    CHECK(invertedindex_getImpacts(index, merge, FIELD_ALL, 2.0, 0, &scale) != NULL);
+    unsigned long built = index->impactVersions[merge * IMPACT_VARIANTS + FIELD_ALL - 1];
+
+    // A document without the term leaves its impacts alone
+    File other = makeFile("other", "other.txt", "rebase onto main", 2);
+    searchengine_indexFile(engine, &other);
+    invertedindex_getImpacts(index, merge, FIELD_ALL, 2.0, 0, &scale);
+    CHECK(index->impactVersions[merge * IMPACT_VARIANTS + FIELD_ALL - 1] == built);
+
+    // Searching only reads the index's settings
+    unsigned long version = index->version;
+    searchresponse_free(run(engine, "merge"));
+    CHECK(index->version == version);
+    CHECK(index->impactVersions[merge * IMPACT_VARIANTS + FIELD_ALL - 1] == built);
+
+    // One that holds it, or removing one that did, rebuilds them
+    File second = makeFile("second", "second.txt", "merge merge merge", 3);
+    searchengine_indexFile(engine, &second);
+    SearchResponse *response = run(engine, "merge");
+    CHECK(response && response->hitCount == 2);
+    if (response && response->hitCount == 2) CHECK(response->hits[0].docId == 2);
+    searchresponse_free(response);
+    CHECK(index->impactVersions[merge * IMPACT_VARIANTS + FIELD_ALL - 1] > built);
+
+    searchengine_removeFile(engine, "second");
+    response = run(engine, "merge");
+    CHECK(response && response->hitCount == 1);
+    if (response && response->hitCount == 1) CHECK(response->hits[0].docId == 0);
+    searchresponse_free(response);
+    searchengine_free(engine);
+}
+
+static void testFilenameWeighting(void) {
+    SearchEngine *engine = searchengine_create();
+    InvertedIndex *index = engine->invertedIndex;
+    File named = makeFile("named", "merge.txt", "merge notes here", 1);
+    File plain = makeFile("plain", "notes.txt", "merge notes here", 2);
+    File other = makeFile("other", "other.txt", "rebase onto main", 3);
+    searchengine_indexFile(engine, &named);
+    searchengine_indexFile(engine, &plain);
+    searchengine_indexFile(engine, &other);
+    int merge = invertedindex_findTerm(index, "merge");
+    const Posting *posting = &index->postings[merge][0];
+    CHECK(posting->docId == 0 && posting->filenameFrequency == 1);
+
+    // BM25F saturates the weighted sum of both fields once, so the combined
+    // score beats either field alone but not the two added up
+    double content = invertedindex_scorePosting(index, merge, posting, FIELD_CONTENT, 2.0, 1);
+    double filename = invertedindex_scorePosting(index, merge, posting, FIELD_FILENAME, 2.0, 1);
+    double both = invertedindex_scorePosting(index, merge, posting, FIELD_ALL, 2.0, 1);
+    CHECK(content > 0 && filename > 0);
+    CHECK(both > content && both > filename && both < content + filename);
+    CHECK(invertedindex_scorePosting(index, merge, posting, FIELD_CONTENT, 5.0, 1) == content);
+    CHECK(invertedindex_scorePosting(index, merge, posting, FIELD_ALL, 0.0, 1) == content);
+    CHECK(invertedindex_scorePosting(index, merge, posting, FIELD_ALL, 4.0, 1) > both);
+
+    // TF-IDF adds the weighted fields up
+    double tfidf = invertedindex_scorePosting(index, merge, posting, FIELD_ALL, 2.0, 0);
+    CHECK(fabs(tfidf - invertedindex_scorePosting(index, merge, posting, FIELD_CONTENT, 2.0, 0) -
+               invertedindex_scorePosting(index, merge, posting, FIELD_FILENAME, 2.0, 0)) < 1e-9);
+
+    // Impacts are rebuilt for another weight and decode to the exact scores
+    // within one quantization step
+    double weights[] = { 2.0, 4.0, 2.0 };
+    for (int w = 0; w < 3; w++) {
+        double scale;
+        const unsigned short *impacts = invertedindex_getImpacts(index, merge, FIELD_ALL, weights[w], 1, &scale);
+        for (int j = 0; j < index->postingCounts[merge]; j++) {
+            double exact = invertedindex_scorePosting(index, merge, &index->postings[merge][j], FIELD_ALL,
+                                                      weights[w], 1);
+            CHECK(fabs(impacts[j] * scale - exact) <= scale);
+        }
+    }
+
+    // The same content ranks higher when the filename holds the term too
+    SearchResponse *response = run(engine, "merge");
+    CHECK(response && response->hitCount == 2);
+    if (response && response->hitCount == 2) {
+        CHECK(response->hits[0].docId == 0 && response->hits[0].score > response->hits[1].score);
+    }
+    searchresponse_free(response);
+    searchengine_free(engine);
+}
+
+static void testResultsBuiltOnDemand(void) {
+    SearchEngine *engine = searchengine_create();
+    File first = makeFile("first", "first.txt", "merge conflict", 1);
+    File second = makeFile("second", "second.txt", "merge merge", 2);
+    File third = makeFile("third", "third.txt", "merge once more", 3);
+    searchengine_indexFile(engine, &first);
+    searchengine_indexFile(engine, &second);
+    searchengine_indexFile(engine, &third);
+
+    SearchResponse *response = run(engine, "merge");
+    CHECK(response && response->hitCount == 3);
+    if (!response || response->hitCount != 3) {
+        searchresponse_free(response);
+        searchengine_free(engine);
+        return;
+    }
+    for (int i = 0; i < 3; i++) CHECK(!response->results[i] && !response->breakdowns[i]);
+
+    // The first read builds the result in the arena; later ones return it
+    SearchResult *result = searchresponse_result(response, 0);
+    CHECK(result != NULL && searchresponse_result(response, 0) == result);
+    CHECK(!response->results[1] && !response->results[2]);
+    CHECK(result->rankingBreakdown == NULL);
+    File *file = &engine->files[result->docId];
+    CHECK(strcmp(result->fileId, file->id) == 0 && result->fileId != file->id);
+    CHECK(strstr(result->highlightedSnippet, "<b>merge</b>") != NULL);
+
+    // Explaining attaches the breakdown to a result already built, and one
+    // built later picks it up
+    RankingBreakdown *breakdown = searchresponse_explain(response, 0);
+    CHECK(breakdown != NULL && searchresponse_explain(response, 0) == breakdown);
+    CHECK(result->rankingBreakdown == breakdown);
+    CHECK(breakdown->baseScore > 0);
+    breakdown = searchresponse_explain(response, 1);
+    CHECK(searchresponse_result(response, 1)->rankingBreakdown == breakdown);
+    CHECK(searchresponse_result(response, 3) == NULL && searchresponse_explain(response, -1) == NULL);
+
+    // A hit whose file went away is not built; one already built stays intact
+    char fileId[16];
+    strcpy(fileId, result->fileId);
+    searchengine_removeFile(engine, engine->files[response->hits[2].docId].id);
+    CHECK(searchresponse_result(response, 2) == NULL);
+    searchengine_removeFile(engine, fileId);
+    CHECK(strcmp(result->fileId, fileId) == 0 && searchresponse_result(response, 0) == result);
+    searchresponse_free(response);
+    searchengine_free(engine);
+}
+
+static void testCursorPagesWithRerankDepth(void) {
+    SearchEngine *engine = searchengine_create();
+    char ids[20][8], names[20][16], contents[20][160];
+    for (int i = 0; i < 20; i++) {
+        snprintf(ids[i], sizeof(ids[i]), "d%d", i);
+        snprintf(names[i], sizeof(names[i]), "d%d.txt", i);
+        contents[i][0] = '\0';
+        for (int r = 0; r <= i % 7; r++) strcat(contents[i], "merge ");
+        strcat(contents[i], i % 2 ? "conflict" : "branch history");
+        File file = makeFile(ids[i], names[i], contents[i], i);
+        searchengine_indexFile(engine, &file);
+    }
+
+    // Every page fills until the matches run out, however many earlier pages
+    // sorted before the cursor
+    int seen[20] = {0};
+    int pages = 0, total = 0;
+    char cursor[SEARCH_CURSOR_LENGTH] = "";
+    for (;;) {
+        SearchRequest request = {0};
+        request.query = "merge";
+        request.scope = "all";
+        request.limit = 3;
+        request.rerankDepth = 10;
+        request.searchAfter = pages ? cursor : NULL;
+        SearchResponse *response = searchengine_execute(engine, &request);
+        CHECK(response != NULL);
+        if (!response || response->hitCount == 0) {
+            searchresponse_free(response);
+            break;
+        }
+        CHECK(response->hitCount == (total + 3 <= 20 ? 3 : 20 - total));
+        for (int i = 0; i < response->hitCount; i++) {
+            SearchResult *result = searchresponse_result(response, i);
+            CHECK(!seen[response->hits[i].docId]);
+            seen[response->hits[i].docId] = 1;
+            if (i == response->hitCount - 1) strcpy(cursor, result->cursor);
+        }
+        total += response->hitCount;
+        pages++;
+        searchresponse_free(response);
+        if (pages > 20) break;
+    }
+    CHECK(total == 20);
+    CHECK(pages == 7);
+    searchengine_free(engine);
+}
+
+static void testExplainShowsModelScore(void) {
+    SearchEngine *engine = searchengine_create();
+    File file = makeFile("one", "one.txt", "a merge conflict", 1);
+    searchengine_indexFile(engine, &file);
+
+    SearchResponse *response = run(engine, "merge");
+    CHECK(response && response->hitCount == 1);
+    if (response && response->hitCount == 1) {
+        RankingBreakdown *breakdown = searchresponse_explain(response, 0);
+        CHECK(!breakdown->reranked && breakdown->modelScore == 0);
+    }
+    searchresponse_free(response);
+
+    // A single leaf: every hit scores 0.25 + 2
+    char path[] = "/tmp/test_search_engine_modelXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    FILE *model = fdopen(fd, "w");
+    fprintf(model, "gbdt %d 1 0.25\ntree 1\n0 -1 0 0 0 2\n", RANKING_FEATURE_COUNT);
+    fclose(model);
+    CHECK(searchengine_loadReranker(engine, path));
+    unlink(path);
+
+    response = run(engine, "merge");
+    CHECK(response && response->hitCount == 1);
+    if (response && response->hitCount == 1) {
+        RankingBreakdown *breakdown = searchresponse_explain(response, 0);
+        CHECK(breakdown->reranked);
+        CHECK(breakdown->modelScore == 2.25);
+        CHECK(breakdown->modelScore == response->hits[0].score);
+        CHECK(breakdown->baseScore > 0);
+    }
+    searchresponse_free(response);
+    searchengine_free(engine);
+}
+
+static void testModelPagesPastItsWindow(void) {
+    // "merge" makes up a larger share of each earlier document, so candidates
+    // come in docId order, and the model scores every hit alike, which also
+    // ranks them by docId
+    SearchEngine *engine = searchengine_create();
+    char ids[20][8], names[20][16], contents[20][128];
+    for (int i = 0; i < 20; i++) {
+        snprintf(ids[i], sizeof(ids[i]), "d%02d", i);
+        snprintf(names[i], sizeof(names[i]), "d%02d.txt", i);
+        contents[i][0] = '\0';
+        for (int w = 0; w < 20; w++) strcat(contents[i], w < 20 - i ? "merge " : "other ");
+        File file = makeFile(ids[i], names[i], contents[i], 1);
+        searchengine_indexFile(engine, &file);
+    }
+    char path[] = "/tmp/test_search_engine_modelXXXXXX";
+    int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    FILE *model = fdopen(fd, "w");
+    fprintf(model, "gbdt %d 1 0\ntree 1\n0 -1 0 0 0 1\n", RANKING_FEATURE_COUNT);
+    fclose(model);
+    CHECK(searchengine_loadReranker(engine, path));
+    unlink(path);
+
+    // The model sees 5 candidates per page, yet pages keep filling until
+    // every hit was served once
+    int seen[20] = {0};
+    int pages = 0, total = 0;
+    char cursor[SEARCH_CURSOR_LENGTH] = "";
+    for (;;) {
+        SearchRequest request = {0};
+        request.query = "merge";
+        request.scope = "all";
+        request.limit = 3;
+        request.rerankDepth = 5;
+        request.searchAfter = pages ? cursor : NULL;
+        SearchResponse *response = searchengine_execute(engine, &request);
+        CHECK(response != NULL);
+        if (!response || response->hitCount == 0) {
+            searchresponse_free(response);
+            break;
+        }
+        CHECK(response->hitCount == (total + 3 <= 20 ? 3 : 20 - total));
+        for (int i = 0; i < response->hitCount; i++) {
+            SearchResult *result = searchresponse_result(response, i);
+            CHECK(response->hits[i].docId == total + i);
+            CHECK(!seen[response->hits[i].docId]);
+            seen[response->hits[i].docId] = 1;
+            if (i == response->hitCount - 1) strcpy(cursor, result->cursor);
+        }
+        total += response->hitCount;
+        pages++;
+        searchresponse_free(response);
+        if (pages > 20) break;
+    }
+    CHECK(total == 20);
+    CHECK(pages == 7);
+    searchengine_free(engine);
+}
+
+static void testRemovedTextLeavesNgrams(void) {
+    SearchEngine *engine = searchengine_create();
+    File conflict = makeFile("conflict", "conflict.txt", "merge conflict resolved", 1);
+    File request = makeFile("request", "request.txt", "merge request opened", 2);
+    searchengine_indexFile(engine, &conflict);
+    searchengine_indexFile(engine, &request);
+
+    const char *context[] = { "merge" };
+    NgramCandidate candidates[4];
+    CHECK(ngram_complete(engine->ngrams, context, 1, "", candidates, 4) == 2);
+
+    searchengine_removeFile(engine, "conflict");
+    int count = ngram_complete(engine->ngrams, context, 1, "", candidates, 4);
+    CHECK(count == 1);
+    if (count == 1) CHECK(strcmp(candidates[0].word, "request") == 0);
+    const char *removed[] = { "resolved" };
+    CHECK(ngram_complete(engine->ngrams, removed, 1, "", candidates, 4) == 0);
+    searchengine_free(engine);
+}
+
+static int filteredHits(SearchEngine *engine, char *query, char **types, int typeCount,
+                        long dateFrom, long dateTo, int *docIds) {
+    SearchRequest request = {0};
+    request.query = query;
+    request.scope = "all";
+    request.limit = 10;
+    request.fileTypes = types;
+    request.fileTypesCount = typeCount;
+    request.dateFrom = dateFrom;
+    request.dateTo = dateTo;
+    SearchResponse *response = searchengine_execute(engine, &request);
+    CHECK(response != NULL);
+    if (!response) return -1;
+    int count = response->hitCount;
+    for (int i = 0; i < count; i++) docIds[i] = response->hits[i].docId;
+    searchresponse_free(response);
+    return count;
+}
+
+static int holds(const int *docIds, int count, int docId) {
+    for (int i = 0; i < count; i++) {
+        if (docIds[i] == docId) return 1;
+    }
+    return 0;
+}
+
+static void testTypeAndDateFilters(void) {
+    SearchEngine *engine = searchengine_create();
+    char ids[6][4], names[6][12];
+    for (int i = 0; i < 6; i++) {
+        snprintf(ids[i], sizeof(ids[i]), "f%d", i);
+        snprintf(names[i], sizeof(names[i]), "f%d.%s", i, i % 2 ? "md" : "txt");
+        File file = makeFile(ids[i], names[i], i == 3 ? "merge rare" : "merge", (i + 1) * 1000L);
+        file.type = i % 2 ? "md" : "txt";
+        searchengine_indexFile(engine, &file);
+    }
+
+    int docIds[10];
+    char *md[] = { "md" };
+    char *both[] = { "md", "txt" };
+    char *pdf[] = { "pdf" };
+    CHECK(filteredHits(engine, "merge", md, 1, 0, 0, docIds) == 3);
+    CHECK(holds(docIds, 3, 1) && holds(docIds, 3, 3) && holds(docIds, 3, 5));
+    CHECK(filteredHits(engine, "merge", both, 2, 0, 0, docIds) == 6);
+    CHECK(filteredHits(engine, "merge", pdf, 1, 0, 0, docIds) == 0);
+
+    // Bounds are inclusive; a range narrower than the postings becomes a bitmap
+    CHECK(filteredHits(engine, "merge", NULL, 0, 2000, 4000, docIds) == 3);
+    CHECK(holds(docIds, 3, 1) && holds(docIds, 3, 2) && holds(docIds, 3, 3));
+    CHECK(filteredHits(engine, "merge", md, 1, 2000, 4000, docIds) == 2);
+    CHECK(holds(docIds, 2, 1) && holds(docIds, 2, 3));
+    CHECK(filteredHits(engine, "merge", NULL, 0, 4500, 0, docIds) == 2);
+    CHECK(filteredHits(engine, "merge", NULL, 0, 7000, 8000, docIds) == 0);
+
+    // A wide range over a rare term is tested per posting instead
+    CHECK(filteredHits(engine, "rare", NULL, 0, 1000, 5000, docIds) == 1);
+    CHECK(filteredHits(engine, "rare", NULL, 0, 4500, 0, docIds) == 0);
+    CHECK(filteredHits(engine, "rare", pdf, 1, 1000, 5000, docIds) == 0);
+
+    // Removed documents leave both filters
+    searchengine_removeFile(engine, "f3");
+    CHECK(filteredHits(engine, "merge", md, 1, 2000, 4000, docIds) == 1);
+    CHECK(filteredHits(engine, "merge", NULL, 0, 2000, 4000, docIds) == 2);
+    searchengine_free(engine);
+}
+
+static char* explain(SearchEngine *engine, char *query) {
+    SearchRequest request = {0};
+    request.query = query;
+    request.scope = "all";
+    return searchengine_explain(engine, &request);
+}
+
+static void testExplainShowsPlan(void) {
+    SearchEngine *engine = searchengine_create();
+    char ids[50][8], contents[50][32];
+    for (int i = 0; i < 50; i++) {
+        snprintf(ids[i], sizeof(ids[i]), "d%d", i);
+        snprintf(contents[i], sizeof(contents[i]), "%s %s", i % 2 ? "merge" : "rebase",
+                 i % 10 == 0 ? "conflict" : "branch");
+        File file = makeFile(ids[i], "doc.txt", contents[i], i * 1000L);
+        file.type = i % 5 ? "txt" : "md";
+        searchengine_indexFile(engine, &file);
+    }
+
+    // The rarer term drives the intersection and the other is probed
+    char *text = explain(engine, "merge AND conflict");
+    CHECK(strncmp(text, "filter none\nintersect ", 22) == 0);
+    CHECK(strstr(text, "  drive terms [scan] all: {conflict} postings=5") != NULL);
+    CHECK(strstr(text, "  then terms [probe] all: {merge} postings=25") != NULL);
+    free(text);
+
+    text = explain(engine, "merge OR rebase");
+    CHECK(strstr(text, "terms [accumulate] all: {merge rebase} postings=50") != NULL);
+    free(text);
+    text = explain(engine, "merge -conflict");
+    CHECK(strstr(text, "  exclude terms [probe] all: {conflict}") != NULL);
+    free(text);
+    text = explain(engine, "\"merge conflict\"");
+    CHECK(strstr(text, "phrase all: \"merge conflict\"") != NULL);
+    free(text);
+    text = explain(engine, "reb*");
+    CHECK(strstr(text, "terms [scan] all: \"reb\" {rebase}") != NULL);
+    free(text);
+    text = explain(engine, "content:merge");
+    CHECK(strstr(text, "terms [scan] content: {merge}") != NULL);
+    free(text);
+    text = explain(engine, "zzz");
+    CHECK(strstr(text, "empty postings=0") != NULL);
+    free(text);
+
+    text = explain(engine, "(merge");
+    CHECK(strcmp(text, "unbalanced parentheses\n") == 0);
+    free(text);
+    text = explain(engine, "");
+    CHECK(strcmp(text, "empty query\n") == 0);
+    free(text);
+
+    // Filters are reported above the plan they narrow
+    char *md[] = { "md" };
+    SearchRequest request = {0};
+    request.query = "merge AND conflict";
+    request.scope = "all";
+    request.fileTypes = md;
+    request.fileTypesCount = 1;
+    request.dateFrom = 1000;
+    request.dateTo = 10000;
+    text = searchengine_explain(engine, &request);
+    CHECK(strncmp(text, "filter docs=2\n", 14) == 0);
+    free(text);
+    request.dateTo = 3000;
+    text = searchengine_explain(engine, &request);
+    CHECK(strcmp(text, "filter matches nothing\n") == 0);
+    free(text);
+    searchengine_free(engine);
+}
+
+static int isExact(SearchResponse *response, int i) {
+    SearchResult *result = searchresponse_result(response, i);
+    return result && strcmp(result->matchType, "exact") == 0;
+}
+
+static void testExactMatchFollowsQueryTerms(void) {
+    SearchEngine *engine = searchengine_create();
+    File literal = makeFile("literal", "literal.txt", "merge and rebase", 1);
+    File apart = makeFile("apart", "apart.txt", "rebase first, then merge", 2);
+    File conflict = makeFile("conflict", "conflict.txt", "a merge conflict here", 3);
+    File config = makeFile("config", "config.txt", "settings", 4);
+    searchengine_indexFile(engine, &literal);
+    searchengine_indexFile(engine, &apart);
+    searchengine_indexFile(engine, &conflict);
+    searchengine_indexFile(engine, &config);
+
+    // Operators are syntax: both documents hold both terms and neither the
+    // operator's text nor its order matters
+    SearchResponse *response = run(engine, "merge AND rebase");
+    CHECK(response && response->hitCount == 2);
+    for (int i = 0; response && i < response->hitCount; i++) {
+        CHECK(isExact(response, i));
+        SearchResult *result = searchresponse_result(response, i);
+        CHECK(strstr(result->highlightedSnippet, "<b>and</b>") == NULL);
+        CHECK(strstr(result->highlightedSnippet, "<b>merge</b>") != NULL);
+    }
+    searchresponse_free(response);
+
+    // A quoted phrase is the same text as the bare words
+    response = run(engine, "\"merge conflict\"");
+    CHECK(response && response->hitCount == 1);
+    if (response && response->hitCount == 1) CHECK(isExact(response, 0));
+    searchresponse_free(response);
+
+    // Excluded terms are not asked for
+    response = run(engine, "merge -conflict");
+    CHECK(response && response->hitCount == 2);
+    for (int i = 0; response && i < response->hitCount; i++) CHECK(isExact(response, i));
+    searchresponse_free(response);
+
+    // The field prefix only scopes the term
+    response = run(engine, "filename:config");
+    CHECK(response && response->hitCount == 1);
+    if (response && response->hitCount == 1) CHECK(isExact(response, 0));
+    searchresponse_free(response);
+
+    // A prefix stands for the terms it expanded to
+    response = run(engine, "reb*");
+    CHECK(response && response->hitCount == 2);
+    for (int i = 0; response && i < response->hitCount; i++) {
+        CHECK(isExact(response, i));
+        SearchResult *result = searchresponse_result(response, i);
+        CHECK(strstr(result->highlightedSnippet, "<b>rebase</b>") != NULL);
+    }
+    searchresponse_free(response);
+    searchengine_free(engine);
+}
+
+int main(void) {
+    testChurnPastInitialCapacity();
+    testUnbalancedQueryIsRejected();
+    testImpactsFollowTheirTerm();
+    testFilenameWeighting();
+    testResultsBuiltOnDemand();
+    testCursorPagesWithRerankDepth();
+    testExplainShowsModelScore();
+    testModelPagesPastItsWindow();
+    testExactMatchFollowsQueryTerms();
+    testRemovedTextLeavesNgrams();
+    testTypeAndDateFilters();
+    testExplainShowsPlan();
+    if (failures) {
+        fprintf(stderr, "test_search_engine: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_search_engine: ok\n");
+    return 0;
+}
@@ -0,0 +1,113 @@
+#define _POSIX_C_SOURCE 200809L
+#include "snippet.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+// Every highlight covers one of the terms, case aside, inside the plain text
+static void checkHighlights(const Snippet *snippet, char **terms, int termCount) {
+    for (int h = 0; h < snippet->highlightCount; h++) {
+        const HighlightRange *range = &snippet->highlights[h];
+        CHECK(range->start >= 0 && range->start + range->length <= (int)strlen(snippet->text));
+        int matched = 0;
+        for (int t = 0; t < termCount && !matched; t++) {
+            matched = (int)strlen(terms[t]) == range->length &&
+                      strncasecmp(snippet->text + range->start, terms[t], range->length) == 0;
+        }
+        CHECK(matched);
+    }
+}
+
+static void testWindowWithMostDistinctTerms(void) {
+    // A lone "merge" early, then both terms together much later
+    char content[1024] = "merge ";
+    for (int i = 0; i < 40; i++) strcat(content, "filler ");
+    strcat(content, "then Merge the conflict here ");
+    for (int i = 0; i < 40; i++) strcat(content, "filler ");
+    char *terms[] = { "merge", "conflict" };
+
+    Snippet *snippet = snippet_create(content, terms, 2, 60);
+    CHECK(strncmp(snippet->text, "...", 3) == 0);
+    CHECK(strstr(snippet->text, "Merge the conflict") != NULL);
+    CHECK(strstr(snippet->highlighted, "<b>Merge</b> the <b>conflict</b>") != NULL);
+    CHECK(snippet->highlightCount == 2);
+    checkHighlights(snippet, terms, 2);
+    // Cut at word boundaries, not inside "filler"
+    CHECK(strncmp(snippet->text, "...filler", 9) == 0 || strncmp(snippet->text, "... ", 4) == 0);
+    size_t length = strlen(snippet->text);
+    CHECK(length >= 3 && strcmp(snippet->text + length - 3, "...") == 0);
+    snippet_free(snippet);
+}
+
+static void testTiesGoToMoreHits(void) {
+    char content[1024] = "merge once ";
+    for (int i = 0; i < 30; i++) strcat(content, "filler ");
+    strcat(content, "merge merge merge ");
+    for (int i = 0; i < 30; i++) strcat(content, "filler ");
+    char *terms[] = { "merge" };
+
+    Snippet *snippet = snippet_create(content, terms, 1, 40);
+    CHECK(snippet->highlightCount == 3);
+    CHECK(strstr(snippet->text, "merge once") == NULL);
+    checkHighlights(snippet, terms, 1);
+    snippet_free(snippet);
+}
+
+static void testMarkupIsEscaped(void) {
+    const char *content = "if (a < b && c > d) <merge> \"here\"";
+    char *terms[] = { "merge" };
+    Snippet *snippet = snippet_create(content, terms, 1, 200);
+    CHECK(strcmp(snippet->text, content) == 0);
+    CHECK(strcmp(snippet->highlighted,
+                 "if (a &lt; b &amp;&amp; c &gt; d) &lt;<b>merge</b>&gt; \"here\"") == 0);
+    CHECK(snippet->highlightCount == 1);
+    if (snippet->highlightCount == 1) CHECK(snippet->highlights[0].start == 21);
+    snippet_free(snippet);
+
+    // Worst case: every byte escapes
+    char ampersands[256];
+    memset(ampersands, '&', 200);
+    strcpy(ampersands + 200, " merge");
+    snippet = snippet_create(ampersands, terms, 1, 300);
+    CHECK(strstr(snippet->highlighted, "&amp;&amp; <b>merge</b>") != NULL);
+    snippet_free(snippet);
+}
+
+static void testNoMatchKeepsTheStart(void) {
+    char content[512] = "";
+    for (int i = 0; i < 40; i++) strcat(content, "words ");
+    char *terms[] = { "merge" };
+    Snippet *snippet = snippet_create(content, terms, 1, 50);
+    CHECK(strncmp(snippet->text, "words", 5) == 0);
+    CHECK(snippet->highlightCount == 0);
+    CHECK(strstr(snippet->highlighted, "<b>") == NULL);
+
+    // Whole words only
+    snippet_free(snippet);
+    snippet = snippet_create("merged and remerge", terms, 1, 50);
+    CHECK(snippet->highlightCount == 0);
+    snippet_free(snippet);
+}
+
+int main(void) {
+    testWindowWithMostDistinctTerms();
+    testTiesGoToMoreHits();
+    testMarkupIsEscaped();
+    testNoMatchKeepsTheStart();
+    if (failures) {
+        fprintf(stderr, "test_snippet: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_snippet: ok\n");
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "storage.h"
+#include "autocomplete.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static void testIdLookupAfterDelete(void) {
+    Storage *storage = storage_create();
+    File *first = storage_addFile(storage, "first.txt", "merge conflict", 14, "txt");
+    File *second = storage_addFile(storage, "second.txt", "rebase onto main", 16, "txt");
+    File *third = storage_addFile(storage, "third.txt", "cherry pick", 11, "txt");
+    CHECK(storage_getFile(storage, first->id) == first);
+    CHECK(storage_getFile(storage, third->id) == third);
+
+    // Lookups probe past the removed key; the removed id is gone for good
+    char removed[37];
+    strcpy(removed, second->id);
+    CHECK(storage_deleteFile(storage, removed) == 1);
+    CHECK(storage_getFile(storage, removed) == NULL);
+    CHECK(storage_deleteFile(storage, removed) == 0);
+    CHECK(storage_getFile(storage, first->id) == first && storage_getFile(storage, third->id) == third);
+
+    // The next add takes the freed slot under a new id
+    File *fourth = storage_addFile(storage, "fourth.txt", "squash", 6, "txt");
+    CHECK(fourth == second && storage->slotCount == 3);
+    CHECK(strcmp(fourth->id, removed) != 0 && storage_getFile(storage, fourth->id) == fourth);
+    CHECK(storage_getFile(storage, removed) == NULL);
+    CHECK(strcmp(fourth->filename, "fourth.txt") == 0);
+
+    // Churn leaves removed keys behind; rehashing drops them rather than
+    // growing the table
+    char kept[37];
+    strcpy(kept, first->id);
+    for (int i = 0; i < 5000; i++) {
+        File *file = storage_addFile(storage, "churn.txt", "churn", 5, "txt");
+        char id[37];
+        strcpy(id, file->id);
+        CHECK(storage_deleteFile(storage, id) == 1);
+    }
+    CHECK(storage->slotCount == 4 && storage->idSlotCapacity == 1024);
+    CHECK(storage_getFile(storage, kept) == first && storage_getFile(storage, fourth->id) == fourth);
+    SearchStats *stats = storage_getStats(storage);
+    CHECK(stats->totalFiles == 3 && stats->indexSize == 14 + 11 + 6);
+    free(stats);
+    storage_free(storage);
+}
+
+static void testFullStorage(void) {
+    Storage *storage = storage_create();
+    for (int i = 0; i < STORAGE_MAX_FILES; i++) {
+        CHECK(storage_addFile(storage, "file.txt", "text", 4, "txt") != NULL);
+    }
+    CHECK(storage_addFile(storage, "over.txt", "text", 4, "txt") == NULL);
+
+    // Every id is still found once the table has grown
+    int count;
+    File *files = storage_getAllFiles(storage, &count);
+    CHECK(count == STORAGE_MAX_FILES && storage->idSlotCapacity > 2 * STORAGE_MAX_FILES);
+    for (int i = 0; i < count; i++) CHECK(storage_getFile(storage, files[i].id) == &files[i]);
+
+    CHECK(storage_deleteFile(storage, files[1234].id) == 1);
+    File *file = storage_addFile(storage, "again.txt", "text", 4, "txt");
+    CHECK(file == &files[1234] && storage_getFile(storage, file->id) == file);
+    storage_free(storage);
+}
+
+static void testPopularQueries(void) {
+    Storage *storage = storage_create();
+    for (int i = 0; i < 5; i++) storage_addSearchHistory(storage, "git rebase", 3);
+    for (int i = 0; i < 3; i++) storage_addSearchHistory(storage, "Git Merge ", 2);
+    storage_addSearchHistory(storage, "grep", 1);
+
+    // Queries are counted normalized, most searched first
+    PopularQuery popular[8];
+    int count = storage_getPopularQueries(storage, "git", popular, 8);
+    CHECK(count == 2);
+    if (count == 2) {
+        CHECK(strcmp(popular[0].query, "git rebase") == 0);
+        CHECK(strcmp(popular[1].query, "git merge") == 0);
+        CHECK(popular[0].count > popular[1].count);
+    }
+    CHECK(storage_getPopularQueries(storage, NULL, popular, 8) == 3);
+    CHECK(storage_getPopularQueries(storage, "svn", popular, 8) == 0);
+    storage_free(storage);
+}
+
+static void testHistoryWrapsAround(void) {
+    Storage *storage = storage_create();
+    char query[32];
+    int total = SEARCH_HISTORY_CAPACITY + 250;
+    for (int i = 0; i < total; i++) {
+        snprintf(query, sizeof(query), "%s %d", i % 2 ? "merge" : "rebase", i);
+        storage_addSearchHistory(storage, i % 5 ? query : "wrapped search", i);
+    }
+
+    // The ring keeps the latest searches, oldest first
+    int count;
+    SearchHistory *history = storage_getSearchHistory(storage, total, &count);
+    CHECK(count == SEARCH_HISTORY_CAPACITY);
+    if (count == SEARCH_HISTORY_CAPACITY) {
+        CHECK(history[0].resultsCount == total - SEARCH_HISTORY_CAPACITY);
+        CHECK(history[count - 1].resultsCount == total - 1);
+        snprintf(query, sizeof(query), "merge %d", total - 1);
+        CHECK(strcmp(history[count - 1].query, query) == 0);
+    }
+    free(history);
+
+    // Popularity counted every search before the ring overwrote it
+    PopularQuery popular[1];
+    CHECK(storage_getPopularQueries(storage, "wrapped", popular, 1) == 1);
+    CHECK(popular[0].count > (total / 5) * 0.99);
+    storage_free(storage);
+}
+
+static void testPopularSuggestions(void) {
+    Storage *storage = storage_create();
+    for (int i = 0; i < 4; i++) storage_addSearchHistory(storage, "merge conflict", 1);
+    storage_addSearchHistory(storage, "merge request", 1);
+    storage_addSearchHistory(storage, "rebase", 1);
+
+    CHECK(init_autocomplete_system() == 0);
+    autocomplete_result_t results[MAX_AUTOCOMPLETE_SUGGESTIONS];
+    CHECK(get_popular_suggestions("merge", results, MAX_AUTOCOMPLETE_SUGGESTIONS) == 0);
+
+    set_popularity_source(storage->popularity);
+    int count = get_popular_suggestions("merge", results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    CHECK(count == 2);
+    if (count == 2) {
+        CHECK(strcmp(results[0].suggestion, "merge conflict") == 0);
+        CHECK(strcmp(results[1].suggestion, "merge request") == 0);
+        CHECK(results[0].score > results[1].score);
+    }
+    CHECK(get_popular_suggestions("merge", results, 1) == 1);
+
+    // Searches recorded later show up without another attach
+    for (int i = 0; i < 10; i++) storage_addSearchHistory(storage, "merge request", 1);
+    count = get_popular_suggestions("merge", results, MAX_AUTOCOMPLETE_SUGGESTIONS);
+    CHECK(count == 2);
+    if (count == 2) CHECK(strcmp(results[0].suggestion, "merge request") == 0);
+
+    set_popularity_source(NULL);
+    cleanup_autocomplete_system();
+    storage_free(storage);
+}
+
+int main(void) {
+    testIdLookupAfterDelete();
+    testFullStorage();
+    testPopularQueries();
+    testHistoryWrapsAround();
+    testPopularSuggestions();
+    if (failures) {
+        fprintf(stderr, "test_storage: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_storage: ok\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "strsearch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static unsigned char fold(unsigned char c) {
+    return c >= 'A' && c <= 'Z' ? c + 32 : c;
+}
+
+static const char* naiveFind(const char *haystack, size_t haystackLen, const char *needle, size_t needleLen) {
+    for (size_t i = 0; i + needleLen <= haystackLen; i++) {
+        size_t j = 0;
+        while (j < needleLen && fold((unsigned char)haystack[i + j]) == fold((unsigned char)needle[j])) j++;
+        if (j == needleLen) return haystack + i;
+    }
+    return NULL;
+}
+
+// Letters of both cases and the bytes either side of the letter ranges, so
+// folding anything but A-Z would show
+static const char alphabet[] = "aAbBzZ@[`{\xc1\xe1";
+
+static void testMatchesNaiveSearch(void) {
+    unsigned int seed = 99;
+    for (size_t haystackLen = 1; haystackLen <= 80; haystackLen++) {
+        // Exactly haystackLen bytes and no terminator, so reading past the
+        // tail is caught by the sanitizers
+        char *haystack = (char *)malloc(haystackLen);
+        for (int round = 0; round < 20; round++) {
+            for (size_t i = 0; i < haystackLen; i++) {
+                seed = seed * 1103515245 + 12345;
+                haystack[i] = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+            }
+            seed = seed * 1103515245 + 12345;
+            size_t needleLen = 1 + (seed >> 16) % (haystackLen < 40 ? haystackLen : 40);
+            seed = seed * 1103515245 + 12345;
+            size_t at = (seed >> 16) % (haystackLen - needleLen + 1);
+
+            // A copy of some slice with its case flipped, or random bytes
+            char needle[41];
+            for (size_t j = 0; j < needleLen; j++) {
+                char c = haystack[at + j];
+                if (round % 3 == 2) {
+                    seed = seed * 1103515245 + 12345;
+                    c = alphabet[(seed >> 16) % (sizeof(alphabet) - 1)];
+                } else if (c >= 'a' && c <= 'z') {
+                    c -= 32;
+                } else if (c >= 'A' && c <= 'Z') {
+                    c += 32;
+                }
+                needle[j] = c;
+            }
+            const char *expected = naiveFind(haystack, haystackLen, needle, needleLen);
+            CHECK(strsearch_find(haystack, haystackLen, needle, needleLen) == expected);
+            if (round % 3 != 2) CHECK(expected != NULL);
+        }
+        free(haystack);
+    }
+}
+
+static void testMatchAtTheLastByte(void) {
+    for (size_t haystackLen = 1; haystackLen <= 70; haystackLen++) {
+        char *haystack = (char *)malloc(haystackLen);
+        memset(haystack, 'x', haystackLen);
+        haystack[haystackLen - 1] = 'Q';
+        CHECK(strsearch_find(haystack, haystackLen, "q", 1) == haystack + haystackLen - 1);
+        if (haystackLen >= 2) {
+            haystack[haystackLen - 2] = 'p';
+            CHECK(strsearch_find(haystack, haystackLen, "PQ", 2) == haystack + haystackLen - 2);
+            CHECK(strsearch_find(haystack, haystackLen, "pQx", 3) == NULL);
+        }
+        // '[' is 'Z' + 1 and '{' is 'z' + 1; neither folds
+        haystack[haystackLen - 1] = '[';
+        CHECK(strsearch_find(haystack, haystackLen, "{", 1) == NULL);
+        free(haystack);
+    }
+    CHECK(strsearch_find("abc", 3, "", 0) != NULL);
+    CHECK(strsearch_find("ab", 2, "abc", 3) == NULL);
+}
+
+int main(void) {
+    testMatchesNaiveSearch();
+    testMatchAtTheLastByte();
+    if (failures) {
+        fprintf(stderr, "test_strsearch: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_strsearch: ok\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "trigram_index.h"
+#include "fuzzy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int failures = 0;
+
+#define CHECK(condition) do { \
+    if (!(condition)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+        failures++; \
+    } \
+} while (0)
+
+static int contains(const int *docIds, int count, int docId) {
+    for (int i = 0; i < count; i++) {
+        if (docIds[i] == docId) return 1;
+    }
+    return 0;
+}
+
+static void testApproximateThreshold(void) {
+    TrigramIndex *index = trigramindex_create();
+    const char *names[] = {
+        "configuration.txt",   // the query itself
+        "confiquration.txt",   // one substitution: three of its eleven trigrams lost
+        "cxnfiguratixn.txt",   // two substitutions near the ends: four lost
+        "readme.md",
+    };
+    for (int i = 0; i < 4; i++) trigramindex_addDocument(index, i, names[i]);
+
+    int count;
+    int *candidates = trigramindex_getCandidates(index, "configuration", 0, &count);
+    CHECK(count == 1 && candidates[0] == 0);
+    free(candidates);
+
+    // One edit may destroy three trigrams, so eight of eleven must remain
+    candidates = trigramindex_getCandidates(index, "configuration", 1, &count);
+    CHECK(count == 2);
+    CHECK(contains(candidates, count, 0) && contains(candidates, count, 1));
+    free(candidates);
+
+    candidates = trigramindex_getCandidates(index, "configuration", 2, &count);
+    CHECK(count == 3 && !contains(candidates, count, 3));
+    free(candidates);
+
+    // Too few trigrams to require any: the caller verifies every document
+    candidates = trigramindex_getCandidates(index, "config", 2, &count);
+    CHECK(count == -1 && candidates == NULL);
+    candidates = trigramindex_getCandidates(index, "rm", 0, &count);
+    CHECK(count == -1 && candidates == NULL);
+    trigramindex_free(index);
+}
+
+// Candidates are a superset of what fuzzy_substringDistance accepts
+static void testNoFalseNegatives(void) {
+    TrigramIndex *index = trigramindex_create();
+    char names[300][16];
+    unsigned int seed = 7;
+    for (int d = 0; d < 300; d++) {
+        int length = 8 + d % 7;
+        for (int i = 0; i < length; i++) {
+            seed = seed * 1103515245 + 12345;
+            names[d][i] = "abcde"[(seed >> 16) % 5];
+        }
+        names[d][length] = '\0';
+        trigramindex_addDocument(index, d, names[d]);
+    }
+
+    const char *queries[] = { "abcdea", "eedcba", "aabbccdd", "cdecdecde", "badcab" };
+    for (int q = 0; q < 5; q++) {
+        for (int maxDistance = 0; maxDistance <= 1; maxDistance++) {
+            int count;
+            int *candidates = trigramindex_getCandidates(index, queries[q], maxDistance, &count);
+            for (int d = 0; d < 300 && count >= 0; d++) {
+                if (fuzzy_substringDistance(queries[q], names[d], maxDistance) <= maxDistance) {
+                    CHECK(contains(candidates, count, d));
+                }
+            }
+            for (int i = 1; i < count; i++) CHECK(candidates[i - 1] < candidates[i]);
+            free(candidates);
+        }
+    }
+    trigramindex_free(index);
+}
+
+int main(void) {
+    testApproximateThreshold();
+    testNoFalseNegatives();
+    if (failures) {
+        fprintf(stderr, "test_trigram_index: %d failed\n", failures);
+        return 1;
+    }
+    printf("test_trigram_index: ok\n");
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "trigram_index.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+TrigramIndex* trigramindex_create(void) {
+    TrigramIndex *index = (TrigramIndex *)malloc(sizeof(TrigramIndex));
+    index->postingCapacity = 4096;
+    index->postings = (TrigramPosting *)calloc(index->postingCapacity, sizeof(TrigramPosting));
+    index->postingCount = 0;
+    index->maxDocId = -1;
+    return index;
+}
+
+static uint32_t trigramAt(const char *text, int i) {
+    return ((uint32_t)(unsigned char)tolower((unsigned char)text[i]) << 16) |
+           ((uint32_t)(unsigned char)tolower((unsigned char)text[i + 1]) << 8) |
+           (uint32_t)(unsigned char)tolower((unsigned char)text[i + 2]);
+}
+
+static int slotFor(TrigramIndex *index, uint32_t trigram) {
+    int mask = index->postingCapacity - 1;
+    int slot = (int)((trigram * 2654435761u) & mask);
+    while (index->postings[slot].docIds && index->postings[slot].trigram != trigram) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+static TrigramPosting* findPosting(TrigramIndex *index, uint32_t trigram) {
+    TrigramPosting *posting = &index->postings[slotFor(index, trigram)];
+    return posting->docIds ? posting : NULL;
+}
+
+static void growPostings(TrigramIndex *index) {
+    TrigramPosting *old = index->postings;
+    int oldCapacity = index->postingCapacity;
+    index->postingCapacity *= 2;
+    index->postings = (TrigramPosting *)calloc(index->postingCapacity, sizeof(TrigramPosting));
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].docIds) {
+            index->postings[slotFor(index, old[i].trigram)] = old[i];
+        }
+    }
+    free(old);
+}
+
+void trigramindex_addDocument(TrigramIndex *index, int docId, const char *text) {
+    int len = strlen(text);
+    for (int i = 0; i + 2 < len; i++) {
+        if (index->postingCount * 2 >= index->postingCapacity) {
+            growPostings(index);
+        }
+        uint32_t trigram = trigramAt(text, i);
+        TrigramPosting *posting = &index->postings[slotFor(index, trigram)];
+        if (!posting->docIds) {
+            posting->trigram = trigram;
+            posting->docCapacity = 4;
+            posting->docIds = (int *)malloc(sizeof(int) * posting->docCapacity);
+            posting->docCount = 0;
+            index->postingCount++;
+        }
+        // Doc ids arrive in increasing order, so a repeated trigram is always the tail
+        if (posting->docCount > 0 && posting->docIds[posting->docCount - 1] == docId) continue;
+        if (posting->docCount == posting->docCapacity) {
+            posting->docCapacity *= 2;
+            posting->docIds = (int *)realloc(posting->docIds, sizeof(int) * posting->docCapacity);
+        }
+        posting->docIds[posting->docCount++] = docId;
+    }
+    if (docId > index->maxDocId) index->maxDocId = docId;
+}
+
+static int lowerBound(const int *values, int count, int target) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (values[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void trigramindex_removeDocument(TrigramIndex *index, int docId, const char *text) {
+    int len = strlen(text);
+    for (int i = 0; i + 2 < len; i++) {
+        TrigramPosting *posting = findPosting(index, trigramAt(text, i));
+        if (!posting) continue;
+        int pos = lowerBound(posting->docIds, posting->docCount, docId);
+        if (pos < posting->docCount && posting->docIds[pos] == docId) {
+            memmove(&posting->docIds[pos], &posting->docIds[pos + 1],
+                    sizeof(int) * (posting->docCount - pos - 1));
+            posting->docCount--;
+        }
+    }
+}
+
+static int compareByDocCount(const void *a, const void *b) {
+    const TrigramPosting *postingA = *(const TrigramPosting * const *)a;
+    const TrigramPosting *postingB = *(const TrigramPosting * const *)b;
+    return postingA->docCount - postingB->docCount;
+}
+
+int* trigramindex_getCandidates(TrigramIndex *index, const char *query, int maxDistance, int *count) {
+    int len = strlen(query);
+    *count = -1;
+    if (len < 3) return NULL;
+
+    int gramCount = 0;
+    uint32_t *grams = (uint32_t *)malloc(sizeof(uint32_t) * (len - 2));
+    for (int i = 0; i + 2 < len; i++) {
+        uint32_t trigram = trigramAt(query, i);
+        int duplicate = 0;
+        for (int j = 0; j < gramCount; j++) {
+            if (grams[j] == trigram) {
+                duplicate = 1;
+                break;
+            }
+        }
+        if (!duplicate) grams[gramCount++] = trigram;
+    }
+
+    // Each edit can destroy at most three of the query's trigrams
+    int required = gramCount - 3 * (maxDistance > 0 ? maxDistance : 0);
+    if (required <= 0) {
+        free(grams);
+        return NULL;
+    }
+
+    TrigramPosting **lists = (TrigramPosting **)malloc(sizeof(TrigramPosting *) * gramCount);
+    int listCount = 0;
+    for (int i = 0; i < gramCount; i++) {
+        TrigramPosting *posting = findPosting(index, grams[i]);
+        if (posting && posting->docCount > 0) lists[listCount++] = posting;
+    }
+    free(grams);
+
+    int *result = NULL;
+    *count = 0;
+    if (listCount < required) {
+        free(lists);
+        return NULL;
+    }
+
+    if (required == gramCount) {
+        // Exact substring: intersect smallest list first, binary-searching the rest
+        qsort(lists, listCount, sizeof(TrigramPosting *), compareByDocCount);
+        result = (int *)malloc(sizeof(int) * lists[0]->docCount);
+        memcpy(result, lists[0]->docIds, sizeof(int) * lists[0]->docCount);
+        *count = lists[0]->docCount;
+        for (int i = 1; i < listCount && *count > 0; i++) {
+            int kept = 0, from = 0;
+            for (int j = 0; j < *count; j++) {
+                from += lowerBound(lists[i]->docIds + from, lists[i]->docCount - from, result[j]);
+                if (from < lists[i]->docCount && lists[i]->docIds[from] == result[j]) {
+                    result[kept++] = result[j];
+                }
+            }
+            *count = kept;
+        }
+    } else {
+        // Approximate: keep docs that share at least `required` distinct trigrams
+        unsigned short *hits = (unsigned short *)calloc(index->maxDocId + 1, sizeof(unsigned short));
+        for (int i = 0; i < listCount; i++) {
+            for (int j = 0; j < lists[i]->docCount; j++) {
+                hits[lists[i]->docIds[j]]++;
+            }
+        }
+        result = (int *)malloc(sizeof(int) * (index->maxDocId + 1));
+        for (int docId = 0; docId <= index->maxDocId; docId++) {
+            if (hits[docId] >= required) result[(*count)++] = docId;
+        }
+        free(hits);
+    }
+
+    free(lists);
+    return result;
+}
+
+void trigramindex_free(TrigramIndex *index) {
+    if (!index) return;
+    for (int i = 0; i < index->postingCapacity; i++) {
+        free(index->postings[i].docIds);
+    }
+    free(index->postings);
+    free(index);
+}
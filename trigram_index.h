@@ -0,0 +1,28 @@
+#ifndef TRIGRAM_INDEX_H
+#define TRIGRAM_INDEX_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t trigram;
+    int *docIds;      // ascending
+    int docCount;
+    int docCapacity;
+} TrigramPosting;
+
+typedef struct {
+    TrigramPosting *postings;
+    int postingCount;
+    int postingCapacity;
+    int maxDocId;
+} TrigramIndex;
+
+TrigramIndex* trigramindex_create(void);
+void trigramindex_addDocument(TrigramIndex *index, int docId, const char *text);
+void trigramindex_removeDocument(TrigramIndex *index, int docId, const char *text);
+// Returns ascending doc ids that may contain query within maxDistance edits.
+// *count is -1 when the query is too short to filter on; callers then verify every doc.
+int* trigramindex_getCandidates(TrigramIndex *index, const char *query, int maxDistance, int *count);
+void trigramindex_free(TrigramIndex *index);
+
+#endif